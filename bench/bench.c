@@ -0,0 +1,258 @@
+// 基准测试程序：在进程内加载 bench 目录中的基准程序（由同名 .wat 文件编译得到的 .wasm 文件），对每个基准程序先预热再重复执行多次，
+// 以 JSON 格式将每次调用（即 op）的耗时统计、CPU 指令数以及消耗的燃料输出到标准输出，便于比较不同提交之间的性能差异
+//
+// 用法：wasmc-bench [-w N] [-r N] [-d DIR] [NAME ...]
+// -w N   预热的调用次数，默认为 3
+// -r N   计时的调用次数，默认为 20
+// -d DIR 基准程序目录，默认为 bench
+// NAME   只运行指定的基准程序（例如 fib sieve），不指定时运行全部基准程序
+//
+// 每次调用的结果都会与期望值比较，结果不正确的基准程序不输出统计数据（error 字段为异常信息），此时返回值为 1
+// 注：CPU 指令数通过 perf_event_open 读取硬件计数器（只统计用户态），内核或者虚拟机不支持时为 null；
+// 燃料即虚拟机在安全点扣除的指令数量（按照函数和 loop 控制块计算，不依赖硬件计数器），可以作为字节码指令数量的近似值
+
+#include "interpreter.h"
+#include "module.h"
+#include "utils.h"
+#include <inttypes.h>
+#include <linux/perf_event.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_DIR "bench"// 默认的基准程序目录
+#define PATH_SIZE 1024   // 文件路径的最大长度
+
+// 基准程序
+typedef struct Kernel {
+    const char *name;  // 名称
+    const char *file;  // .wasm 文件名（不含目录）
+    const char *export;// 导出函数名，函数只有一个 i32 参数，返回 i32 或者 i64
+    uint32_t arg;      // 调用参数，决定每次调用的工作量
+    uint64_t expected; // 期望的返回值（i32 时只比较低 32 位）
+} Kernel;
+
+// 基准程序的工作量大致相同（每次调用几毫秒），修改参数时需要同时修改期望的返回值
+Kernel kernels[] = {
+        {"fib", "fib.wasm", "fib", 20, 6765},
+        {"sieve", "sieve.wasm", "sieve", 16384, 1900},
+        {"matmul", "matmul.wasm", "matmul", 32, 0x2aa000},
+        {"memset", "memops.wasm", "memset", 65536, 0x5a5a5a5a},
+        {"memcpy", "memops.wasm", "memcpy", 65536, 0x6d736177},
+        {"dispatch", "dispatch.wasm", "dispatch", 2000, 0x6347afc1},
+        {"vcall", "vcall.wasm", "vcall", 20000, 0x4edb19d0},
+        {"floatmath", "floatmath.wasm", "floatmath", 20000, 3141592775},
+};
+
+// 耗时统计（纳秒）
+typedef struct Stats {
+    double median;
+    double mean;
+    double min;
+    double max;
+    double stddev;
+} Stats;
+
+// 获取单调时钟的纳秒数
+uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+// 比较两个 double，用于排序后计算中位数
+int compare_double(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return x < y ? -1 : x > y;
+}
+
+// 计算 count 个样本的统计数据（会对 samples 排序）
+Stats compute_stats(double *samples, uint32_t count) {
+    Stats s = {0};
+    qsort(samples, count, sizeof(double), compare_double);
+    s.min = samples[0];
+    s.max = samples[count - 1];
+    s.median = count % 2 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+    for (uint32_t i = 0; i < count; i++) {
+        s.mean += samples[i];
+    }
+    s.mean /= count;
+    for (uint32_t i = 0; i < count; i++) {
+        s.stddev += (samples[i] - s.mean) * (samples[i] - s.mean);
+    }
+    s.stddev = count > 1 ? sqrt(s.stddev / (count - 1)) : 0;
+    return s;
+}
+
+// 打开当前线程在用户态执行的 CPU 指令数的硬件计数器，不支持时返回 -1
+int open_instruction_counter(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// 以参数 arg 调用一次导出函数，返回调用是否成功以及返回值是否与期望值一致
+bool call_kernel(Instance *inst, uint32_t handle, Kernel *k, uint8_t result_type) {
+    inst->sp = -1;
+    inst->fp = -1;
+    inst->csp = -1;
+    inst->stack[++inst->sp].value.uint32 = k->arg;
+    inst->stack[inst->sp].value_type = I32;
+    if (!invoke_export(inst, handle)) {
+        return false;
+    }
+    StackValue *got = &inst->stack[inst->sp];
+    bool ok = result_type == I64 ? got->value.uint64 == k->expected : got->value.uint32 == (uint32_t) k->expected;
+    if (!ok) {
+        snprintf(inst->exception, sizeof(inst->exception), "unexpected result 0x%" PRIx64,
+                 result_type == I64 ? got->value.uint64 : (uint64_t) got->value.uint32);
+    }
+    return ok;
+}
+
+// 运行一个基准程序，并以 JSON 对象的格式输出结果，返回基准程序是否运行成功
+bool run_kernel(Kernel *k, const char *dir, uint32_t warmup, uint32_t reps, int counter) {
+    char path[PATH_SIZE];
+    snprintf(path, PATH_SIZE, "%s/%s", dir, k->file);
+    printf("    {\"name\": \"%s\", \"export\": \"%s\", \"arg\": %u, ", k->name, k->export, k->arg);
+
+    int byte_count;
+    uint8_t *bytes = mmap_file(path, &byte_count);
+    if (!bytes) {
+        printf("\"error\": \"could not load %s\"}", path);
+        return false;
+    }
+    Options options = {0};
+    Module *m = load_module(bytes, byte_count, options);
+    Instance *inst = instantiate(m);
+
+    uint32_t handle = resolve_export(m, k->export);
+    Block *func = handle == EXPORT_HANDLE_INVALID ? NULL : get_export_by_handle(inst, handle);
+    bool ok = func && m->exports[handle].external_kind == KIND_FUNCTION && func->type->param_count == 1 &&
+              func->type->result_count == 1 && (func->type->results[0] == I32 || func->type->results[0] == I64);
+    if (!ok) {
+        printf("\"error\": \"%s is not a function with signature (i32) -> i32 or i64\"}", k->export);
+        free_instance(inst);
+        free_module(m);
+        munmap(bytes, (size_t) byte_count);
+        return false;
+    }
+    uint8_t result_type = (uint8_t) func->type->results[0];
+
+    // 预热：触发延迟分配（例如内存页的缺页异常），并使 CPU 缓存和分支预测器进入稳定状态
+    for (uint32_t i = 0; ok && i < warmup; i++) {
+        ok = call_kernel(inst, handle, k, result_type);
+    }
+
+    double *ns = acalloc(reps, sizeof(double), "bench ns");
+    double *instructions = acalloc(reps, sizeof(double), "bench instructions");
+    int64_t fuel = 0;
+    for (uint32_t i = 0; ok && i < reps; i++) {
+        inst->fuel = FUEL_UNLIMITED;
+        if (counter >= 0) {
+            ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        uint64_t start = bench_now_ns();
+        ok = call_kernel(inst, handle, k, result_type);
+        ns[i] = (double) (bench_now_ns() - start);
+        if (counter >= 0) {
+            uint64_t count = 0;
+            ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(counter, &count, sizeof(count)) != sizeof(count)) {
+                count = 0;
+            }
+            instructions[i] = (double) count;
+        }
+        fuel = FUEL_UNLIMITED - inst->fuel;
+    }
+
+    if (ok) {
+        Stats s = compute_stats(ns, reps);
+        printf("\"ns_per_op\": {\"median\": %.0f, \"mean\": %.0f, \"min\": %.0f, \"max\": %.0f, \"stddev\": %.0f}, ",
+               s.median, s.mean, s.min, s.max, s.stddev);
+        if (counter >= 0) {
+            printf("\"instructions_per_op\": %.0f, ", compute_stats(instructions, reps).median);
+        } else {
+            printf("\"instructions_per_op\": null, ");
+        }
+        printf("\"fuel_per_op\": %" PRId64 "}", fuel);
+    } else {
+        printf("\"error\": \"%s\"}", inst->exception);
+    }
+
+    free(ns);
+    free(instructions);
+    free_instance(inst);
+    free_module(m);
+    munmap(bytes, (size_t) byte_count);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    const char *dir = BENCH_DIR;
+    uint32_t warmup = 3, reps = 20;
+
+    int arg_idx = 1;
+    for (; arg_idx < argc && argv[arg_idx][0] == '-'; arg_idx++) {
+        if (strcmp(argv[arg_idx], "-w") == 0 && arg_idx + 1 < argc) {
+            warmup = (uint32_t) strtoul(argv[++arg_idx], NULL, 0);
+        } else if (strcmp(argv[arg_idx], "-r") == 0 && arg_idx + 1 < argc) {
+            reps = (uint32_t) strtoul(argv[++arg_idx], NULL, 0);
+            reps = reps ? reps : 1;
+        } else if (strcmp(argv[arg_idx], "-d") == 0 && arg_idx + 1 < argc) {
+            dir = argv[++arg_idx];
+        } else {
+            fprintf(stderr, "The right usage is:\n%s [-w N] [-r N] [-d DIR] [NAME ...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    uint32_t kernel_count = sizeof(kernels) / sizeof(kernels[0]);
+    for (int i = arg_idx; i < argc; i++) {
+        bool found = false;
+        for (uint32_t j = 0; j < kernel_count; j++) {
+            found = found || strcmp(argv[i], kernels[j].name) == 0;
+        }
+        if (!found) {
+            fprintf(stderr, "Unknown kernel %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    int counter = open_instruction_counter();
+    printf("{\n  \"warmup\": %u,\n  \"reps\": %u,\n  \"kernels\": [\n", warmup, reps);
+    bool ok = true, first = true;
+    for (uint32_t j = 0; j < kernel_count; j++) {
+        bool selected = arg_idx == argc;
+        for (int i = arg_idx; i < argc; i++) {
+            selected = selected || strcmp(argv[i], kernels[j].name) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+        printf(first ? "" : ",\n");
+        first = false;
+        ok = run_kernel(&kernels[j], dir, warmup, reps, counter) && ok;
+        fflush(stdout);
+    }
+    printf("\n  ]\n}\n");
+    if (counter >= 0) {
+        close(counter);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+;; 以 br_table 分派的字节码虚拟机，执行内存中的小程序 n 轮，主要开销为 br_table 跳转
+;; 指令：0 acc += cnt，1 acc = rotl(acc, 3) ^ cnt，2 acc *= 31，3 cnt -= 1，4 cnt 不为 0 时跳转到程序开头，5 停机
+(module
+  (memory 1)
+  (data (i32.const 0) "\00\01\02\00\02\01\03\04\05")
+  (func $dispatch (export "dispatch") (param $cnt i32) (result i32)
+    (local $pc i32)
+    (local $acc i32)
+    block $halt
+      loop $next
+        block $op5
+          block $op4
+            block $op3
+              block $op2
+                block $op1
+                  block $op0
+                    local.get $pc
+                    i32.load8_u
+                    local.get $pc
+                    i32.const 1
+                    i32.add
+                    local.set $pc
+                    br_table $op0 $op1 $op2 $op3 $op4 $op5 $halt
+                  end
+                  local.get $acc
+                  local.get $cnt
+                  i32.add
+                  local.set $acc
+                  br $next
+                end
+                local.get $acc
+                i32.const 3
+                i32.rotl
+                local.get $cnt
+                i32.xor
+                local.set $acc
+                br $next
+              end
+              local.get $acc
+              i32.const 31
+              i32.mul
+              local.set $acc
+              br $next
+            end
+            local.get $cnt
+            i32.const 1
+            i32.sub
+            local.set $cnt
+            br $next
+          end
+          local.get $cnt
+          if
+            i32.const 0
+            local.set $pc
+          end
+          br $next
+        end
+        br $halt
+      end
+    end
+    local.get $acc))
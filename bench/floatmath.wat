@@ -0,0 +1,50 @@
+;; 以中点法对 4 * sqrt(1 - x^2) 在 [0, 1] 上分 n 段求积分（即近似计算 π），返回结果乘以 10^9 后取整
+;; 主要开销为 f64 的算术运算、类型转换和 sqrt
+(module
+  (func $floatmath (export "floatmath") (param $n i32) (result i64)
+    (local $i i32)
+    (local $h f64)
+    (local $x f64)
+    (local $sum f64)
+    f64.const 1
+    local.get $n
+    f64.convert_i32_s
+    f64.div
+    local.set $h
+    block $done
+      loop $next
+        local.get $i
+        local.get $n
+        i32.ge_s
+        br_if $done
+        local.get $i
+        f64.convert_i32_s
+        f64.const 0.5
+        f64.add
+        local.get $h
+        f64.mul
+        local.tee $x
+        local.get $x
+        f64.mul
+        f64.const 1
+        f64.sub
+        f64.neg
+        f64.sqrt
+        local.get $sum
+        f64.add
+        local.set $sum
+        local.get $i
+        i32.const 1
+        i32.add
+        local.set $i
+        br $next
+      end
+    end
+    local.get $sum
+    local.get $h
+    f64.mul
+    f64.const 4
+    f64.mul
+    f64.const 1e9
+    f64.mul
+    i64.trunc_f64_s))
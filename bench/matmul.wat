@@ -0,0 +1,138 @@
+;; n×n 的 i32 矩阵乘法 C = A × B（n 不超过 64），其中 A[i][j] = i + j，B[i][j] = i - j，返回 C 中所有元素之和
+;; A、B、C 分别位于内存偏移 0、16384、32768 处，主要开销为三重循环和 i32 的访存
+(module
+  (memory 1)
+  (func $matmul (export "matmul") (param $n i32) (result i32)
+    (local $i i32)
+    (local $j i32)
+    (local $k i32)
+    (local $sum i32)
+    (local $total i32)
+    ;; 初始化 A 和 B
+    block $init_done
+      loop $init_i
+        local.get $i
+        local.get $n
+        i32.ge_u
+        br_if $init_done
+        i32.const 0
+        local.set $j
+        block $init_row_done
+          loop $init_j
+            local.get $j
+            local.get $n
+            i32.ge_u
+            br_if $init_row_done
+            local.get $i
+            local.get $n
+            i32.mul
+            local.get $j
+            i32.add
+            i32.const 2
+            i32.shl
+            local.tee $k
+            local.get $i
+            local.get $j
+            i32.add
+            i32.store
+            local.get $k
+            local.get $i
+            local.get $j
+            i32.sub
+            i32.store offset=16384
+            local.get $j
+            i32.const 1
+            i32.add
+            local.set $j
+            br $init_j
+          end
+        end
+        local.get $i
+        i32.const 1
+        i32.add
+        local.set $i
+        br $init_i
+      end
+    end
+    ;; C = A × B
+    i32.const 0
+    local.set $i
+    block $mul_done
+      loop $mul_i
+        local.get $i
+        local.get $n
+        i32.ge_u
+        br_if $mul_done
+        i32.const 0
+        local.set $j
+        block $row_done
+          loop $mul_j
+            local.get $j
+            local.get $n
+            i32.ge_u
+            br_if $row_done
+            i32.const 0
+            local.set $sum
+            i32.const 0
+            local.set $k
+            block $dot_done
+              loop $mul_k
+                local.get $k
+                local.get $n
+                i32.ge_u
+                br_if $dot_done
+                local.get $i
+                local.get $n
+                i32.mul
+                local.get $k
+                i32.add
+                i32.const 2
+                i32.shl
+                i32.load
+                local.get $k
+                local.get $n
+                i32.mul
+                local.get $j
+                i32.add
+                i32.const 2
+                i32.shl
+                i32.load offset=16384
+                i32.mul
+                local.get $sum
+                i32.add
+                local.set $sum
+                local.get $k
+                i32.const 1
+                i32.add
+                local.set $k
+                br $mul_k
+              end
+            end
+            local.get $i
+            local.get $n
+            i32.mul
+            local.get $j
+            i32.add
+            i32.const 2
+            i32.shl
+            local.get $sum
+            i32.store offset=32768
+            local.get $total
+            local.get $sum
+            i32.add
+            local.set $total
+            local.get $j
+            i32.const 1
+            i32.add
+            local.set $j
+            br $mul_j
+          end
+        end
+        local.get $i
+        i32.const 1
+        i32.add
+        local.set $i
+        br $mul_i
+      end
+    end
+    local.get $total))
@@ -0,0 +1,83 @@
+;; 不依赖批量内存指令的 memset 和 memcpy（len 不超过 65536），按 8 字节一次处理，剩余不足 8 字节的部分逐字节处理
+;; memset 填充 [0, len)，memcpy 将 [0, len) 复制到 [65536, 65536 + len)，主要开销为循环和 i64 的访存
+(module
+  (memory 2)
+  (data (i32.const 0) "wasmc-bench")
+  (func $memset (export "memset") (param $len i32) (result i32)
+    (local $i i32)
+    block $words_done
+      loop $words
+        local.get $i
+        i32.const 8
+        i32.add
+        local.get $len
+        i32.gt_u
+        br_if $words_done
+        local.get $i
+        i64.const 0x5a5a5a5a5a5a5a5a
+        i64.store offset=65536
+        local.get $i
+        i32.const 8
+        i32.add
+        local.set $i
+        br $words
+      end
+    end
+    block $bytes_done
+      loop $bytes
+        local.get $i
+        local.get $len
+        i32.ge_u
+        br_if $bytes_done
+        local.get $i
+        i32.const 0x5a
+        i32.store8 offset=65536
+        local.get $i
+        i32.const 1
+        i32.add
+        local.set $i
+        br $bytes
+      end
+    end
+    local.get $len
+    i32.load offset=65532)
+  (func $memcpy (export "memcpy") (param $len i32) (result i32)
+    (local $i i32)
+    block $words_done
+      loop $words
+        local.get $i
+        i32.const 8
+        i32.add
+        local.get $len
+        i32.gt_u
+        br_if $words_done
+        local.get $i
+        local.get $i
+        i64.load
+        i64.store offset=65536
+        local.get $i
+        i32.const 8
+        i32.add
+        local.set $i
+        br $words
+      end
+    end
+    block $bytes_done
+      loop $bytes
+        local.get $i
+        local.get $len
+        i32.ge_u
+        br_if $bytes_done
+        local.get $i
+        local.get $i
+        i32.load8_u
+        i32.store8 offset=65536
+        local.get $i
+        i32.const 1
+        i32.add
+        local.set $i
+        br $bytes
+      end
+    end
+    i32.const 0
+    i32.load offset=65536))
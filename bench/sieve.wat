@@ -0,0 +1,71 @@
+;; 埃拉托斯特尼筛法，统计小于 n 的素数数量（n 不超过 65536），主要开销为循环、分支和单字节的访存
+(module
+  (memory 1)
+  (func $sieve (export "sieve") (param $n i32) (result i32)
+    (local $i i32)
+    (local $j i32)
+    (local $count i32)
+    ;; 清零标记（每次调用都重新筛选）
+    i32.const 0
+    local.set $i
+    block $clear_done
+      loop $clear
+        local.get $i
+        local.get $n
+        i32.ge_u
+        br_if $clear_done
+        local.get $i
+        i32.const 0
+        i32.store8
+        local.get $i
+        i32.const 1
+        i32.add
+        local.set $i
+        br $clear
+      end
+    end
+    i32.const 2
+    local.set $i
+    block $outer_done
+      loop $outer
+        local.get $i
+        local.get $n
+        i32.ge_u
+        br_if $outer_done
+        local.get $i
+        i32.load8_u
+        i32.eqz
+        if
+          local.get $count
+          i32.const 1
+          i32.add
+          local.set $count
+          local.get $i
+          local.get $i
+          i32.mul
+          local.set $j
+          block $inner_done
+            loop $inner
+              local.get $j
+              local.get $n
+              i32.ge_u
+              br_if $inner_done
+              local.get $j
+              i32.const 1
+              i32.store8
+              local.get $j
+              local.get $i
+              i32.add
+              local.set $j
+              br $inner
+            end
+          end
+        end
+        local.get $i
+        i32.const 1
+        i32.add
+        local.set $i
+        br $outer
+      end
+    end
+    local.get $count))
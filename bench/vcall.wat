@@ -0,0 +1,47 @@
+;; 通过 call_indirect 轮流调用表中的 4 个函数 n 次，模拟虚函数调用，主要开销为间接调用时的签名检查和函数调用
+(module
+  (type $binop (func (param i32 i32) (result i32)))
+  (table 4 funcref)
+  (elem (i32.const 0) $add $sub $xor $mul)
+  (func $add (param i32 i32) (result i32)
+    local.get 0
+    local.get 1
+    i32.add)
+  (func $sub (param i32 i32) (result i32)
+    local.get 0
+    local.get 1
+    i32.sub)
+  (func $xor (param i32 i32) (result i32)
+    local.get 0
+    local.get 1
+    i32.xor)
+  (func $mul (param i32 i32) (result i32)
+    local.get 0
+    local.get 1
+    i32.const 1
+    i32.or
+    i32.mul)
+  (func $vcall (export "vcall") (param $n i32) (result i32)
+    (local $i i32)
+    (local $acc i32)
+    block $done
+      loop $next
+        local.get $i
+        local.get $n
+        i32.ge_u
+        br_if $done
+        local.get $acc
+        local.get $i
+        local.get $i
+        i32.const 3
+        i32.and
+        call_indirect (type $binop)
+        local.set $acc
+        local.get $i
+        i32.const 1
+        i32.add
+        local.set $i
+        br $next
+      end
+    end
+    local.get $acc))
@@ -0,0 +1,247 @@
+#include "aio.h"
+#include "import.h"
+#include "utils.h"
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// 创建容量为 entries 的 io_uring，内核不支持时返回 NULL
+IoRing *create_io_ring(uint32_t entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    IoRing *ring = acalloc(1, sizeof(IoRing), "IoRing");
+    ring->fd = fd;
+    ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    // 内核支持时提交队列和完成队列可以通过一次 mmap 映射
+    bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap && ring->cq_size > ring->sq_size) {
+        ring->sq_size = ring->cq_size;
+    }
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        FATAL("Could not map io_uring submission queue: %s\n", strerror(errno))
+    }
+    if (single_mmap) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            FATAL("Could not map io_uring completion queue: %s\n", strerror(errno))
+        }
+    }
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        FATAL("Could not map io_uring submission queue entries: %s\n", strerror(errno))
+    }
+
+    uint8_t *sq = ring->sq_ptr;
+    ring->sq_head = (_Atomic uint32_t *) (sq + p.sq_off.head);
+    ring->sq_tail = (_Atomic uint32_t *) (sq + p.sq_off.tail);
+    ring->sq_mask = *(uint32_t *) (sq + p.sq_off.ring_mask);
+    ring->sq_entries = *(uint32_t *) (sq + p.sq_off.ring_entries);
+    ring->sq_array = (uint32_t *) (sq + p.sq_off.array);
+
+    uint8_t *cq = ring->cq_ptr;
+    ring->cq_head = (_Atomic uint32_t *) (cq + p.cq_off.head);
+    ring->cq_tail = (_Atomic uint32_t *) (cq + p.cq_off.tail);
+    ring->cq_mask = *(uint32_t *) (cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+    pthread_mutex_init(&ring->lock, NULL);
+    return ring;
+}
+
+// 释放 io_uring
+void free_io_ring(IoRing *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_size);
+    }
+    munmap(ring->sq_ptr, ring->sq_size);
+    close(ring->fd);
+    pthread_mutex_destroy(&ring->lock);
+    free(ring);
+}
+
+// 将已累积的请求提交给内核（调用前需要持有 ring->lock）
+void submit_locked(IoRing *ring) {
+    uint32_t queued = atomic_load_explicit(&ring->queued, memory_order_relaxed);
+    while (queued > 0) {
+        int n = (int) syscall(__NR_io_uring_enter, ring->fd, queued, 0, 0, NULL, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // 内核暂时无法接收更多请求（例如完成队列已满），保留剩余的请求等下次提交
+            break;
+        }
+        queued -= (uint32_t) n;
+        if (n == 0) {
+            break;
+        }
+    }
+    atomic_store_explicit(&ring->queued, queued, memory_order_relaxed);
+}
+
+// 将请求加入提交队列
+bool io_ring_queue(IoRing *ring, const AioRequest *req, uint64_t user_data) {
+    pthread_mutex_lock(&ring->lock);
+
+    // 只有持有锁的线程会写入提交队列，所以队列尾部可以直接读取，而队列头部由内核更新
+    uint32_t tail = atomic_load_explicit(ring->sq_tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(ring->sq_head, memory_order_acquire) >= ring->sq_entries) {
+        submit_locked(ring);
+        if (tail - atomic_load_explicit(ring->sq_head, memory_order_acquire) >= ring->sq_entries) {
+            pthread_mutex_unlock(&ring->lock);
+            return false;
+        }
+    }
+
+    uint32_t idx = tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = req->opcode;
+    sqe->fd = req->fd;
+    sqe->addr = (uint64_t) (uintptr_t) req->buf;
+    sqe->len = req->len;
+    sqe->off = req->offset;
+    sqe->user_data = user_data;
+    ring->sq_array[idx] = idx;
+
+    // 先写完提交队列项再更新队列尾部，保证内核读到的是完整的请求
+    atomic_store_explicit(ring->sq_tail, tail + 1, memory_order_release);
+    atomic_fetch_add_explicit(&ring->queued, 1, memory_order_relaxed);
+
+    pthread_mutex_unlock(&ring->lock);
+    return true;
+}
+
+// 将提交队列中累积的请求一次性提交给内核
+void io_ring_submit(IoRing *ring) {
+    if (atomic_load_explicit(&ring->queued, memory_order_relaxed) == 0) {
+        return;
+    }
+    pthread_mutex_lock(&ring->lock);
+    submit_locked(ring);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+// 等待至少一个请求完成，并依次处理所有已完成的请求
+void io_ring_wait(IoRing *ring, void (*handler)(uint64_t user_data, int32_t res, void *arg), void *arg) {
+    uint32_t head = atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+    while (head == atomic_load_explicit(ring->cq_tail, memory_order_acquire)) {
+        int n = (int) syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (n < 0 && errno != EINTR) {
+            FATAL("Could not wait for io_uring completions: %s\n", strerror(errno))
+        }
+    }
+
+    // 请求一定是在某次释放 ring->lock 之前加入提交队列的，这里获取一次锁，使提交请求的线程在此之前的写入（例如实例的运行时状态）
+    // 对完成线程可见，而不依赖内核中的同步（内核中的同步对线程检查工具不可见）
+    pthread_mutex_lock(&ring->lock);
+    pthread_mutex_unlock(&ring->lock);
+
+    uint32_t tail = atomic_load_explicit(ring->cq_tail, memory_order_acquire);
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+        uint64_t user_data = cqe->user_data;
+        int32_t res = cqe->res;
+        head++;
+        // 先取出完成队列项的内容再更新队列头部，此后内核即可复用该位置
+        atomic_store_explicit(ring->cq_head, head, memory_order_release);
+        handler(user_data, res, arg);
+    }
+}
+
+// 同步执行请求
+int32_t aio_execute(const AioRequest *req) {
+    ssize_t n;
+    switch (req->opcode) {
+        case IORING_OP_READ:
+            n = req->offset == UINT64_MAX ? read(req->fd, req->buf, req->len)
+                                          : pread(req->fd, req->buf, req->len, (off_t) req->offset);
+            break;
+        case IORING_OP_WRITE:
+            n = req->offset == UINT64_MAX ? write(req->fd, req->buf, req->len)
+                                          : pwrite(req->fd, req->buf, req->len, (off_t) req->offset);
+            break;
+        case IORING_OP_RECV:
+            n = recv(req->fd, req->buf, req->len, 0);
+            break;
+        default:
+            return -EINVAL;
+    }
+    return n < 0 ? -errno : (int32_t) n;
+}
+
+// 异步宿主函数的公共部分：检查缓冲区，实例在调度器中执行时记录请求并请求暂停，否则同步执行
+bool submit_request(Instance *inst, uint8_t opcode, StackValue *args, uint64_t offset, StackValue *results) {
+    Memory *mem = instance_memory(inst);
+    uint32_t ptr = args[1].value.uint32;
+    uint32_t len = args[2].value.uint32;
+    uint32_t pages = atomic_load_explicit((_Atomic uint32_t *) &mem->cur_size, memory_order_acquire);
+    if ((uint64_t) ptr + len > (uint64_t) pages * PAGE_SIZE) {
+        sprintf(inst->exception, "out of bounds memory access");
+        return false;
+    }
+
+    AioRequest req = {
+            .opcode = opcode,
+            .fd = args[0].value.int32,
+            .buf = mem->bytes + ptr,
+            .len = len,
+            .offset = offset,
+    };
+    if (!inst->aio) {
+        results[0].value.int32 = aio_execute(&req);
+        return true;
+    }
+
+    // 返回值只是占位，请求完成后会被实际结果覆盖
+    *inst->aio = req;
+    inst->suspend_request = TRAP_WAIT_IO;
+    results[0].value.int32 = 0;
+    return true;
+}
+
+// aio.read(fd: i32, ptr: i32, len: i32, offset: i64) -> i32
+bool aio_read(Instance *inst, StackValue *args, StackValue *results) {
+    return submit_request(inst, IORING_OP_READ, args, args[3].value.uint64, results);
+}
+
+// aio.write(fd: i32, ptr: i32, len: i32, offset: i64) -> i32
+bool aio_write(Instance *inst, StackValue *args, StackValue *results) {
+    return submit_request(inst, IORING_OP_WRITE, args, args[3].value.uint64, results);
+}
+
+// aio.recv(fd: i32, ptr: i32, len: i32) -> i32
+bool aio_recv(Instance *inst, StackValue *args, StackValue *results) {
+    return submit_request(inst, IORING_OP_RECV, args, 0, results);
+}
+
+// 在进程内注册模块名为 aio 的异步宿主函数
+void register_aio_imports(void) {
+    static const HostSymbol symbols[] = {
+            {"read", (void *) aio_read},
+            {"recv", (void *) aio_recv},
+            {"write", (void *) aio_write},
+    };
+    register_host_symbols("aio", symbols, sizeof(symbols) / sizeof(symbols[0]));
+}
@@ -0,0 +1,80 @@
+#ifndef WASMC_AIO_H
+#define WASMC_AIO_H
+
+#include "module.h"
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AIO_QUEUE_DEPTH 256// io_uring 提交队列的容量
+#define AIO_SUBMIT_BATCH 32// 提交队列中累积的请求达到该数量时，即使工作线程仍有其他任务也会立即提交给内核
+
+// io_uring 实例（不依赖 liburing，直接通过系统调用创建并映射提交队列和完成队列）
+typedef struct IoRing {
+    int fd;// io_uring_setup 返回的文件描述符
+
+    // 提交队列，由多个工作线程共享（由 lock 保护）
+    pthread_mutex_t lock;
+    _Atomic uint32_t *sq_head;
+    _Atomic uint32_t *sq_tail;
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    uint32_t *sq_array;
+    struct io_uring_sqe *sqes;
+    _Atomic uint32_t queued;// 已写入提交队列但尚未通过 io_uring_enter 提交给内核的请求数量
+
+    // 完成队列，只由完成线程读取
+    _Atomic uint32_t *cq_head;
+    _Atomic uint32_t *cq_tail;
+    uint32_t cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // 映射的内存
+    void *sq_ptr;
+    size_t sq_size;
+    void *cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+} IoRing;
+
+// 异步 I/O 请求，由异步宿主函数填写，实例暂停后再由调度器加入提交队列
+// 注：宿主函数返回后解释器还要压入返回值，如果在宿主函数中直接提交，请求可能在返回值（占位）压入之前就已完成
+typedef struct AioRequest {
+    uint8_t opcode; // io_uring 操作码（IORING_OP_READ、IORING_OP_WRITE 或 IORING_OP_RECV）
+    int fd;         // 文件描述符
+    uint8_t *buf;   // 实例内存中的缓冲区
+    uint32_t len;   // 缓冲区的字节数
+    uint64_t offset;// 文件偏移，为 UINT64_MAX 时使用文件的当前位置
+} AioRequest;
+
+// 创建容量为 entries 的 io_uring，内核不支持时返回 NULL
+IoRing *create_io_ring(uint32_t entries);
+
+// 释放 io_uring
+void free_io_ring(IoRing *ring);
+
+// 将请求加入提交队列（不会立即提交给内核），请求完成时完成队列项的 user_data 即参数 user_data
+// 提交队列已满时会先提交已累积的请求，仍然没有空闲位置时返回 false
+bool io_ring_queue(IoRing *ring, const AioRequest *req, uint64_t user_data);
+
+// 将提交队列中累积的请求一次性提交给内核（可以在多个线程中同时调用）
+void io_ring_submit(IoRing *ring);
+
+// 等待至少一个请求完成，并依次对每个完成的请求调用 handler（res 为系统调用的结果，失败时为负的错误码）
+// 注：只能在一个线程（即完成线程）中调用
+void io_ring_wait(IoRing *ring, void (*handler)(uint64_t user_data, int32_t res, void *arg), void *arg);
+
+// 同步执行请求，返回值与 io_uring 的完成队列项中的结果一致
+int32_t aio_execute(const AioRequest *req);
+
+// 在进程内注册模块名为 aio 的异步宿主函数（均返回 i32，成功时为字节数，失败时为负的错误码）：
+// aio.read(fd: i32, ptr: i32, len: i32, offset: i64)，offset 为 -1 时从文件的当前位置读取（例如管道）
+// aio.write(fd: i32, ptr: i32, len: i32, offset: i64)，offset 为 -1 时从文件的当前位置写入
+// aio.recv(fd: i32, ptr: i32, len: i32)，从套接字中读取
+// 实例在调度器中执行时，宿主函数只记录请求并暂停实例（inst->trap 为 TRAP_WAIT_IO），请求完成后由调度器写回结果并恢复执行；
+// 否则（例如在命令行中直接调用）同步执行
+void register_aio_imports(void);
+
+#endif
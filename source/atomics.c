@@ -0,0 +1,377 @@
+#include "atomics.h"
+#include "opcode.h"
+#include "pool.h"
+#include "utils.h"
+#include <errno.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// 原子加载/存储/读-改-写指令都按照 7 条一组排列，组内各条指令访问的字节数以及值类型都相同
+// 例如 i32.atomic.load、i64.atomic.load、i32.atomic.load8_u、i32.atomic.load16_u、i64.atomic.load8_u、i64.atomic.load16_u、i64.atomic.load32_u
+uint32_t atomic_access_sizes[7] = {4, 8, 1, 2, 1, 2, 4};
+uint8_t atomic_value_types[7] = {I32, I64, I32, I32, I64, I64, I64};
+
+// 所有等待队列，挂起的线程按照等待的内存地址分散到各个等待队列中
+WaitQueue wait_queues[WAIT_QUEUE_COUNT] = {[0 ... WAIT_QUEUE_COUNT - 1] = {PTHREAD_MUTEX_INITIALIZER, NULL, NULL}};
+
+// 按照访问的字节数 size，对地址 maddr 上的值执行 C11 原子读-改-写操作 op，并将操作前的值（零扩展）赋给 res
+#define ATOMIC_RMW(op, maddr, size, operand, res)                                \
+    switch (size) {                                                              \
+        case 1:                                                                  \
+            res = op((_Atomic uint8_t *) (maddr), (uint8_t) (operand));          \
+            break;                                                               \
+        case 2:                                                                  \
+            res = op((_Atomic uint16_t *) (maddr), (uint16_t) (operand));        \
+            break;                                                               \
+        case 4:                                                                  \
+            res = op((_Atomic uint32_t *) (maddr), (uint32_t) (operand));        \
+            break;                                                               \
+        default:                                                                 \
+            res = op((_Atomic uint64_t *) (maddr), (uint64_t) (operand));        \
+            break;                                                               \
+    }
+
+// 创建页数为 min_size、最大页数为 max_size 的共享内存
+Memory *create_shared_memory(uint32_t min_size, uint32_t max_size) {
+    Memory *mem = acalloc(1, sizeof(Memory), "Memory");
+    mem->min_size = min_size;
+    mem->max_size = max_size;
+    mem->cur_size = min_size;
+    mem->shared = true;
+    // 按照最大页数预留地址空间，这样内存增长时数据的地址不变，其他线程中的实例可以继续访问
+    mem->bytes = reserve_memory((size_t) max_size * PAGE_SIZE, "Memory->bytes");
+    mem->reserved_size = max_size;
+    return mem;
+}
+
+// 释放共享内存
+void free_shared_memory(Memory *mem) {
+    if (mem->bytes) {
+        munmap(mem->bytes, (size_t) mem->reserved_size * PAGE_SIZE);
+    }
+    free(mem);
+}
+
+// 增长共享内存，成功时返回增长前的页数，超出最大页数时返回 UINT32_MAX
+uint32_t grow_shared_memory(Memory *mem, uint32_t delta) {
+    _Atomic uint32_t *cur_size = (_Atomic uint32_t *) &mem->cur_size;
+    uint32_t prev_pages = atomic_load(cur_size);
+    do {
+        if ((uint64_t) prev_pages + delta > mem->max_size) {
+            return UINT32_MAX;
+        }
+        // 预留的地址空间中超出当前页数的部分始终为 0，所以只需要修改当前页数
+    } while (!atomic_compare_exchange_weak(cur_size, &prev_pages, prev_pages + delta));
+    return prev_pages;
+}
+
+// 执行 futex 系统调用
+long futex(_Atomic uint32_t *uaddr, int op, uint32_t val, const struct timespec *timeout, uint32_t val3) {
+    return syscall(SYS_futex, uaddr, op, val, timeout, NULL, val3);
+}
+
+// 获取地址 maddr 所在的等待队列
+WaitQueue *get_wait_queue(uint8_t *maddr) {
+    return &wait_queues[((uintptr_t) maddr >> 2) % WAIT_QUEUE_COUNT];
+}
+
+// 挂起当前线程，直到其他线程在地址 maddr 上调用 atomic_notify 或者超时
+uint32_t atomic_wait(uint8_t *maddr, uint32_t size, uint64_t expected, int64_t timeout) {
+    WaitQueue *q = get_wait_queue(maddr);
+
+    // 计算超时的绝对时间（FUTEX_WAIT_BITSET 使用 CLOCK_MONOTONIC 的绝对时间）
+    struct timespec deadline;
+    if (timeout >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout / 1000000000;
+        deadline.tv_nsec += timeout % 1000000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    // 比较值和加入等待队列都需要持有等待队列的锁，而唤醒也需要持有同一把锁，
+    // 这样在比较之后修改值并调用 atomic_notify 的线程一定能唤醒当前线程
+    Waiter w = {maddr, 0, NULL};
+    pthread_mutex_lock(&q->lock);
+    uint64_t value = size == 4 ? atomic_load((_Atomic uint32_t *) maddr) : atomic_load((_Atomic uint64_t *) maddr);
+    if (value != expected) {
+        pthread_mutex_unlock(&q->lock);
+        return ATOMIC_WAIT_NOT_EQUAL;
+    }
+    if (q->tail) {
+        q->tail->next = &w;
+    } else {
+        q->head = &w;
+    }
+    q->tail = &w;
+    pthread_mutex_unlock(&q->lock);
+
+    // 在 futex 上挂起，被信号中断或者虚假唤醒时重新挂起
+    while (!atomic_load(&w.notified)) {
+        if (futex(&w.notified, FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG, 0, timeout >= 0 ? &deadline : NULL, FUTEX_BITSET_MATCH_ANY) != 0 && errno == ETIMEDOUT) {
+            break;
+        }
+    }
+    if (atomic_load(&w.notified)) {
+        return ATOMIC_WAIT_OK;
+    }
+
+    // 超时后需要将自身从等待队列中移除，但如果移除前恰好被唤醒，则仍然视为被唤醒
+    pthread_mutex_lock(&q->lock);
+    if (atomic_load(&w.notified)) {
+        pthread_mutex_unlock(&q->lock);
+        return ATOMIC_WAIT_OK;
+    }
+    Waiter *prev = NULL;
+    for (Waiter *cur = q->head; cur != &w; prev = cur, cur = cur->next) {}
+    if (prev) {
+        prev->next = w.next;
+    } else {
+        q->head = w.next;
+    }
+    if (q->tail == &w) {
+        q->tail = prev;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ATOMIC_WAIT_TIMED_OUT;
+}
+
+// 按照挂起的先后顺序唤醒最多 count 个挂起在地址 maddr 上的线程，返回被唤醒的线程数量
+uint32_t atomic_notify(uint8_t *maddr, uint32_t count) {
+    WaitQueue *q = get_wait_queue(maddr);
+    uint32_t woken = 0;
+
+    pthread_mutex_lock(&q->lock);
+    Waiter *prev = NULL;
+    Waiter *cur = q->head;
+    while (cur && woken < count) {
+        // 注：线程被唤醒后 Waiter（位于其栈上）随时可能失效，所以必须在唤醒前读取下一个线程
+        Waiter *next = cur->next;
+        if (cur->addr != maddr) {
+            prev = cur;
+            cur = next;
+            continue;
+        }
+        if (prev) {
+            prev->next = next;
+        } else {
+            q->head = next;
+        }
+        if (q->tail == cur) {
+            q->tail = prev;
+        }
+        atomic_store(&cur->notified, 1);
+        futex(&cur->notified, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, 1, NULL, 0);
+        woken++;
+        cur = next;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return woken;
+}
+
+// 对地址 maddr 上长度为 size 字节的值执行原子比较并交换，返回交换前的值（零扩展）
+// 注：期望值会先被截断为 size 字节再和内存中的值比较
+uint64_t atomic_cmpxchg(uint8_t *maddr, uint32_t size, uint64_t expected, uint64_t replacement) {
+    switch (size) {
+        case 1: {
+            uint8_t old = (uint8_t) expected;
+            atomic_compare_exchange_strong((_Atomic uint8_t *) maddr, &old, (uint8_t) replacement);
+            return old;
+        }
+        case 2: {
+            uint16_t old = (uint16_t) expected;
+            atomic_compare_exchange_strong((_Atomic uint16_t *) maddr, &old, (uint16_t) replacement);
+            return old;
+        }
+        case 4: {
+            uint32_t old = (uint32_t) expected;
+            atomic_compare_exchange_strong((_Atomic uint32_t *) maddr, &old, (uint32_t) replacement);
+            return old;
+        }
+        default: {
+            uint64_t old = expected;
+            atomic_compare_exchange_strong((_Atomic uint64_t *) maddr, &old, replacement);
+            return old;
+        }
+    }
+}
+
+// 校验原子指令访问的内存地址并返回实际内存地址，非法时返回 NULL 并设置 inst->exception
+// 与普通的内存加载/存储指令不同，原子指令要求地址必须按照访问的字节数自然对齐
+uint8_t *atomic_address(Instance *inst, Memory *mem, uint32_t addr, uint32_t offset, uint32_t size) {
+    uint64_t ea = (uint64_t) addr + offset;
+    uint32_t pages = atomic_load_explicit((_Atomic uint32_t *) &mem->cur_size, memory_order_acquire);
+    if (ea + size > (uint64_t) pages * PAGE_SIZE) {
+        sprintf(inst->exception, "out of bounds memory access");
+        return NULL;
+    }
+    if (ea & (size - 1)) {
+        sprintf(inst->exception, "unaligned atomic");
+        return NULL;
+    }
+    return mem->bytes + ea;
+}
+
+// 执行原子指令（操作码前缀 0xFE 之后的部分）
+bool exec_atomic(Instance *inst) {
+    const uint8_t *bytes = inst->module->bytes;
+    StackValue *stack = inst->stack;
+    Memory *mem = instance_memory(inst);
+
+    uint32_t opcode = read_LEB_unsigned(bytes, &inst->pc, 32);
+    if (opcode == AtomicFence) {
+        // atomic.fence 的立即数为保留字节（必须为 0）
+        read_LEB_unsigned(bytes, &inst->pc, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        return true;
+    }
+
+    // 其余原子指令的立即数和内存加载/存储指令相同：第一个立即数表示对齐方式，第二个立即数表示内存偏移量
+    read_LEB_unsigned(bytes, &inst->pc, 32);
+    uint32_t offset = read_LEB_unsigned(bytes, &inst->pc, 32);
+
+    uint8_t *maddr;
+    uint64_t res = 0;
+    switch (opcode) {
+        case AtomicNotify: {
+            // 指令作用：唤醒最多 count 个挂起在该地址上的线程，并将被唤醒的线程数量压入操作数栈顶
+            uint32_t count = stack[inst->sp--].value.uint32;
+            uint32_t addr = stack[inst->sp].value.uint32;
+            if (!(maddr = atomic_address(inst, mem, addr, offset, 4))) {
+                return false;
+            }
+            // 非共享内存上不可能有挂起的线程
+            stack[inst->sp].value.uint64 = mem->shared ? atomic_notify(maddr, count) : 0;
+            stack[inst->sp].value_type = I32;
+            return true;
+        }
+        case AtomicWait32:
+        case AtomicWait64: {
+            // 指令作用：如果该地址上的值等于期望值，则挂起当前线程直到被唤醒或者超时，并将结果压入操作数栈顶
+            uint32_t size = opcode == AtomicWait32 ? 4 : 8;
+            int64_t timeout = stack[inst->sp--].value.int64;
+            uint64_t expected = size == 4 ? stack[inst->sp--].value.uint32 : stack[inst->sp--].value.uint64;
+            uint32_t addr = stack[inst->sp].value.uint32;
+            if (!(maddr = atomic_address(inst, mem, addr, offset, size))) {
+                return false;
+            }
+            // 非共享内存上挂起的线程永远不可能被唤醒
+            if (!mem->shared) {
+                sprintf(inst->exception, "expected shared memory");
+                return false;
+            }
+            stack[inst->sp].value.uint64 = atomic_wait(maddr, size, expected, timeout);
+            stack[inst->sp].value_type = I32;
+            return true;
+        }
+        case I32AtomicLoad ... I64AtomicLoad32U: {
+            // 指令作用：从内存中原子地加载数据，零扩展后压入操作数栈顶
+            uint32_t idx = opcode - I32AtomicLoad;
+            uint32_t addr = stack[inst->sp].value.uint32;
+            if (!(maddr = atomic_address(inst, mem, addr, offset, atomic_access_sizes[idx]))) {
+                return false;
+            }
+            switch (atomic_access_sizes[idx]) {
+                case 1:
+                    res = atomic_load((_Atomic uint8_t *) maddr);
+                    break;
+                case 2:
+                    res = atomic_load((_Atomic uint16_t *) maddr);
+                    break;
+                case 4:
+                    res = atomic_load((_Atomic uint32_t *) maddr);
+                    break;
+                default:
+                    res = atomic_load((_Atomic uint64_t *) maddr);
+                    break;
+            }
+            stack[inst->sp].value.uint64 = res;
+            stack[inst->sp].value_type = atomic_value_types[idx];
+            return true;
+        }
+        case I32AtomicStore ... I64AtomicStore32: {
+            // 指令作用：将操作数栈顶值截断后原子地存储到内存中
+            uint32_t idx = opcode - I32AtomicStore;
+            uint64_t value = stack[inst->sp--].value.uint64;
+            uint32_t addr = stack[inst->sp--].value.uint32;
+            if (!(maddr = atomic_address(inst, mem, addr, offset, atomic_access_sizes[idx]))) {
+                return false;
+            }
+            switch (atomic_access_sizes[idx]) {
+                case 1:
+                    atomic_store((_Atomic uint8_t *) maddr, (uint8_t) value);
+                    break;
+                case 2:
+                    atomic_store((_Atomic uint16_t *) maddr, (uint16_t) value);
+                    break;
+                case 4:
+                    atomic_store((_Atomic uint32_t *) maddr, (uint32_t) value);
+                    break;
+                default:
+                    atomic_store((_Atomic uint64_t *) maddr, value);
+                    break;
+            }
+            return true;
+        }
+        case I32AtomicRmwCmpxchg ... I64AtomicRmw32CmpxchgU: {
+            // 指令作用：如果内存中的值等于期望值，则将其原子地替换为新值，并将内存中原来的值零扩展后压入操作数栈顶
+            uint32_t idx = opcode - I32AtomicRmwCmpxchg;
+            uint64_t replacement = stack[inst->sp--].value.uint64;
+            uint64_t expected = stack[inst->sp--].value.uint64;
+            uint32_t addr = stack[inst->sp].value.uint32;
+            if (!(maddr = atomic_address(inst, mem, addr, offset, atomic_access_sizes[idx]))) {
+                return false;
+            }
+            stack[inst->sp].value.uint64 = atomic_cmpxchg(maddr, atomic_access_sizes[idx], expected, replacement);
+            stack[inst->sp].value_type = atomic_value_types[idx];
+            return true;
+        }
+        case I32AtomicRmwAdd ... I64AtomicRmw32XchgU: {
+            // 指令作用：对内存中的值原子地执行读-改-写操作，并将内存中原来的值零扩展后压入操作数栈顶
+            // 读-改-写指令按照 add、sub、and、or、xor、xchg 的顺序每 7 条一组
+            uint32_t idx = (opcode - I32AtomicRmwAdd) % 7;
+            uint32_t size = atomic_access_sizes[idx];
+            uint64_t operand = stack[inst->sp--].value.uint64;
+            uint32_t addr = stack[inst->sp].value.uint32;
+            if (!(maddr = atomic_address(inst, mem, addr, offset, size))) {
+                return false;
+            }
+            switch ((opcode - I32AtomicRmwAdd) / 7) {
+                case 0:
+                    ATOMIC_RMW(atomic_fetch_add, maddr, size, operand, res)
+                    break;
+                case 1:
+                    ATOMIC_RMW(atomic_fetch_sub, maddr, size, operand, res)
+                    break;
+                case 2:
+                    ATOMIC_RMW(atomic_fetch_and, maddr, size, operand, res)
+                    break;
+                case 3:
+                    ATOMIC_RMW(atomic_fetch_or, maddr, size, operand, res)
+                    break;
+                case 4:
+                    ATOMIC_RMW(atomic_fetch_xor, maddr, size, operand, res)
+                    break;
+                default:
+                    ATOMIC_RMW(atomic_exchange, maddr, size, operand, res)
+                    break;
+            }
+            stack[inst->sp].value.uint64 = res;
+            stack[inst->sp].value_type = atomic_value_types[idx];
+            return true;
+        }
+        default:
+            sprintf(inst->exception, "unknown atomic opcode 0x%x", opcode);
+            return false;
+    }
+}
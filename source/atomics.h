@@ -0,0 +1,51 @@
+#ifndef WASMC_ATOMICS_H
+#define WASMC_ATOMICS_H
+
+#include "module.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define WAIT_QUEUE_COUNT 64// 等待队列的数量，挂起的线程按照等待的内存地址分散到各个等待队列中
+
+// memory.atomic.wait 指令的返回值
+#define ATOMIC_WAIT_OK 0       // 被 memory.atomic.notify 唤醒
+#define ATOMIC_WAIT_NOT_EQUAL 1// 内存中的值和期望值不相等，没有挂起
+#define ATOMIC_WAIT_TIMED_OUT 2// 等待超时
+
+// 挂起在某个内存地址上的线程
+typedef struct Waiter {
+    uint8_t *addr;            // 等待的内存地址
+    _Atomic uint32_t notified;// 是否已经被唤醒，同时也是线程挂起时使用的 futex
+    struct Waiter *next;      // 等待队列中的下一个线程
+} Waiter;
+
+// 等待队列，按照挂起的先后顺序唤醒线程
+typedef struct WaitQueue {
+    pthread_mutex_t lock;
+    Waiter *head;
+    Waiter *tail;
+} WaitQueue;
+
+// 创建页数为 min_size、最大页数为 max_size 的共享内存，供宿主通过 register_host_symbols 注册后让多个实例导入，
+// 这样在不同宿主线程中执行的多个实例即可通过同一块共享内存通信
+Memory *create_shared_memory(uint32_t min_size, uint32_t max_size);
+
+// 释放共享内存（需要保证导入该内存的所有实例都已释放）
+void free_shared_memory(Memory *mem);
+
+// 增长共享内存（可以在多个线程中同时调用），成功时返回增长前的页数，超出最大页数时返回 UINT32_MAX
+uint32_t grow_shared_memory(Memory *mem, uint32_t delta);
+
+// 挂起当前线程，直到其他线程在地址 maddr 上调用 atomic_notify 或者超时（timeout 为纳秒数，为负数表示不会超时）
+// 注：挂起前会先比较地址 maddr 上长度为 size 字节（4 或 8）的值和期望值 expected，不相等时直接返回
+uint32_t atomic_wait(uint8_t *maddr, uint32_t size, uint64_t expected, int64_t timeout);
+
+// 按照挂起的先后顺序唤醒最多 count 个挂起在地址 maddr 上的线程，返回被唤醒的线程数量
+uint32_t atomic_notify(uint8_t *maddr, uint32_t count);
+
+// 执行原子指令（操作码前缀 0xFE 之后的部分），执行失败时返回 false 并设置 inst->exception
+bool exec_atomic(Instance *inst);
+
+#endif
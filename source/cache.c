@@ -0,0 +1,339 @@
+#include "cache.h"
+#include "module.h"
+#include "opcode.h"
+#include "utils.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 生成缓存文件时使用的缓冲区
+typedef struct CacheBuffer {
+    uint8_t *data;  // 缓冲区数据
+    size_t size;    // 缓冲区已使用的字节数
+    size_t capacity;// 缓冲区的容量
+} CacheBuffer;
+
+// 向缓冲区末尾追加数据（按照 8 字节对齐），返回数据在缓冲区中的偏移量
+// 注：如果数据长度为 0 则返回 0，加载缓存时偏移量 0 会被还原为 NULL（缓存文件开头是头部，所以实际数据的偏移量不可能为 0）
+uint64_t cache_append(CacheBuffer *buf, const void *data, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+
+    size_t offset = (buf->size + 7) & ~(size_t) 7;
+    if (offset + size > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity : 0x1000;
+        while (offset + size > capacity) {
+            capacity *= 2;
+        }
+        buf->data = arecalloc(buf->data, buf->capacity, capacity, sizeof(uint8_t), "CacheBuffer");
+        buf->capacity = capacity;
+    }
+
+    if (data) {
+        memcpy(buf->data + offset, data, size);
+    }
+    buf->size = offset + size;
+    return offset;
+}
+
+// 根据模块字节码的哈希值生成缓存文件路径
+void cache_path(char *path, size_t len, const char *cache_dir, uint64_t hash) {
+    snprintf(path, len, "%s/%016llx.wasmc-cache", cache_dir, (unsigned long long) hash);
+}
+
+// 将缓存文件中的偏移量修正为实际地址
+#define CACHE_FIXUP(base, ptr)                                 \
+    if (ptr) {                                                 \
+        (ptr) = (void *) ((uint8_t *) (base) + (uintptr_t) (ptr)); \
+    }
+
+// 检查缓存文件中从偏移量 offset 开始的 count 个大小为 size 的元素是否都在文件范围内
+// 注：偏移量 0 表示 NULL，只允许在元素数量为 0 时出现；生成缓存时数据都是按照 8 字节对齐追加的
+bool cache_range_valid(uint64_t offset, uint64_t count, uint64_t size, uint64_t file_size) {
+    if (count == 0) {
+        return offset == 0;
+    }
+    return offset >= sizeof(CacheHeader) && offset % 8 == 0 && offset <= file_size && count * size <= file_size - offset;
+}
+
+// 检查控制块与模块字节码是否一致：类型与起始地址处的操作码相同且立即数是合法的控制块签名，结束地址处为 End_ 操作码，
+// else 地址紧跟在 Else_ 操作码之后（仅 If 控制块），跳转地址与收集控制块信息时的计算方式相同
+bool cache_block_valid(const Block *block, const Module *m) {
+    uint8_t opcode = m->bytes[block->start_addr];
+    uint8_t value_type = m->bytes[block->start_addr + 1];
+    uint32_t br_addr = opcode == Loop ? block->start_addr + 2 : block->end_addr;
+    return (opcode == Block_ || opcode == Loop || opcode == If) && block->block_type == opcode &&
+           (value_type == BLOCK || value_type == I32 || value_type == I64 || value_type == F32 || value_type == F64) &&
+           m->bytes[block->end_addr] == End_ && block->br_addr == br_addr &&
+           (block->else_addr == 0 || (opcode == If && block->else_addr > block->start_addr + 1 &&
+                                      block->else_addr <= block->end_addr && m->bytes[block->else_addr - 1] == Else_));
+}
+
+// 校验缓存文件中所有的偏移量、数量和地址，保证修正指针之后不会访问到缓存文件或者模块字节码之外的内存
+// 注：缓存文件可能被截断或者篡改，所以在修正任何指针之前都需要先完成校验
+bool validate_module_cache(const uint8_t *map, const CacheHeader *header, const Module *m) {
+    uint64_t file_size = header->file_size;
+    if (!cache_range_valid(header->types_offset, header->type_count, sizeof(Type), file_size) ||
+        !cache_range_valid(header->functions_offset, header->function_count, sizeof(Block), file_size) ||
+        !cache_range_valid(header->exports_offset, header->export_count, sizeof(Export), file_size) ||
+        header->import_func_count > header->function_count) {
+        return false;
+    }
+
+    const Type *types = (const Type *) (map + header->types_offset);
+    for (uint32_t i = 0; i < header->type_count; i++) {
+        if (!cache_range_valid((uintptr_t) types[i].params, types[i].param_count, sizeof(uint32_t), file_size) ||
+            !cache_range_valid((uintptr_t) types[i].results, types[i].result_count, sizeof(uint32_t), file_size)) {
+            return false;
+        }
+    }
+
+    // 导入函数会被解析导入段得到的导入函数覆盖，所以只需校验本地函数
+    const Block *functions = (const Block *) (map + header->functions_offset);
+    for (uint32_t f = header->import_func_count; f < header->function_count; f++) {
+        const Block *func = &functions[f];
+        uint64_t type_offset = (uintptr_t) func->type - header->types_offset;
+        if ((uintptr_t) func->type < header->types_offset || type_offset % sizeof(Type) != 0 ||
+            type_offset / sizeof(Type) >= header->type_count || func->fidx != f || func->block_type != 0x00 ||
+            func->start_addr > func->end_addr || func->end_addr >= m->byte_count || m->bytes[func->end_addr] != End_ ||
+            !cache_range_valid((uintptr_t) func->locals, func->local_count, sizeof(uint32_t), file_size) ||
+            !cache_range_valid((uintptr_t) func->blocks, func->block_count, sizeof(Block), file_size)) {
+            return false;
+        }
+        if (func->block_count == 0) {
+            continue;
+        }
+
+        // 控制块的地址必须位于函数的字节码部分之内且与模块字节码一致，
+        // 控制块还必须按照起始地址严格递增的顺序存储（执行时按照起始地址二分查找控制块），且相互之间正确嵌套：
+        // 按照起始地址顺序遍历时，用控制块栈记录包含当前控制块的外层控制块，当前控制块必须在最内层的外层控制块结束之前结束
+        const Block *blocks = (const Block *) (map + (uintptr_t) func->blocks);
+        uint32_t blockstack[BLOCKSTACK_SIZE];
+        int top = -1;
+        for (uint32_t b = 0; b < func->block_count; b++) {
+            if (blocks[b].start_addr < func->start_addr || blocks[b].start_addr >= blocks[b].end_addr ||
+                blocks[b].end_addr >= func->end_addr || (b > 0 && blocks[b].start_addr <= blocks[b - 1].start_addr) ||
+                !cache_block_valid(&blocks[b], m)) {
+                return false;
+            }
+            while (top >= 0 && blocks[blockstack[top]].end_addr < blocks[b].start_addr) {
+                top--;
+            }
+            if ((top >= 0 && blocks[b].end_addr >= blocks[blockstack[top]].end_addr) || top + 1 >= BLOCKSTACK_SIZE) {
+                return false;
+            }
+            blockstack[++top] = b;
+        }
+    }
+
+    // 导出项的成员名必须以 '\0' 结尾且位于缓存文件之内，导出函数的索引不能越界，导出表和内存的索引只能为 0
+    const Export *exports = (const Export *) (map + header->exports_offset);
+    for (uint32_t e = 0; e < header->export_count; e++) {
+        uint64_t name_offset = (uintptr_t) exports[e].export_name;
+        uint32_t kind = exports[e].external_kind;
+        if (!cache_range_valid(name_offset, 1, 1, file_size) ||
+            !memchr(map + name_offset, '\0', file_size - name_offset) || kind > KIND_GLOBAL ||
+            (kind == KIND_FUNCTION && exports[e].index >= header->function_count) ||
+            ((kind == KIND_TABLE || kind == KIND_MEMORY) && exports[e].index != 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 从缓存目录 cache_dir 中加载与模块字节码对应的缓存文件
+// 如果命中缓存，则返回 true，并将缓存中的函数签名、函数和导出项记录到 m->cache 中
+// 注：无论是否命中缓存，都会计算模块字节码的哈希值并保存到 m->cache.hash 中
+bool load_module_cache(Module *m, const char *cache_dir) {
+    char path[PATH_MAX];
+    struct stat sb;
+
+    // 缓存文件以模块字节码的哈希值作为文件名
+    m->cache.hash = hash_bytes(m->bytes, m->byte_count);
+    cache_path(path, sizeof(path), cache_dir, m->cache.hash);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    if (fstat(fd, &sb) < 0 || (size_t) sb.st_size < sizeof(CacheHeader)) {
+        close(fd);
+        return false;
+    }
+
+    // 以写时复制（copy-on-write）的方式将缓存文件映射进内存，
+    // 这样修正指针时只会复制被修改的页，且不会影响缓存文件本身
+    uint8_t *map = mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    // 校验缓存文件头部，确保缓存文件是由当前版本的 wasmc 针对同一个 Wasm 模块生成的，且是完整的
+    // 注：哈希值相同不代表模块相同，所以还需要与缓存文件中保存的模块内容逐字节比较
+    CacheHeader *header = (CacheHeader *) map;
+    if (header->magic != CACHE_MAGIC || header->version != CACHE_VERSION ||
+        header->type_size != sizeof(Type) || header->block_size != sizeof(Block) || header->export_size != sizeof(Export) ||
+        header->byte_count != m->byte_count || header->hash != m->cache.hash || header->file_size != (uint64_t) sb.st_size ||
+        !cache_range_valid(header->bytes_offset, header->byte_count, sizeof(uint8_t), header->file_size) ||
+        memcmp(map + header->bytes_offset, m->bytes, m->byte_count) != 0 || !validate_module_cache(map, header, m)) {
+        munmap(map, sb.st_size);
+        return false;
+    }
+
+    Type *types = (Type *) (map + header->types_offset);
+    Block *functions = (Block *) (map + header->functions_offset);
+    Export *exports = (Export *) (map + header->exports_offset);
+
+    // 修正函数签名中的指针
+    for (uint32_t i = 0; i < header->type_count; i++) {
+        CACHE_FIXUP(map, types[i].params)
+        CACHE_FIXUP(map, types[i].results)
+    }
+
+    // 修正函数以及函数中控制块的指针
+    for (uint32_t f = 0; f < header->function_count; f++) {
+        Block *func = &functions[f];
+        CACHE_FIXUP(map, func->type)
+        CACHE_FIXUP(map, func->locals)
+        CACHE_FIXUP(map, func->blocks)
+
+        // 导入函数的相关信息会在解析导入段时重新设置
+        if (f < header->import_func_count) {
+            continue;
+        }
+        func->func = func;
+
+        // 控制块的签名指向的是全局的控制块签名，无法缓存，所以需要根据 Block_/Loop/If 操作码的立即数重新获取
+        for (uint32_t b = 0; b < func->block_count; b++) {
+            func->blocks[b].type = get_block_type(m->bytes[func->blocks[b].start_addr + 1]);
+            func->blocks[b].func = func;
+        }
+        atomic_store_explicit(&func->compiled, true, memory_order_relaxed);
+    }
+
+    // 修正导出项中的指针
+    for (uint32_t e = 0; e < header->export_count; e++) {
+        CACHE_FIXUP(map, exports[e].export_name)
+    }
+
+    m->cache.map = map;
+    m->cache.map_size = sb.st_size;
+    m->cache.types = types;
+    m->cache.type_count = header->type_count;
+    m->cache.functions = functions;
+    m->cache.function_count = header->function_count;
+    m->cache.import_func_count = header->import_func_count;
+    m->cache.exports = exports;
+    m->cache.export_count = header->export_count;
+    return true;
+}
+
+// 将模块的解析结果写入到缓存目录 cache_dir 中，文件名为模块字节码的哈希值
+// 注：调用前模块中所有函数都必须已编译完成
+void save_module_cache(Module *m, const char *cache_dir) {
+    CacheBuffer buf = {0};
+    CacheHeader header = {
+            .magic = CACHE_MAGIC,
+            .version = CACHE_VERSION,
+            .type_size = sizeof(Type),
+            .block_size = sizeof(Block),
+            .export_size = sizeof(Export),
+            .byte_count = m->byte_count,
+            .hash = m->cache.hash,
+            .type_count = m->type_count,
+            .function_count = m->function_count,
+            .import_func_count = m->import_func_count,
+            .export_count = m->export_count,
+    };
+
+    // 先为头部预留位置，待所有数据写入后再更新头部
+    cache_append(&buf, &header, sizeof(CacheHeader));
+
+    // 写入函数签名，以及每个函数签名的参数类型和返回值类型
+    header.types_offset = cache_append(&buf, m->types, m->type_count * sizeof(Type));
+    for (uint32_t i = 0; i < m->type_count; i++) {
+        uint64_t params = cache_append(&buf, m->types[i].params, m->types[i].param_count * sizeof(uint32_t));
+        uint64_t results = cache_append(&buf, m->types[i].results, m->types[i].result_count * sizeof(uint32_t));
+        // 注：缓冲区在追加数据时地址可能会变化，所以每次都需要根据偏移量重新获取地址
+        Type *type = (Type *) (buf.data + header.types_offset) + i;
+        type->params = (uint32_t *) (uintptr_t) params;
+        type->results = (uint32_t *) (uintptr_t) results;
+    }
+
+    // 写入函数，以及每个函数的局部变量类型和控制块表
+    header.functions_offset = cache_append(&buf, m->functions, m->function_count * sizeof(Block));
+    for (uint32_t f = 0; f < m->function_count; f++) {
+        Block *src = &m->functions[f];
+        uint64_t locals = cache_append(&buf, src->locals, src->local_count * sizeof(uint32_t));
+        uint64_t blocks = cache_append(&buf, src->blocks, src->block_count * sizeof(Block));
+
+        // 控制块的签名和所属函数在加载缓存时重新设置
+        for (uint32_t b = 0; b < src->block_count; b++) {
+            Block *block = (Block *) (buf.data + blocks) + b;
+            block->type = NULL;
+            block->func = NULL;
+        }
+
+        Block *func = (Block *) (buf.data + header.functions_offset) + f;
+        func->type = (Type *) (uintptr_t) (header.types_offset + (src->type - m->types) * sizeof(Type));
+        func->locals = (uint32_t *) (uintptr_t) locals;
+        func->blocks = (Block *) (uintptr_t) blocks;
+        func->func = NULL;
+        func->import_module = NULL;
+        func->import_field = NULL;
+        func->func_ptr = NULL;
+        atomic_store_explicit(&func->compiled, false, memory_order_relaxed);
+    }
+
+    // 写入导出项，以及每个导出项的成员名
+    header.exports_offset = cache_append(&buf, m->exports, m->export_count * sizeof(Export));
+    for (uint32_t e = 0; e < m->export_count; e++) {
+        char *name = m->exports[e].export_name;
+        uint64_t name_offset = cache_append(&buf, name, strlen(name) + 1);
+        Export *export = (Export *) (buf.data + header.exports_offset) + e;
+        export->export_name = (char *) (uintptr_t) name_offset;
+    }
+
+    // 写入 Wasm 二进制模块的内容，用于加载缓存时确认是同一个模块
+    header.bytes_offset = cache_append(&buf, m->bytes, m->byte_count);
+
+    // 更新头部
+    header.file_size = buf.size;
+    memcpy(buf.data, &header, sizeof(CacheHeader));
+
+    // 先写入临时文件，再重命名为缓存文件，保证其他进程不会读取到不完整的缓存文件
+    char path[PATH_MAX], tmp_path[PATH_MAX + 16];
+    cache_path(path, sizeof(path), cache_dir, m->cache.hash);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (int) getpid());
+
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file) {
+        ERROR("Could not write cache file '%s'\n", tmp_path)
+        free(buf.data);
+        return;
+    }
+    bool ok = fwrite(buf.data, 1, buf.size, file) == buf.size;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmp_path, path) != 0) {
+        ERROR("Could not write cache file '%s'\n", path)
+        unlink(tmp_path);
+    }
+    free(buf.data);
+}
+
+// 释放缓存文件映射的内存
+void free_module_cache(ModuleCache *cache) {
+    if (cache->map) {
+        munmap(cache->map, cache->map_size);
+        cache->map = NULL;
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef WASMC_CACHE_H
+#define WASMC_CACHE_H
+
+#include "module.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CACHE_MAGIC 0x43434d57// 缓存文件的魔数，对应的 ASCII 字符为 'WMCC'
+#define CACHE_VERSION 0x06    // 缓存文件格式的版本号，缓存文件格式发生变化时需要加 1
+
+// 缓存文件头部结构体
+// 缓存文件由头部和数据两部分组成，数据部分是模块解析结果（函数签名、函数、控制块、导出项等）在内存中的镜像，
+// 其中的指针都被替换成了相对于缓存文件开头的偏移量，加载时只需将缓存文件映射进内存，再将偏移量修正为实际地址即可
+// 注：数据部分还保存了 Wasm 二进制模块的完整内容，加载时逐字节比较，避免不同模块的哈希值碰撞时误用缓存
+typedef struct CacheHeader {
+    uint32_t magic;           // 魔数
+    uint32_t version;         // 缓存文件格式的版本号
+    uint32_t type_size;       // 生成缓存时 Type 结构体的大小
+    uint32_t block_size;      // 生成缓存时 Block 结构体的大小
+    uint32_t export_size;     // 生成缓存时 Export 结构体的大小
+    uint32_t byte_count;      // Wasm 二进制模块的字节数
+    uint64_t hash;            // Wasm 二进制模块内容的哈希值
+    uint64_t file_size;       // 缓存文件的字节数
+    uint32_t type_count;      // 函数签名的数量
+    uint32_t function_count;  // 所有函数的数量（包括导入函数）
+    uint32_t import_func_count;// 导入函数的数量
+    uint32_t export_count;    // 导出项的数量
+    uint64_t types_offset;    // 函数签名数组在缓存文件中的偏移量
+    uint64_t functions_offset;// 函数数组在缓存文件中的偏移量
+    uint64_t exports_offset;  // 导出项数组在缓存文件中的偏移量
+    uint64_t bytes_offset;    // Wasm 二进制模块内容在缓存文件中的偏移量
+} CacheHeader;
+
+// 从缓存目录 cache_dir 中加载与模块字节码对应的缓存文件
+// 如果命中缓存，则返回 true，并将缓存中的函数签名、函数和导出项记录到 m->cache 中
+// 注：无论是否命中缓存，都会计算模块字节码的哈希值并保存到 m->cache.hash 中
+bool load_module_cache(Module *m, const char *cache_dir);
+
+// 将模块的解析结果写入到缓存目录 cache_dir 中，文件名为模块字节码的哈希值
+// 注：调用前模块中所有函数都必须已编译完成
+void save_module_cache(Module *m, const char *cache_dir);
+
+// 释放缓存文件映射的内存
+void free_module_cache(ModuleCache *cache);
+
+#endif
@@ -0,0 +1,308 @@
+#include "checkpoint.h"
+#include "module.h"
+#include "pool.h"
+#include "utils.h"
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 将 size 字节的数据 data 写入文件 fd 中偏移量为 offset 的位置，并返回数据之后的偏移量，失败时返回 0
+uint64_t write_at(int fd, const void *data, size_t size, uint64_t offset) {
+    const uint8_t *p = data;
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pwrite(fd, p + done, size - done, (off_t) (offset + done));
+        if (n <= 0) {
+            return 0;
+        }
+        done += n;
+    }
+    return offset + size;
+}
+
+// 从文件 fd 中偏移量为 offset 的位置读取 size 字节的数据到 data 中
+bool read_at(int fd, void *data, size_t size, uint64_t offset) {
+    uint8_t *p = data;
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, p + done, size - done, (off_t) (offset + done));
+        if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+// 判断一页内存是否全为 0
+bool is_zero_page(const uint8_t *page) {
+    const uint64_t *words = (const uint64_t *) page;
+    for (uint32_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+        if (words[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 将栈帧 frame 编码为检查点文件中的栈帧（控制块指针编码为函数索引和控制块索引），失败时返回 false
+bool encode_frame(Frame *frame, CheckpointFrame *out) {
+    Block *block = frame->block;
+
+    switch (block->block_type) {
+        case 0x00:
+            out->fidx = block->fidx;
+            out->block_idx = -1;
+            break;
+        case 0x02:
+        case 0x03:
+        case 0x04:
+            out->fidx = block->func->fidx;
+            out->block_idx = (int32_t) (block - block->func->blocks);
+            break;
+        default:
+            // 初始化表达式的控制块是临时创建的，不在安全点内
+            return false;
+    }
+
+    out->sp = frame->sp;
+    out->fp = frame->fp;
+    out->ra = frame->ra;
+    return true;
+}
+
+// 将检查点文件中的栈帧解码为实例 inst 的栈帧，失败时返回 false
+bool decode_frame(Instance *inst, CheckpointFrame *in, Frame *frame) {
+    Module *m = inst->module;
+
+    if (in->fidx < m->import_func_count || in->fidx >= m->function_count) {
+        return false;
+    }
+    // 栈帧中保存的运行时状态同样不能超出实例的容量，ra 必须是模块字节码中的地址
+    if (in->sp < -1 || in->sp >= STACK_SIZE || in->fp < -1 || in->fp > in->sp + 1 || in->ra >= m->byte_count) {
+        return false;
+    }
+
+    // 延迟编译时函数可能尚未编译过，需要先收集函数中控制块的相关信息
+    // 注：fidx 是在所有函数（包括导入函数）中的索引；编译的结果只取决于字节码，因此控制块在函数控制块表中的索引与写入检查点时一致
+    Block *func = &m->functions[in->fidx];
+    compile_function(m, func);
+
+    if (in->block_idx == -1) {
+        frame->block = func;
+    } else if (in->block_idx >= 0 && (uint32_t) in->block_idx < func->block_count) {
+        frame->block = &func->blocks[in->block_idx];
+    } else {
+        return false;
+    }
+
+    frame->sp = in->sp;
+    frame->fp = in->fp;
+    frame->ra = in->ra;
+    return true;
+}
+
+// 将实例 inst 的状态（内存、全局变量、表以及运行时状态）写入检查点文件 path
+bool write_checkpoint(Instance *inst, const char *path) {
+    Module *m = inst->module;
+    CheckpointHeader header = {0};
+    CheckpointFrame *frames = NULL;
+    bool ok = false;
+
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    header.module_hash = hash_bytes(m->bytes, m->byte_count);
+    header.byte_count = m->byte_count;
+    header.memory_pages = inst->memory.cur_size;
+    header.table_size = inst->table.cur_size;
+    header.global_count = m->global_count;
+    header.pc = inst->pc;
+    header.sp = inst->sp;
+    header.fp = inst->fp;
+    header.csp = inst->csp;
+    header.trap = inst->trap;
+
+    // 等待中的异步 I/O 请求属于宿主，无法写入检查点
+    if (inst->trap == TRAP_WAIT_IO) {
+        ERROR("Instance is waiting for I/O, could not write checkpoint '%s'\n", path)
+        return false;
+    }
+
+    // 将调用栈中的栈帧编码为与地址无关的形式
+    uint32_t frame_count = inst->csp + 1;
+    frames = acalloc(frame_count ? frame_count : 1, sizeof(CheckpointFrame), "CheckpointFrame");
+    for (uint32_t i = 0; i < frame_count; i++) {
+        if (!encode_frame(&inst->callstack[i], &frames[i])) {
+            ERROR("Instance is not at a safepoint, could not write checkpoint '%s'\n", path)
+            free(frames);
+            return false;
+        }
+    }
+
+    // 依次计算各部分在文件中的偏移量，内存数据按照 PAGE_SIZE 对齐，以便恢复时可以直接映射
+    header.globals_offset = sizeof(CheckpointHeader);
+    header.table_offset = header.globals_offset + sizeof(StackValue) * header.global_count;
+    header.stack_offset = header.table_offset + sizeof(uint32_t) * header.table_size;
+    header.callstack_offset = header.stack_offset + sizeof(StackValue) * (header.sp + 1);
+    header.memory_offset = header.callstack_offset + sizeof(CheckpointFrame) * frame_count;
+    header.memory_offset = (header.memory_offset + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        ERROR("Could not open checkpoint file '%s'\n", path)
+        free(frames);
+        return false;
+    }
+
+    if (!write_at(fd, &header, sizeof(CheckpointHeader), 0) ||
+        (header.global_count && !write_at(fd, inst->globals, sizeof(StackValue) * header.global_count, header.globals_offset)) ||
+        (header.table_size && !write_at(fd, inst->table.entries, sizeof(uint32_t) * header.table_size, header.table_offset)) ||
+        (header.sp >= 0 && !write_at(fd, inst->stack, sizeof(StackValue) * (header.sp + 1), header.stack_offset)) ||
+        (frame_count && !write_at(fd, frames, sizeof(CheckpointFrame) * frame_count, header.callstack_offset))) {
+        goto done;
+    }
+
+    // 先将文件扩展到完整大小，再只写入非 0 的内存页，全为 0 的页保留为文件空洞，不占用磁盘空间
+    size_t memory_size = (size_t) header.memory_pages * PAGE_SIZE;
+    if (ftruncate(fd, (off_t) (header.memory_offset + memory_size)) != 0) {
+        goto done;
+    }
+    for (size_t off = 0; off < memory_size; off += PAGE_SIZE) {
+        const uint8_t *page = inst->memory.bytes + off;
+        if (!is_zero_page(page) && !write_at(fd, page, PAGE_SIZE, header.memory_offset + off)) {
+            goto done;
+        }
+    }
+    ok = true;
+
+done:
+    ok = close(fd) == 0 && ok;
+    if (!ok) {
+        ERROR("Could not write checkpoint file '%s'\n", path)
+    }
+    free(frames);
+    return ok;
+}
+
+// 从检查点文件 path 中恢复模块 m 的实例，失败时返回 NULL
+Instance *restore_checkpoint(Module *m, const char *path) {
+    CheckpointHeader header;
+    CheckpointFrame *frames = NULL;
+    Instance *inst = NULL;
+    struct stat sb;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ERROR("Could not open checkpoint file '%s'\n", path)
+        return NULL;
+    }
+
+    // 校验文件头部：检查点必须由同一个模块生成，且运行时状态不能超出实例的容量
+    if (!read_at(fd, &header, sizeof(CheckpointHeader), 0) ||
+        header.magic != CHECKPOINT_MAGIC || header.version != CHECKPOINT_VERSION) {
+        ERROR("Invalid checkpoint file '%s'\n", path)
+        goto fail;
+    }
+    if (header.byte_count != m->byte_count || header.module_hash != hash_bytes(m->bytes, m->byte_count)) {
+        ERROR("Checkpoint file '%s' was written by a different module\n", path)
+        goto fail;
+    }
+    if (header.global_count != m->global_count || header.table_size != m->table.cur_size ||
+        header.memory_pages > m->memory.max_size || header.pc >= m->byte_count || header.sp < -1 ||
+        header.sp >= STACK_SIZE || header.fp < -1 || header.fp > header.sp + 1 || header.csp < -1 ||
+        header.csp >= CALLSTACK_SIZE || header.trap > TRAP_YIELD || header.memory_offset % PAGE_SIZE != 0) {
+        ERROR("Corrupted checkpoint file '%s'\n", path)
+        goto fail;
+    }
+
+    // 内存数据会以 MAP_FIXED 的方式直接映射文件，如果文件被截断，访问超出文件末尾的页时会触发 SIGBUS，
+    // 所以必须先确认文件包含完整的内存数据
+    size_t memory_size = (size_t) header.memory_pages * PAGE_SIZE;
+    if (fstat(fd, &sb) != 0 || header.memory_offset > (uint64_t) sb.st_size ||
+        memory_size > (uint64_t) sb.st_size - header.memory_offset) {
+        ERROR("Corrupted checkpoint file '%s'\n", path)
+        goto fail;
+    }
+
+    inst = acalloc(1, sizeof(Instance), "Instance");
+    inst->module = m;
+    inst->pc = header.pc;
+    inst->sp = header.sp;
+    inst->fp = header.fp;
+    inst->csp = header.csp;
+    inst->trap = (TrapKind) header.trap;
+    inst->fuel = FUEL_UNLIMITED;
+    inst->epoch_deadline = EPOCH_DEADLINE_NONE;
+
+    // 表：如果表是从外部模块导入的，则将表中元素写回导入表
+    inst->table = m->table;
+    if (!m->import_table) {
+        inst->table.entries = acalloc(m->table.cur_size, sizeof(uint32_t), "Table.entries");
+    }
+
+    // 全局变量：导入的全局变量同样恢复为检查点中的值
+    inst->globals = acalloc(m->global_count, sizeof(StackValue), "globals");
+
+    if ((header.global_count && !read_at(fd, inst->globals, sizeof(StackValue) * header.global_count, header.globals_offset)) ||
+        (header.table_size && !read_at(fd, inst->table.entries, sizeof(uint32_t) * header.table_size, header.table_offset)) ||
+        (header.sp >= 0 && !read_at(fd, inst->stack, sizeof(StackValue) * (header.sp + 1), header.stack_offset))) {
+        ERROR("Corrupted checkpoint file '%s'\n", path)
+        goto fail;
+    }
+
+    // 调用栈：将检查点中的栈帧解码为实例中的栈帧
+    uint32_t frame_count = header.csp + 1;
+    if (frame_count) {
+        frames = acalloc(frame_count, sizeof(CheckpointFrame), "CheckpointFrame");
+        if (!read_at(fd, frames, sizeof(CheckpointFrame) * frame_count, header.callstack_offset)) {
+            ERROR("Corrupted checkpoint file '%s'\n", path)
+            goto fail;
+        }
+        for (uint32_t i = 0; i < frame_count; i++) {
+            if (!decode_frame(inst, &frames[i], &inst->callstack[i])) {
+                ERROR("Corrupted checkpoint file '%s'\n", path)
+                goto fail;
+            }
+        }
+    }
+
+    // 内存：如果内存是从外部模块导入的，则只能将内存数据读取到导入内存中
+    inst->memory = m->memory;
+    if (m->import_memory) {
+        if (header.memory_pages > inst->memory.cur_size || !read_at(fd, inst->memory.bytes, memory_size, header.memory_offset)) {
+            ERROR("Could not restore imported memory from checkpoint '%s'\n", path)
+            goto fail;
+        }
+    } else {
+        // 按照内存的最大页数预留地址空间（与实例池相同，内存增长时无需重新申请内存），
+        // 然后以写时复制的方式将检查点中的内存数据映射到预留的内存开头，这样恢复的开销与内存大小无关，
+        // 只有实际被访问的页才会从文件中读取，只有实际被写入的页才会复制出私有的副本，且修改不会写回检查点文件
+        inst->memory.cur_size = header.memory_pages;
+        inst->memory.reserved_size = m->memory.max_size;
+        inst->memory.bytes = reserve_memory((size_t) m->memory.max_size * PAGE_SIZE, "Memory.bytes");
+        if (memory_size > 0 &&
+            mmap(inst->memory.bytes, memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, (off_t) header.memory_offset) == MAP_FAILED) {
+            ERROR("Could not map memory from checkpoint '%s'\n", path)
+            goto fail;
+        }
+    }
+
+    // 映射建立后即可关闭文件，映射会保持对文件的引用
+    close(fd);
+    free(frames);
+    return inst;
+
+fail:
+    close(fd);
+    free(frames);
+    if (inst) {
+        free_instance(inst);
+    }
+    return NULL;
+}
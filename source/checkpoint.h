@@ -0,0 +1,54 @@
+#ifndef WASMC_CHECKPOINT_H
+#define WASMC_CHECKPOINT_H
+
+#include "module.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CHECKPOINT_MAGIC 0x4b434d57// 检查点文件的魔数，对应的 ASCII 字符为 'WMCK'
+#define CHECKPOINT_VERSION 0x02    // 检查点文件格式的版本号，文件格式发生变化时需要加 1
+
+// 检查点文件头部结构体
+// 检查点文件依次包含：头部、全局变量、表中元素、操作数栈、调用栈，以及按照 PAGE_SIZE 对齐的内存数据，
+// 其中内存数据中全为 0 的页不会写入文件（即文件空洞），恢复时以写时复制的方式将内存数据映射进内存
+typedef struct CheckpointHeader {
+    uint32_t magic;           // 魔数
+    uint32_t version;         // 检查点文件格式的版本号
+    uint64_t module_hash;     // 实例对应模块的字节码的哈希值，用于校验恢复时使用的是同一个模块
+    uint32_t byte_count;      // 实例对应模块的字节数
+    uint32_t memory_pages;    // 内存的当前页数
+    uint64_t memory_offset;   // 内存数据在文件中的偏移量（按照 PAGE_SIZE 对齐）
+    uint32_t table_size;      // 表的当前元素数量
+    uint32_t global_count;    // 全局变量的数量
+    uint64_t globals_offset;  // 全局变量在文件中的偏移量
+    uint64_t table_offset;    // 表中元素在文件中的偏移量
+    uint64_t stack_offset;    // 操作数栈在文件中的偏移量（只保存 0 到 sp 的部分）
+    uint64_t callstack_offset;// 调用栈在文件中的偏移量（只保存 0 到 csp 的部分）
+    uint32_t pc;              // 程序计数器
+    int32_t sp;               // 操作数栈顶指针
+    int32_t fp;               // 当前栈帧的帧指针
+    int32_t csp;              // 调用栈指针
+    uint32_t trap;            // 陷阱类型，实例处于暂停状态时恢复后可以调用 resume 函数继续执行
+} CheckpointHeader;
+
+// 检查点文件中的栈帧结构体
+// 栈帧关联的控制块不能直接保存指针，而是保存为所属函数的索引以及在函数控制块表中的索引
+typedef struct CheckpointFrame {
+    uint32_t fidx;     // 控制块所属函数在所有函数中的索引
+    int32_t block_idx; // 控制块在函数控制块表中的索引（为 -1 表示控制块即函数本身）
+    int32_t sp;        // 同 Frame 中的 sp
+    int32_t fp;        // 同 Frame 中的 fp
+    uint32_t ra;       // 同 Frame 中的 ra
+} CheckpointFrame;
+
+// 将实例 inst 的状态（内存、全局变量、表以及运行时状态）写入检查点文件 path
+// 注：只能在实例处于安全点时调用，即调用栈中只有函数和 Block_/Loop/If 控制块（不能正在计算初始化表达式），
+// 且实例不能正在等待异步 I/O（I/O 请求无法写入检查点）
+bool write_checkpoint(Instance *inst, const char *path);
+
+// 从检查点文件 path 中恢复模块 m 的实例，失败时返回 NULL
+// 如果写入检查点时实例处于暂停状态（例如燃料耗尽），则恢复后的实例同样处于暂停状态，可以调用 resume 函数继续执行
+// 注：内存数据以写时复制的方式直接映射检查点文件，无需读取整个内存
+Instance *restore_checkpoint(Module *m, const char *path);
+
+#endif
@@ -1,14 +1,155 @@
+#include "aio.h"
+#include "checkpoint.h"
+#include "epoch.h"
 #include "interpreter.h"
 #include "module.h"
+#include "opstats.h"
+#include "profiler.h"
+#include "snapshot.h"
 #include "utils.h"
 #include <readline/history.h>
 #include <readline/readline.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #define BEGIN(x, y) "\033[" #x ";" #y "m"// x: 背景，y: 前景
 #define CLOSE "\033[0m"                  // 关闭所有属性
 
+#define BATCH_OUTPUT_BUFFER 0x100000// 批量调用模式下标准输出缓冲区的大小 1MB
+
+// 获取单调时钟的纳秒数
+uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+// 比较两次调用的耗时，用于排序后计算分位数
+int compare_ns(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+// 批量调用模式：从文件 path（为 - 时即标准输入）中逐行读取调用，格式与交互模式相同（即函数名和以空格分隔的参数），
+// 每次调用输出一行结果：返回值、没有返回值时为空行、执行失败时为 error: 异常信息，因此输出的行与输入的调用一一对应
+// 结果写入带缓冲的标准输出（不逐行刷新），全部调用结束后将总耗时以及每次调用的耗时统计输出到标准错误
+// 注：所有调用都在同一个实例上执行，模块只加载一次；返回值为 0 表示所有调用都成功，为 1 表示有调用失败
+int run_batch(Instance *inst, char *path, int64_t fuel, uint64_t timeout_ms, EpochTicker *ticker) {
+    Module *m = inst->module;
+    FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!in) {
+        ERROR("Could not open %s\n", path)
+        return 2;
+    }
+    setvbuf(stdout, NULL, _IOFBF, BATCH_OUTPUT_BUFFER);
+
+    char *line = NULL;             // 每行输入（由 getline 申请内存，每行复用）
+    size_t line_cap = 0;           // line 的容量
+    char *argv_buf[100];           // 每行输入拆分得到的参数
+    char value_str[VALUE_STR_SIZE];// 函数返回值的字符串形式
+    uint64_t *durations = NULL;    // 每次调用的耗时（纳秒）
+    uint64_t call_count = 0;       // 调用次数
+    uint64_t capacity = 0;         // durations 的容量
+    uint64_t failed = 0;           // 失败的调用次数
+    uint64_t call_total = 0;       // 所有调用的耗时之和（纳秒）
+    uint64_t start = now_ns();
+
+    ssize_t len;
+    while ((len = getline(&line, &line_cap, in)) != -1) {
+        // 去掉行尾的换行符，跳过空行
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        if (len == 0) {
+            continue;
+        }
+
+        int argc = 0;
+        char **argv = split_argv(line, argv_buf, 100, &argc);
+
+        // 查找导出函数并检查参数数量，失败时同样输出一行，保证输出与输入一一对应
+        uint32_t handle = resolve_export(m, argv[0]);
+        if (handle == EXPORT_HANDLE_INVALID || m->exports[handle].external_kind != KIND_FUNCTION) {
+            printf("error: no exported function named '%s'\n", argv[0]);
+            failed++;
+            continue;
+        }
+        Block *func = get_export_by_handle(inst, handle);
+        if ((uint32_t) (argc - 1) != func->type->param_count) {
+            printf("error: expected %u arguments, got %d\n", func->type->param_count, argc - 1);
+            failed++;
+            continue;
+        }
+
+        // 重置运行时相关状态并压入参数，然后调用函数（只统计函数调用本身的耗时）
+        inst->sp = -1;
+        inst->fp = -1;
+        inst->csp = -1;
+        inst->fuel = fuel;
+        if (ticker) {
+            set_epoch_deadline(inst, timeout_ms);
+        }
+        parse_args(inst, func->type, argc - 1, argv + 1);
+
+        uint64_t t0 = now_ns();
+        bool ok = invoke_export(inst, handle);
+        uint64_t elapsed = now_ns() - t0;
+
+        if (call_count == capacity) {
+            uint64_t new_capacity = capacity ? capacity * 2 : 1024;
+            durations = arecalloc(durations, capacity, new_capacity, sizeof(uint64_t), "Batch durations");
+            capacity = new_capacity;
+        }
+        durations[call_count++] = elapsed;
+        call_total += elapsed;
+
+        if (!ok) {
+            printf("error: %s\n", inst->exception);
+            failed++;
+        } else if (inst->sp >= 0) {
+            printf("%s\n", value_repr(&inst->stack[inst->sp], value_str, VALUE_STR_SIZE));
+        } else {
+            putchar('\n');
+        }
+    }
+    fflush(stdout);
+    uint64_t total = now_ns() - start;
+
+    // 输出耗时统计：总耗时包括读取输入、解析参数和输出结果，每次调用的耗时只包括函数调用本身
+    fprintf(stderr, "calls: %lu, failed: %lu, total: %.3f ms, calls only: %.3f ms\n",
+            (unsigned long) call_count, (unsigned long) failed, (double) total / 1e6, (double) call_total / 1e6);
+    if (call_count > 0) {
+        qsort(durations, call_count, sizeof(uint64_t), compare_ns);
+        fprintf(stderr, "per call: mean %.3f us, min %.3f us, p50 %.3f us, p99 %.3f us, max %.3f us\n",
+                (double) call_total / (double) call_count / 1e3, (double) durations[0] / 1e3,
+                (double) durations[call_count / 2] / 1e3, (double) durations[call_count * 99 / 100] / 1e3,
+                (double) durations[call_count - 1] / 1e3);
+    }
+
+    free(durations);
+    free(line);
+    if (in != stdin) {
+        fclose(in);
+    }
+    return failed > 0 ? 1 : 0;
+}
+
+// 停止采样分析器并将样本写入折叠栈文件 path（未指定 --profile 时 path 为 NULL，什么都不做）
+// 注：样本中记录了模块的指针，所以需要在释放模块之前调用
+void finish_profile(char *path) {
+    if (path) {
+        stop_profiler();
+        write_profile(path);
+    }
+}
+
+// 进程退出时将指令统计输出到标准错误（仅在指令统计构建模式下注册）
+void print_opcode_report_at_exit(void) {
+    print_opcode_report(stderr);
+}
+
 // 命令行主函数
 int main(int argc, char **argv) {
     char *mod_path;       // Wasm 模块文件路径
@@ -16,15 +157,57 @@ int main(int argc, char **argv) {
     int byte_count;       // Wasm 模块文件映射的内存大小
     char *line = NULL;    // 指向每行输入的字符串的指针
     int res;              // 调用函数过程中的返回值，true 表示函数调用成功，false 表示函数调用失败
+    Options options = {0};// 模块加载选项
+    char *preinit_path = NULL;// 预初始化快照的输出路径
+    int64_t fuel = FUEL_UNLIMITED;// 每次函数调用可以消耗的燃料
+    uint64_t timeout_ms = 0;      // 每次函数调用的超时毫秒数（为 0 表示不限制）
+    EpochTicker *ticker = NULL;   // 指定超时时间时，每毫秒递增一次全局纪元计数器的定时线程
+    char *batch_path = NULL;      // 批量调用模式下读取调用的文件路径（为 - 时即标准输入）
+    char *profile_path = NULL;    // 采样分析器输出的折叠栈文件路径（为 NULL 表示不启用采样分析器）
+    bool aio = false;             // 是否允许模块导入 aio 模块的宿主函数（可以读写任意文件描述符）
+    char *argv_buf[100];      // 每行输入拆分得到的参数
+    char value_str[VALUE_STR_SIZE];// 函数返回值的字符串形式
 
-    // 如果参数数量不为 2，则报错并提示正确调用方式，然后退出
-    if (argc != 2) {
-        fprintf(stderr, "The right usage is:\n%s WASM_FILE_PATH\n", argv[0]);
+    // 解析命令行选项，选项之后的参数即 Wasm 文件路径
+    int arg_idx = 1;
+    for (; arg_idx < argc && strncmp(argv[arg_idx], "--", 2) == 0; arg_idx++) {
+        if (strcmp(argv[arg_idx], "--lazy") == 0) {
+            // 启用延迟编译
+            options.lazy_compile = true;
+        } else if (strcmp(argv[arg_idx], "--cache") == 0 && arg_idx + 1 < argc) {
+            // 指定预编译缓存目录
+            options.cache_dir = argv[++arg_idx];
+        } else if (strcmp(argv[arg_idx], "--preinit") == 0 && arg_idx + 1 < argc) {
+            // 执行完起始函数后将实例的状态写入预初始化快照，然后退出
+            preinit_path = argv[++arg_idx];
+        } else if (strcmp(argv[arg_idx], "--fuel") == 0 && arg_idx + 1 < argc) {
+            // 限制每次函数调用可以消耗的燃料（大致为执行的指令数量），耗尽时函数调用失败
+            fuel = strtoll(argv[++arg_idx], NULL, 0);
+        } else if (strcmp(argv[arg_idx], "--timeout") == 0 && arg_idx + 1 < argc) {
+            // 限制每次函数调用的执行时间（毫秒），超时时函数调用被中断
+            timeout_ms = strtoull(argv[++arg_idx], NULL, 0);
+        } else if (strcmp(argv[arg_idx], "--batch") == 0 && arg_idx + 1 < argc) {
+            // 从文件或者标准输入中批量读取调用，而不进入交互模式
+            batch_path = argv[++arg_idx];
+        } else if (strcmp(argv[arg_idx], "--profile") == 0 && arg_idx + 1 < argc) {
+            // 启用采样分析器，退出时将客户函数的调用栈样本以折叠栈格式写入文件（可以作为 flamegraph.pl 的输入）
+            profile_path = argv[++arg_idx];
+        } else if (strcmp(argv[arg_idx], "--aio") == 0) {
+            // 允许模块导入 aio 模块的宿主函数，这些函数可以读写进程中的任意文件描述符，所以默认不提供
+            aio = true;
+        } else {
+            break;
+        }
+    }
+
+    // 如果参数数量不正确，则报错并提示正确调用方式，然后退出
+    if (argc - arg_idx != 1) {
+        fprintf(stderr, "The right usage is:\n%s [--lazy] [--cache DIR] [--preinit OUT_FILE] [--fuel N] [--timeout MS] [--batch FILE|-] [--profile OUT_FILE] [--aio] WASM_FILE_PATH\n", argv[0]);
         return 2;
     }
 
-    // 第二个参数即 Wasm 文件路径
-    mod_path = argv[1];
+    // 最后一个参数即 Wasm 文件路径
+    mod_path = argv[arg_idx];
 
     // 加载 Wasm 模块，并映射到内存中
     bytes = mmap_file(mod_path, &byte_count);
@@ -35,8 +218,51 @@ int main(int argc, char **argv) {
         return 2;
     }
 
+#ifdef WASMC_PROFILE_OPCODES
+    atexit(print_opcode_report_at_exit);
+#endif
+
+    // 注册 aio 模块的宿主函数，命令行中没有调度器，所以这些函数同步执行
+    if (aio) {
+        register_aio_imports();
+    }
+
+    // 在实例化之前启动采样分析器，这样起始函数的执行也会被采样
+    if (profile_path) {
+        start_profiler(PROFILE_DEFAULT_HZ);
+    }
+
     // 解析 Wasm 模块，即将 Wasm 二进制格式转化成内存格式
-    Module *m = load_module(bytes, byte_count);
+    Module *m = load_module(bytes, byte_count, options);
+
+    // 基于模块创建实例，后续所有的函数调用都在该实例上执行
+    Instance *inst = instantiate(m);
+
+    // 如果指定了预初始化快照的输出路径，则将实例的状态写入快照后直接退出
+    if (preinit_path) {
+        res = write_preinit_snapshot(inst, preinit_path);
+        finish_profile(profile_path);
+        free_instance(inst);
+        free_module(m);
+        return res ? 0 : 1;
+    }
+
+    // 指定了超时时间时，以 1 毫秒为一个纪元启动定时线程
+    if (timeout_ms > 0) {
+        ticker = start_epoch_ticker(1000000);
+    }
+
+    // 批量调用模式：执行完所有调用后直接退出
+    if (batch_path) {
+        res = run_batch(inst, batch_path, fuel, timeout_ms, ticker);
+        if (ticker) {
+            stop_epoch_ticker(ticker);
+        }
+        finish_profile(profile_path);
+        free_instance(inst);
+        free_module(m);
+        return res;
+    }
 
     // 无限循环，每次循环处理单行命令
     while (1) {
@@ -60,50 +286,95 @@ int main(int argc, char **argv) {
         argc = 0;
 
         // 将输入的字符串按照空格拆分成多个参数
-        argv = split_argv(line, &argc);
+        argv = split_argv(line, argv_buf, 100, &argc);
 
         // 如果没有参数，则继续下一个循环
         if (argc == 0) {
             continue;
         }
 
+        // 以冒号开头的是命令行内置命令：
+        // :checkpoint FILE 将实例的状态写入检查点文件
+        // :restore FILE 从检查点文件恢复实例，并替换当前实例
+        // :opstats [reset] 输出指令统计（需要以指令统计构建模式构建），或者清零指令统计
+        if (strcmp(argv[0], ":checkpoint") == 0 && argc == 2) {
+            write_checkpoint(inst, argv[1]);
+            free(line);
+            continue;
+        }
+        if (strcmp(argv[0], ":restore") == 0 && argc == 2) {
+            Instance *restored = restore_checkpoint(m, argv[1]);
+            if (restored) {
+                free_instance(inst);
+                inst = restored;
+            }
+            free(line);
+            continue;
+        }
+
+        if (strcmp(argv[0], ":opstats") == 0) {
+            if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+                reset_opcode_stats();
+            } else {
+                print_opcode_report(stdout);
+                fflush(stdout);
+            }
+            free(line);
+            continue;
+        }
+
         // 重置运行时相关状态，主要是清空操作数栈、调用栈等
-        m->sp = -1;
-        m->fp = -1;
-        m->csp = -1;
+        inst->sp = -1;
+        inst->fp = -1;
+        inst->csp = -1;
+        inst->fuel = fuel;
+        if (ticker) {
+            set_epoch_deadline(inst, timeout_ms);
+        }
 
-        // 通过名称（即第一个参数）从 Wasm 模块中查找同名的导出函数
-        Block *func = get_export(m, argv[0]);
+        // 通过名称（即第一个参数）从 Wasm 模块中查找同名的导出函数的句柄
+        uint32_t handle = resolve_export(m, argv[0]);
 
         // 如果没有查找到函数，则报错提示信息，并进入下一个循环
-        if (!func) {
+        if (handle == EXPORT_HANDLE_INVALID || m->exports[handle].external_kind != KIND_FUNCTION) {
             ERROR("no exported function named '%s'\n", argv[0])
             continue;
         }
+        Block *func = get_export_by_handle(inst, handle);
 
         // 解析函数参数，并将参数压入到操作数栈
-        parse_args(m, func->type, argc - 1, argv + 1);
+        parse_args(inst, func->type, argc - 1, argv + 1);
 
-        // 调用指定函数
-        res = invoke(m, func->fidx);
+        // 通过句柄调用指定函数
+        res = invoke_export(inst, handle);
 
         // 如果 invoke 函数返回 true，则说明函数成功执行，
         // 在判断函数是否有返回值，如果有返回值，则将返回值打印出来；
         // 如果 invoke 函数返回 true，则说明函数执行过程中出现异常，将异常信息打印出来即可。
-        // 注：在解释执行函数过程中，如果有异常，会将异常信息写入到 exception 中
+        // 注：在解释执行函数过程中，如果有异常，会将异常信息写入到 inst->exception 中
         if (res) {
-            if (m->sp >= 0) {
-                printf("%s\n", value_repr(&m->stack[m->sp]));
+            if (inst->sp >= 0) {
+                printf("%s\n", value_repr(&inst->stack[inst->sp], value_str, VALUE_STR_SIZE));
                 // 刷新标准输出缓冲区，把输出缓冲区里的东西打印到标准输出设备上，已实现及时获取执行结果
                 fflush(stdout);
             }
         } else {
-            ERROR("Exception: %s\n", exception)
+            ERROR("Exception: %s\n", inst->exception)
         }
 
         // readline 会为输入的字符串动态分配内存，所以使用完之后需要将内存释放掉
         free(line);
     }
 
+    if (ticker) {
+        stop_epoch_ticker(ticker);
+    }
+
+    finish_profile(profile_path);
+
+    // 释放实例和模块占用的内存
+    free_instance(inst);
+    free_module(m);
+
     return 0;
 }
@@ -0,0 +1,60 @@
+#include "epoch.h"
+#include "utils.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// 全局纪元计数器
+_Atomic uint64_t epoch = 0;
+
+// 将全局纪元计数器加 1
+void increment_epoch(void) {
+    atomic_fetch_add_explicit(&epoch, 1, memory_order_relaxed);
+}
+
+// 设置实例的截止纪元为当前纪元之后的第 ticks 个纪元
+void set_epoch_deadline(Instance *inst, uint64_t ticks) {
+    uint64_t now = atomic_load_explicit(&epoch, memory_order_relaxed);
+    inst->epoch_deadline = ticks >= EPOCH_DEADLINE_NONE - now ? EPOCH_DEADLINE_NONE : now + ticks;
+}
+
+// 定时线程的主函数：按照绝对时间休眠，避免递增间隔因为线程调度的延迟而累积偏移
+void *epoch_ticker_main(void *arg) {
+    EpochTicker *ticker = arg;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (!atomic_load(&ticker->stop)) {
+        next.tv_sec += (time_t) (ticker->interval_ns / 1000000000);
+        next.tv_nsec += (long) (ticker->interval_ns % 1000000000);
+        if (next.tv_nsec >= 1000000000) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        increment_epoch();
+    }
+    return NULL;
+}
+
+// 启动每隔 interval_ns 纳秒递增一次全局纪元计数器的定时线程
+EpochTicker *start_epoch_ticker(uint64_t interval_ns) {
+    ASSERT(interval_ns > 0, "Epoch ticker interval must be positive\n")
+
+    EpochTicker *ticker = acalloc(1, sizeof(EpochTicker), "EpochTicker");
+    ticker->interval_ns = interval_ns;
+    if (pthread_create(&ticker->thread, NULL, epoch_ticker_main, ticker) != 0) {
+        FATAL("Could not create epoch ticker thread\n")
+    }
+    return ticker;
+}
+
+// 停止定时线程并释放其占用的内存
+void stop_epoch_ticker(EpochTicker *ticker) {
+    atomic_store(&ticker->stop, true);
+    pthread_join(ticker->thread, NULL);
+    free(ticker);
+}
@@ -0,0 +1,33 @@
+#ifndef WASMC_EPOCH_H
+#define WASMC_EPOCH_H
+
+#include "module.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// 全局纪元计数器，由定时线程（或者宿主）递增，虚拟机在安全点比较其与实例的截止纪元
+// 注：只需要读取一个原子变量，所以比燃料计量的开销更低，但只能按照时间而不能按照指令数量限制执行
+extern _Atomic uint64_t epoch;
+
+// 定时线程，每隔 interval_ns 纳秒将全局纪元计数器加 1
+typedef struct EpochTicker {
+    pthread_t thread;
+    uint64_t interval_ns;// 递增间隔的纳秒数
+    _Atomic bool stop;   // 是否需要停止定时线程
+} EpochTicker;
+
+// 将全局纪元计数器加 1，超过截止纪元的实例会在下一个安全点被中断
+void increment_epoch(void);
+
+// 设置实例的截止纪元为当前纪元之后的第 ticks 个纪元，即实例最多还能执行 ticks 个纪元
+void set_epoch_deadline(Instance *inst, uint64_t ticks);
+
+// 启动每隔 interval_ns 纳秒递增一次全局纪元计数器的定时线程
+EpochTicker *start_epoch_ticker(uint64_t interval_ns);
+
+// 停止定时线程并释放其占用的内存
+void stop_epoch_ticker(EpochTicker *ticker);
+
+#endif
@@ -0,0 +1,127 @@
+#include "import.h"
+#include "utils.h"
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 进程内注册的宿主模块，以及已打开的动态库的句柄缓存
+// 两者都只会追加不会删除（宿主模块重复注册时替换其符号表），由 import_lock 保护
+HostModule *host_modules = NULL;
+uint32_t host_module_count = 0;
+LibraryHandle *library_handles = NULL;
+uint32_t library_handle_count = 0;
+pthread_mutex_t import_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// 比较两个宿主符号的成员名，用于排序和二分查找
+int compare_host_symbol(const void *a, const void *b) {
+    return strcmp(((const HostSymbol *) a)->name, ((const HostSymbol *) b)->name);
+}
+
+// 复制字符串
+char *copy_string(const char *str) {
+    size_t len = strlen(str);
+    char *res = acalloc(len + 1, sizeof(char), "string");
+    memcpy(res, str, len);
+    return res;
+}
+
+// 在进程内注册模块名为 module_name 的宿主符号表
+void register_host_symbols(const char *module_name, const HostSymbol *symbols, uint32_t count) {
+    // 拷贝符号表并按照成员名排序，解析导入项时即可二分查找
+    HostSymbol *sorted = acalloc(count ? count : 1, sizeof(HostSymbol), "HostSymbol");
+    memcpy(sorted, symbols, sizeof(HostSymbol) * count);
+    qsort(sorted, count, sizeof(HostSymbol), compare_host_symbol);
+
+    pthread_mutex_lock(&import_lock);
+    for (uint32_t i = 0; i < host_module_count; i++) {
+        if (strcmp(host_modules[i].name, module_name) == 0) {
+            free(host_modules[i].symbols);
+            host_modules[i].symbols = sorted;
+            host_modules[i].count = count;
+            pthread_mutex_unlock(&import_lock);
+            return;
+        }
+    }
+    host_modules = arecalloc(host_modules, host_module_count, host_module_count + 1, sizeof(HostModule), "HostModule");
+    host_modules[host_module_count].name = copy_string(module_name);
+    host_modules[host_module_count].symbols = sorted;
+    host_modules[host_module_count].count = count;
+    host_module_count++;
+    pthread_mutex_unlock(&import_lock);
+}
+
+// 从进程内注册的宿主模块中查找导入项（调用前需要持有 import_lock），找到时返回 true
+// 参数 module_found 用于返回是否存在该模块名的宿主模块
+bool find_host_symbol(const char *module_name, const char *field, void **val, bool *module_found) {
+    for (uint32_t i = 0; i < host_module_count; i++) {
+        if (strcmp(host_modules[i].name, module_name) == 0) {
+            *module_found = true;
+            HostSymbol key = {.name = field};
+            HostSymbol *sym = bsearch(&key, host_modules[i].symbols, host_modules[i].count, sizeof(HostSymbol), compare_host_symbol);
+            if (sym) {
+                *val = sym->value;
+                return true;
+            }
+            return false;
+        }
+    }
+    *module_found = false;
+    return false;
+}
+
+// 获取与模块名同名的动态库的句柄（调用前需要持有 import_lock），每个动态库只会打开一次，失败时返回 NULL 并设置 err
+void *open_library(const char *module_name, const char **err) {
+    for (uint32_t i = 0; i < library_handle_count; i++) {
+        if (strcmp(library_handles[i].name, module_name) == 0) {
+            return library_handles[i].handle;
+        }
+    }
+
+    void *handle = dlopen(module_name, RTLD_LAZY);
+    if (!handle) {
+        *err = dlerror();
+        return NULL;
+    }
+
+    // 句柄在进程退出前一直保持打开，导入函数的指针在此期间始终有效
+    library_handles = arecalloc(library_handles, library_handle_count, library_handle_count + 1, sizeof(LibraryHandle), "LibraryHandle");
+    library_handles[library_handle_count].name = copy_string(module_name);
+    library_handles[library_handle_count].handle = handle;
+    library_handle_count++;
+    return handle;
+}
+
+// 解析导入项：优先查找进程内注册的宿主符号，其次从与模块名同名的动态库中查找
+bool resolve_import(const char *module_name, const char *field, void **val, const char **err) {
+    bool module_found;
+    bool res = false;
+
+    pthread_mutex_lock(&import_lock);
+
+    if (find_host_symbol(module_name, field, val, &module_found)) {
+        res = true;
+    } else if (module_found) {
+        // 注册了该模块名的宿主模块时，不再查找同名的动态库
+        *err = "unknown import in registered host module";
+    } else {
+        void *handle = open_library(module_name, err);
+        if (handle) {
+            // 查找动态库中的 symbol，dlsym 返回符号对应的地址，既可以是函数地址，也可以是变量地址
+            dlerror();
+            *val = dlsym(handle, field);
+            const char *dl_err = dlerror();
+            if (dl_err) {
+                *err = dl_err;
+            } else {
+                res = true;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&import_lock);
+    return res;
+}
@@ -0,0 +1,42 @@
+#ifndef WASMC_IMPORT_H
+#define WASMC_IMPORT_H
+
+#include "module.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HOST_RESULT_MAX 16// 宿主函数返回值数量的上限
+
+// 宿主函数的调用约定：导入函数（无论是注册的宿主函数还是从动态库中查找到的函数）都需要遵循该约定
+// 参数 args 指向操作数栈中的函数参数（按照函数签名的顺序），返回值需要写入 results 中（值类型由调用方根据函数签名设置）
+// 如果执行过程中出现异常，则将异常信息写入 inst->exception 中并返回 false
+typedef bool (*HostFunc)(Instance *inst, StackValue *args, StackValue *results);
+
+// 宿主符号，即宿主进程提供给 Wasm 模块导入的成员
+typedef struct HostSymbol {
+    const char *name;// 成员名
+    void *value;     // 成员的值：函数为 HostFunc，表为 Table *，内存为 Memory *，全局变量为 StackValue 的值的地址
+} HostSymbol;
+
+// 注册的宿主模块，即一组同一模块名下的宿主符号
+typedef struct HostModule {
+    char *name;         // 模块名
+    HostSymbol *symbols;// 宿主符号（按照成员名排序，以便二分查找）
+    uint32_t count;     // 宿主符号的数量
+} HostModule;
+
+// 已打开的动态库
+typedef struct LibraryHandle {
+    char *name;  // 导入的模块名（即动态库文件名）
+    void *handle;// dlopen 返回的句柄
+} LibraryHandle;
+
+// 在进程内注册模块名为 module_name 的宿主符号表（可以在多个线程中同时调用），注册后 Wasm 模块即可导入其中的符号
+// 注：符号表会被拷贝，但成员名和成员的值需要在进程退出前保持有效；重复注册同一模块名时，新的符号表会覆盖旧的
+void register_host_symbols(const char *module_name, const HostSymbol *symbols, uint32_t count);
+
+// 解析导入项：优先查找进程内注册的宿主符号，其次从与模块名同名的动态库中查找（动态库的句柄会被缓存，每个动态库只会打开一次）
+// 如果解析成功则返回 true 并将导入项的值赋给 val，如果解析失败则返回 false 并设置 err
+bool resolve_import(const char *module_name, const char *field, void **val, const char **err);
+
+#endif
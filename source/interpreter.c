@@ -1,8 +1,14 @@
 #include "interpreter.h"
+#include "atomics.h"
+#include "epoch.h"
+#include "import.h"
 #include "module.h"
 #include "opcode.h"
+#include "opstats.h"
+#include "profiler.h"
 #include "utils.h"
 #include <math.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -10,43 +16,43 @@
 
 // 控制块（包含函数）被调用前，将关联的栈帧压入到调用栈顶，成为当前栈帧，
 // 同时保存该栈帧被压入调用栈顶前的运行时状态，例如 sp fp ra 等
-void push_block(Module *m, Block *block, int sp) {
+void push_block(Instance *inst, Block *block, int sp) {
     /* 1. 压入调用栈顶 */
 
     // 因新的栈帧要压入调用栈顶成为当前栈帧，所以调用栈指针（保存处在调用栈顶的栈帧索引）要加 1
-    m->csp += 1;
+    inst->csp += 1;
 
     /* 2. 关联控制块 */
 
     // 将 参数 block 设置为 当前栈帧关联的控制块
-    m->callstack[m->csp].block = block;
+    inst->callstack[inst->csp].block = block;
 
     /* 3. 保存 sp */
 
     // 将该栈帧被压入操作数栈顶前的【操作数栈顶指针】保存到 frame->sp 中，
     // 以便后续当前栈帧关联的控制块执行完成，当前栈帧弹出后，恢复压栈前的【操作数栈顶指针】
-    m->callstack[m->csp].sp = sp;
+    inst->callstack[inst->csp].sp = sp;
 
     /* 4. 保存 fp */
 
     // 将该栈帧被压入操作数栈顶前的【当前栈帧的操作数栈底指针】保存到 frame>fp 中，
     // 以便后续该栈帧关联的控制块执行完成，该栈帧弹出后，恢复压栈前的【当前栈帧的操作数栈底指针】
-    m->callstack[m->csp].fp = m->fp;
+    inst->callstack[inst->csp].fp = inst->fp;
 
     /* 5. 保存 ra */
 
     // 将该栈帧被压入操作数栈顶前的【下一条即将执行的指令的地址】保存到 frame>ra 中，
     // 以便后续该栈帧关联的函数执行完后，返回到调用该函数的地方继续执行后面的指令
-    m->callstack[m->csp].ra = m->pc;
+    inst->callstack[inst->csp].ra = inst->pc;
 }
 
 // 当前控制块（包含函数）执行结束后，将关联的当前栈帧从调用栈顶中弹出，
 // 同时恢复该栈帧被压入调用栈顶前的运行时状态，例如 sp fp ra 等
-Block *pop_block(Module *m) {
+Block *pop_block(Instance *inst) {
     /* 1. 弹出调用栈顶 */
 
     // 从调用栈顶中弹出当前栈帧，同时调用栈指针减 1
-    Frame *frame = &m->callstack[m->csp--];
+    Frame *frame = &inst->callstack[inst->csp--];
 
     /* 2. 校验控制块的返回值类型 */
 
@@ -57,8 +63,8 @@ Block *pop_block(Module *m) {
     if (t->result_count == 1) {
         // 获取当前栈帧的操作数栈顶值，也就是控制块（包含函数）的返回值，
         // 判断其类型和【控制块签名中的返回值类型】是否一致，如果不一致则记录异常信息
-        if (m->stack[m->sp].value_type != t->results[0]) {
-            sprintf(exception, "call type mismatch");
+        if (inst->stack[inst->sp].value_type != t->results[0]) {
+            sprintf(inst->exception, "call type mismatch");
             return NULL;
         }
     }
@@ -71,14 +77,14 @@ Block *pop_block(Module *m) {
         // 背景知识：目前多返回值提案还没有进入 Wasm 标准，根据当前版本的 Wasm 标准，控制块不能有参数，且最多只能有一个返回值
         // 如果控制块有一个返回值，则这个返回值需要压入到恢复后的操作数栈顶，即恢复后的操作数栈长度需要加 1
         // 所以恢复的【操作数栈顶指针值】是 该栈帧被压入调用栈前的【操作数栈顶指针】再加 1
-        if (frame->sp < m->sp) {
-            m->stack[frame->sp + 1] = m->stack[m->sp];
-            m->sp = frame->sp + 1;
+        if (frame->sp < inst->sp) {
+            inst->stack[frame->sp + 1] = inst->stack[inst->sp];
+            inst->sp = frame->sp + 1;
         }
     } else {
         // 如果控制块没有返回值，则直接恢复该栈帧被压入调用栈前的【操作数栈顶指针】即可
-        if (frame->sp < m->sp) {
-            m->sp = frame->sp;
+        if (frame->sp < inst->sp) {
+            inst->sp = frame->sp;
         }
     }
 
@@ -86,56 +92,155 @@ Block *pop_block(Module *m) {
 
     // 因为该栈帧弹出，所以需要恢复该栈帧被压入调用栈前的【当前栈帧的操作数栈底指针】
     // 注：frame->fp 保存的是该栈帧被压入调用栈前的【当前栈帧的操作数栈底指针】
-    m->fp = frame->fp;
+    inst->fp = frame->fp;
 
     /* 5. 恢复 ra */
 
     // 当控制块类型为函数时，在函数执行完成该栈帧弹出时，需要返回到该函数调用指令的下一条指令继续执行
     if (frame->block->block_type == 0x00) {
         // 将函数返回地址赋给程序计数器 pc（记录下一条即将执行的指令的地址）
-        m->pc = frame->ra;
+        inst->pc = frame->ra;
     }
 
     return frame->block;
 }
 
+// 根据 Block_/Loop/If 操作码的地址，在当前函数的控制块表中查找对应的控制块
+// 注：函数的控制块表是按照起始地址递增的顺序存储的，所以可以使用二分查找；
+// 而待查找的控制块一定嵌套在当前栈帧关联的控制块之内，即起始地址更大，所以只需在其之后的控制块中查找
+Block *lookup_block(Instance *inst, uint32_t addr) {
+    // 通过当前栈帧关联的控制块，找到其所属的函数
+    Block *current = inst->callstack[inst->csp].block;
+    Block *func = current->func;
+    uint32_t low = current == func ? 0 : (uint32_t) (current - func->blocks) + 1;
+    uint32_t high = func->block_count;
+
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (func->blocks[mid].start_addr < addr) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    ASSERT(low < func->block_count && func->blocks[low].start_addr == addr, "Block at 0x%x not found\n", addr)
+    return &func->blocks[low];
+}
+
+// 调用外部引入函数：将操作数栈顶的函数参数传给宿主函数，再将参数弹出并将宿主函数的返回值压入操作数栈
+// 注：宿主函数需要遵循 HostFunc 的调用约定，执行出现异常时宿主函数需要将异常信息写入 inst->exception 中并返回 false
+bool call_host(Instance *inst, Block *func) {
+    Type *type = func->type;
+    StackValue results[HOST_RESULT_MAX];
+
+    if (!func->func_ptr) {
+        sprintf(inst->exception, "unresolved import %s.%s", func->import_module, func->import_field);
+        return false;
+    }
+    if (type->result_count > HOST_RESULT_MAX) {
+        sprintf(inst->exception, "too many results for import %s.%s", func->import_module, func->import_field);
+        return false;
+    }
+
+    StackValue *args = &inst->stack[inst->sp - (int) type->param_count + 1];
+    if (!((HostFunc) func->func_ptr)(inst, args, results)) {
+        return false;
+    }
+
+    inst->sp -= (int) type->param_count;
+    for (uint32_t r = 0; r < type->result_count; r++) {
+        results[r].value_type = type->results[r];
+        inst->stack[++inst->sp] = results[r];
+    }
+
+    // 宿主函数请求暂停执行时，pc 已经指向调用指令的下一条指令，所以可以直接从这里继续执行
+    // 注：等待异步 I/O 时压入操作数栈的返回值只是占位，请求完成后会被实际结果覆盖
+    if (inst->suspend_request != TRAP_ERROR) {
+        inst->trap = inst->suspend_request;
+        inst->suspend_request = TRAP_ERROR;
+        sprintf(inst->exception, inst->trap == TRAP_YIELD ? "yielded" : "waiting for io");
+        return false;
+    }
+    return true;
+}
+
 // 调用函数前的设置，主要设置内容如下：
 // 1. 将当前函数关联的栈帧压入到调用栈顶成为当前栈帧，同时保存该栈帧被压入调用栈顶前的运行时状态，例如 sp fp ra 等
 // 2. 将当前函数的局部变量压入到操作数栈顶（默认初始值为 0）
 // 3. 将函数的字节码部分的【起始地址】设置为 pc（即下一条待执行指令的地址），即开始执行函数字节码中的指令流
-void setup_call(Module *m, uint32_t fidx) {
-    // 根据索引 fidx 从 m->functions 中获取当前函数
-    Block *func = &m->functions[fidx];
+// 如果函数无法执行（有多个返回值、操作数栈中没有足够的参数或者局部变量超出操作数栈容量），则记录异常信息并返回 false
+bool setup_call(Instance *inst, uint32_t fidx) {
+    // 根据索引 fidx 从 inst->module->functions 中获取当前函数
+    Block *func = &inst->module->functions[fidx];
+
+    // 如果启用了延迟编译，则函数首次被调用时才会收集其控制块的相关信息
+    compile_function(inst->module, func);
 
     // 获取函数签名
     Type *type = func->type;
+
+    // 背景知识：目前多返回值提案还没有进入 Wasm 标准，函数返回时最多只保留一个返回值（具体可查看 pop_block 函数），
+    // 执行有多个返回值的函数会导致调用方的操作数栈下溢，所以在进入函数前直接退出执行
+    if (type->result_count > 1) {
+        sprintf(inst->exception, "multiple return values not supported");
+        return false;
+    }
+    // 操作数栈下溢（只会出现在未经校验的字节码中）或者溢出时，都会覆盖实例中操作数栈之外的数据，所以需要检查
+    if (inst->sp + 1 < (int) type->param_count) {
+        sprintf(inst->exception, "operand stack underflow");
+        return false;
+    }
+    if (inst->sp + (int) func->local_count >= STACK_SIZE) {
+        sprintf(inst->exception, "operand stack exhausted");
+        return false;
+    }
     // 将当前函数关联的栈帧压入到调用栈顶，成为当前栈帧，同时保存该栈帧被压入调用栈顶前的运行时状态，例如 sp fp ra 等
     // 注：第三个参数操作数栈顶指针减去函数参数个数的原因如下：
     // 调用该函数的父函数的栈帧的操作数栈，和该函数的栈帧的操作数栈，是相邻的，且有一部分数据是重叠的，
     // 这部分数据就是子函数的参数，这样就起到了父函数将参数传递给子函数的作用，所以目前操作数栈顶会有 type->param_count 个参数
     // 真实的操作数栈顶位置应该去除掉子函数参数个数，因为当子函数执行完成后，操作数栈上的参数应该要被消耗掉，
-    // 所以真实的操作数栈顶指针应该是 m->sp - (int)type->param_count
+    // 所以真实的操作数栈顶指针应该是 inst->sp - (int)type->param_count
     // push_block 函数的第三个参数的 sp 本意就是栈帧压入调用栈时的真实操作数栈顶，待后面函数执行完栈帧弹出时，恢复 push_block 中缓存的真实操作数栈顶
-    push_block(m, func, m->sp - (int) type->param_count);
+    push_block(inst, func, inst->sp - (int) type->param_count);
 
     // 设置当前栈帧的操作数栈底指针 fp，减去函数参数个数的原因同上，也是为了从父函数传递参数给子函数
-    m->fp = m->sp - (int) type->param_count + 1;
+    inst->fp = inst->sp - (int) type->param_count + 1;
 
     // 将当前函数的局部变量压入到操作数栈顶（默认初始值为 0）
     for (uint32_t lidx = 0; lidx < func->local_count; lidx++) {
-        m->sp += 1;
-        m->stack[m->sp].value_type = func->locals[lidx];
-        m->stack[m->sp].value.uint64 = 0;
+        inst->sp += 1;
+        inst->stack[inst->sp].value_type = func->locals[lidx];
+        inst->stack[inst->sp].value.uint64 = 0;
     }
 
-    // 将函数的字节码部分的【起始地址】设置为 m->pc（即下一条待执行指令的地址）
-    m->pc = func->start_addr;
+    // 将函数的字节码部分的【起始地址】设置为 inst->pc（即下一条待执行指令的地址）
+    inst->pc = func->start_addr;
+    return true;
+}
+
+// 安全点，即函数入口、Loop 控制块入口以及每次循环时的检查：扣除 cost 单位的燃料，
+// 并检查全局纪元计数器是否已经达到截止纪元，燃料耗尽或者被中断时记录异常信息并返回 false
+// 注：到达安全点时 pc 等运行时状态已经指向控制块的第一条指令，所以补充燃料或者延长截止纪元后调用 resume 函数即可从中断处继续执行
+bool safepoint(Instance *inst, uint32_t cost) {
+    inst->fuel -= cost;
+    if (inst->fuel < 0) {
+        inst->trap = TRAP_OUT_OF_FUEL;
+        sprintf(inst->exception, "out of fuel");
+        return false;
+    }
+    if (atomic_load_explicit(&epoch, memory_order_relaxed) >= inst->epoch_deadline) {
+        inst->trap = TRAP_INTERRUPTED;
+        sprintf(inst->exception, "interrupted");
+        return false;
+    }
+    return true;
 }
 
 // 虚拟机执行字节码中的指令流
-bool interpret(Module *m) {
-    const uint8_t *bytes = m->bytes;// Wasm 二进制内容
-    StackValue *stack = m->stack;   // 操作数栈
+bool interpret(Instance *inst) {
+    const uint8_t *bytes = inst->module->bytes;// Wasm 二进制内容
+    StackValue *stack = inst->stack;   // 操作数栈
     uint8_t opcode;                 // 操作码
     uint32_t cur_pc;                // 当前的程序计数器（即下一条即将执行的指令的地址）
     Block *block;                   // 控制块
@@ -152,10 +257,22 @@ bool interpret(Module *m) {
     float g, h, i;                  // 用于 F32 数值计算
     double j, k, l;                 // 用于 F64 数值计算
 
-    while (m->pc < m->byte_count) {
-        opcode = bytes[m->pc];// 读取指令中的操作码
-        cur_pc = m->pc;       // 保存程序计数器的值（即下一条即将执行的指令的地址）
-        m->pc += 1;           // 程序计数器加 1，即指向下一条指令
+    // 除了燃料耗尽等可以恢复的情况之外，虚拟机执行失败退出时都是无法继续执行的异常
+    inst->trap = TRAP_ERROR;
+
+#ifdef WASMC_PROFILE_OPCODES
+    begin_opcode_timing();
+#endif
+
+    while (inst->pc < inst->module->byte_count) {
+        opcode = bytes[inst->pc];// 读取指令中的操作码
+        cur_pc = inst->pc;       // 保存程序计数器的值（即下一条即将执行的指令的地址）
+        inst->pc += 1;           // 程序计数器加 1，即指向下一条指令
+
+#ifdef WASMC_PROFILE_OPCODES
+        // 指令统计构建模式：记录指令的执行次数（以及上一条指令消耗的周期数），具体可查看 opstats.h
+        record_opcode(opcode, bytes + inst->pc);
+#endif
 
         switch (opcode) {
             /*
@@ -164,7 +281,7 @@ bool interpret(Module *m) {
             case Unreachable:
                 // 指令作用：引发运行时错误
                 // 当执行 Unreachable 操作码时，则记录异常信息并返回 false 退出虚拟机执行
-                sprintf(exception, "%s", "unreachable");
+                sprintf(inst->exception, "%s", "unreachable");
                 return false;
             case Nop:
                 // 指令作用：什么都不做
@@ -180,60 +297,65 @@ bool interpret(Module *m) {
 
                 // 该指令的立即数为控制块的返回值类型（占 1 个字节）
                 // TODO: 暂时不需要控制块的返回值类型，故暂时忽略
-                value_type = read_LEB_unsigned(bytes, &m->pc, 32);
+                value_type = read_LEB_unsigned(bytes, &inst->pc, 32);
                 (void) value_type;
 
                 // 如果调用栈溢出，则记录异常信息并返回 false 退出虚拟机执行
-                if (m->csp >= CALLSTACK_SIZE) {
-                    sprintf(exception, "call stack exhausted");
+                if (inst->csp + 1 >= CALLSTACK_SIZE) {
+                    sprintf(inst->exception, "call stack exhausted");
                     return false;
                 }
 
-                // 在 block_lookup 中根据 Loop/Block_ 操作码的地址查找对应的控制块
-                // 注：block_lookup 索引就是控制块的起始地址，而控制块就是以 Block_/Loop/If 操作码为开头
-                block = m->block_lookup[cur_pc];
+                // 在当前函数的控制块表中根据 Loop/Block_ 操作码的地址查找对应的控制块
+                // 注：控制块的起始地址就是对应 Block_/Loop/If 操作码的地址
+                block = lookup_block(inst, cur_pc);
 
                 // 控制块（包含函数）被调用前，将【待调用的控制块（包含函数）关联的栈帧】压入到调用栈顶，成为当前栈帧，
                 // 同时保存该栈帧被压入调用栈顶前的运行时状态，例如 sp fp ra 等
-                push_block(m, block, m->sp);
+                push_block(inst, block, inst->sp);
+
+                // 进入 Loop 控制块时经过安全点：扣除一次循环消耗的燃料，并检查是否被中断
+                if (opcode == Loop && !safepoint(inst, block->fuel_cost)) {
+                    return false;
+                }
                 continue;
             case If:
                 // 指令作用：将当前控制块（if 类型）关联的栈帧压入到调用栈顶，成为当前栈帧
 
                 // 该指令的立即数为控制块的返回值类型（占 1 个字节）
                 // TODO: 暂时不需要控制块的返回值类型，故暂时忽略
-                value_type = read_LEB_unsigned(bytes, &m->pc, 32);
+                value_type = read_LEB_unsigned(bytes, &inst->pc, 32);
                 (void) value_type;
 
                 // 如果调用栈溢出，则记录异常信息并返回 false 退出虚拟机执行
-                if (m->csp >= CALLSTACK_SIZE) {
-                    sprintf(exception, "call stack exhausted");
+                if (inst->csp + 1 >= CALLSTACK_SIZE) {
+                    sprintf(inst->exception, "call stack exhausted");
                     return false;
                 }
 
-                // 在 block_lookup 中根据 If 操作码的地址查找对应的控制块
-                // 注：block_lookup 索引就是控制块的起始地址，而控制块就是以 Block_/Loop/If 操作码为开头
-                block = m->block_lookup[cur_pc];
+                // 在当前函数的控制块表中根据 If 操作码的地址查找对应的控制块
+                // 注：控制块的起始地址就是对应 Block_/Loop/If 操作码的地址
+                block = lookup_block(inst, cur_pc);
 
                 // 控制块（包含函数）被调用前，将【待调用的控制块（包含函数）关联的栈帧】压入到调用栈顶，成为当前栈帧，
                 // 同时保存该栈帧被压入调用栈顶前的运行时状态，例如 sp fp ra 等
-                push_block(m, block, m->sp);
+                push_block(inst, block, inst->sp);
 
                 // 从操作数栈顶获取判断条件的值
                 // 注：在调用 If 指令时，操作数栈顶保存的就是判断条件的值
-                cond = stack[m->sp--].value.uint32;
+                cond = stack[inst->sp--].value.uint32;
                 // 如果判断条件为 false，则将程序计数器 pc 设置为 else 控制块首地址或 if 控制块结尾地址，
                 // 即跳过 if 分支的代码对应的指令，执行后面的指令
                 if (cond == 0) {
                     if (block->else_addr == 0) {
                         // 如果不存在 else 分支，则跳转到 if 控制块结尾的下一条指令继续执行
-                        m->pc = block->br_addr + 1;
+                        inst->pc = block->br_addr + 1;
                         // 在上面的 push_block 函数中 if 控制块对应的栈帧已经被压入到调用栈且调用栈顶索引 csp 加 1，
                         // 此时不需要执行 if 控制块的指令，所以调用栈顶索引需要减 1
-                        m->csp -= 1;
+                        inst->csp -= 1;
                     } else {
                         // 如果存在 else 分支，则执行 else 分支代码对应的字节码的起始指令，也是 Else_ 指令的下一条指令
-                        m->pc = block->else_addr;
+                        inst->pc = block->else_addr;
                     }
                 }
                 continue;
@@ -246,18 +368,18 @@ bool interpret(Module *m) {
                 // 指令作用：跳转到控制块的结尾指令继续执行
 
                 // 获取当前栈帧对应的控制块
-                block = m->callstack[m->csp].block;
+                block = inst->callstack[inst->csp].block;
                 // 跳转到控制块的结尾指令继续执行
                 // 注：当上一个分支对应的指令流执行完成后，会执行到 Else_ 指令，则需要跳过 Else_ 指令后面的 else 分支对应的指令流，
                 // 直接执行控制块的结尾指令，可以看出 Else_ 指令起到了分隔多个分支对应的指令流的作用
-                m->pc = block->br_addr;
+                inst->pc = block->br_addr;
                 continue;
             case End_:
                 // 指令作用：控制块执行结束后，将关联的当前栈帧从调用栈顶中弹出，并根据具体情况决定是否退出虚拟机的执行
 
                 // 当前控制块（包含函数）执行结束后，将关联的当前栈帧从调用栈顶中弹出，
                 // 同时恢复该栈帧被压入调用栈顶前的运行时状态，例如 sp fp ra 等
-                block = pop_block(m);
+                block = pop_block(inst);
 
                 // 如果 pop_block 函数返回 NULL，则说明有异常（具体逻辑可查看 pop_block 函数），
                 // 则直接返回 false 退出虚拟机执行
@@ -268,7 +390,7 @@ bool interpret(Module *m) {
                 if (block->block_type == 0x00) {
                     // 1. 当控制块类型为函数时，且调用栈为空（即 csp 为 -1），说明已经执行完顶层的控制块，
                     // 则直接返回 true 退出虚拟机执行，否则继续执行下一条指令
-                    if (m->csp == -1) {
+                    if (inst->csp == -1) {
                         return true;
                     }
                 } else if (block->block_type == 0x01) {
@@ -288,11 +410,16 @@ bool interpret(Module *m) {
                 // 另外该目标标签索引是相对的，例如为 0 表示该指令所在的控制块定义的跳转标签，
                 // 为 1 表示往外一层控制块定义的跳转标签，
                 // 为 2 表示再往外一层控制块定义的跳转标签，以此类推
-                depth = read_LEB_unsigned(bytes, &m->pc, 32);
+                depth = read_LEB_unsigned(bytes, &inst->pc, 32);
                 // 将目标控制块关联的栈帧设置为当前栈帧
-                m->csp -= (int) depth;
+                inst->csp -= (int) depth;
                 // 跳转到目标控制块的跳转地址继续执行后面的指令
-                m->pc = m->callstack[m->csp].block->br_addr;
+                block = inst->callstack[inst->csp].block;
+                inst->pc = block->br_addr;
+                // 跳转到 Loop 控制块的开头即开始下一次循环，经过安全点：扣除一次循环消耗的燃料，并检查是否被中断
+                if (block->block_type == Loop && !safepoint(inst, block->fuel_cost)) {
+                    return false;
+                }
                 continue;
             case BrIf:
                 // 指令作用：根据判断条件决定是否跳转到目标控制块的跳转地址继续执行后面的指令
@@ -301,15 +428,20 @@ bool interpret(Module *m) {
                 // 另外该目标标签索引是相对的，例如为 0 表示该指令所在的控制块定义的跳转标签，
                 // 为 1 表示往外一层控制块定义的跳转标签，
                 // 为 2 表示再往外一层控制块定义的跳转标签，以此类推
-                depth = read_LEB_unsigned(bytes, &m->pc, 32);
+                depth = read_LEB_unsigned(bytes, &inst->pc, 32);
                 // 将操作数栈顶值弹出，作为判断条件
-                cond = stack[m->sp--].value.uint32;
+                cond = stack[inst->sp--].value.uint32;
                 // 如果为真则跳转，否则不跳转
                 if (cond) {
                     // 将目标控制块关联的栈帧设置为当前栈帧
-                    m->csp -= (int) depth;
+                    inst->csp -= (int) depth;
                     // 跳转到目标控制块的跳转地址继续执行后面的指令
-                    m->pc = m->callstack[m->csp].block->br_addr;
+                    block = inst->callstack[inst->csp].block;
+                    inst->pc = block->br_addr;
+                    // 跳转到 Loop 控制块的开头即开始下一次循环，经过安全点：扣除一次循环消耗的燃料，并检查是否被中断
+                    if (block->block_type == Loop && !safepoint(inst, block->fuel_cost)) {
+                        return false;
+                    }
                 }
                 continue;
             case BrTable: {
@@ -324,46 +456,51 @@ bool interpret(Module *m) {
                 // 否则跳转到默认索引指定的标签处
 
                 // 读取目标标签索引的数量，也就是索引表的大小
-                uint32_t count = read_LEB_unsigned(bytes, &m->pc, 32);
+                uint32_t count = read_LEB_unsigned(bytes, &inst->pc, 32);
 
                 // 如果索引表超出了规定的最大值，则记录异常信息并直接返回 false 退出虚拟机执行
                 if (count > BR_TABLE_SIZE) {
-                    sprintf(exception, "br_table size %d exceeds max %d\n", count, BR_TABLE_SIZE);
+                    sprintf(inst->exception, "br_table size %d exceeds max %d\n", count, BR_TABLE_SIZE);
                     return false;
                 }
 
                 // 构造索引表
                 for (uint32_t n = 0; n < count; n++) {
-                    m->br_table[n] = read_LEB_unsigned(bytes, &m->pc, 32);
+                    inst->br_table[n] = read_LEB_unsigned(bytes, &inst->pc, 32);
                 }
 
                 // 读取默认索引
-                depth = read_LEB_unsigned(bytes, &m->pc, 32);
+                depth = read_LEB_unsigned(bytes, &inst->pc, 32);
 
                 // 从操作数栈顶弹出一个 i32 类型的值 m
-                int32_t didx = stack[m->sp--].value.int32;
+                int32_t didx = stack[inst->sp--].value.int32;
                 // 如果 m 小于索引表大小 n，则跳转到索引表第 m 个索引指向的目标标签处，
                 // 否则跳转到默认索引指定的标签处
                 if (didx >= 0 && didx < (int32_t) count) {
-                    depth = m->br_table[didx];
+                    depth = inst->br_table[didx];
                 }
 
                 // 将目标控制块关联的栈帧设置为当前栈帧
-                m->csp -= (int) depth;
+                inst->csp -= (int) depth;
                 // 跳转到目标控制块的跳转地址继续执行后面的指令
-                m->pc = m->callstack[m->csp].block->br_addr;
+                block = inst->callstack[inst->csp].block;
+                inst->pc = block->br_addr;
+                // 跳转到 Loop 控制块的开头即开始下一次循环，经过安全点：扣除一次循环消耗的燃料，并检查是否被中断
+                if (block->block_type == Loop && !safepoint(inst, block->fuel_cost)) {
+                    return false;
+                }
                 continue;
             }
             case Return:
                 // 指令作用：直接跳出最外层控制块，最终效果是函数返回
 
                 // 循环向外层控制块跳转，直到跳转到当前函数对应的控制块（也就是循环条件中判断是否是函数类型的代码块）
-                while (m->csp >= 0 && m->callstack[m->csp].block->block_type != 0x00) {
-                    m->csp--;
+                while (inst->csp >= 0 && inst->callstack[inst->csp].block->block_type != 0x00) {
+                    inst->csp--;
                 }
                 // 直接跳到当前函数对应的控制块结尾处，即 End_ 指令处并执行该指令
                 // 对应的当前栈帧弹出调用栈和退出虚拟机执行 是在 End_ 指令执行逻辑中
-                m->pc = m->callstack[m->csp].block->end_addr;
+                inst->pc = inst->callstack[inst->csp].block->end_addr;
                 continue;
 
             /*
@@ -374,16 +511,19 @@ bool interpret(Module *m) {
                 // 注：Call 指令要调用的函数是在编译期确定的，也就是说被调用函数的索引硬编码在 call 指令的立即数中
 
                 // 读取该指令的立即数，也就是被调用函数的索引（占 4 个字节）
-                fidx = read_LEB_unsigned(bytes, &m->pc, 32);
+                fidx = read_LEB_unsigned(bytes, &inst->pc, 32);
 
-                // 如果函数索引值小于 m->import_func_count，则说明该函数为外部函数
-                // 原因：在解析 Wasm 二进制文件内容时，首先解析导入段中的函数到 m->functions，然后再解析函数段中的函数到 m->functions
-                if (fidx < m->import_func_count) {
-                    // TODO: 暂时忽略调用外部引入函数情况
+                // 如果函数索引值小于 inst->module->import_func_count，则说明该函数为外部函数
+                // 原因：在解析 Wasm 二进制文件内容时，首先解析导入段中的函数到 inst->module->functions，然后再解析函数段中的函数到 inst->module->functions
+                if (fidx < inst->module->import_func_count) {
+                    // 调用外部引入函数，即直接执行 func_ptr 指针所指向的宿主函数
+                    if (!call_host(inst, &inst->module->functions[fidx])) {
+                        return false;
+                    }
                 } else {
                     // 如果调用栈溢出，则记录异常信息并返回 false 退出虚拟机执行
-                    if (m->csp >= CALLSTACK_SIZE) {
-                        sprintf(exception, "call stack exhausted");
+                    if (inst->csp + 1 >= CALLSTACK_SIZE) {
+                        sprintf(inst->exception, "call stack exhausted");
                         return false;
                     }
 
@@ -391,7 +531,14 @@ bool interpret(Module *m) {
                     // 1. 将当前函数关联的栈帧压入到调用栈顶成为当前栈帧，同时保存该栈帧被压入调用栈顶前的运行时状态，例如 sp fp ra 等
                     // 2. 将当前函数的局部变量压入到操作数栈顶（默认初始值为 0）
                     // 3. 将函数的字节码部分的【起始地址】设置为 pc（即下一条待执行指令的地址），即开始执行函数字节码中的指令流
-                    setup_call(m, fidx);
+                    if (!setup_call(inst, fidx)) {
+                        return false;
+                    }
+
+                    // 进入函数时经过安全点：扣除函数消耗的燃料，并检查是否被中断
+                    if (!safepoint(inst, inst->module->functions[fidx].fuel_cost)) {
+                        return false;
+                    }
                 }
                 continue;
             case CallIndirect: {
@@ -400,42 +547,51 @@ bool interpret(Module *m) {
                 // 具体调用哪个函数只有在运行期间根据操作数栈顶的值才能确定
 
                 // 第一个立即数表示被调用函数的类型索引（占 4 个字节）
-                uint32_t tidx = read_LEB_unsigned(bytes, &m->pc, 32);
+                uint32_t tidx = read_LEB_unsigned(bytes, &inst->pc, 32);
 
                 // 第二个立即数为保留立即数（占 1 个比特位）
-                read_LEB_unsigned(bytes, &m->pc, 1);
+                read_LEB_unsigned(bytes, &inst->pc, 1);
 
                 // 操作数栈顶保存的值是【函数索引值】在表 table 中的索引
-                uint32_t val = stack[m->sp--].value.uint32;
+                uint32_t val = stack[inst->sp--].value.uint32;
                 // 如果该值大于或等于表 table 的最大值，则记录异常信息并返回 false 退出虚拟机执行
-                if (val >= m->table.max_size) {
-                    sprintf(exception, "undefined element 0x%x (max: 0x%x) in table", val, m->table.max_size);
+                if (val >= inst->table.max_size) {
+                    sprintf(inst->exception, "undefined element 0x%x (max: 0x%x) in table", val, inst->table.max_size);
                     return false;
                 }
 
                 // 从表 table 中读取【函数索引值】
-                fidx = m->table.entries[val];
+                fidx = inst->table.entries[val];
 
-                // 如果函数索引值小于 m->import_func_count，则说明该函数为外部函数
-                // 原因：在解析 Wasm 二进制文件内容到内存时，是先解析导入段中的函数到 m->functions，然后再解析函数段中的函数到 m->functions
-                if (fidx < m->import_func_count) {
-                    // TODO: 暂时忽略调用外部引入函数情况
+                // 如果函数索引值小于 inst->module->import_func_count，则说明该函数为外部函数
+                // 原因：在解析 Wasm 二进制文件内容到内存时，是先解析导入段中的函数到 inst->module->functions，然后再解析函数段中的函数到 inst->module->functions
+                if (fidx < inst->module->import_func_count) {
+                    // 如果【实际函数类型】和【指令立即数中对应的函数类型】不相同，
+                    // 则记录异常信息并返回 false 退出虚拟机执行
+                    if (inst->module->functions[fidx].type->mask != inst->module->types[tidx].mask) {
+                        sprintf(inst->exception, "indirect call type mismatch (call type and function type differ)");
+                        return false;
+                    }
+                    // 调用外部引入函数，即直接执行 func_ptr 指针所指向的宿主函数
+                    if (!call_host(inst, &inst->module->functions[fidx])) {
+                        return false;
+                    }
                 } else {
                     // 通过函数索引获取到函数
-                    Block *func = &m->functions[fidx];
+                    Block *func = &inst->module->functions[fidx];
                     // 获取函数签名
                     Type *ftype = func->type;
 
                     // 如果调用栈溢出，则记录异常信息并返回 false 退出虚拟机执行
-                    if (m->csp >= CALLSTACK_SIZE) {
-                        sprintf(exception, "call stack exhausted");
+                    if (inst->csp + 1 >= CALLSTACK_SIZE) {
+                        sprintf(inst->exception, "call stack exhausted");
                         return false;
                     }
 
                     // 如果【实际函数类型】和【指令立即数中对应的函数类型】不相同，
                     // 则记录异常信息并返回 false 退出虚拟机执行
-                    if (ftype->mask != m->types[tidx].mask) {
-                        sprintf(exception, "indirect call type mismatch (call type and function type differ)");
+                    if (ftype->mask != inst->module->types[tidx].mask) {
+                        sprintf(inst->exception, "indirect call type mismatch (call type and function type differ)");
                         return false;
                     }
 
@@ -443,13 +599,15 @@ bool interpret(Module *m) {
                     // 1. 将当前函数关联的栈帧压入到调用栈顶成为当前栈帧，同时保存该栈帧被压入调用栈顶前的运行时状态，例如 sp fp ra 等
                     // 2. 将当前函数的局部变量压入到操作数栈顶（默认初始值为 0）
                     // 3. 将函数的字节码部分的【起始地址】设置为 pc（即下一条待执行指令的地址），即开始执行函数字节码中的指令流
-                    setup_call(m, fidx);
+                    if (!setup_call(inst, fidx)) {
+                        return false;
+                    }
 
                     // 由于 setup_call 函数中会将函数参数和局部变量压入操作数栈，
                     // 所以可以校验【函数签名中声明的参数数量 + 函数局部变量数量】和【压入操作数栈的函数参数和局部变量总数】是否相等，
                     // 如果不相等则记录异常信息并返回 false 退出虚拟机执行
-                    if (ftype->param_count + func->local_count != m->sp - m->fp + 1) {
-                        sprintf(exception, "indirect call type mismatch (param counts differ)");
+                    if (ftype->param_count + func->local_count != inst->sp - inst->fp + 1) {
+                        sprintf(inst->exception, "indirect call type mismatch (param counts differ)");
                         return false;
                     }
 
@@ -457,11 +615,16 @@ bool interpret(Module *m) {
                     // 所以可以遍历【压入操作数栈的函数参数】的值，校验其类型和【函数签名中声明的参数类型】是否相等，
                     // 如果不相等则记录异常信息并返回 false 退出虚拟机执行
                     for (uint32_t n = 0; n < ftype->param_count; n++) {
-                        if (ftype->params[n] != m->stack[m->fp + n].value_type) {
-                            sprintf(exception, "indirect call type mismatch (param types differ)");
+                        if (ftype->params[n] != inst->stack[inst->fp + n].value_type) {
+                            sprintf(inst->exception, "indirect call type mismatch (param types differ)");
                             return false;
                         }
                     }
+
+                    // 进入函数时经过安全点：扣除函数消耗的燃料，并检查是否被中断
+                    if (!safepoint(inst, func->fuel_cost)) {
+                        return false;
+                    }
                 }
                 continue;
             }
@@ -471,7 +634,7 @@ bool interpret(Module *m) {
              * */
             case Drop:
                 // 指令作用：丢弃操作数栈顶值
-                m->sp--;
+                inst->sp--;
                 continue;
             case Select:
                 // 指令作用：从栈顶弹出 3 个操作数，根据最先弹出的操作数从其他两个操作数中选择一个压栈
@@ -479,20 +642,20 @@ bool interpret(Module *m) {
                 // 注：最先弹出的操作数必须是 i32 类型，其他 2 个操作数数相同类型就可以
 
                 // 最先弹出的操作数必须是 i32 类型，否则报错
-                ASSERT(stack[m->sp].value_type == I32, "The type of operand stack top value need to be i32 when call select instruction \n")
+                ASSERT(stack[inst->sp].value_type == I32, "The type of operand stack top value need to be i32 when call select instruction \n")
                 // 先从操作数栈弹出一个值作为判断条件
-                cond = stack[m->sp--].value.uint32;
+                cond = stack[inst->sp--].value.uint32;
 
                 // 先将次栈顶设置为栈顶，
                 // 如果判断条件为 true，则将最后弹出的操作数压栈，
                 // 最后弹出的操作数也就是当前的次栈顶的值，已经将其设置为栈顶值，所以后面无需再做任何操作
-                m->sp--;
+                inst->sp--;
 
                 // 如果判断条件为 false，则将中间弹出的操作数压栈，
-                // 中间弹出的操作数压栈也就是 m->sp-- 之前的栈顶值，
-                // 所以用 m->sp-- 之前的栈顶值覆盖掉  m->sp-- 之后的栈顶值即可
+                // 中间弹出的操作数压栈也就是 inst->sp-- 之前的栈顶值，
+                // 所以用 inst->sp-- 之前的栈顶值覆盖掉  inst->sp-- 之后的栈顶值即可
                 if (!cond) {
-                    stack[m->sp] = stack[m->sp + 1];
+                    stack[inst->sp] = stack[inst->sp + 1];
                 }
                 continue;
 
@@ -502,34 +665,34 @@ bool interpret(Module *m) {
              *
              * 注：每个函数关联的栈帧拥有一段操作数栈（多个函数栈帧共享同一个大的操作数栈），
              * 该函数栈帧的操作数栈的开头就存储局部变量，
-             * 所以可以通过【函数栈帧的操作数栈底】加上【局部变量索引】来定位到该局部变量，即 m->fp + idx
+             * 所以可以通过【函数栈帧的操作数栈底】加上【局部变量索引】来定位到该局部变量，即 inst->fp + idx
              * */
             case LocalGet:
                 // 指令作用：将指定局部变量压入到操作数栈顶
 
                 // 该指令的立即数为局部变量的索引
-                idx = read_LEB_unsigned(bytes, &m->pc, 32);
+                idx = read_LEB_unsigned(bytes, &inst->pc, 32);
 
                 // 将指定局部变量的值压入到操作数栈顶
-                stack[++m->sp] = stack[m->fp + idx];
+                stack[++inst->sp] = stack[inst->fp + idx];
                 continue;
             case LocalSet:
                 // 指令作用：将操作数栈顶的值弹出并保存到指定局部变量中
 
                 // 该指令的立即数为局部变量的索引
-                idx = read_LEB_unsigned(bytes, &m->pc, 32);
+                idx = read_LEB_unsigned(bytes, &inst->pc, 32);
 
                 // 弹出操作数栈顶的值，将其保存到指定局部变量中
-                stack[m->fp + idx] = stack[m->sp--];
+                stack[inst->fp + idx] = stack[inst->sp--];
                 continue;
             case LocalTee:
                 // 指令作用：将操作数栈顶值保存到指定局部变量中，但不弹出栈顶值
 
                 // 该指令的立即数为局部变量的索引
-                idx = read_LEB_unsigned(bytes, &m->pc, 32);
+                idx = read_LEB_unsigned(bytes, &inst->pc, 32);
 
                 // 弹出操作数栈顶的值，将其保存到指定局部变量中（注意：不弹出栈顶值）
-                stack[m->fp + idx] = stack[m->sp];
+                stack[inst->fp + idx] = stack[inst->sp];
                 continue;
 
             /*
@@ -540,19 +703,19 @@ bool interpret(Module *m) {
                 // 指令作用：将指定全局变量压入到操作数栈顶
 
                 // 该指令的立即数为全局变量的索引
-                idx = read_LEB_unsigned(bytes, &m->pc, 32);
+                idx = read_LEB_unsigned(bytes, &inst->pc, 32);
 
                 // 将指定局部变量的值压入到操作数栈顶
-                stack[++m->sp] = m->globals[idx];
+                stack[++inst->sp] = inst->globals[idx];
                 continue;
             case GlobalSet:
                 // 指令作用：操作数栈顶的值弹出并保存到指定全局变量中
 
                 // 该指令的立即数为全局变量的索引
-                idx = read_LEB_unsigned(bytes, &m->pc, 32);
+                idx = read_LEB_unsigned(bytes, &inst->pc, 32);
 
                 // 弹出操作数栈顶的值，将其保存到指定全局变量中
-                m->globals[idx] = stack[m->sp--];
+                inst->globals[idx] = stack[inst->sp--];
                 continue;
 
             /*
@@ -566,105 +729,105 @@ bool interpret(Module *m) {
                 // 保存的是以 2 为底，对齐字节数的对数，占 4 个字节
                 // 例如 0 表示一字节（2^0）对齐，1 表示两字节（2^1）对齐，2 表示四字节（2^2）对齐
                 // 对齐方式只起提示作用，目的是帮助 JIT/AOT 编译器生成更优化的机器代码，对实际执行结果没有任何影响，暂时忽略
-                read_LEB_unsigned(bytes, &m->pc, 32);
+                read_LEB_unsigned(bytes, &inst->pc, 32);
 
                 // 第二个立即数表示内存偏移量
                 // 从操作数栈顶弹出一个 i32 类型的数，和内存偏移量 offset 相加，就可以得到实际内存相对地址
                 // 注：操作数栈顶弹出的数和内存偏移量都是 32 位无符号整数，所以 Wasm 实际拥有 33 比特的地址空间
-                offset = read_LEB_unsigned(bytes, &m->pc, 32);
+                offset = read_LEB_unsigned(bytes, &inst->pc, 32);
                 // 从操作数栈顶弹出一个 i32 类型的数（用于获取实际内存地址）
-                addr = stack[m->sp--].value.uint32;
+                addr = stack[inst->sp--].value.uint32;
 
                 // 获取实际内存地址
-                maddr = m->memory.bytes + offset + addr;
+                maddr = inst->memory.bytes + offset + addr;
 
                 // TODO: 忽略校验 offset/addr/maddr 值的合法性
 
                 // 将 0 作为初始值压入操作数栈顶
-                stack[++m->sp].value.uint64 = 0;
+                stack[++inst->sp].value.uint64 = 0;
 
                 // 根据具体指令将实际内存地址里保存的数值拷贝到操作数栈顶
                 switch (opcode) {
                     case I32Load:
                         // 从内存拷贝 4 个字节数到操作数栈顶（栈顶类型为 32 位整数）
-                        memcpy(&stack[m->sp].value, maddr, 4);
-                        stack[m->sp].value_type = I32;
+                        memcpy(&stack[inst->sp].value, maddr, 4);
+                        stack[inst->sp].value_type = I32;
                         break;
 
                     case I64Load:
                         // 从内存拷贝 8 个字节数到操作数栈顶（栈顶类型为 64 位整数）
-                        memcpy(&stack[m->sp].value, maddr, 8);
-                        stack[m->sp].value_type = I64;
+                        memcpy(&stack[inst->sp].value, maddr, 8);
+                        stack[inst->sp].value_type = I64;
                         break;
                     case F32Load:
                         // 从内存拷贝 4 个字节数到操作数栈顶（栈顶类型为 32 位浮点数）
-                        memcpy(&stack[m->sp].value, maddr, 4);
-                        stack[m->sp].value_type = F32;
+                        memcpy(&stack[inst->sp].value, maddr, 4);
+                        stack[inst->sp].value_type = F32;
                         break;
                     case F64Load:
                         // 从内存拷贝 8 个字节数到操作数栈顶（栈顶类型为 64 位浮点数）
-                        memcpy(&stack[m->sp].value, maddr, 8);
-                        stack[m->sp].value_type = F64;
+                        memcpy(&stack[inst->sp].value, maddr, 8);
+                        stack[inst->sp].value_type = F64;
                         break;
                     case I32Load8S:
                         // 从内存拷贝 1 个字节有符号数到操作数栈顶（栈顶类型为 32 位整数）
-                        memcpy(&stack[m->sp].value, maddr, 1);
-                        sext_8_32(&stack[m->sp].value.uint32);
-                        stack[m->sp].value_type = I32;
+                        memcpy(&stack[inst->sp].value, maddr, 1);
+                        sext_8_32(&stack[inst->sp].value.uint32);
+                        stack[inst->sp].value_type = I32;
                         break;
                     case I32Load8U:
                         // 从内存拷贝 1 个字节无符号数到操作数栈顶（栈顶类型为 32 位整数）
                         // 因为是无符号数，在转换为更大的数据类型时，只需简单地在开头添加 0 占位，无需特殊转换
-                        memcpy(&stack[m->sp].value, maddr, 1);
-                        stack[m->sp].value_type = I32;
+                        memcpy(&stack[inst->sp].value, maddr, 1);
+                        stack[inst->sp].value_type = I32;
                         break;
                     case I32Load16S:
                         // 从内存拷贝 2 个字节有符号数到操作数栈顶（栈顶类型为 32 位整数）
-                        memcpy(&stack[m->sp].value, maddr, 2);
-                        sext_16_32(&stack[m->sp].value.uint32);
-                        stack[m->sp].value_type = I32;
+                        memcpy(&stack[inst->sp].value, maddr, 2);
+                        sext_16_32(&stack[inst->sp].value.uint32);
+                        stack[inst->sp].value_type = I32;
                         break;
                     case I32Load16U:
                         // 从内存拷贝 2 个字节无符号数到操作数栈顶（栈顶类型为 32 位整数）
                         // 因为是无符号数，在转换为更大的数据类型时，只需简单地在开头添加 0 占位，无需特殊转换
-                        memcpy(&stack[m->sp].value, maddr, 2);
-                        stack[m->sp].value_type = I32;
+                        memcpy(&stack[inst->sp].value, maddr, 2);
+                        stack[inst->sp].value_type = I32;
                         break;
                     case I64Load8S:
                         // 从内存拷贝 1 个字节有符号数到操作数栈顶（栈顶类型为 64 位整数）
-                        memcpy(&stack[m->sp].value, maddr, 1);
-                        sext_8_64(&stack[m->sp].value.uint64);
-                        stack[m->sp].value_type = I64;
+                        memcpy(&stack[inst->sp].value, maddr, 1);
+                        sext_8_64(&stack[inst->sp].value.uint64);
+                        stack[inst->sp].value_type = I64;
                         break;
                     case I64Load8U:
                         // 从内存拷贝 1 个字节无符号数到操作数栈顶（栈顶类型为 64 位整数）
                         // 因为是无符号数，在转换为更大的数据类型时，只需简单地在开头添加 0 占位，无需特殊转换
-                        memcpy(&stack[m->sp].value, maddr, 1);
-                        stack[m->sp].value_type = I64;
+                        memcpy(&stack[inst->sp].value, maddr, 1);
+                        stack[inst->sp].value_type = I64;
                         break;
                     case I64Load16S:
                         // 从内存拷贝 2 个字节有符号数到操作数栈顶（栈顶类型为 64 位整数）
-                        memcpy(&stack[m->sp].value, maddr, 2);
-                        sext_16_64(&stack[m->sp].value.uint64);
-                        stack[m->sp].value_type = I64;
+                        memcpy(&stack[inst->sp].value, maddr, 2);
+                        sext_16_64(&stack[inst->sp].value.uint64);
+                        stack[inst->sp].value_type = I64;
                         break;
                     case I64Load16U:
                         // 从内存拷贝 2 个字节无符号数到操作数栈顶（栈顶类型为 64 位整数）
                         // 因为是无符号数，在转换为更大的数据类型时，只需简单地在开头添加 0 占位，无需特殊转换
-                        memcpy(&stack[m->sp].value, maddr, 2);
-                        stack[m->sp].value_type = I64;
+                        memcpy(&stack[inst->sp].value, maddr, 2);
+                        stack[inst->sp].value_type = I64;
                         break;
                     case I64Load32S:
                         // 从内存拷贝 4 个字节有符号数到操作数栈顶（栈顶类型为 64 位整数）
-                        memcpy(&stack[m->sp].value, maddr, 4);
-                        sext_32_64(&stack[m->sp].value.uint64);
-                        stack[m->sp].value_type = I64;
+                        memcpy(&stack[inst->sp].value, maddr, 4);
+                        sext_32_64(&stack[inst->sp].value.uint64);
+                        stack[inst->sp].value_type = I64;
                         break;
                     case I64Load32U:
                         // 从内存拷贝 4 个字节无符号数到操作数栈顶（栈顶类型为 64 位整数）
                         // 因为是无符号数，在转换为更大的数据类型时，只需简单地在开头添加 0 占位，无需特殊转换
-                        memcpy(&stack[m->sp].value, maddr, 4);
-                        stack[m->sp].value_type = I64;
+                        memcpy(&stack[inst->sp].value, maddr, 4);
+                        stack[inst->sp].value_type = I64;
                         break;
                     default:
                         break;
@@ -682,20 +845,20 @@ bool interpret(Module *m) {
                 // 保存的是以 2 为底，对齐字节数的对数，占 4 个字节
                 // 例如 0 表示一字节（2^0）对齐，1 表示两字节（2^1）对齐，2 表示四字节（2^2）对齐
                 // 对齐方式只起提示作用，目的是帮助 JIT/AOT 编译器生成更优化的机器代码，对实际执行结果没有任何影响，暂时忽略
-                read_LEB_unsigned(bytes, &m->pc, 32);
+                read_LEB_unsigned(bytes, &inst->pc, 32);
 
                 // 第二个立即数表示内存偏移量
                 // 从操作数栈顶弹出一个 i32 类型的数，和内存偏移量 offset 相加，就可以得到实际内存相对地址
                 // 注：操作数栈顶弹出的数和内存偏移量都是 32 位无符号整数，所以 Wasm 实际拥有 33 比特的地址空间
-                offset = read_LEB_unsigned(bytes, &m->pc, 32);
+                offset = read_LEB_unsigned(bytes, &inst->pc, 32);
 
                 // 获取操作数栈顶地址，并将栈顶弹出
-                StackValue *sval = &stack[m->sp--];
+                StackValue *sval = &stack[inst->sp--];
 
                 // 再从操作数栈顶弹出一个 i32 类型的数（用于获取实际内存地址）
-                addr = stack[m->sp--].value.uint32;
+                addr = stack[inst->sp--].value.uint32;
                 // 获取实际内存地址
-                maddr = m->memory.bytes + offset + addr;
+                maddr = inst->memory.bytes + offset + addr;
 
                 // TODO: 忽略校验 offset/addr/maddr 值的合法性
 
@@ -750,11 +913,14 @@ bool interpret(Module *m) {
 
                 // 该指令的立即数表示当前操作的是第几块内存（占 1 个内存）
                 // 但由于当前 Wasm 规范规定最多只能导入或定义一块内存，所以目前必须为 0
-                read_LEB_unsigned(bytes, &m->pc, 32);
+                read_LEB_unsigned(bytes, &inst->pc, 32);
 
                 // 将当前的内存页数以 i32 类型压入操作数栈顶
-                stack[++m->sp].value_type = I32;
-                stack[m->sp].value.uint32 = m->memory.cur_size;
+                // 注：共享内存可能被其他线程中的实例增长，所以需要从实例实际使用的内存中原子地读取当前页数
+                stack[++inst->sp].value_type = I32;
+                stack[inst->sp].value.uint32 = inst->memory.shared
+                                                       ? atomic_load((_Atomic uint32_t *) &instance_memory(inst)->cur_size)
+                                                       : inst->memory.cur_size;
                 continue;
 
             /*
@@ -765,19 +931,28 @@ bool interpret(Module *m) {
 
                 // 该指令的立即数表示当前操作的是第几块内存（占 1 个内存）
                 // 但由于当前 Wasm 规范规定最多只能导入或定义一块内存，所以目前必须为 0
-                read_LEB_unsigned(bytes, &m->pc, 32);
-
-                // 先保存当前内存页数
-                uint32_t prev_pages = m->memory.cur_size;
+                read_LEB_unsigned(bytes, &inst->pc, 32);
 
                 // 将操作数栈顶值作为内存要增长的页数
-                uint32_t delta = stack[m->sp].value.uint32;
+                uint32_t delta = stack[inst->sp].value.uint32;
+
+                // 共享内存已经按照最大页数预留了地址空间，只需要原子地增加当前页数（多个线程可能同时增长同一块共享内存）
+                if (inst->memory.shared) {
+                    Memory *mem = instance_memory(inst);
+                    uint32_t res = grow_shared_memory(mem, delta);
+                    // 与非共享内存的处理保持一致，增长失败时同样返回当前内存页数
+                    stack[inst->sp].value.uint32 = res == UINT32_MAX ? atomic_load((_Atomic uint32_t *) &mem->cur_size) : res;
+                    continue;
+                }
+
+                // 先保存当前内存页数
+                uint32_t prev_pages = inst->memory.cur_size;
 
                 // 用刚刚保存的当前内存页数覆盖当前操作数栈顶值
-                stack[m->sp].value.uint32 = prev_pages;
+                stack[inst->sp].value.uint32 = prev_pages;
 
                 // 校验内存增长页数是否合法
-                if (delta == 0 || delta + prev_pages > m->memory.max_size) {
+                if (delta == 0 || delta + prev_pages > inst->memory.max_size) {
                     // 如果内存增长页数为 0，
                     // 或者内存增长页数加上当前内存页数后，超过了内存最大页数，
                     // 则什么都不做，执行下一条指令
@@ -785,8 +960,14 @@ bool interpret(Module *m) {
                 }
 
                 // 如果内存增长页数合法，则增加 delta 页内存
-                m->memory.cur_size += delta;
-                m->memory.bytes = arecalloc(m->memory.bytes, prev_pages * PAGE_SIZE, m->memory.cur_size * PAGE_SIZE, sizeof(uint8_t), "Module->memory.bytes");
+                inst->memory.cur_size += delta;
+
+                // 如果已经预先预留了足够的内存（例如实例池中的实例），则无需重新申请内存
+                // 注：预留的内存中超出当前页数的部分始终为 0（具体可查看 pool.c）
+                if (inst->memory.cur_size <= inst->memory.reserved_size) {
+                    continue;
+                }
+                inst->memory.bytes = arecalloc(inst->memory.bytes, prev_pages * PAGE_SIZE, inst->memory.cur_size * PAGE_SIZE, sizeof(uint8_t), "Instance->memory.bytes");
                 continue;
 
             /*
@@ -797,34 +978,34 @@ bool interpret(Module *m) {
             case I32Const:
                 // 指令作用：将指令的立即数以 i32 类型压入操作数栈顶
 
-                stack[++m->sp].value_type = I32;
-                stack[m->sp].value.uint32 = read_LEB_signed(bytes, &m->pc, 32);
+                stack[++inst->sp].value_type = I32;
+                stack[inst->sp].value.uint32 = read_LEB_signed(bytes, &inst->pc, 32);
                 continue;
             case I64Const:
                 // 指令作用：将指令的立即数以 i64 类型压入操作数栈顶
 
-                stack[++m->sp].value_type = I64;
-                stack[m->sp].value.int64 = (int64_t) read_LEB_signed(bytes, &m->pc, 64);
+                stack[++inst->sp].value_type = I64;
+                stack[inst->sp].value.int64 = (int64_t) read_LEB_signed(bytes, &inst->pc, 64);
                 continue;
             case F32Const:
                 // 指令作用：将指令的立即数以 f32 类型压入操作数栈顶
 
-                stack[++m->sp].value_type = F32;
+                stack[++inst->sp].value_type = F32;
                 // LEB128 编码仅针对整数，而该指令的立即数为浮点数，并没有被编码，而是直接写入到 Wasm 二进制文件中的
-                memcpy(&stack[m->sp].value.uint32, bytes + m->pc, 4);
+                memcpy(&stack[inst->sp].value.uint32, bytes + inst->pc, 4);
                 // 由于是直接将 4 个字节长度的立即数的值拷贝到栈顶，
                 // 没有调用 read_LEB_signed（该函数会实时更新 pc 保存的值），所以程序计数器需要手动加 4
-                m->pc += 4;
+                inst->pc += 4;
                 continue;
             case F64Const:
                 // 指令作用：将指令的立即数以 f64 类型压入操作数栈顶
 
-                stack[++m->sp].value_type = F64;
+                stack[++inst->sp].value_type = F64;
                 // LEB128 编码仅针对整数，而该指令的立即数为浮点数，并没有被编码，而是直接写入到 Wasm 二进制文件中的
-                memcpy(&stack[m->sp].value.uint64, bytes + m->pc, 8);
+                memcpy(&stack[inst->sp].value.uint64, bytes + inst->pc, 8);
                 // 由于是直接将 8 个字节长度的立即数的值拷贝到栈顶，
                 // 没有调用 read_LEB_signed（该函数会实时更新 pc 保存的值），所以程序计数器需要手动加 8
-                m->pc += 8;
+                inst->pc += 8;
                 continue;
 
             /*
@@ -838,16 +1019,16 @@ bool interpret(Module *m) {
 
                 // 获取栈顶操作数栈顶值（32 位整数），判断是否为 0，
                 // 然后用判断结果（i32 类型的布尔值）覆盖当前操作数栈顶值
-                stack[m->sp].value_type = I32;
-                stack[m->sp].value.uint32 = stack[m->sp].value.uint32 == 0;
+                stack[inst->sp].value_type = I32;
+                stack[inst->sp].value.uint32 = stack[inst->sp].value.uint32 == 0;
                 continue;
             case I64Eqz:
                 // 指令作用：判断操作数栈顶值（64 位整数）是否为 0
 
                 // 获取栈顶操作数值（64 位整数），判断是否为 0，
                 // 然后用判断结果（i32 类型的布尔值）覆盖当前操作数栈顶值
-                stack[m->sp].value_type = I32;
-                stack[m->sp].value.uint32 = stack[m->sp].value.uint64 == 0;
+                stack[inst->sp].value_type = I32;
+                stack[inst->sp].value.uint32 = stack[inst->sp].value.uint64 == 0;
                 continue;
 
             /*
@@ -856,9 +1037,9 @@ bool interpret(Module *m) {
             case I32Eq ... I32GeU:
                 // 指令作用：获取操作数栈的栈顶和次栈顶的值（32 位整数），根据具体指令对两个值进行比较，并用比较结果覆盖当前操作数栈顶值
 
-                a = stack[m->sp - 1].value.uint32;
-                b = stack[m->sp].value.uint32;
-                m->sp -= 1;
+                a = stack[inst->sp - 1].value.uint32;
+                b = stack[inst->sp].value.uint32;
+                inst->sp -= 1;
                 switch (opcode) {
                     case I32Eq:
                         c = a == b;
@@ -894,15 +1075,15 @@ bool interpret(Module *m) {
                         break;
                 }
                 // 注：比较的结果为布尔值，用 32 位整数表示
-                stack[m->sp].value_type = I32;
-                stack[m->sp].value.uint32 = c;
+                stack[inst->sp].value_type = I32;
+                stack[inst->sp].value.uint32 = c;
                 continue;
             case I64Eq ... I64GeU:
                 // 指令作用：获取操作数栈的栈顶和次栈顶的值（64 位整数），根据具体指令对两个值进行比较，并用比较结果覆盖当前操作数栈顶值
 
-                d = stack[m->sp - 1].value.uint64;
-                e = stack[m->sp].value.uint64;
-                m->sp -= 1;
+                d = stack[inst->sp - 1].value.uint64;
+                e = stack[inst->sp].value.uint64;
+                inst->sp -= 1;
                 switch (opcode) {
                     case I64Eq:
                         c = d == e;
@@ -938,15 +1119,15 @@ bool interpret(Module *m) {
                         break;
                 }
                 // 注：比较的结果为布尔值，用 32 位整数表示
-                stack[m->sp].value_type = I32;
-                stack[m->sp].value.uint32 = c;
+                stack[inst->sp].value_type = I32;
+                stack[inst->sp].value.uint32 = c;
                 continue;
             case F32Eq ... F32Ge:
                 // 指令作用：获取操作数栈的栈顶和次栈顶的值（32 位浮点数），根据具体指令对两个值进行比较，并用比较结果覆盖当前操作数栈顶值
 
-                g = stack[m->sp - 1].value.f32;
-                h = stack[m->sp].value.f32;
-                m->sp -= 1;
+                g = stack[inst->sp - 1].value.f32;
+                h = stack[inst->sp].value.f32;
+                inst->sp -= 1;
                 switch (opcode) {
                     case F32Eq:
                         c = g == h;
@@ -970,15 +1151,15 @@ bool interpret(Module *m) {
                         break;
                 }
                 // 注：比较的结果为布尔值，用 32 位整数表示
-                stack[m->sp].value_type = I32;
-                stack[m->sp].value.uint32 = c;
+                stack[inst->sp].value_type = I32;
+                stack[inst->sp].value.uint32 = c;
                 continue;
             case F64Eq ... F64Ge:
                 // 指令作用：获取操作数栈的栈顶和次栈顶的值（64 位浮点数），根据具体指令对两个值进行比较，并用比较结果覆盖当前操作数栈顶值
 
-                j = stack[m->sp - 1].value.f64;
-                k = stack[m->sp].value.f64;
-                m->sp -= 1;
+                j = stack[inst->sp - 1].value.f64;
+                k = stack[inst->sp].value.f64;
+                inst->sp -= 1;
                 switch (opcode) {
                     case F64Eq:
                         c = j == k;
@@ -1002,8 +1183,8 @@ bool interpret(Module *m) {
                         break;
                 }
                 // 注：比较的结果为布尔值，用 32 位整数表示
-                stack[m->sp].value_type = I32;
-                stack[m->sp].value.uint32 = c;
+                stack[inst->sp].value_type = I32;
+                stack[inst->sp].value.uint32 = c;
                 continue;
 
             /*
@@ -1012,7 +1193,7 @@ bool interpret(Module *m) {
             case I32Clz ... I32PopCnt:
                 // 指令作用：获取操作数栈顶值（32 位整数），根据指令对其进行相应计算，并用计算结果覆盖当前操作数栈顶值
 
-                a = stack[m->sp].value.uint32;
+                a = stack[inst->sp].value.uint32;
                 switch (opcode) {
                     case I32Clz:
                         // 数值的二进制表示的位数
@@ -1030,19 +1211,19 @@ bool interpret(Module *m) {
                         break;
                 }
 
-                stack[m->sp].value.uint32 = c;
+                stack[inst->sp].value.uint32 = c;
                 continue;
             case I32Add ... I32Rotr:
                 // 指令作用：获取操作数栈的栈顶和次栈顶的值（32 位整数），根据具体指令对两个值进行计算，并用计算结果覆盖当前操作数栈顶值
 
-                a = stack[m->sp - 1].value.uint32;
-                b = stack[m->sp].value.uint32;
-                m->sp -= 1;
+                a = stack[inst->sp - 1].value.uint32;
+                b = stack[inst->sp].value.uint32;
+                inst->sp -= 1;
 
                 // 执行 I32DivS 和 I32RemU 之间的指令时，栈顶值 b 不能为 0，
                 // 如果为 0 则记录异常信息并返回 false 退出虚拟机执行
                 if (opcode >= I32DivS && opcode <= I32RemU && b == 0) {
-                    sprintf(exception, "integer divide by zero");
+                    sprintf(inst->exception, "integer divide by zero");
                     return false;
                 }
 
@@ -1062,7 +1243,7 @@ bool interpret(Module *m) {
                     case I32DivS:
                         // 除法（有符号）
                         if (a == 0x80000000 && b == -1) {
-                            sprintf(exception, "integer overflow");
+                            sprintf(inst->exception, "integer overflow");
                             return false;
                         }
                         c = (int32_t) a / (int32_t) b;
@@ -1119,12 +1300,12 @@ bool interpret(Module *m) {
                         break;
                 }
 
-                stack[m->sp].value.uint32 = c;
+                stack[inst->sp].value.uint32 = c;
                 continue;
             case I64Clz ... I64PopCnt:
                 // 指令作用：获取操作数栈顶值（64 位整数），根据指令对其进行相应计算，并用计算结果覆盖当前操作数栈顶值
 
-                d = stack[m->sp].value.uint64;
+                d = stack[inst->sp].value.uint64;
 
                 switch (opcode) {
                     case I64Clz:
@@ -1143,19 +1324,19 @@ bool interpret(Module *m) {
                         break;
                 }
 
-                stack[m->sp].value.uint64 = f;
+                stack[inst->sp].value.uint64 = f;
                 continue;
             case I64Add ... I64Rotr:
                 // 指令作用：获取操作数栈的栈顶和次栈顶的值（64 位整数），根据具体指令对两个值进行计算，并用计算结果覆盖当前操作数栈顶值
 
-                d = stack[m->sp - 1].value.uint64;
-                e = stack[m->sp].value.uint64;
-                m->sp -= 1;
+                d = stack[inst->sp - 1].value.uint64;
+                e = stack[inst->sp].value.uint64;
+                inst->sp -= 1;
 
                 // 执行 I64DivS 和 I64RemU 之间的指令时，栈顶值 e 不能为 0，
                 // 如果为 0 则记录异常信息并返回 false 退出虚拟机执行
                 if (opcode >= I64DivS && opcode <= I64RemU && e == 0) {
-                    sprintf(exception, "integer divide by zero");
+                    sprintf(inst->exception, "integer divide by zero");
                     return false;
                 }
 
@@ -1175,7 +1356,7 @@ bool interpret(Module *m) {
                     case I64DivS:
                         // 除法（有符号）
                         if (d == 0x80000000 && e == -1) {
-                            sprintf(exception, "integer overflow");
+                            sprintf(inst->exception, "integer overflow");
                             return false;
                         }
                         f = (int64_t) d / (int64_t) e;
@@ -1232,42 +1413,42 @@ bool interpret(Module *m) {
                         break;
                 }
 
-                stack[m->sp].value.uint64 = f;
+                stack[inst->sp].value.uint64 = f;
                 continue;
             case F32Abs:
                 // 取绝对值（32 位浮点型）
-                stack[m->sp].value.f32 = fabsf(stack[m->sp].value.f32);
+                stack[inst->sp].value.f32 = fabsf(stack[inst->sp].value.f32);
                 continue;
             case F32Neg:
                 // 取反（32 位浮点型）
-                stack[m->sp].value.f32 = -stack[m->sp].value.f32;
+                stack[inst->sp].value.f32 = -stack[inst->sp].value.f32;
                 continue;
             case F32Ceil:
                 // 获取大于或等于操作数栈顶值的最小的整数值（32 位浮点型）
-                stack[m->sp].value.f32 = ceilf(stack[m->sp].value.f32);
+                stack[inst->sp].value.f32 = ceilf(stack[inst->sp].value.f32);
                 continue;
             case F32Floor:
                 // 获取小于或等于操作数栈顶值的最小的整数值（32 位浮点型）
-                stack[m->sp].value.f32 = floorf(stack[m->sp].value.f32);
+                stack[inst->sp].value.f32 = floorf(stack[inst->sp].value.f32);
                 continue;
             case F32Trunc:
                 // 将小数部分截去，保留整数（32 位浮点型）
-                stack[m->sp].value.f32 = truncf(stack[m->sp].value.f32);
+                stack[inst->sp].value.f32 = truncf(stack[inst->sp].value.f32);
                 continue;
             case F32Nearest:
                 // 获取最接近操作数栈顶值的整数，如果有 2 个数同样接近，则取偶数的整数（32 位浮点型）
-                stack[m->sp].value.f32 = rintf(stack[m->sp].value.f32);
+                stack[inst->sp].value.f32 = rintf(stack[inst->sp].value.f32);
                 continue;
             case F32Sqrt:
                 // 取平方根（32 位浮点型）
-                stack[m->sp].value.f32 = sqrtf(stack[m->sp].value.f32);
+                stack[inst->sp].value.f32 = sqrtf(stack[inst->sp].value.f32);
                 continue;
             case F32Add ... F32CopySign:
                 // 指令作用：获取操作数栈的栈顶和次栈顶的值（32 位浮点数），根据具体指令对两个值进行计算，并用计算结果覆盖当前操作数栈顶值
 
-                g = stack[m->sp - 1].value.f32;
-                h = stack[m->sp].value.f32;
-                m->sp -= 1;
+                g = stack[inst->sp - 1].value.f32;
+                h = stack[inst->sp].value.f32;
+                inst->sp -= 1;
 
                 switch (opcode) {
                     case F32Add:
@@ -1285,7 +1466,7 @@ bool interpret(Module *m) {
                     case F32Div:
                         // 除法
                         if (h == 0) {
-                            sprintf(exception, "integer divide by zero");
+                            sprintf(inst->exception, "integer divide by zero");
                             return false;
                         }
                         i = g / h;
@@ -1307,42 +1488,42 @@ bool interpret(Module *m) {
                         break;
                 }
 
-                stack[m->sp].value.f32 = i;
+                stack[inst->sp].value.f32 = i;
                 continue;
             case F64Abs:
                 // 取绝对值（64 位浮点型）
-                stack[m->sp].value.f32 = (float) fabs(stack[m->sp].value.f64);
+                stack[inst->sp].value.f32 = (float) fabs(stack[inst->sp].value.f64);
                 continue;
             case F64Neg:
                 // 取反（64 位浮点型）
-                stack[m->sp].value.f64 = -stack[m->sp].value.f64;
+                stack[inst->sp].value.f64 = -stack[inst->sp].value.f64;
                 continue;
             case F64Ceil:
                 // 获取大于或等于操作数栈顶值的最小的整数值（64 位浮点型）
-                stack[m->sp].value.f64 = ceil(stack[m->sp].value.f64);
+                stack[inst->sp].value.f64 = ceil(stack[inst->sp].value.f64);
                 continue;
             case F64Floor:
                 // 获取小于或等于操作数栈顶值的最小的整数值（64 位浮点型）
-                stack[m->sp].value.f64 = floor(stack[m->sp].value.f64);
+                stack[inst->sp].value.f64 = floor(stack[inst->sp].value.f64);
                 continue;
             case F64Trunc:
                 // 将小数部分截去，保留整数（64 位浮点型）
-                stack[m->sp].value.f64 = trunc(stack[m->sp].value.f64);
+                stack[inst->sp].value.f64 = trunc(stack[inst->sp].value.f64);
                 continue;
             case F64Nearest:
                 // 获取最接近操作数栈顶值的整数，如果有 2 个数同样接近，则取偶数的整数（64 位浮点型）
-                stack[m->sp].value.f64 = rint(stack[m->sp].value.f64);
+                stack[inst->sp].value.f64 = rint(stack[inst->sp].value.f64);
                 continue;
             case F64Sqrt:
                 // 取平方根（64 位浮点型）
-                stack[m->sp].value.f64 = sqrt(stack[m->sp].value.f64);
+                stack[inst->sp].value.f64 = sqrt(stack[inst->sp].value.f64);
                 continue;
             case F64Add ... F64CopySign:
                 // 指令作用：获取操作数栈的栈顶和次栈顶的值（64 位浮点数），根据具体指令对两个值进行计算，并用计算结果覆盖当前操作数栈顶值
 
-                j = stack[m->sp - 1].value.f64;
-                k = stack[m->sp].value.f64;
-                m->sp -= 1;
+                j = stack[inst->sp - 1].value.f64;
+                k = stack[inst->sp].value.f64;
+                inst->sp -= 1;
 
                 switch (opcode) {
                     case F64Add:
@@ -1360,7 +1541,7 @@ bool interpret(Module *m) {
                     case F64Div:
                         // 除法
                         if (k == 0) {
-                            sprintf(exception, "integer divide by zero");
+                            sprintf(inst->exception, "integer divide by zero");
                             return false;
                         }
                         l = j / k;
@@ -1382,7 +1563,7 @@ bool interpret(Module *m) {
                         break;
                 }
 
-                stack[m->sp].value.f64 = l;
+                stack[inst->sp].value.f64 = l;
                 continue;
 
             /*
@@ -1393,145 +1574,145 @@ bool interpret(Module *m) {
              * */
             case I32WrapI64:
                 // 指令作用：将 64 位整数截断为 32 位整数
-                stack[m->sp].value.uint64 &= 0x00000000ffffffff;
-                stack[m->sp].value_type = I32;
+                stack[inst->sp].value.uint64 &= 0x00000000ffffffff;
+                stack[inst->sp].value_type = I32;
                 continue;
             case I32TruncF32S:
                 // 指令作用：将 32 位浮点数截断为 32 有符号位整数（截掉小数部分）
-                OP_I32_TRUNC_F32(stack[m->sp].value.int32, stack[m->sp].value.f32)
-                stack[m->sp].value_type = I32;
+                OP_I32_TRUNC_F32(stack[inst->sp].value.int32, stack[inst->sp].value.f32)
+                stack[inst->sp].value_type = I32;
                 continue;
             case I32TruncF32U:
                 // 指令作用：将 32 位浮点数截断为 32 位无符号整数（截掉小数部分）
-                OP_U32_TRUNC_F32(stack[m->sp].value.uint32, stack[m->sp].value.f32)
-                stack[m->sp].value_type = I32;
+                OP_U32_TRUNC_F32(stack[inst->sp].value.uint32, stack[inst->sp].value.f32)
+                stack[inst->sp].value_type = I32;
                 continue;
             case I32TruncF64S:
                 // 指令作用：将 64 位浮点数截断为 32 位有符号整数（截掉小数部分）
-                OP_I32_TRUNC_F64(stack[m->sp].value.int32, stack[m->sp].value.f64)
-                stack[m->sp].value_type = I32;
+                OP_I32_TRUNC_F64(stack[inst->sp].value.int32, stack[inst->sp].value.f64)
+                stack[inst->sp].value_type = I32;
                 continue;
             case I32TruncF64U:
                 // 指令作用：将 64 位浮点数截断为 32 位无符号整数（截掉小数部分）
-                OP_U32_TRUNC_F64(stack[m->sp].value.uint32, stack[m->sp].value.f64)
-                stack[m->sp].value_type = I32;
+                OP_U32_TRUNC_F64(stack[inst->sp].value.uint32, stack[inst->sp].value.f64)
+                stack[inst->sp].value_type = I32;
                 continue;
             case I64ExtendI32S:
                 // 指令作用：将 32 位有符号整数位数拉升为 64 位整数
-                stack[m->sp].value.uint64 = stack[m->sp].value.uint32;
-                sext_32_64(&stack[m->sp].value.uint64);
-                stack[m->sp].value_type = I64;
+                stack[inst->sp].value.uint64 = stack[inst->sp].value.uint32;
+                sext_32_64(&stack[inst->sp].value.uint64);
+                stack[inst->sp].value_type = I64;
                 continue;
             case I64ExtendI32U:
                 // 指令作用：将 32 位无符号整数位数拉升为 64 位整数
-                stack[m->sp].value.uint64 = stack[m->sp].value.uint32;
-                stack[m->sp].value_type = I64;
+                stack[inst->sp].value.uint64 = stack[inst->sp].value.uint32;
+                stack[inst->sp].value_type = I64;
                 continue;
             case I64TruncF32S:
                 // 指令作用：将 32 位浮点数截断为 64 位有符号整数（截掉小数部分）
-                OP_I64_TRUNC_F32(stack[m->sp].value.int64, stack[m->sp].value.f32)
-                stack[m->sp].value_type = I64;
+                OP_I64_TRUNC_F32(stack[inst->sp].value.int64, stack[inst->sp].value.f32)
+                stack[inst->sp].value_type = I64;
                 continue;
             case I64TruncF32U:
                 // 指令作用：将 32 位浮点数截断为 64 位无符号整数（截掉小数部分）
-                OP_U64_TRUNC_F32(stack[m->sp].value.uint64, stack[m->sp].value.f32)
-                stack[m->sp].value_type = I64;
+                OP_U64_TRUNC_F32(stack[inst->sp].value.uint64, stack[inst->sp].value.f32)
+                stack[inst->sp].value_type = I64;
                 continue;
             case I64TruncF64S:
                 // 指令作用：将 64 位浮点数截断为 64 位有符号整数（截掉小数部分）
-                OP_I64_TRUNC_F64(stack[m->sp].value.int64, stack[m->sp].value.f64)
-                stack[m->sp].value_type = I64;
+                OP_I64_TRUNC_F64(stack[inst->sp].value.int64, stack[inst->sp].value.f64)
+                stack[inst->sp].value_type = I64;
                 continue;
             case I64TruncF64U:
                 // 指令作用：将 64 位无符号浮点数截断为 64 位无符号整数（截掉小数部分）
-                OP_U64_TRUNC_F64(stack[m->sp].value.uint64, stack[m->sp].value.f64)
-                stack[m->sp].value_type = I64;
+                OP_U64_TRUNC_F64(stack[inst->sp].value.uint64, stack[inst->sp].value.f64)
+                stack[inst->sp].value_type = I64;
                 continue;
             case F32ConvertI32S:
                 // 指令作用：将 32 位有符号整数转化为 32 位浮点数
-                stack[m->sp].value.f32 = (float) stack[m->sp].value.int32;
-                stack[m->sp].value_type = F32;
+                stack[inst->sp].value.f32 = (float) stack[inst->sp].value.int32;
+                stack[inst->sp].value_type = F32;
                 continue;
             case F32ConvertI32U:
                 // 指令作用：将 32 位无符号整数转化为 32 位浮点数
-                stack[m->sp].value.f32 = (float) stack[m->sp].value.uint32;
-                stack[m->sp].value_type = F32;
+                stack[inst->sp].value.f32 = (float) stack[inst->sp].value.uint32;
+                stack[inst->sp].value_type = F32;
                 continue;
             case F32ConvertI64S:
                 // 指令作用：将 64 位有符号整数转化为 32 位浮点数
-                stack[m->sp].value.f32 = (float) stack[m->sp].value.int64;
-                stack[m->sp].value_type = F32;
+                stack[inst->sp].value.f32 = (float) stack[inst->sp].value.int64;
+                stack[inst->sp].value_type = F32;
                 continue;
             case F32ConvertI64U:
                 // 指令作用：将 64 位无符号整数转化为 32 位浮点数
-                stack[m->sp].value.f32 = (float) stack[m->sp].value.uint64;
-                stack[m->sp].value_type = F32;
+                stack[inst->sp].value.f32 = (float) stack[inst->sp].value.uint64;
+                stack[inst->sp].value_type = F32;
                 continue;
             case F32DemoteF64:
                 // 指令作用：将 64 位浮点数精度降低到 32 位
-                stack[m->sp].value.f32 = (float) stack[m->sp].value.f64;
-                stack[m->sp].value_type = F32;
+                stack[inst->sp].value.f32 = (float) stack[inst->sp].value.f64;
+                stack[inst->sp].value_type = F32;
                 continue;
             case F64ConvertI32S:
                 // 指令作用：将 32 位有符号整数转化为 64 位浮点数
-                stack[m->sp].value.f64 = stack[m->sp].value.int32;
-                stack[m->sp].value_type = F64;
+                stack[inst->sp].value.f64 = stack[inst->sp].value.int32;
+                stack[inst->sp].value_type = F64;
                 continue;
             case F64ConvertI32U:
                 // 指令作用：将 32 位无符号整数转化为 64 位浮点数
-                stack[m->sp].value.f64 = stack[m->sp].value.uint32;
-                stack[m->sp].value_type = F64;
+                stack[inst->sp].value.f64 = stack[inst->sp].value.uint32;
+                stack[inst->sp].value_type = F64;
                 continue;
             case F64ConvertI64S:
                 // 指令作用：将 64 位有符号整数转化为 64 位浮点数
-                stack[m->sp].value.f64 = (double) stack[m->sp].value.int64;
-                stack[m->sp].value_type = F64;
+                stack[inst->sp].value.f64 = (double) stack[inst->sp].value.int64;
+                stack[inst->sp].value_type = F64;
                 continue;
             case F64ConvertI64U:
                 // 指令作用：将 64 位无符号整数转化为 64 位浮点数
-                stack[m->sp].value.f64 = (double) stack[m->sp].value.uint64;
-                stack[m->sp].value_type = F64;
+                stack[inst->sp].value.f64 = (double) stack[inst->sp].value.uint64;
+                stack[inst->sp].value_type = F64;
                 continue;
             case F64PromoteF32:
                 // 指令作用：将 32 位浮点数精度提升到 64 位
-                stack[m->sp].value.f64 = stack[m->sp].value.f32;
-                stack[m->sp].value_type = F64;
+                stack[inst->sp].value.f64 = stack[inst->sp].value.f32;
+                stack[inst->sp].value_type = F64;
                 continue;
             case I32ReinterpretF32:
                 // 指令作用：将 64 位浮点数重新解释为 32 位整数类型，但不改变比特位
-                stack[m->sp].value_type = I32;
+                stack[inst->sp].value_type = I32;
                 continue;
             case I64ReinterpretF64:
                 // 指令作用：将 64 位浮点数重新解释为 64 位整数类型，但不改变比特位
-                stack[m->sp].value_type = I64;
+                stack[inst->sp].value_type = I64;
                 continue;
             case F32ReinterpretI32:
                 // 指令作用：将 32 位整数重新解释为 32 位浮点数类型，但不改变比特位
-                stack[m->sp].value_type = F32;
+                stack[inst->sp].value_type = F32;
                 continue;
             case F64ReinterpretI64:
                 // 指令作用：将 64 位整数重新解释为 64 位浮点数类型，但不改变比特位
-                stack[m->sp].value_type = F64;
+                stack[inst->sp].value_type = F64;
                 continue;
             case I32Extend8S:
                 // 指令作用：将 8 位有符号整数位数拉升为 32 位整数
-                stack[m->sp].value.int32 = ((int32_t) (int8_t) stack[m->sp].value.int32);
+                stack[inst->sp].value.int32 = ((int32_t) (int8_t) stack[inst->sp].value.int32);
                 continue;
             case I32Extend16S:
                 // 指令作用：将 16 位有符号整数位数拉升为 32 位整数
-                stack[m->sp].value.int32 = ((int32_t) (int16_t) stack[m->sp].value.int32);
+                stack[inst->sp].value.int32 = ((int32_t) (int16_t) stack[inst->sp].value.int32);
                 continue;
             case I64Extend8S:
                 // 指令作用：将 8 位有符号整数位数拉升为 64 位整数
-                stack[m->sp].value.int64 = ((int64_t) (int8_t) stack[m->sp].value.int64);
+                stack[inst->sp].value.int64 = ((int64_t) (int8_t) stack[inst->sp].value.int64);
                 continue;
             case I64Extend16S:
                 // 指令作用：将 16 位有符号整数位数拉升为 64 位整数
-                stack[m->sp].value.int64 = ((int64_t) (int16_t) stack[m->sp].value.int64);
+                stack[inst->sp].value.int64 = ((int64_t) (int16_t) stack[inst->sp].value.int64);
                 continue;
             case I64Extend32S:
                 // 指令作用：将 32 位有符号整数位数拉升为 64 位整数
-                stack[m->sp].value.int64 = ((int64_t) (int32_t) stack[m->sp].value.int64);
+                stack[inst->sp].value.int64 = ((int64_t) (int32_t) stack[inst->sp].value.int64);
                 continue;
             case TruncSat: {
                 // 饱和截断指令
@@ -1549,53 +1730,59 @@ bool interpret(Module *m) {
                 // 为了保持统一，我们仍将 0xFC 作为一个普通操作码，将跟在它后面的字节当作它的立即数，这样就可以认为只有一条饱和截断指令
 
                 // 在读取一个字节，用来区分不同类型的浮点数和整数之间的转换
-                uint8_t type = read_LEB_unsigned(bytes, &m->pc, 8);
+                uint8_t type = read_LEB_unsigned(bytes, &inst->pc, 8);
                 switch (type) {
                     case 0x00:
                         // 指令作用：将 32 位浮点数饱和截断为 32 有符号位整数（截掉小数部分）
-                        OP_I32_TRUNC_SAT_F32(stack[m->sp].value.int32, stack[m->sp].value.f32)
-                        stack[m->sp].value_type = I32;
+                        OP_I32_TRUNC_SAT_F32(stack[inst->sp].value.int32, stack[inst->sp].value.f32)
+                        stack[inst->sp].value_type = I32;
                         break;
                     case 0x01:
                         // 指令作用：将 32 位浮点数截断为 32 位无符号整数（截掉小数部分）
-                        OP_U32_TRUNC_SAT_F32(stack[m->sp].value.uint32, stack[m->sp].value.f32)
-                        stack[m->sp].value_type = I32;
+                        OP_U32_TRUNC_SAT_F32(stack[inst->sp].value.uint32, stack[inst->sp].value.f32)
+                        stack[inst->sp].value_type = I32;
                         break;
                     case 0x02:
                         // 指令作用：将 64 位浮点数截断为 32 位有符号整数（截掉小数部分）
-                        OP_I32_TRUNC_SAT_F64(stack[m->sp].value.int32, stack[m->sp].value.f64)
-                        stack[m->sp].value_type = I32;
+                        OP_I32_TRUNC_SAT_F64(stack[inst->sp].value.int32, stack[inst->sp].value.f64)
+                        stack[inst->sp].value_type = I32;
                         break;
                     case 0x03:
                         // 指令作用：将 64 位浮点数截断为 32 位无符号整数（截掉小数部分）
-                        OP_U32_TRUNC_SAT_F64(stack[m->sp].value.uint32, stack[m->sp].value.f64)
-                        stack[m->sp].value_type = I32;
+                        OP_U32_TRUNC_SAT_F64(stack[inst->sp].value.uint32, stack[inst->sp].value.f64)
+                        stack[inst->sp].value_type = I32;
                         break;
                     case 0x04:
                         // 指令作用：将 32 位浮点数截断为 64 位有符号整数（截掉小数部分）
-                        OP_I64_TRUNC_SAT_F32(stack[m->sp].value.int64, stack[m->sp].value.f32)
-                        stack[m->sp].value_type = I64;
+                        OP_I64_TRUNC_SAT_F32(stack[inst->sp].value.int64, stack[inst->sp].value.f32)
+                        stack[inst->sp].value_type = I64;
                         break;
                     case 0x05:
                         // 指令作用：将 32 位浮点数截断为 64 位无符号整数（截掉小数部分）
-                        OP_U64_TRUNC_SAT_F32(stack[m->sp].value.uint64, stack[m->sp].value.f32)
-                        stack[m->sp].value_type = I64;
+                        OP_U64_TRUNC_SAT_F32(stack[inst->sp].value.uint64, stack[inst->sp].value.f32)
+                        stack[inst->sp].value_type = I64;
                         break;
                     case 0x06:
                         // 指令作用：将 64 位浮点数截断为 64 位有符号整数（截掉小数部分）
-                        OP_I64_TRUNC_SAT_F64(stack[m->sp].value.int64, stack[m->sp].value.f64)
-                        stack[m->sp].value_type = I64;
+                        OP_I64_TRUNC_SAT_F64(stack[inst->sp].value.int64, stack[inst->sp].value.f64)
+                        stack[inst->sp].value_type = I64;
                         break;
                     case 0x07:
                         // 指令作用：将 64 位无符号浮点数截断为 64 位无符号整数（截掉小数部分）
-                        OP_U64_TRUNC_SAT_F64(stack[m->sp].value.uint64, stack[m->sp].value.f64)
-                        stack[m->sp].value_type = I64;
+                        OP_U64_TRUNC_SAT_F64(stack[inst->sp].value.uint64, stack[inst->sp].value.f64)
+                        stack[inst->sp].value_type = I64;
                         break;
                     default:
                         break;
                 }
                 continue;
             }
+            case Atomic:
+                // 原子指令（线程提案），具体可查看 atomics.c
+                if (!exec_atomic(inst)) {
+                    return false;
+                }
+                continue;
             default:
                 // 无法识别的非法操作码（不在 Wasm 规定的字节码）
                 return false;
@@ -1607,28 +1794,104 @@ bool interpret(Module *m) {
 }
 
 // 调用索引为 fidx 的函数
-bool invoke(Module *m, uint32_t fidx) {
+bool invoke(Instance *inst, uint32_t fidx) {
     bool result;
 
+    inst->trap = TRAP_ERROR;
+
+    // 导出的函数是外部引入函数时，直接执行宿主函数即可
+    // 注：此时宿主函数返回后函数调用就已经完成，所以即使宿主函数请求让出执行也视为执行成功
+    if (fidx < inst->module->import_func_count) {
+        if (call_host(inst, &inst->module->functions[fidx])) {
+            return true;
+        }
+        if (inst->trap == TRAP_YIELD) {
+            inst->trap = TRAP_ERROR;
+            return true;
+        }
+        return false;
+    }
+
     // 调用函数前的设置，主要设置内容如下：
     // 1. 将当前函数关联的栈帧压入到调用栈顶成为当前栈帧，同时保存该栈帧被压入调用栈顶前的运行时状态，例如 sp fp ra 等
     // 2. 将当前函数的局部变量压入到操作数栈顶（默认初始值为 0）
     // 3. 将函数的字节码部分的【起始地址】设置为 pc（即下一条待执行指令的地址），即开始执行函数字节码中的指令流
-    setup_call(m, fidx);
+    if (!setup_call(inst, fidx)) {
+        return false;
+    }
+
+    // 进入函数时经过安全点：扣除函数消耗的燃料，并检查是否被中断
+    if (!safepoint(inst, inst->module->functions[fidx].fuel_cost)) {
+        return false;
+    }
 
-    // 虚拟机执行起始函数的字节码中的指令流
-    result = interpret(m);
+    // 虚拟机执行起始函数的字节码中的指令流（执行期间记录当前线程正在执行的实例，供采样分析器读取调用栈）
+    Instance *outer = executing_instance;
+    executing_instance = inst;
+    result = interpret(inst);
+    executing_instance = outer;
 
     // 返回虚拟机的执行指令的结果
     // 如果结果为 false，表示执行过程中出现异常。如果结果为 true，表示成功执行完指令流。
     return result;
 }
 
+// 根据虚拟机的执行结果获取可恢复执行的状态
+ExecStatus exec_status(Instance *inst, bool result) {
+    if (result) {
+        return EXEC_DONE;
+    }
+    return inst->trap == TRAP_ERROR ? EXEC_TRAP : EXEC_SUSPENDED;
+}
+
+// 以可恢复的方式调用句柄为 handle 的导出函数
+ExecStatus invoke_resumable(Instance *inst, uint32_t handle) {
+    return exec_status(inst, invoke_export(inst, handle));
+}
+
+// 从暂停处继续执行
+ExecStatus resume(Instance *inst) {
+    if (inst->trap == TRAP_ERROR) {
+        sprintf(inst->exception, "instance is not suspended");
+        return EXEC_TRAP;
+    }
+    // 直接调用的导出函数是宿主函数时，宿主函数返回后调用就已经完成（例如等待的异步 I/O 已经写回结果），没有需要继续执行的栈帧
+    if (inst->csp < 0) {
+        inst->trap = TRAP_ERROR;
+        return EXEC_DONE;
+    }
+    Instance *outer = executing_instance;
+    executing_instance = inst;
+    bool result = interpret(inst);
+    executing_instance = outer;
+    return exec_status(inst, result);
+}
+
+// 请求在当前宿主函数返回后让出执行
+void request_yield(Instance *inst) {
+    inst->suspend_request = TRAP_YIELD;
+}
+
+// 补充 amount 单位的燃料（燃料耗尽时剩余的燃料可能为负数，补充后抵扣）
+void add_fuel(Instance *inst, int64_t amount) {
+    inst->fuel = inst->fuel > FUEL_UNLIMITED - amount ? FUEL_UNLIMITED : inst->fuel + amount;
+}
+
+// 调用句柄为 handle 的导出函数
+bool invoke_export(Instance *inst, uint32_t handle) {
+    Module *m = inst->module;
+    if (handle >= m->export_count || m->exports[handle].external_kind != KIND_FUNCTION) {
+        sprintf(inst->exception, "export handle %u is not a function", handle);
+        return false;
+    }
+    return invoke(inst, m->exports[handle].index);
+}
+
 // 计算初始化表达式
 // 参数 type 为初始化表达式的返回值类型
 // 参数 *pc 为初始化表达式的字节码部分的【起始地址】
-void run_init_expr(Module *m, uint8_t type, uint32_t *pc) {
-    m->pc = *pc;// 将控制块中字节码部分的【起始地址】赋值给程序计数器 m->pc（程序计数器，记录下一条即将执行的指令的地址）
+void run_init_expr(Instance *inst, uint8_t type, uint32_t *pc) {
+    inst->pc = *pc;// 将控制块中字节码部分的【起始地址】赋值给程序计数器 inst->pc（程序计数器，记录下一条即将执行的指令的地址）
 
     Block block = {
             .block_type = 0x01,          // 控制块类型为初始化表达式
@@ -1637,18 +1900,18 @@ void run_init_expr(Module *m, uint8_t type, uint32_t *pc) {
     };
     // 初始化表达式的字节码中的指令流被执行前，将【待调用的初始化表达式控制块关联的栈帧】压入到调用栈顶，成为当前栈帧，
     // 同时保存该栈帧被压入调用栈顶前的运行时状态，例如 sp fp ra 等
-    push_block(m, &block, m->sp);
+    push_block(inst, &block, inst->sp);
 
     // 虚拟机执行初始化表达式的字节码中的指令流
-    interpret(m);
+    interpret(inst);
 
-    // 当初始化表达式的字节码中的指令流被执行完成后，需要将在 Wasm 二进制字节码中的当前位置的地址赋给参数 *pc，以便继续解析后面的 Wasm 二进制字节码
-    // 注：run_init_expr 函数是在解析 Wasm 二进制字节码的 load_module 函数中调用，
-    // 在调用 run_init_expr 函数计算初始化表达式结果后，仍需要继续解析后面的二进制字节码内容
-    *pc = m->pc;
+    // 当初始化表达式的字节码中的指令流被执行完成后，需要将在 Wasm 二进制字节码中的当前位置的地址赋给参数 *pc，以便调用方继续读取后面的 Wasm 二进制字节码
+    // 注：run_init_expr 函数是在创建实例的 instantiate 函数中调用，
+    // 在调用 run_init_expr 函数计算初始化表达式结果后，调用方可能仍需要继续读取后面的二进制字节码内容
+    *pc = inst->pc;
 
     // 初始化表达式的字节码中的指令流执行完成后，操作数栈顶保存的就是指令流的执行结果，也就是初始化表达式计算的返回值
     // 由于初始化表达式计算一定会有返回值，且目前版本的 Wasm 规范规定控制块最多只能有一个返回值，所以初始化表达式计算必定会有一个返回值
     // 所以可以通过比对保存在操作数栈顶的值类型和参数 type 是否相同，来判断计算得到的返回值的类型是否正确
-    ASSERT(m->stack[m->sp].value_type == type, "Init_expr type mismatch 0x%x != 0x%x\n", m->stack[m->sp].value_type, type)
+    ASSERT(inst->stack[inst->sp].value_type == type, "Init_expr type mismatch 0x%x != 0x%x\n", inst->stack[inst->sp].value_type, type)
 }
@@ -5,21 +5,49 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+// 可恢复执行的状态
+typedef enum ExecStatus {
+    EXEC_DONE = 0,     // 函数执行完成，返回值位于操作数栈顶
+    EXEC_TRAP = 1,     // 执行过程中出现异常（异常信息保存在 inst->exception 中），无法继续执行
+    EXEC_SUSPENDED = 2,// 在安全点或者宿主函数返回后暂停执行（原因见 inst->trap），调用 resume 函数即可继续执行
+} ExecStatus;
+
 // 调用函数前的设置，主要设置内容如下：
 // 1. 将当前函数关联的栈帧压入到调用栈顶成为当前栈帧，同时保存该栈帧被压入调用栈顶前的运行时状态，例如 sp fp ra 等
 // 2. 将当前函数的局部变量压入到操作数栈顶（默认初始值为 0）
 // 3. 将函数的字节码部分的【起始地址】设置为 pc（即下一条待执行指令的地址），即开始执行函数字节码中的指令流
-void setup_call(Module *m, uint32_t fidx);
+// 如果函数无法执行（有多个返回值、操作数栈中没有足够的参数或者局部变量超出操作数栈容量），则记录异常信息并返回 false
+bool setup_call(Instance *inst, uint32_t fidx);
 
 // 虚拟机执行字节码中的指令流
-bool interpret(Module *m);
+bool interpret(Instance *inst);
 
 // 调用索引为 fidx 的函数
-bool invoke(Module *m, uint32_t fidx);
+bool invoke(Instance *inst, uint32_t fidx);
+
+// 以可恢复的方式调用句柄为 handle 的导出函数，函数参数需要事先压入操作数栈
+// 燃料耗尽、超过截止纪元或者宿主函数请求让出执行时返回 EXEC_SUSPENDED，此时实例的运行时状态完整地保存在实例中，
+// 调用方可以先去执行其他实例（例如在少量线程上以协程的方式轮流执行大量实例），稍后再调用 resume 函数继续执行
+ExecStatus invoke_resumable(Instance *inst, uint32_t handle);
+
+// 从暂停处（即 inst->trap 为 TRAP_OUT_OF_FUEL、TRAP_INTERRUPTED、TRAP_YIELD 或 TRAP_WAIT_IO）继续执行
+// 注：因燃料耗尽或者超过截止纪元而暂停时，需要先补充燃料或者延长截止纪元，否则会在下一个安全点再次暂停
+ExecStatus resume(Instance *inst);
+
+// 请求在当前宿主函数返回后让出执行，只能在宿主函数中调用，宿主函数的返回值会先压入操作数栈
+// 注：通过 invoke_resumable 调用时返回 EXEC_SUSPENDED，通过 invoke 调用时返回 false（inst->trap 为 TRAP_YIELD）
+void request_yield(Instance *inst);
+
+// 补充 amount 单位的燃料，补充后可以调用 resume 函数继续执行
+// 注：直接设置 inst->fuel 即可限制后续调用能执行的指令数量，默认为 FUEL_UNLIMITED
+void add_fuel(Instance *inst, int64_t amount);
+
+// 调用句柄为 handle 的导出函数（句柄可以通过 resolve_export 函数获取），函数参数需要事先压入操作数栈
+bool invoke_export(Instance *inst, uint32_t handle);
 
 // 计算初始化表达式
 // 参数 type 为初始化表达式的返回值类型
 // 参数 *pc 为初始化表达式的字节码部分的【起始地址】
-void run_init_expr(Module *m, uint8_t type, uint32_t *pc);
+void run_init_expr(Instance *inst, uint8_t type, uint32_t *pc);
 
 #endif
@@ -1,13 +1,20 @@
 #include "module.h"
+#include "cache.h"
+#include "import.h"
 #include "interpreter.h"
 #include "opcode.h"
+#include "pool.h"
 #include "utils.h"
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 // 在单条指令中，除了占一个字节的操作码之外，后面可能也会紧跟着立即数，如果有立即数，则直接跳过立即数
 // 注：指令是否存在立即数，是由操作数的类型决定，这也是 Wasm 标准规范的内容之一
@@ -104,6 +111,16 @@ void skip_immediate(const uint8_t *bytes, uint32_t *pos) {
             // TruncSat 指令的操作码由两个字节表示，第二个字节的数值用来表示不同类型的浮点数和整数之间的转换
             read_LEB_unsigned(bytes, pos, 8);
             break;
+        case Atomic:
+            // 原子指令的操作码同样由前缀和紧跟其后的数值表示，除 atomic.fence 的立即数为 1 个保留字节之外，
+            // 其余原子指令的立即数和内存加载/存储指令相同（对齐方式和内存偏移量）
+            if (read_LEB_unsigned(bytes, pos, 32) == AtomicFence) {
+                read_LEB_unsigned(bytes, pos, 1);
+            } else {
+                read_LEB_unsigned(bytes, pos, 32);
+                read_LEB_unsigned(bytes, pos, 32);
+            }
+            break;
         default:
             // 其他操作码没有立即数
             // 注：Wasm 指令大部分指令没有立即数
@@ -111,101 +128,370 @@ void skip_immediate(const uint8_t *bytes, uint32_t *pos) {
     }
 }
 
-// 收集所有本地模块定义的函数中 Block_/Loop/If 控制块的相关信息，例如起始地址、结束地址、跳转地址、控制块类型等，
+// 跳过初始化表达式 init_expr，即跳过 End_ 指令之前的所有指令以及 End_ 指令本身
+// 注：模块中只记录初始化表达式的起始地址，实例化时才会计算初始化表达式（具体可查看 run_init_expr 函数）
+void skip_init_expr(const uint8_t *bytes, uint32_t *pos) {
+    while (bytes[*pos] != End_) {
+        skip_immediate(bytes, pos);
+    }
+    *pos = *pos + 1;
+}
+
+// 收集单个本地模块定义的函数中 Block_/Loop/If 控制块的相关信息，例如起始地址、结束地址、跳转地址、控制块类型等，
 // 便于后续虚拟机解释执行指令时可以借助这些信息
-void find_blocks(Module *m) {
-    Block *function;
+// 收集到的控制块按照起始地址递增的顺序紧凑地存储在 function->blocks 中，即每个函数拥有独立的控制块表，
+// 参数 scratch 为可复用的临时缓冲区，遍历过程中先将控制块写入其中，遍历结束后再一次性拷贝到从内存池 arena 中申请的内存中
+// 注：不同函数的控制块表互不相关，所以多个线程只要使用各自的内存池，就可以同时处理不同的函数而无需加锁
+void find_function_blocks(Module *m, Block *function, BlockScratch *scratch, Arena *arena) {
     Block *block;
-    // 声明用于在遍历过程中存储控制块 block 的相关信息的栈
-    Block *blockstack[BLOCKSTACK_SIZE];
+    // 声明用于在遍历过程中存储控制块的栈，栈中保存的是控制块在 scratch->blocks 中的索引
+    // 注：由于 scratch->blocks 在扩容时地址可能会变化，所以不能直接保存控制块的指针
+    uint32_t blockstack[BLOCKSTACK_SIZE];
+    // 当前指令的燃料消耗所计入的控制块（即包含该指令的最内层 Loop 控制块，为 -1 表示计入函数本身），
+    // 以及每个控制块入栈前的该值，用于控制块结束时恢复
+    int fuel_owner = -1;
+    int fuel_owners[BLOCKSTACK_SIZE];
     int top = -1;
+    uint32_t count = 0;
     uint8_t opcode = Unreachable;
 
-    // 遍历 m->functions 中所有的本地模块定义的函数，从每个函数字节码部分中收集 Block_/Loop/If 控制块的相关信息
-    // 注：跳过从外部模块导入的函数，原因是导入函数的执行只需要执行 func_ptr 指针所指向的真实函数即可，无需通过虚拟机执行指令的方式
-    for (uint32_t f = m->import_func_count; f < m->function_count; f++) {
-        // 获取单个函数对应的结构体
-        function = &m->functions[f];
-
-        // 从该函数的字节码部分的【起始地址】开始收集 Block_/Loop/If 控制块的相关信息--遍历字节码中的每条指令
-        uint32_t pos = function->start_addr;
-        // 直到该函数的字节码部分的【结束地址】结束
-        while (pos <= function->end_addr) {
-            // 每次 while 循环都会分析一条指令，而每条指令都是以占单个字节的操作码开始
-
-            // 获取操作码，根据操作码类型执行不同逻辑
-            opcode = m->bytes[pos];
-            switch (opcode) {
-                case Block_:
-                case Loop:
-                case If:
-                    // 如果操作码为 Block_/Loop/If 之一，则声明一个 Block 结构体
-                    block = acalloc(1, sizeof(Block), "Block");
-
-                    // 设置控制块的块类型：Block_/Loop/If
-                    block->block_type = opcode;
-
-                    // 由于 Block_/Loop/If 操作码的立即数用于表示该控制块的类型（占一个字节）
-                    // 所以可以根据该立即数，来获取控制块的类型，即控制块的返回值的数量和类型
-
-                    // get_block_type 根据表示该控制块的类型的值（占一个字节），返回控制块的签名，即控制块的返回值的数量和类型
-                    // 0x7f 表示有一个 i32 类型返回值、0x7e 表示有一个 i64 类型返回值、0x7d 表示有一个 f32 类型返回值、0x7c 表示有一个 f64 类型返回值、0x40 表示没有返回值
-                    // 注：目前多返回值提案还没有进入 Wasm 标准，根据当前版本的 Wasm 标准，控制块不能有参数，且最多只能有一个返回值
-                    block->type = get_block_type(m->bytes[pos + 1]);
-                    // 设置控制块的起始地址
-                    block->start_addr = pos;
-
-                    // 向控制块栈中添加该控制块对应结构体
-                    blockstack[++top] = block;
-                    // 向 m->block_lookup 映射中添加该控制块对应结构体，其中 key 为对应操作码 Block_/Loop/If 的地址
-                    m->block_lookup[pos] = block;
-                    break;
-                case Else_:
-                    // 如果当前控制块中存在操作码为 Else_ 的指令，则当前控制块的块类型必须为 If
-                    ASSERT(blockstack[top]->block_type == If, "Else not matched with if\n")
+    // 从该函数的字节码部分的【起始地址】开始收集 Block_/Loop/If 控制块的相关信息--遍历字节码中的每条指令
+    uint32_t pos = function->start_addr;
+    // 直到该函数的字节码部分的【结束地址】结束
+    while (pos <= function->end_addr) {
+        // 每次 while 循环都会分析一条指令，而每条指令都是以占单个字节的操作码开始
 
-                    // 将 Else_ 指令的下一条指令地址，设置为该控制块的 else_addr，即 else 分支对应的字节码的首地址，
-                    // 便于后续虚拟机在执行指令时，根据条件跳转到 else 分支对应的字节码继续执行指令
-                    blockstack[top]->else_addr = pos + 1;
-                    break;
-                case End_:
-                    // 如果操作码 End_ 的地址就是函数的字节码部分的【结束地址】，说明该控制块为该函数的最后一个控制块，则直接退出
-                    if (pos == function->end_addr) {
-                        break;
-                    }
+        // 获取操作码，根据操作码类型执行不同逻辑
+        opcode = m->bytes[pos];
 
-                    // 如果执行了 End_ 指令，说明至少收集了一个控制块的相关信息，所以 top 不可能是初始值 -1，至少大于等于 0
-                    ASSERT(top >= 0, "Blockstack underflow\n")
-
-                    // 从控制块栈栈弹出该控制块
-                    block = blockstack[top--];
-
-                    // 将操作码 End_ 的地址设置为控制块的结束地址
-                    block->end_addr = pos;
-                    // 设置控制块的跳转地址 br_addr
-                    if (block->block_type == Loop) {
-                        // 如果是 Loop 类型的控制块，需要循环执行，所以跳转地址就是该控制块开头指令（即 Loop 指令）的下一条指令地址
-                        // 注：Loop 指令占用两个字节（1 字节操作码 + 1 字节操作数），所以需要加 2
-                        block->br_addr = block->start_addr + 2;
-                    } else {
-                        // 如果是非 Loop 类型的控制块，则跳转地址就是该控制块的结尾地址，也就是操作码 End_ 的地址
-                        block->br_addr = pos;
-                    }
-                    break;
-                default:
+        // 每条指令消耗 1 单位燃料，计入包含该指令的最内层 Loop 控制块或者函数本身
+        if (fuel_owner < 0) {
+            function->fuel_cost++;
+        } else {
+            scratch->blocks[fuel_owner].fuel_cost++;
+        }
+
+        switch (opcode) {
+            case Block_:
+            case Loop:
+            case If:
+                // 如果临时缓冲区已满，则将其容量扩大一倍
+                if (count == scratch->capacity) {
+                    uint32_t capacity = scratch->capacity ? scratch->capacity * 2 : 64;
+                    scratch->blocks = arecalloc(scratch->blocks, scratch->capacity, capacity, sizeof(Block), "BlockScratch");
+                    scratch->capacity = capacity;
+                }
+
+                // 如果操作码为 Block_/Loop/If 之一，则从临时缓冲区中取出一个 Block 结构体
+                block = &scratch->blocks[count];
+                memset(block, 0, sizeof(Block));
+
+                // 设置控制块的块类型：Block_/Loop/If
+                block->block_type = opcode;
+
+                // 由于 Block_/Loop/If 操作码的立即数用于表示该控制块的类型（占一个字节）
+                // 所以可以根据该立即数，来获取控制块的类型，即控制块的返回值的数量和类型
+
+                // get_block_type 根据表示该控制块的类型的值（占一个字节），返回控制块的签名，即控制块的返回值的数量和类型
+                // 0x7f 表示有一个 i32 类型返回值、0x7e 表示有一个 i64 类型返回值、0x7d 表示有一个 f32 类型返回值、0x7c 表示有一个 f64 类型返回值、0x40 表示没有返回值
+                // 注：目前多返回值提案还没有进入 Wasm 标准，根据当前版本的 Wasm 标准，控制块不能有参数，且最多只能有一个返回值
+                block->type = get_block_type(m->bytes[pos + 1]);
+                // 设置控制块的起始地址
+                block->start_addr = pos;
+                // 设置控制块所属的函数
+                block->func = function;
+
+                // 向控制块栈中添加该控制块对应的索引，Loop 控制块内的指令的燃料消耗计入该控制块
+                fuel_owners[++top] = fuel_owner;
+                if (opcode == Loop) {
+                    fuel_owner = (int) count;
+                }
+                blockstack[top] = count++;
+                break;
+            case Else_:
+                // 如果当前控制块中存在操作码为 Else_ 的指令，则当前控制块的块类型必须为 If
+                ASSERT(top >= 0 && scratch->blocks[blockstack[top]].block_type == If, "Else not matched with if\n")
+
+                // 将 Else_ 指令的下一条指令地址，设置为该控制块的 else_addr，即 else 分支对应的字节码的首地址，
+                // 便于后续虚拟机在执行指令时，根据条件跳转到 else 分支对应的字节码继续执行指令
+                scratch->blocks[blockstack[top]].else_addr = pos + 1;
+                break;
+            case End_:
+                // 如果操作码 End_ 的地址就是函数的字节码部分的【结束地址】，说明该控制块为该函数的最后一个控制块，则直接退出
+                if (pos == function->end_addr) {
                     break;
+                }
+
+                // 如果执行了 End_ 指令，说明至少收集了一个控制块的相关信息，所以 top 不可能是初始值 -1，至少大于等于 0
+                ASSERT(top >= 0, "Blockstack underflow\n")
+
+                // 从控制块栈栈弹出该控制块
+                fuel_owner = fuel_owners[top];
+                block = &scratch->blocks[blockstack[top--]];
+
+                // 将操作码 End_ 的地址设置为控制块的结束地址
+                block->end_addr = pos;
+                // 设置控制块的跳转地址 br_addr
+                if (block->block_type == Loop) {
+                    // 如果是 Loop 类型的控制块，需要循环执行，所以跳转地址就是该控制块开头指令（即 Loop 指令）的下一条指令地址
+                    // 注：Loop 指令占用两个字节（1 字节操作码 + 1 字节操作数），所以需要加 2
+                    block->br_addr = block->start_addr + 2;
+                } else {
+                    // 如果是非 Loop 类型的控制块，则跳转地址就是该控制块的结尾地址，也就是操作码 End_ 的地址
+                    block->br_addr = pos;
+                }
+                break;
+            default:
+                break;
+        }
+        // 在单条指令中，除了占一个字节的操作码之外，后面可能也会紧跟着立即数，如果有立即数，则直接跳过立即数去处理下一条指令的操作码
+        // 注：指令是否存在立即数，是由操作数的类型决定，这也是 Wasm 标准规范的内容之一
+        skip_immediate(m->bytes, &pos);
+    }
+    // 当执行完 End_ 分支后，top 应该重新回到 -1，否则就是没有执行 End_ 分支
+    ASSERT(top == -1, "Function ended in middle of block\n")
+    // 控制块应该以操作码 End_ 结束
+    ASSERT(opcode == End_, "Function block did not end with 0xb\n")
+
+    // 将收集到的控制块一次性拷贝到为该函数申请的控制块表中
+    function->block_count = count;
+    if (count > 0) {
+        function->blocks = arena_alloc(arena, count, sizeof(Block), "function->blocks");
+        memcpy(function->blocks, scratch->blocks, count * sizeof(Block));
+    }
+
+    // 标记该函数已编译完成
+    // 注：使用 release 语义，保证其他线程看到该标记时，也一定能看到上面写入的控制块表
+    atomic_store_explicit(&function->compiled, true, memory_order_release);
+}
+
+// 编译函数，即收集函数中控制块的相关信息（如果已经编译过则直接返回）
+// 注：延迟编译时会在函数首次被调用时执行，可以在多个线程中同时调用
+void compile_function(Module *m, Block *function) {
+    // 已经编译过的函数直接返回，这也是绝大多数调用的情况，只需一次原子读取即可
+    if (atomic_load_explicit(&function->compiled, memory_order_acquire)) {
+        return;
+    }
+
+    // 加锁后再次检查，保证同一个函数只会被一个线程编译一次，同时也保证了对模块内存池的访问是互斥的
+    pthread_mutex_lock(&m->compile_lock);
+    if (!atomic_load_explicit(&function->compiled, memory_order_relaxed)) {
+        BlockScratch scratch = {0};
+        find_function_blocks(m, function, &scratch, &m->arena);
+        free(scratch.blocks);
+    }
+    pthread_mutex_unlock(&m->compile_lock);
+}
+
+// 并行收集控制块信息时，每个工作线程共享的任务状态
+typedef struct FindBlocksTask {
+    Module *m;                   // 待处理的模块
+    atomic_uint_fast32_t next;   // 下一批待处理函数的起始索引（各个线程通过原子操作领取任务，无需加锁）
+    size_t arena_size;           // 每个线程的内存池的初始容量
+} FindBlocksTask;
+
+// 工作线程的入口函数：每次领取 FIND_BLOCKS_BATCH 个函数进行处理，直到所有函数都被处理完
+// 返回值为该线程的内存池，其中存储了该线程收集到的所有控制块，由调用方合并到模块的内存池中
+void *find_blocks_worker(void *arg) {
+    FindBlocksTask *task = arg;
+    Module *m = task->m;
+    // 每个线程拥有独立的临时缓冲区和内存池，在处理该线程领取的所有函数时复用
+    BlockScratch scratch = {0};
+    Arena *arena = acalloc(1, sizeof(Arena), "Arena");
+    arena_init(arena, task->arena_size);
+
+    while (true) {
+        uint32_t start = atomic_fetch_add(&task->next, FIND_BLOCKS_BATCH);
+        if (start >= m->function_count) {
+            break;
+        }
+        uint32_t end = start + FIND_BLOCKS_BATCH < m->function_count ? start + FIND_BLOCKS_BATCH : m->function_count;
+        for (uint32_t f = start; f < end; f++) {
+            find_function_blocks(m, &m->functions[f], &scratch, arena);
+        }
+    }
+    free(scratch.blocks);
+    return arena;
+}
+
+// 收集所有本地模块定义的函数中 Block_/Loop/If 控制块的相关信息，例如起始地址、结束地址、跳转地址、控制块类型等，
+// 便于后续虚拟机解释执行指令时可以借助这些信息
+// 注：在解析完类型段、导入段、函数段和代码段后，各个函数的字节码部分是相互独立的，
+// 所以当本地函数足够多时，会按照机器的 CPU 核数创建线程池，将函数分批交给多个线程并行处理
+// 参数 code_size 为代码段的字节数，用于预估存储控制块所需的内存大小
+void find_blocks(Module *m, uint32_t code_size) {
+    // 跳过从外部模块导入的函数，原因是导入函数的执行只需要执行 func_ptr 指针所指向的真实函数即可，无需通过虚拟机执行指令的方式
+    FindBlocksTask task = {.m = m};
+    atomic_init(&task.next, m->import_func_count);
+
+    // 根据本地函数数量和 CPU 核数计算线程数，函数数量太少时创建线程的开销反而更大，此时直接在当前线程处理即可
+    uint32_t local_count = m->function_count - m->import_func_count;
+    // 无法获取 CPU 核数时使用默认的线程数量，且无论如何都不超过 FIND_BLOCKS_MAX_THREADS
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t max_threads = cpu_count > 0 ? (uint32_t) cpu_count : FIND_BLOCKS_DEFAULT_THREADS;
+    if (max_threads > FIND_BLOCKS_MAX_THREADS) {
+        max_threads = FIND_BLOCKS_MAX_THREADS;
+    }
+    uint32_t thread_count = local_count / FIND_BLOCKS_BATCH;
+    if (thread_count > max_threads) {
+        thread_count = max_threads;
+    }
+
+    // 按照平均每 16 个字节的字节码包含一个控制块来预估存储控制块所需的内存，并平均分配给各个线程的内存池
+    task.arena_size = (size_t) code_size / 16 * sizeof(Block) / (thread_count > 1 ? thread_count : 1);
+
+    // 当前线程本身也会作为工作线程参与处理，所以只需额外创建 thread_count - 1 个线程
+    pthread_t threads[FIND_BLOCKS_MAX_THREADS - 1];
+    uint32_t created = 0;
+    for (uint32_t t = 0; t + 1 < thread_count; t++) {
+        if (pthread_create(&threads[created], NULL, find_blocks_worker, &task) != 0) {
+            // 如果创建线程失败，则由已创建的线程（包括当前线程）处理剩余函数即可
+            break;
+        }
+        created++;
+    }
+
+    Arena *arena = find_blocks_worker(&task);
+    arena_merge(&m->arena, arena);
+    free(arena);
+
+    // 等待所有工作线程处理完成，并将各个线程的内存池合并到模块的内存池中
+    // 注：合并时只需拼接内存块链表，且是在线程结束后由当前线程进行，所以无需加锁
+    for (uint32_t t = 0; t < created; t++) {
+        pthread_join(threads[t], (void **) &arena);
+        arena_merge(&m->arena, arena);
+        free(arena);
+    }
+}
+
+// 为模块的所有导出项建立哈希表（开放寻址、线性探测），哈希表的内存从内存池中申请
+// 注：如果存在同名的导出项，则只保留第一个，与按顺序遍历查找的结果一致
+void build_export_map(Module *m) {
+    uint32_t size = 1;
+    while (size < m->export_count * 2) {
+        size <<= 1;
+    }
+    m->export_map = arena_alloc(&m->arena, size, sizeof(uint32_t), "export_map");
+    m->export_map_mask = size - 1;
+
+    for (uint32_t e = 0; e < m->export_count; e++) {
+        char *name = m->exports[e].export_name;
+        if (!name) {
+            continue;
+        }
+        uint32_t slot = hash_string(name) & m->export_map_mask;
+        while (m->export_map[slot] && strcmp(m->exports[m->export_map[slot] - 1].export_name, name) != 0) {
+            slot = (slot + 1) & m->export_map_mask;
+        }
+        if (!m->export_map[slot]) {
+            m->export_map[slot] = e + 1;
+        }
+    }
+}
+
+// 解析自定义段 name 中的函数名子段，end 为自定义段的结束地址
+// name 段由若干子段组成，编码格式如下（函数名子段的 ID 为 1，其他子段为模块名、局部变量名等，直接跳过）：
+// name_sec: subsection*
+// subsection: id|byte_count|bytes
+// func_names: vec<idx|name>
+// 注：name 段只用于调试，所以格式错误时直接忽略剩余内容，而不是让模块加载失败
+void parse_name_section(Module *m, uint32_t *pos, uint32_t end) {
+    // 按照标准 name 段位于数据段之后，此时函数数量已经确定
+    if (m->function_count == 0) {
+        return;
+    }
+    while (*pos < end) {
+        uint32_t id = read_LEB_unsigned(m->bytes, pos, 7);
+        uint32_t sub_len = read_LEB_unsigned(m->bytes, pos, 32);
+        uint32_t sub_end = *pos + sub_len;
+        if (sub_end > end || sub_end < *pos) {
+            return;
+        }
+        if (id != 1) {
+            *pos = sub_end;
+            continue;
+        }
+
+        uint32_t count = read_LEB_unsigned(m->bytes, pos, 32);
+        if (!m->function_names) {
+            m->function_names = arena_alloc(&m->arena, m->function_count, sizeof(char *), "Module->function_names");
+        }
+        for (uint32_t i = 0; i < count && *pos < sub_end; i++) {
+            uint32_t fidx = read_LEB_unsigned(m->bytes, pos, 32);
+            uint32_t len_pos = *pos;
+            uint32_t len = read_LEB_unsigned(m->bytes, &len_pos, 32);
+            if (len_pos + len > sub_end || len_pos + len < len_pos) {
+                return;
+            }
+            char *name = read_string(m->bytes, pos, NULL, &m->arena);
+            if (fidx < m->function_count) {
+                m->function_names[fidx] = name;
             }
-            // 在单条指令中，除了占一个字节的操作码之外，后面可能也会紧跟着立即数，如果有立即数，则直接跳过立即数去处理下一条指令的操作码
-            // 注：指令是否存在立即数，是由操作数的类型决定，这也是 Wasm 标准规范的内容之一
-            skip_immediate(m->bytes, &pos);
         }
-        // 当执行完 End_ 分支后，top 应该重新回到 -1，否则就是没有执行 End_ 分支
-        ASSERT(top == -1, "Function ended in middle of block\n")
-        // 控制块应该以操作码 End_ 结束
-        ASSERT(opcode == End_, "Function block did not end with 0xb\n")
+        *pos = sub_end;
     }
 }
 
+// 预估模块元数据所需的内存大小，以便一次性为内存池申请足够的内存
+// 只需遍历各个段的头部，根据各个段的字节数以及段中的元素数量进行估算即可
+size_t estimate_arena_size(const uint8_t *bytes, uint32_t byte_count) {
+    size_t size = 0;
+    uint32_t pos = 8;
+    uint32_t function_count = 0;// 导入项和函数段中的函数数量之和，即函数数量的上限
+
+    while (pos < byte_count) {
+        uint32_t id = read_LEB_unsigned(bytes, &pos, 7);
+        uint32_t slen = read_LEB_unsigned(bytes, &pos, 32);
+        uint32_t start_pos = pos;
+        // 除了自定义段和起始段之外，其他段的内容都以元素数量开头
+        uint32_t count = 0;
+        if (slen > 0 && id != CustomID && id != StartID) {
+            count = read_LEB_unsigned(bytes, &pos, 32);
+        }
+
+        // 每个元素额外预留对齐所需的字节数
+        size += (size_t) count * ARENA_ALIGN * 2;
+        switch (id) {
+            case TypeID:
+                // 函数签名，以及参数和返回值的类型（数量不会超过段的字节数）
+                size += (size_t) count * sizeof(Type) + (size_t) slen * sizeof(uint32_t);
+                break;
+            case ImportID:
+                // 导入函数和导入全局变量，以及模块名和成员名（长度不会超过段的字节数）
+                size += (size_t) count * (sizeof(Block) + sizeof(Global)) + slen;
+                function_count += count;
+                break;
+            case FuncID:
+                size += (size_t) count * sizeof(Block);
+                function_count += count;
+                break;
+            case GlobalID:
+                size += (size_t) count * sizeof(Global);
+                break;
+            case ExportID:
+                // 导出项，以及导出项哈希表（槽位数量不超过导出项数量的 4 倍）
+                size += (size_t) count * (sizeof(Export) + 4 * sizeof(uint32_t)) + slen;
+                break;
+            case CustomID:
+                // name 段中的函数名（长度不会超过段的字节数），以及按照函数索引存储的函数名数组（函数数量不会超过导入项和函数段中的函数数量之和）
+                size += slen + (size_t) function_count * sizeof(char *);
+                break;
+            case CodeID:
+                // 局部变量的类型，按照平均每 4 个字节的代码包含一个局部变量进行估算
+                size += (size_t) slen / 4 * sizeof(uint32_t);
+                break;
+            case ElemID:
+            case DataID:
+                size += (size_t) count * sizeof(Segment);
+                break;
+            default:
+                break;
+        }
+        pos = start_pos + slen;
+    }
+    return size;
+}
+
 // 解析表段中的表 table_type（目前表段只会包含一张表）
 // 表 table_type 编码如下：
 // table_type: 0x70|limits
@@ -245,7 +531,10 @@ void parse_memory_type(Module *m, uint32_t *pos) {
     // 由于内存段中只会有一块内存，所以无需遍历
 
     // flags 为标记位，如果为 0 表示只指定内存大小的下限；为 1 表示既指定内存大小的上限，又指定内存大小的下限
+    // 线程提案中 flags 的第 2 位表示内存是否为共享内存，共享内存必须指定内存大小上限
     uint32_t flags = read_LEB_unsigned(m->bytes, pos, 32);
+    m->memory.shared = (flags & 0x2) != 0;
+    ASSERT(!m->memory.shared || (flags & 0x1), "shared memory must have maximum\n")
     // 先读取内存大小的下限，并设置为该内存的初始大小
     uint32_t pages = read_LEB_unsigned(m->bytes, pos, 32);
     m->memory.min_size = pages;
@@ -264,7 +553,7 @@ void parse_memory_type(Module *m, uint32_t *pos) {
 }
 
 // 解析 Wasm 二进制文件内容，将其转化成内存格式 Module，以便后续虚拟机基于此执行对应指令
-struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
+struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count, Options options) {
     // 用于标记解析 Wasm 二进制文件第 pos 个字节
     uint32_t pos = 0;
 
@@ -274,14 +563,13 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
     // 为 Wasm 内存格式对应的结构体 m 申请内存
     m = acalloc(1, sizeof(struct Module), "Module");
 
-    // 重置运行时相关状态，主要是清空操作数栈、调用栈等
-    m->sp = -1;
-    m->fp = -1;
-    m->csp = -1;
-
     m->bytes = bytes;
     m->byte_count = byte_count;
-    m->block_lookup = acalloc(m->byte_count, sizeof(Block *), "function->block_lookup");
+    m->options = options;
+    pthread_mutex_init(&m->compile_lock, NULL);
+
+    // 代码段的字节数，用于预估存储控制块所需的内存大小
+    uint32_t code_size = 0;
 
     // 起始函数索引初始值设置为 -1
     m->start_function = -1;
@@ -302,6 +590,13 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
     pos += 4;
     ASSERT(version == WA_VERSION, "Wrong module version 0x%x\n", version)
 
+    // 根据各个段的字节数预估模块元数据所需的内存大小，并一次性为内存池申请足够的内存
+    arena_init(&m->arena, estimate_arena_size(bytes, byte_count));
+
+    // 如果指定了预编译缓存目录，则尝试加载缓存
+    // 命中缓存时，类型段、函数段、导出段和代码段的解析结果直接从缓存中获取，且无需再收集控制块信息
+    bool cached = options.cache_dir && load_module_cache(m, options.cache_dir);
+
     // 最后根据段 ID 分别解析后面的各个段的内容
     // 和其他二进制格式（例如 Java 类文件）一样，Wasm 二进制格式也是以魔数和版本号开头，
     // 之后就是模块的主体内容，这些内容被分别放在不同的段（Section）中。
@@ -321,8 +616,15 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
         switch (id) {
             case CustomID: {
                 // 解析自定义段
-                // TODO: 暂不处理自定义段内容，直接跳过
-                pos += slen;
+                // 自定义段编码格式如下：
+                // custom_sec: 0x00|byte_count|name|bytes
+                // 目前只解析名称为 name 的自定义段中的函数名（用于采样分析器等输出可读的函数名），其他自定义段直接跳过
+                uint32_t name_len = read_LEB_unsigned(bytes, &pos, 32);
+                if (name_len == 4 && pos + 4 <= start_pos + slen && memcmp(bytes + pos, "name", 4) == 0) {
+                    pos += 4;
+                    parse_name_section(m, &pos, start_pos + slen);
+                }
+                pos = start_pos + slen;
                 break;
             }
             case TypeID: {
@@ -333,11 +635,19 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
                 // 类型段编码格式如下：
                 // type_sec: 0x01|byte_count|vec<func_type>
 
+                // 命中缓存时直接使用缓存中的函数签名
+                if (cached) {
+                    m->types = m->cache.types;
+                    m->type_count = m->cache.type_count;
+                    pos = start_pos + slen;
+                    break;
+                }
+
                 // 读取类型段中所有函数签名的数量
                 m->type_count = read_LEB_unsigned(bytes, &pos, 32);
 
                 // 为存储类型段中的函数签名申请内存
-                m->types = acalloc(m->type_count, sizeof(Type), "Module->types");
+                m->types = arena_alloc(&m->arena, m->type_count, sizeof(Type), "Module->types");
 
                 // 遍历解析每个类型 func_type，其编码格式如下：
                 // func_type: 0x60|param_count|(param_val)+|return_count|(return_val)+
@@ -349,8 +659,7 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
 
                     // 解析函数参数个数
                     type->param_count = read_LEB_unsigned(bytes, &pos, 32);
-                    type->params = acalloc(type->param_count, sizeof(uint32_t),
-                                           "type->params");
+                    type->params = arena_alloc(&m->arena, type->param_count, sizeof(uint32_t), "type->params");
                     // 解析函数每个参数的类型
                     for (uint32_t p = 0; p < type->param_count; p++) {
                         type->params[p] = read_LEB_unsigned(bytes, &pos, 32);
@@ -358,8 +667,7 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
 
                     // 解析函数返回值个数
                     type->result_count = read_LEB_unsigned(bytes, &pos, 32);
-                    type->results = acalloc(type->result_count, sizeof(uint32_t),
-                                            "type->results");
+                    type->results = arena_alloc(&m->arena, type->result_count, sizeof(uint32_t), "type->results");
                     // 解析函数每个返回值的类型
                     for (uint32_t r = 0; r < type->result_count; r++) {
                         type->results[r] = read_LEB_unsigned(bytes, &pos, 32);
@@ -383,15 +691,17 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
                 // 读取导入项数量
                 uint32_t import_count = read_LEB_unsigned(bytes, &pos, 32);
 
+                // 导入函数和导入全局变量的数量都不会超过导入项数量，所以按照导入项数量一次性申请内存即可
+                m->functions = arena_alloc(&m->arena, import_count, sizeof(Block), "Block(imports)");
+                m->globals = arena_alloc(&m->arena, import_count, sizeof(Global), "globals(imports)");
+
                 // 遍历所有导入项，解析对应数据
                 for (uint32_t idx = 0; idx < import_count; idx++) {
-                    uint32_t module_len, field_len;
-
                     // 读取模块名 module_name（从哪个模块导入）
-                    char *import_module = read_string(bytes, &pos, &module_len);
+                    char *import_module = read_string(bytes, &pos, NULL, &m->arena);
 
                     // 读取导入项的成员名 member_name
-                    char *import_field = read_string(bytes, &pos, &field_len);
+                    char *import_field = read_string(bytes, &pos, NULL, &m->arena);
 
                     // 读取导入项类型 tag（四种类型：函数、表、内存、全局变量）
                     uint32_t external_kind = bytes[pos++];
@@ -419,30 +729,21 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
 
                             // 再读取全局变量的可变性
                             mutability = read_LEB_unsigned(bytes, &pos, 1);
-                            // TODO: 可变性暂无用处，故先将变量 mutability 标记为无用
-                            (void) mutability;
                             break;
                         default:
                             break;
                     }
 
                     void *val;
-                    char *err, *sym = malloc(module_len + field_len + 5);
-
-                    do {
-                        // 尝试从导入的模块中查找导入项，并将导入项的值赋给 val
-                        // 第一个句柄参数为模块名 import_module
-                        // 第二个符号参数为成员名 import_field
-                        // resolve_sym 函数中，如果从外部模块中找到导入项，则会将导入项的值赋给 val，并返回 true
-                        if (resolve_sym(import_module, import_field, &val, &err)) {
-                            break;
-                        }
+                    const char *err;
 
+                    // 尝试从导入的模块中查找导入项，并将导入项的值赋给 val
+                    // 第一个参数为模块名 import_module，第二个参数为成员名 import_field
+                    // resolve_import 函数中，优先查找进程内注册的宿主符号，其次从与模块名同名的动态库中查找，找到则返回 true
+                    if (!resolve_import(import_module, import_field, &val, &err)) {
                         // 如果未找到，则报错
                         FATAL("Error: %s\n", err)
-                    } while (false);
-
-                    free(sym);
+                    }
 
                     // 根据导入项类型，将导入项的值保存到对应的地方
                     switch (external_kind) {
@@ -456,8 +757,6 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
                             m->import_func_count += 1;
                             m->function_count += 1;
 
-                            // 为当前的导入函数对应在本地模块的函数申请内存
-                            m->functions = arecalloc(m->functions, fidx, m->import_func_count, sizeof(Block), "Block(imports)");
                             // 获取当前的导入函数对应在本地模块的函数
                             Block *func = &m->functions[fidx];
                             // 设置【导入函数的导入模块名】为【本地模块中对应函数的导入模块名】
@@ -475,6 +774,7 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
                             // 一个模块只能定义一张表，如果 m->table.entries 不为空，说明已经存在表，则报错
                             ASSERT(!m->table.entries, "More than 1 table not supported\n")
                             Table *tval = val;
+                            m->import_table = tval;
                             m->table.entries = val;
                             // 如果【本地模块的表的当前元素数量】大于【导入表的元素数量上限】，则报错
                             ASSERT(m->table.cur_size <= tval->max_size, "Imported table is not large enough\n")
@@ -492,8 +792,11 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
                             // 一个模块只能定义一块内存，如果 m->memory.bytes 不为空，说明已经存在表，则报错
                             ASSERT(!m->memory.bytes, "More than 1 memory not supported\n")
                             Memory *mval = val;
+                            m->import_memory = mval;
                             // 如果【本地模块的内存的当前页数】大于【导入内存的最大页数】，则报错
                             ASSERT(m->memory.cur_size <= mval->max_size, "Imported memory is not large enough\n")
+                            // 共享内存只能导入共享内存，非共享内存也只能导入非共享内存
+                            ASSERT(m->memory.shared == mval->shared, "Imported memory shared flag mismatch\n")
                             // 设置【导入内存的当前页数】为【本地模块内存的当前页数】
                             m->memory.cur_size = mval->cur_size;
                             // 设置【导入内存的最大页数】为【本地模块内存的最大页数】
@@ -507,30 +810,14 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
                             // 本地模块的全局变量数量加 1
                             m->global_count += 1;
 
-                            // 为全局变量申请内存，在原有模块本身的全局变量基础上，再添加导入的全局变量对应的全局变量
-                            m->globals = arecalloc(m->globals, m->global_count - 1, m->global_count, sizeof(StackValue), "globals");
                             // 获取当前的导入全局变量对应在本地模块中的全局变量
-                            StackValue *glob = &m->globals[m->global_count - 1];
+                            Global *glob = &m->globals[m->global_count - 1];
                             // 设置【导入全局变量的值类型】为【本地模块中对应全局变量的值类型】
                             // 注：变量的值类型主要为 I32/I64/F32/F64
                             glob->value_type = global_type;
-                            // 根据全局变量的值类型，设置【导入全局变量的值】为【本地模块中对应全局变量的值】
-                            switch (global_type) {
-                                case I32:
-                                    memcpy(&glob->value.uint32, val, 4);
-                                    break;
-                                case I64:
-                                    memcpy(&glob->value.uint64, val, 8);
-                                    break;
-                                case F32:
-                                    memcpy(&glob->value.f32, val, 4);
-                                    break;
-                                case F64:
-                                    memcpy(&glob->value.f64, val, 8);
-                                    break;
-                                default:
-                                    break;
-                            }
+                            glob->mutability = mutability;
+                            // 记录导入全局变量的实际值，实例化时再将其拷贝到实例的全局变量中
+                            glob->import_value = val;
                             break;
                         default:
                             // 如果导入项为其他类型，则报错
@@ -546,12 +833,24 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
                 // 函数段编码格式如下：
                 // func_sec: 0x03|byte_count|vec<type_idx>
 
+                // 命中缓存时直接使用缓存中的函数，只需将解析导入段得到的导入函数拷贝过去即可
+                if (cached) {
+                    ASSERT(m->import_func_count == m->cache.import_func_count, "Cached import count mismatch\n")
+                    if (m->import_func_count != 0) {
+                        memcpy(m->cache.functions, m->functions, sizeof(Block) * m->import_func_count);
+                    }
+                    m->functions = m->cache.functions;
+                    m->function_count = m->cache.function_count;
+                    pos = start_pos + slen;
+                    break;
+                }
+
                 // 读取函数段所有函数的数量
                 m->function_count += read_LEB_unsigned(bytes, &pos, 32);
 
                 // 为存储函数段中的所有函数申请内存
                 Block *functions;
-                functions = acalloc(m->function_count, sizeof(Block), "Block(function)");
+                functions = arena_alloc(&m->arena, m->function_count, sizeof(Block), "Block(function)");
 
                 // 由于解析了导入段在解析函数段之前，而导入段中可能有导入外部模块函数
                 // 因此如果 m->import_func_count 不为 0，则说明已导入外部函数，并存储在了 m->functions 中
@@ -566,6 +865,8 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
                 for (uint32_t f = m->import_func_count; f < m->function_count; f++) {
                     // f 为该函数在所有函数（包括导入函数）中的索引
                     m->functions[f].fidx = f;
+                    // 函数所属的函数即为其本身，便于虚拟机执行时统一通过 block->func 找到当前函数的控制块表
+                    m->functions[f].func = &m->functions[f];
                     // tidx 为该内部函数的函数签名在所有函数签名中的索引
                     uint32_t tidx = read_LEB_unsigned(bytes, &pos, 32);
                     // 通过索引 tidx 从所有函数签名中获取到具体的函数签名，然后设置为该函数的函数签名
@@ -592,9 +893,6 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
 
                 // 解析表段中的表 table_type（目前模块只会包含一张表）
                 parse_table_type(m, &pos);
-
-                // 为存储表中的元素申请内存（在解析元素段时会用到--将元素段中的索引存储到刚申请的内存中）
-                m->table.entries = acalloc(m->table.cur_size, sizeof(uint32_t), "Module->table.entries");
                 break;
             }
             case MemID: {
@@ -617,9 +915,6 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
 
                 // 解析内存段中内存 mem_type（目前模块只会包含一块内存）
                 parse_memory_type(m, &pos);
-
-                // 为存储内存中的数据申请内存（在解析数据段时会用到--将数据段中的数据存储到刚申请的内存中）
-                m->memory.bytes = acalloc(m->memory.cur_size * PAGE_SIZE, sizeof(uint32_t), "Module->memory.bytes");
                 break;
             }
             case GlobalID: {
@@ -636,31 +931,29 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
                 // 读取模块中全局变量的数量
                 uint32_t global_count = read_LEB_unsigned(bytes, &pos, 32);
 
+                // 为所有全局变量（包括导入的全局变量）一次性申请内存，并将之前解析导入段得到的全局变量拷贝过来
+                Global *globals = arena_alloc(&m->arena, m->global_count + global_count, sizeof(Global), "globals");
+                if (m->global_count != 0) {
+                    memcpy(globals, m->globals, sizeof(Global) * m->global_count);
+                }
+                m->globals = globals;
+
                 // 遍历全局段中的每一个全局变量项
                 for (uint32_t g = 0; g < global_count; g++) {
+                    Global *glob = &m->globals[m->global_count];
+
                     // 先读取全局变量的值类型
-                    uint8_t type = read_LEB_unsigned(bytes, &pos, 7);
+                    glob->value_type = read_LEB_unsigned(bytes, &pos, 7);
 
                     // 再读取全局变量的可变性
-                    uint8_t mutability = read_LEB_unsigned(bytes, &pos, 1);
-                    // TODO: 可变性暂无用处，故先将变量 mutability 标记为无用
-                    (void) mutability;
+                    glob->mutability = read_LEB_unsigned(bytes, &pos, 1);
 
-                    // 先保存当前全局变量的索引
-                    uint32_t gidx = m->global_count;
+                    // 记录初始化表达式 init_expr 的起始地址，实例化时再计算初始化表达式，并将计算结果设置为全局变量的初始值
+                    glob->init_addr = pos;
+                    skip_init_expr(bytes, &pos);
 
                     // 全局变量数量加 1
                     m->global_count += 1;
-
-                    // 由于新增一个全局变量，所以需要重新申请内存，调用 arecalloc 函数在原有内存基础上重新申请内存
-                    m->globals = arecalloc(m->globals, gidx, m->global_count, sizeof(StackValue), "globals");
-
-                    // 计算初始化表达式 init_expr，并将计算结果设置为当前全局变量的初始值
-                    run_init_expr(m, type, &pos);
-
-                    // 计算初始化表达式 init_expr 也就是栈式虚拟机执行表达式的字节码中的指令流过程，最终操作数栈顶保存的就是表达式的返回值，即计算结果
-                    // 将栈顶的值弹出并赋值给当前全局变量即可
-                    m->globals[gidx] = m->stack[m->sp--];
                 }
                 pos = start_pos + slen;
                 break;
@@ -675,13 +968,25 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
                 // export: name|export_desc
                 // export_desc: tag|[func_idx, table_idx, mem_idx, global_idx]
 
+                // 命中缓存时直接使用缓存中的导出项
+                if (cached) {
+                    m->exports = m->cache.exports;
+                    m->export_count = m->cache.export_count;
+                    build_export_map(m);
+                    pos = start_pos + slen;
+                    break;
+                }
+
                 // 读取导出项数量
                 uint32_t export_count = read_LEB_unsigned(bytes, &pos, 32);
 
+                // 为所有导出项一次性申请内存
+                m->exports = arena_alloc(&m->arena, export_count, sizeof(Export), "exports");
+
                 // 遍历所有导出项，解析对应数据
                 for (uint32_t e = 0; e < export_count; e++) {
                     // 读取导出成员名
-                    char *name = read_string(bytes, &pos, NULL);
+                    char *name = read_string(bytes, &pos, NULL, &m->arena);
 
                     // 读取导出类型
                     uint32_t external_kind = bytes[pos++];
@@ -689,47 +994,28 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
                     // 读取导出项在相应段中的索引
                     uint32_t index = read_LEB_unsigned(bytes, &pos, 32);
 
+                    // 目前 Wasm 版本规定只能定义一张表和一个内存，所以表和内存的索引只能为 0
+                    ASSERT(external_kind != KIND_TABLE || index == 0, "Only 1 table in MVP\n")
+                    ASSERT(external_kind != KIND_MEMORY || index == 0, "Only 1 memory in MVP\n")
+
                     // 先保存当前导出项的索引
                     uint32_t eidx = m->export_count;
 
                     // 导出项数量加 1
                     m->export_count += 1;
 
-                    // 由于新增一个导出项，所以需要重新申请内存，调用 arecalloc 函数在原有内存基础上重新申请内存
-                    m->exports = arecalloc(m->exports, eidx, m->export_count, sizeof(Export), "exports");
-
                     // 设置导出项的成员名
                     m->exports[eidx].export_name = name;
 
                     // 设置导出项的类型
                     m->exports[eidx].external_kind = external_kind;
 
-                    // 根据导出项的类型，设置导出项的值
-                    switch (external_kind) {
-                        case KIND_FUNCTION:
-                            // 获取函数并赋给导出项
-                            m->exports[eidx].value = &m->functions[index];
-                            break;
-                        case KIND_TABLE:
-                            // 目前 Wasm 版本规定只能定义一张表，所以索引只能为 0
-                            ASSERT(index == 0, "Only 1 table in MVP\n")
-                            // 获取模块内定义的表并赋给导出项
-                            m->exports[eidx].value = &m->table;
-                            break;
-                        case KIND_MEMORY:
-                            // 目前 Wasm 版本规定只能定义一个内存，所以索引只能为 0
-                            ASSERT(index == 0, "Only 1 memory in MVP\n")
-                            // 获取模块内定义的内存并赋给导出项
-                            m->exports[eidx].value = &m->memory;
-                            break;
-                        case KIND_GLOBAL:
-                            // 获取全局变量并赋给导出项
-                            m->exports[eidx].value = &m->globals[index];
-                            break;
-                        default:
-                            break;
-                    }
+                    // 设置导出项在相应段中的索引
+                    m->exports[eidx].index = index;
                 }
+
+                // 为所有导出项建立哈希表
+                build_export_map(m);
                 break;
             }
             case StartID: {
@@ -757,25 +1043,30 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
                 // 读取元素数量
                 uint32_t elem_count = read_LEB_unsigned(bytes, &pos, 32);
 
-                // 依次对表中每个元素进行初始化
+                // 为所有元素项一次性申请内存
+                m->elems = arena_alloc(&m->arena, elem_count, sizeof(Segment), "elems");
+                m->elem_count = elem_count;
+
+                // 依次记录每个元素项，实例化时再根据元素项初始化实例的表
                 for (uint32_t c = 0; c < elem_count; c++) {
+                    Segment *elem = &m->elems[c];
+
                     // 读取表索引 table_idx（即初始化哪张表）
                     uint32_t index = read_LEB_unsigned(bytes, &pos, 32);
                     // 目前 Wasm 版本规定一个模块只能定义一张表，所以 index 只能为 0
                     ASSERT(index == 0, "Only 1 default table in MVP\n")
 
-                    // 计算初始化表达式 offset_expr，并将计算结果设置为当前表内偏移量 offset
-                    run_init_expr(m, I32, &pos);
+                    // 记录初始化表达式 offset_expr 的起始地址
+                    elem->offset_addr = pos;
+                    skip_init_expr(bytes, &pos);
 
-                    // 计算初始化表达式 offset_expr 也就是栈式虚拟机执行表达式的字节码中的指令流过程，最终操作数栈顶保存的就是表达式的返回值，即计算结果
-                    // 将栈顶的值弹出并赋值给当前表内偏移量 offset
-                    uint32_t offset = m->stack[m->sp--].value.uint32;
+                    // 读取函数索引列表（即给定的元素初始化数据）的长度，并记录函数索引列表的起始地址
+                    elem->count = read_LEB_unsigned(bytes, &pos, 32);
+                    elem->data_addr = pos;
 
-                    // 函数索引列表（即给定的元素初始化数据）
-                    uint32_t num_elem = read_LEB_unsigned(bytes, &pos, 32);
-                    // 遍历函数索引列表，将列表中的函数索引设置为元素的初始值
-                    for (uint32_t n = 0; n < num_elem; n++) {
-                        m->table.entries[offset + n] = read_LEB_unsigned(bytes, &pos, 32);
+                    // 跳过函数索引列表
+                    for (uint32_t n = 0; n < elem->count; n++) {
+                        read_LEB_unsigned(bytes, &pos, 32);
                     }
                 }
                 pos = start_pos + slen;
@@ -791,6 +1082,15 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
                 // code: byte_count|vec<locals>|expr
                 // locals: local_count|val_type
 
+                // 命中缓存时函数的局部变量和字节码地址都已从缓存中获取，直接跳过代码段即可
+                if (cached) {
+                    pos = start_pos + slen;
+                    break;
+                }
+
+                // 记录代码段的字节数
+                code_size = slen;
+
                 // 读取代码段中的代码项的数量
                 uint32_t code_count = read_LEB_unsigned(bytes, &pos, 32);
 
@@ -834,7 +1134,7 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
                     }
 
                     // 为保存函数局部变量的值类型的 function->locals 数组申请内存
-                    function->locals = acalloc(function->local_count, sizeof(uint32_t), "function->locals");
+                    function->locals = arena_alloc(&m->arena, function->local_count, sizeof(uint32_t), "function->locals");
 
                     // 恢复之前的位置，重新遍历所有的 locals
                     pos = save_pos;
@@ -885,26 +1185,27 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
                 // 读取数据数量
                 uint32_t mem_count = read_LEB_unsigned(bytes, &pos, 32);
 
-                // 依次对内存中每个部分进行初始化
+                // 为所有数据项一次性申请内存
+                m->datas = arena_alloc(&m->arena, mem_count, sizeof(Segment), "datas");
+                m->data_count = mem_count;
+
+                // 依次记录每个数据项，实例化时再根据数据项初始化实例的内存
                 for (uint32_t s = 0; s < mem_count; s++) {
+                    Segment *data = &m->datas[s];
+
                     // 读取内存索引 mem_idx（即初始化哪块内存）
                     uint32_t index = read_LEB_unsigned(bytes, &pos, 32);
                     // 目前 Wasm 版本规定一个模块只能定义一块内存，所以 index 只能为 0
                     ASSERT(index == 0, "Only 1 default memory in MVP\n")
 
-                    // 计算初始化表达式 offset_expr，并将计算结果设置为当前内存偏移量 offset
-                    run_init_expr(m, I32, &pos);
-
-                    // 计算初始化表达式 offset_expr 也就是栈式虚拟机执行表达式的字节码中的指令流过程，最终操作数栈顶保存的就是表达式的返回值，即计算结果
-                    // 将栈顶的值弹出并赋值给当前内存偏移量 offset
-                    uint32_t offset = m->stack[m->sp--].value.uint32;
+                    // 记录初始化表达式 offset_expr 的起始地址
+                    data->offset_addr = pos;
+                    skip_init_expr(bytes, &pos);
 
-                    // 读取初始化数据所占内存大小
-                    uint32_t size = read_LEB_unsigned(bytes, &pos, 32);
-
-                    // 将写在二进制文件中的初始化数据拷贝到指定偏移量的内存中
-                    memcpy(m->memory.bytes + offset, bytes + pos, size);
-                    pos += size;
+                    // 读取初始化数据所占内存大小，并记录初始化数据的起始地址
+                    data->count = read_LEB_unsigned(bytes, &pos, 32);
+                    data->data_addr = pos;
+                    pos += data->count;
                 }
                 break;
             }
@@ -919,33 +1220,175 @@ struct Module *load_module(const uint8_t *bytes, const uint32_t byte_count) {
 
     // 收集所有本地模块定义的函数中 Block_/Loop/If 控制块的相关信息，例如起始地址、结束地址、跳转地址、控制块类型等，
     // 便于后续虚拟机解释执行指令时可以借助这些信息
-    find_blocks(m);
+    // 注：如果启用了延迟编译，则推迟到函数首次被调用时再收集（具体可查看 setup_call 函数）；如果命中了缓存，则无需再收集
+    if (!cached && !options.lazy_compile) {
+        find_blocks(m, code_size);
+    }
+
+    // 如果指定了预编译缓存目录但未命中缓存，则将解析结果写入缓存，以便后续加载同一个模块时使用
+    if (!cached && options.cache_dir) {
+        // 写入缓存前需要保证所有函数都已编译完成
+        if (options.lazy_compile) {
+            find_blocks(m, code_size);
+        }
+        save_module_cache(m, options.cache_dir);
+    }
+
+    return m;
+}
+
+// 释放模块占用的内存
+void free_module(struct Module *m) {
+    // 模块解析过程中申请的所有元数据都存储在内存池中，统一释放即可
+    arena_free(&m->arena);
+    free_module_cache(&m->cache);
+    pthread_mutex_destroy(&m->compile_lock);
+    free(m);
+}
+
+// 基于模块创建实例：为实例创建内存、表和全局变量，根据元素段和数据段初始化表和内存，最后执行起始函数
+Instance *instantiate(Module *m) {
+    const uint8_t *bytes = m->bytes;
+
+    // 为实例申请内存
+    Instance *inst = acalloc(1, sizeof(Instance), "Instance");
+    inst->module = m;
+
+    // 重置运行时相关状态，主要是清空操作数栈、调用栈等
+    inst->sp = -1;
+    inst->fp = -1;
+    inst->csp = -1;
+    inst->fuel = FUEL_UNLIMITED;
+    inst->epoch_deadline = EPOCH_DEADLINE_NONE;
+
+    // 创建表：如果表是从外部模块导入的，则直接使用导入表存储的元素，否则为存储表中的元素申请内存
+    inst->table = m->table;
+    if (!m->import_table) {
+        inst->table.entries = acalloc(m->table.cur_size, sizeof(uint32_t), "Instance->table.entries");
+    }
+
+    // 创建内存：如果内存是从外部模块导入的，则直接使用导入内存存储的数据，否则为存储内存中的数据申请内存
+    inst->memory = m->memory;
+    if (!m->import_memory) {
+        if (m->memory.shared) {
+            // 共享内存可能被其他线程中的实例同时访问，增长时不能移动数据，所以直接按照最大页数预留地址空间
+            inst->memory.bytes = reserve_memory((size_t) m->memory.max_size * PAGE_SIZE, "Instance->memory.bytes");
+            inst->memory.reserved_size = m->memory.max_size;
+        } else {
+            inst->memory.bytes = acalloc(m->memory.cur_size * PAGE_SIZE, sizeof(uint32_t), "Instance->memory.bytes");
+        }
+    }
+
+    // 创建全局变量，并按照顺序计算各个全局变量的初始值
+    // 注：初始化表达式中可能会通过 global.get 指令获取导入全局变量的值，所以导入全局变量必须先于模块内定义的全局变量初始化
+    inst->globals = acalloc(m->global_count, sizeof(StackValue), "Instance->globals");
+    for (uint32_t g = 0; g < m->global_count; g++) {
+        Global *glob = &m->globals[g];
+        StackValue *value = &inst->globals[g];
+
+        if (glob->import_value) {
+            // 导入全局变量：根据全局变量的值类型，将导入全局变量的实际值拷贝到实例的全局变量中
+            value->value_type = glob->value_type;
+            switch (glob->value_type) {
+                case I32:
+                case F32:
+                    memcpy(&value->value, glob->import_value, 4);
+                    break;
+                case I64:
+                case F64:
+                    memcpy(&value->value, glob->import_value, 8);
+                    break;
+                default:
+                    break;
+            }
+        } else {
+            // 模块内定义的全局变量：计算初始化表达式 init_expr，并将操作数栈顶的计算结果弹出并赋值给当前全局变量
+            uint32_t pos = glob->init_addr;
+            run_init_expr(inst, glob->value_type, &pos);
+            *value = inst->stack[inst->sp--];
+        }
+    }
+
+    // 根据元素段初始化表
+    for (uint32_t c = 0; c < m->elem_count; c++) {
+        Segment *elem = &m->elems[c];
+
+        // 计算初始化表达式 offset_expr，并将计算结果设置为当前表内偏移量 offset
+        uint32_t pos = elem->offset_addr;
+        run_init_expr(inst, I32, &pos);
+        uint32_t offset = inst->stack[inst->sp--].value.uint32;
+
+        // 遍历函数索引列表，将列表中的函数索引设置为元素的初始值
+        pos = elem->data_addr;
+        for (uint32_t n = 0; n < elem->count; n++) {
+            inst->table.entries[offset + n] = read_LEB_unsigned(bytes, &pos, 32);
+        }
+    }
+
+    // 根据数据段初始化内存
+    for (uint32_t s = 0; s < m->data_count; s++) {
+        Segment *data = &m->datas[s];
+
+        // 计算初始化表达式 offset_expr，并将计算结果设置为当前内存偏移量 offset
+        uint32_t pos = data->offset_addr;
+        run_init_expr(inst, I32, &pos);
+        uint32_t offset = inst->stack[inst->sp--].value.uint32;
+
+        // 将写在二进制文件中的初始化数据拷贝到指定偏移量的内存中
+        memcpy(inst->memory.bytes + offset, bytes + data->data_addr, data->count);
+    }
 
     // 起始函数 m->start_function 是在【模块完成初始化后】，【被导出函数可调用之前】自动被调用的函数
     // 可以将起始函数视为一种初始化全局变量或内存的函数，且起始函数必须处于本地模块内部，不能是从外部导入的函数
 
     // m->start_function 初始赋值为 -1
     // 在解析 Wasm 二进制文件中的起始段时，start_function 会被赋值为起始段中保存的起始函数索引（在本地模块所有函数的索引）
-    // 所以 m->start_function 不为 -1，说明本地模块存在起始函数，
-    // 需要在本地模块已完成初始化后，且本地模块的导出函数被调用之前，执行本地模块的起始函数
+    // 所以 m->start_function 不为 -1，说明本地模块存在起始函数，需要在实例完成初始化后，且实例的导出函数被调用之前，执行起始函数
     if (m->start_function != -1) {
         // 保存起始函数索引到 fidx
         uint32_t fidx = m->start_function;
-        bool result;
 
         // 起始函数必须处于本地模块内部，不能是从外部导入的函数
         // 注：从外部模块导入的函数在本地模块的所有函数中的前部分，可参考上面解析 Wasm 二进制文件导入段中处理外部模块导入函数的逻辑
         ASSERT(fidx >= m->import_func_count, "Start function should be local function of native module\n")
 
         // 调用 Wasm 模块的起始函数
-        result = invoke(m, fidx);
-
         // 虚拟机在执行起始函数的字节码中的指令，如果遇到错误会返回 false，否则顺利执行完成后会返回 true
         // 如果为 false，则将运行时（虚拟机执行指令过程）收集的异常信息打印出来
-        if (!result) {
-            FATAL("Exception: %s\n", exception)
+        if (!invoke(inst, fidx)) {
+            FATAL("Exception: %s\n", inst->exception)
         }
     }
 
-    return m;
+    return inst;
+}
+
+// 释放实例占用的内存
+void free_instance(Instance *inst) {
+    Module *m = inst->module;
+
+    // 如果表和内存不是从外部模块导入的，则需要释放其存储数据所占用的内存
+    if (!m->import_table) {
+        free(inst->table.entries);
+    }
+    // 预留了地址空间的内存（例如从检查点恢复的实例）需要解除映射，否则是通过堆申请的
+    if (!m->import_memory) {
+        if (inst->memory.reserved_size) {
+            munmap(inst->memory.bytes, (size_t) inst->memory.reserved_size * PAGE_SIZE);
+        } else {
+            free(inst->memory.bytes);
+        }
+    }
+
+    free(inst->globals);
+    free(inst);
+}
+
+// 获取实例实际使用的内存：导入的共享内存由多个实例共同使用，其当前页数以导入的内存为准，其他情况为实例自身的内存
+Memory *instance_memory(Instance *inst) {
+    Memory *shared = inst->module->import_memory;
+    if (shared && shared->shared) {
+        return shared;
+    }
+    return &inst->memory;
 }
@@ -1,6 +1,9 @@
 #ifndef WASMC_MODULE_H
 #define WASMC_MODULE_H
 
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -12,6 +15,14 @@
 #define CALLSTACK_SIZE 0x1000 // 调用栈的容量 4096，即 4 * 1024，也就是 4KB
 #define BLOCKSTACK_SIZE 0x1000// 控制块栈的容量 4096，即 4 * 1024，也就是 4KB
 #define BR_TABLE_SIZE 0x10000 // 跳转指令索引表大小 65536，即 64 * 1024，也就是 64KB
+#define EXCEPTION_SIZE 0x1000 // 异常信息的最大长度 4096
+#define FUEL_UNLIMITED INT64_MAX// 实例默认的燃料数量，即不限制执行的指令数量
+#define EPOCH_DEADLINE_NONE UINT64_MAX// 实例默认的截止纪元，即永远不会被中断
+#define FIND_BLOCKS_BATCH 64  // 并行收集控制块信息时，每个线程单次领取的函数数量
+#define FIND_BLOCKS_MAX_THREADS 64// 并行收集控制块信息时的最大线程数量（包括当前线程）
+#define FIND_BLOCKS_DEFAULT_THREADS 4// 无法获取 CPU 核数时，并行收集控制块信息的线程数量
+#define ARENA_CHUNK_SIZE 0x10000// 内存池中单个内存块的最小容量 65536，即 64 * 1024，也就是 64KB
+#define ARENA_ALIGN 8           // 内存池中申请的内存的对齐字节数
 
 #define I32 0x7f    // -0x01
 #define I64 0x7e    // -0x02
@@ -42,6 +53,21 @@ typedef enum {
     DataID   // 数据段 ID
 } SecID;
 
+// 内存池中的单个内存块
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;// 下一个内存块
+    size_t capacity;        // 内存块的容量
+    size_t used;            // 内存块已使用的字节数
+    uint8_t data[];         // 内存块的数据
+} ArenaChunk;
+
+// 内存池（bump-pointer arena）
+// 模块解析过程中所有的元数据（函数签名、函数、控制块、局部变量类型、导入/导出名称等）都从内存池中申请，
+// 申请时只需移动指针，且数据在内存中是连续存放的，释放模块时也只需释放内存池中的内存块即可
+typedef struct Arena {
+    ArenaChunk *head;// 当前正在使用的内存块（之前的内存块通过 next 串联起来）
+} Arena;
+
 // 控制块（包含函数）签名结构体
 // 注：目前多返回值提案还没有进入 Wasm 标准，根据当前版本的 Wasm 标准，非函数类型的控制块不能有参数，且最多只能有一个返回值
 typedef struct Type {
@@ -65,6 +91,12 @@ typedef struct Block {
     uint32_t end_addr;  // 控制块中字节码部分的【结束地址】
     uint32_t else_addr; // 控制块中字节码部分的【else 地址】(仅针对控制块类型为 if 的情况)
     uint32_t br_addr;   // 控制块中字节码部分的【跳转地址】
+    uint32_t fuel_cost; // 执行一次控制块需要消耗的燃料，即控制块中除嵌套的 Loop 控制块之外的指令数量（仅针对控制块类型为函数和 loop 的情况）
+
+    struct Block *func;  // 控制块所属的函数（控制块类型为函数时即为其本身）
+    uint32_t block_count;// 函数中 Block_/Loop/If 控制块的数量（仅针对控制块类型为函数的情况）
+    struct Block *blocks;// 函数中所有 Block_/Loop/If 控制块，按照起始地址递增的顺序紧凑存储（仅针对控制块类型为函数的情况）
+    atomic_bool compiled;// 是否已经收集完函数中控制块的相关信息（仅针对控制块类型为函数的情况）
 
     char *import_module;// 导入函数的导入模块名（仅针对从外部模块导入的函数）
     char *import_field; // 导入函数的导入成员名（仅针对从外部模块导入的函数）
@@ -82,19 +114,38 @@ typedef struct Table {
 
 // 内存结构体
 typedef struct Memory {
-    uint32_t min_size;// 最小页数
-    uint32_t max_size;// 最大页数
-    uint32_t cur_size;// 当前页数
-    uint8_t *bytes;   // 用于存储数据
+    uint32_t min_size;     // 最小页数
+    uint32_t max_size;     // 最大页数
+    uint32_t cur_size;     // 当前页数
+    uint32_t reserved_size;// 预先预留的页数（为 0 表示存储数据的内存是按需申请的，增长时需要重新申请内存）
+    uint8_t *bytes;        // 用于存储数据
+    bool shared;           // 是否为共享内存（线程提案），共享内存按照最大页数预留地址空间，增长时数据地址不变
 } Memory;
 
 // 导出项结构体
 typedef struct Export {
     char *export_name;     // 导出项成员名
     uint32_t external_kind;// 导出项类型（类型可以是函数/表/内存/全局变量）
-    void *value;           // 用于存储导出项的值
+    uint32_t index;        // 导出项在相应段中的索引（导出项的值需要根据索引从实例中获取，具体可查看 get_export_by_handle 函数）
 } Export;
 
+// 全局变量结构体
+// 注：模块中只记录全局变量的类型和初始化表达式，全局变量的值存储在各个实例中，实例化时才会计算初始化表达式
+typedef struct Global {
+    uint8_t value_type;// 全局变量的值类型
+    uint8_t mutability;// 全局变量的可变性
+    uint32_t init_addr;// 初始化表达式 init_expr 的【起始地址】（仅针对模块内定义的全局变量）
+    void *import_value;// 导入全局变量的实际值（仅针对从外部模块导入的全局变量）
+} Global;
+
+// 元素段/数据段中的单个元素项/数据项结构体
+// 注：模块中只记录偏移量的初始化表达式和初始化数据的位置，实例化时才会计算偏移量并初始化实例的表或内存
+typedef struct Segment {
+    uint32_t offset_addr;// 偏移量初始化表达式 offset_expr 的【起始地址】
+    uint32_t count;      // 初始化数据的数量（元素项为函数索引的数量，数据项为字节数）
+    uint32_t data_addr;  // 初始化数据的【起始地址】（元素项为函数索引列表，数据项为字节数组）
+} Segment;
+
 // 全局变量值/操作数栈的值结构体
 typedef struct StackValue {
     uint8_t value_type;// 值类型
@@ -146,7 +197,36 @@ typedef struct Frame {
                 // 注：该属性均针对类型为函数的控制块（只有函数执行完才会返回），其他类型的控制块没有该属性
 } Frame;
 
+// 模块加载选项
+typedef struct Options {
+    // 是否启用延迟编译
+    // 启用后加载模块时只记录各个函数字节码部分的起始地址和结束地址，在函数首次被调用时才收集其控制块的相关信息，
+    // 适用于导出函数很多但每次只会调用其中少部分函数的模块
+    bool lazy_compile;
+
+    // 预编译缓存目录（为 NULL 表示不使用缓存）
+    // 启用后会以模块字节码的哈希值作为键，将模块的解析结果（函数签名、函数、控制块、导出项等）写入该目录，
+    // 后续加载同一个模块时直接映射缓存文件，无需重新解析类型段、函数段、导出段和代码段，也无需重新收集控制块信息
+    const char *cache_dir;
+} Options;
+
+// 预编译缓存（具体可查看 cache.c）
+typedef struct ModuleCache {
+    uint64_t hash;           // 模块字节码的哈希值，即缓存的键
+    void *map;               // 缓存文件映射的内存（为 NULL 表示未命中缓存）
+    size_t map_size;         // 缓存文件映射的内存大小
+    Type *types;             // 缓存中的函数签名
+    uint32_t type_count;     // 缓存中的函数签名数量
+    Block *functions;        // 缓存中的函数（包括导入函数）
+    uint32_t function_count; // 缓存中的函数数量
+    uint32_t import_func_count;// 缓存中的导入函数数量
+    Export *exports;         // 缓存中的导出项
+    uint32_t export_count;   // 缓存中的导出项数量
+} ModuleCache;
+
 // Wasm 内存格式结构体
+// 模块只包含解析 Wasm 二进制文件得到的不可变数据（函数签名、函数、控制块、导出项等），解析完成后可以被多个实例共享，
+// 而每个实例各自的运行时状态（内存、表、全局变量、操作数栈、调用栈等）都存储在 Instance 中
 typedef struct Module {
     const uint8_t *bytes;// 用于存储 Wasm 二进制模块的内容
     uint32_t byte_count; // Wasm 二进制模块的字节数
@@ -156,21 +236,81 @@ typedef struct Module {
 
     uint32_t import_func_count;// 导入函数的数量
     uint32_t function_count;   // 所有函数的数量（包括导入函数）
-    Block *functions;          // 用于存储模块中所有函数（包括导入函数和模块内定义函数）
-    Block **block_lookup;      // 模块中所有 Block 的 map，其中 key 为为对应操作码 Block_/Loop/If 的地址
+    Block *functions;          // 用于存储模块中所有函数（包括导入函数和模块内定义函数），每个函数各自持有其控制块表
 
-    Table table;// 表
+    Table table;// 表的类型（元素类型、元素数量上下限），实例化时根据其为实例创建表
 
-    Memory memory;// 内存
+    Memory memory;// 内存的类型（页数上下限），实例化时根据其为实例创建内存
 
-    StackValue *globals;  // 用于存储全局变量的相关数据（值以及值类型等）
+    Global *globals;      // 用于存储全局变量的类型和初始化表达式
     uint32_t global_count;// 全局变量的数量
 
-    Export *exports;      // 用于存储导出项的相关数据（导出项的值、成员名以及类型等）
+    Export *exports;      // 用于存储导出项的相关数据（导出项的索引、成员名以及类型等）
     uint32_t export_count;// 导出项数量
 
+    // 导出项哈希表（开放寻址、线性探测），按照导出成员名的 FNV-1a 哈希值索引，用于快速查找导出项
+    // 每个槽位存储【导出项索引加 1】（为 0 表示空槽位），槽位数量为 2 的幂，且不少于导出项数量的 2 倍
+    uint32_t *export_map;
+    uint32_t export_map_mask;// 槽位数量减 1
+
+    Segment *elems;     // 用于存储元素段中所有元素项
+    uint32_t elem_count;// 元素项的数量
+
+    Segment *datas;     // 用于存储数据段中所有数据项
+    uint32_t data_count;// 数据项的数量
+
     uint32_t start_function;// 起始函数在本地模块所有函数中索引，而起始函数是在【模块完成初始化后】，【被导出函数可调用之前】自动被调用的函数
 
+    char **function_names;// 按照函数索引存储的函数名（来自自定义段 name 中的函数名子段，没有名称的函数为 NULL），模块没有 name 段时为 NULL
+
+    Table *import_table;  // 从外部模块导入的表（如果表不是导入的则为 NULL）
+    Memory *import_memory;// 从外部模块导入的内存（如果内存不是导入的则为 NULL）
+
+    Arena arena;// 内存池，用于存储模块解析过程中申请的所有元数据
+
+    Options options;             // 模块加载选项
+    pthread_mutex_t compile_lock;// 延迟编译时用于保证每个函数只被编译一次的锁
+    ModuleCache cache;           // 预编译缓存
+} Module;
+
+// 陷阱类型，即虚拟机执行失败退出的原因
+typedef enum TrapKind {
+    TRAP_ERROR = 0,      // 执行过程中出现异常，无法继续执行
+    TRAP_OUT_OF_FUEL = 1,// 燃料耗尽，补充燃料后可以从中断处继续执行（具体可查看 resume 函数）
+    TRAP_INTERRUPTED = 2,// 超过截止纪元被中断，延长截止纪元后可以从中断处继续执行
+    TRAP_YIELD = 3,      // 宿主函数请求让出执行（具体可查看 request_yield 函数），可以直接从中断处继续执行
+    TRAP_WAIT_IO = 4,    // 宿主函数提交了异步 I/O 请求（具体可查看 aio.c），请求完成并写回结果后可以从中断处继续执行
+} TrapKind;
+
+// Wasm 实例结构体
+// 实例引用一个共享的模块，只持有自身的内存、表、全局变量以及运行时状态，同一个模块可以创建任意多个互不影响的实例
+typedef struct Instance {
+    Module *module;// 实例对应的模块
+
+    Table table;// 表
+
+    Memory memory;// 内存
+
+    StackValue *globals;// 用于存储全局变量的相关数据（值以及值类型等），全局变量的数量即 module->global_count
+
+    // 异常信息，用于收集运行时（即虚拟机执行指令过程）中的异常信息
+    // 注：异常信息属于实例，因此多个线程可以同时在不同的实例上执行，互不影响
+    char exception[EXCEPTION_SIZE];
+    TrapKind trap;           // 陷阱类型，仅在执行失败时有效
+    TrapKind suspend_request;// 宿主函数请求在返回后暂停执行的原因（TRAP_YIELD 或 TRAP_WAIT_IO），为 TRAP_ERROR 表示没有请求
+
+    // 剩余的燃料，在函数入口以及 Loop 控制块的入口和每次循环时扣除控制块的燃料消耗，耗尽时虚拟机退出执行
+    // 注：进入控制块时按照其指令数量一次性扣除燃料，所以只需要在上述位置检查，而不需要每执行一条指令都检查
+    int64_t fuel;
+
+    // 截止纪元，全局纪元计数器（具体可查看 epoch.c）达到该值后，虚拟机在下一个安全点（即检查燃料的位置）中断执行
+    uint64_t epoch_deadline;
+
+    // 调度器相关状态（具体可查看 scheduler.c），值均为【工作线程编号加 1】，为 0 表示没有
+    _Atomic uint32_t running_worker;// 正在执行该实例上任务的工作线程，用于保证同一实例上的任务串行执行
+    _Atomic uint32_t home_worker;   // 最近执行该实例上任务的工作线程，新任务优先交给该线程（其缓存中很可能还保留着实例的内存）
+    struct AioRequest *aio;         // 异步宿主函数记录 I/O 请求的位置（具体可查看 aio.c），由调度器设置，为 NULL 时异步宿主函数同步执行
+
     // 下面属性用于记录运行时（即栈式虚拟机执行指令流的过程）状态，相关背景知识请查看上面栈帧结构体的注释
     uint32_t pc;                     // program counter 程序计数器，记录下一条即将执行的指令的地址
     int sp;                          // operand stack pointer 操作数栈顶指针，指向完整的操作数栈顶（注：所有栈帧共享一个完整的操作数栈，分别占用其中的某一部分）
@@ -179,9 +319,32 @@ typedef struct Module {
     int csp;                         // callstack pointer 调用栈指针，保存处在调用栈顶的栈帧索引，即当前栈帧在调用栈中的索引
     Frame callstack[CALLSTACK_SIZE]; // callstack 调用栈，用于存储栈帧
     uint32_t br_table[BR_TABLE_SIZE];// 跳转指令索引表
-} Module;
+} Instance;
+
+// 收集控制块信息时使用的临时缓冲区，可在处理多个函数时复用
+typedef struct BlockScratch {
+    Block *blocks;    // 临时存储控制块
+    uint32_t capacity;// 临时缓冲区的容量
+} BlockScratch;
 
 // 解析 Wasm 二进制文件内容，将其转化成内存格式 Module
-struct Module *load_module(const uint8_t *bytes, uint32_t byte_count);
+struct Module *load_module(const uint8_t *bytes, uint32_t byte_count, Options options);
+
+// 编译函数，即收集函数中控制块的相关信息（如果已经编译过则直接返回）
+// 注：延迟编译时会在函数首次被调用时执行，可以在多个线程中同时调用
+void compile_function(struct Module *m, Block *function);
+
+// 释放模块占用的内存
+// 注：释放模块前需要先释放该模块的所有实例
+void free_module(struct Module *m);
+
+// 基于模块创建实例：为实例创建内存、表和全局变量，根据元素段和数据段初始化表和内存，最后执行起始函数
+Instance *instantiate(Module *m);
+
+// 释放实例占用的内存
+void free_instance(Instance *inst);
+
+// 获取实例实际使用的内存：导入的共享内存由多个实例共同使用，其当前页数以导入的内存为准，其他情况为实例自身的内存
+Memory *instance_memory(Instance *inst);
 
 #endif
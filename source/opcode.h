@@ -191,6 +191,79 @@ typedef enum {
     I64Extend16S = 0xC3,     // i64.extend16_s
     I64Extend32S = 0xC4,     // i64.extend32_s
     TruncSat = 0xFC,         // <i32|64>.trunc_sat_<f32|64>_<s|u>
+    Atomic = 0xFE,           // 原子指令前缀（具体指令见 ATOMIC_OPCODE）
 } OPCODE;
 
+// 原子指令（线程提案）共 67 种，均以操作码前缀 0xFE 引入，紧跟在前缀之后的 LEB128 编码的数值用来区分不同的原子指令
+// 注：除 atomic.fence 之外，原子指令都带有和内存加载/存储指令相同的立即数（对齐方式和内存偏移量）
+typedef enum {
+    AtomicNotify = 0x00,          // memory.atomic.notify
+    AtomicWait32 = 0x01,          // memory.atomic.wait32
+    AtomicWait64 = 0x02,          // memory.atomic.wait64
+    AtomicFence = 0x03,           // atomic.fence
+    I32AtomicLoad = 0x10,         // i32.atomic.load
+    I64AtomicLoad = 0x11,         // i64.atomic.load
+    I32AtomicLoad8U = 0x12,       // i32.atomic.load8_u
+    I32AtomicLoad16U = 0x13,      // i32.atomic.load16_u
+    I64AtomicLoad8U = 0x14,       // i64.atomic.load8_u
+    I64AtomicLoad16U = 0x15,      // i64.atomic.load16_u
+    I64AtomicLoad32U = 0x16,      // i64.atomic.load32_u
+    I32AtomicStore = 0x17,        // i32.atomic.store
+    I64AtomicStore = 0x18,        // i64.atomic.store
+    I32AtomicStore8 = 0x19,       // i32.atomic.store8
+    I32AtomicStore16 = 0x1A,      // i32.atomic.store16
+    I64AtomicStore8 = 0x1B,       // i64.atomic.store8
+    I64AtomicStore16 = 0x1C,      // i64.atomic.store16
+    I64AtomicStore32 = 0x1D,      // i64.atomic.store32
+    I32AtomicRmwAdd = 0x1E,       // i32.atomic.rmw.add
+    I64AtomicRmwAdd = 0x1F,       // i64.atomic.rmw.add
+    I32AtomicRmw8AddU = 0x20,     // i32.atomic.rmw8.add_u
+    I32AtomicRmw16AddU = 0x21,    // i32.atomic.rmw16.add_u
+    I64AtomicRmw8AddU = 0x22,     // i64.atomic.rmw8.add_u
+    I64AtomicRmw16AddU = 0x23,    // i64.atomic.rmw16.add_u
+    I64AtomicRmw32AddU = 0x24,    // i64.atomic.rmw32.add_u
+    I32AtomicRmwSub = 0x25,       // i32.atomic.rmw.sub
+    I64AtomicRmwSub = 0x26,       // i64.atomic.rmw.sub
+    I32AtomicRmw8SubU = 0x27,     // i32.atomic.rmw8.sub_u
+    I32AtomicRmw16SubU = 0x28,    // i32.atomic.rmw16.sub_u
+    I64AtomicRmw8SubU = 0x29,     // i64.atomic.rmw8.sub_u
+    I64AtomicRmw16SubU = 0x2A,    // i64.atomic.rmw16.sub_u
+    I64AtomicRmw32SubU = 0x2B,    // i64.atomic.rmw32.sub_u
+    I32AtomicRmwAnd = 0x2C,       // i32.atomic.rmw.and
+    I64AtomicRmwAnd = 0x2D,       // i64.atomic.rmw.and
+    I32AtomicRmw8AndU = 0x2E,     // i32.atomic.rmw8.and_u
+    I32AtomicRmw16AndU = 0x2F,    // i32.atomic.rmw16.and_u
+    I64AtomicRmw8AndU = 0x30,     // i64.atomic.rmw8.and_u
+    I64AtomicRmw16AndU = 0x31,    // i64.atomic.rmw16.and_u
+    I64AtomicRmw32AndU = 0x32,    // i64.atomic.rmw32.and_u
+    I32AtomicRmwOr = 0x33,        // i32.atomic.rmw.or
+    I64AtomicRmwOr = 0x34,        // i64.atomic.rmw.or
+    I32AtomicRmw8OrU = 0x35,      // i32.atomic.rmw8.or_u
+    I32AtomicRmw16OrU = 0x36,     // i32.atomic.rmw16.or_u
+    I64AtomicRmw8OrU = 0x37,      // i64.atomic.rmw8.or_u
+    I64AtomicRmw16OrU = 0x38,     // i64.atomic.rmw16.or_u
+    I64AtomicRmw32OrU = 0x39,     // i64.atomic.rmw32.or_u
+    I32AtomicRmwXor = 0x3A,       // i32.atomic.rmw.xor
+    I64AtomicRmwXor = 0x3B,       // i64.atomic.rmw.xor
+    I32AtomicRmw8XorU = 0x3C,     // i32.atomic.rmw8.xor_u
+    I32AtomicRmw16XorU = 0x3D,    // i32.atomic.rmw16.xor_u
+    I64AtomicRmw8XorU = 0x3E,     // i64.atomic.rmw8.xor_u
+    I64AtomicRmw16XorU = 0x3F,    // i64.atomic.rmw16.xor_u
+    I64AtomicRmw32XorU = 0x40,    // i64.atomic.rmw32.xor_u
+    I32AtomicRmwXchg = 0x41,      // i32.atomic.rmw.xchg
+    I64AtomicRmwXchg = 0x42,      // i64.atomic.rmw.xchg
+    I32AtomicRmw8XchgU = 0x43,    // i32.atomic.rmw8.xchg_u
+    I32AtomicRmw16XchgU = 0x44,   // i32.atomic.rmw16.xchg_u
+    I64AtomicRmw8XchgU = 0x45,    // i64.atomic.rmw8.xchg_u
+    I64AtomicRmw16XchgU = 0x46,   // i64.atomic.rmw16.xchg_u
+    I64AtomicRmw32XchgU = 0x47,   // i64.atomic.rmw32.xchg_u
+    I32AtomicRmwCmpxchg = 0x48,   // i32.atomic.rmw.cmpxchg
+    I64AtomicRmwCmpxchg = 0x49,   // i64.atomic.rmw.cmpxchg
+    I32AtomicRmw8CmpxchgU = 0x4A, // i32.atomic.rmw8.cmpxchg_u
+    I32AtomicRmw16CmpxchgU = 0x4B,// i32.atomic.rmw16.cmpxchg_u
+    I64AtomicRmw8CmpxchgU = 0x4C, // i64.atomic.rmw8.cmpxchg_u
+    I64AtomicRmw16CmpxchgU = 0x4D,// i64.atomic.rmw16.cmpxchg_u
+    I64AtomicRmw32CmpxchgU = 0x4E,// i64.atomic.rmw32.cmpxchg_u
+} ATOMIC_OPCODE;
+
 #endif
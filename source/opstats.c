@@ -0,0 +1,506 @@
+#include "opstats.h"
+#include "opcode.h"
+#include "utils.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// 单字节操作码的助记符
+const char *opcode_names[256] = {
+        [Unreachable] = "unreachable",
+        [Nop] = "nop",
+        [Block_] = "block",
+        [Loop] = "loop",
+        [If] = "if",
+        [Else_] = "else",
+        [End_] = "end",
+        [Br] = "br",
+        [BrIf] = "br_if",
+        [BrTable] = "br_table",
+        [Return] = "return",
+        [Call] = "call",
+        [CallIndirect] = "call_indirect",
+        [Drop] = "drop",
+        [Select] = "select",
+        [LocalGet] = "local.get",
+        [LocalSet] = "local.set",
+        [LocalTee] = "local.tee",
+        [GlobalGet] = "global.get",
+        [GlobalSet] = "global.set",
+        [I32Load] = "i32.load",
+        [I64Load] = "i64.load",
+        [F32Load] = "f32.load",
+        [F64Load] = "f64.load",
+        [I32Load8S] = "i32.load8_s",
+        [I32Load8U] = "i32.load8_u",
+        [I32Load16S] = "i32.load16_s",
+        [I32Load16U] = "i32.load16_u",
+        [I64Load8S] = "i64.load8_s",
+        [I64Load8U] = "i64.load8_u",
+        [I64Load16S] = "i64.load16_s",
+        [I64Load16U] = "i64.load16_u",
+        [I64Load32S] = "i64.load32_s",
+        [I64Load32U] = "i64.load32_u",
+        [I32Store] = "i32.store",
+        [I64Store] = "i64.store",
+        [F32Store] = "f32.store",
+        [F64Store] = "f64.store",
+        [I32Store8] = "i32.store8",
+        [I32Store16] = "i32.store16",
+        [I64Store8] = "i64.store8",
+        [I64Store16] = "i64.store16",
+        [I64Store32] = "i64.store32",
+        [MemorySize] = "memory.size",
+        [MemoryGrow] = "memory.grow",
+        [I32Const] = "i32.const",
+        [I64Const] = "i64.const",
+        [F32Const] = "f32.const",
+        [F64Const] = "f64.const",
+        [I32Eqz] = "i32.eqz",
+        [I32Eq] = "i32.eq",
+        [I32Ne] = "i32.ne",
+        [I32LtS] = "i32.lt_s",
+        [I32LtU] = "i32.lt_u",
+        [I32GtS] = "i32.gt_s",
+        [I32GtU] = "i32.gt_u",
+        [I32LeS] = "i32.le_s",
+        [I32LeU] = "i32.le_u",
+        [I32GeS] = "i32.ge_s",
+        [I32GeU] = "i32.ge_u",
+        [I64Eqz] = "i64.eqz",
+        [I64Eq] = "i64.eq",
+        [I64Ne] = "i64.ne",
+        [I64LtS] = "i64.lt_s",
+        [I64LtU] = "i64.lt_u",
+        [I64GtS] = "i64.gt_s",
+        [I64GtU] = "i64.gt_u",
+        [I64LeS] = "i64.le_s",
+        [I64LeU] = "i64.le_u",
+        [I64GeS] = "i64.ge_s",
+        [I64GeU] = "i64.ge_u",
+        [F32Eq] = "f32.eq",
+        [F32Ne] = "f32.ne",
+        [F32Lt] = "f32.lt",
+        [F32Gt] = "f32.gt",
+        [F32Le] = "f32.le",
+        [F32Ge] = "f32.ge",
+        [F64Eq] = "f64.eq",
+        [F64Ne] = "f64.ne",
+        [F64Lt] = "f64.lt",
+        [F64Gt] = "f64.gt",
+        [F64Le] = "f64.le",
+        [F64Ge] = "f64.ge",
+        [I32Clz] = "i32.clz",
+        [I32Ctz] = "i32.ctz",
+        [I32PopCnt] = "i32.popcnt",
+        [I32Add] = "i32.add",
+        [I32Sub] = "i32.sub",
+        [I32Mul] = "i32.mul",
+        [I32DivS] = "i32.div_s",
+        [I32DivU] = "i32.div_u",
+        [I32RemS] = "i32.rem_s",
+        [I32RemU] = "i32.rem_u",
+        [I32And] = "i32.and",
+        [I32Or] = "i32.or",
+        [I32Xor] = "i32.xor",
+        [I32Shl] = "i32.shl",
+        [I32ShrS] = "i32.shr_s",
+        [I32ShrU] = "i32.shr_u",
+        [I32Rotl] = "i32.rotl",
+        [I32Rotr] = "i32.rotr",
+        [I64Clz] = "i64.clz",
+        [I64Ctz] = "i64.ctz",
+        [I64PopCnt] = "i64.popcnt",
+        [I64Add] = "i64.add",
+        [I64Sub] = "i64.sub",
+        [I64Mul] = "i64.mul",
+        [I64DivS] = "i64.div_s",
+        [I64DivU] = "i64.div_u",
+        [I64RemS] = "i64.rem_s",
+        [I64RemU] = "i64.rem_u",
+        [I64And] = "i64.and",
+        [I64Or] = "i64.or",
+        [I64Xor] = "i64.xor",
+        [I64Shl] = "i64.shl",
+        [I64ShrS] = "i64.shr_s",
+        [I64ShrU] = "i64.shr_u",
+        [I64Rotl] = "i64.rotl",
+        [I64Rotr] = "i64.rotr",
+        [F32Abs] = "f32.abs",
+        [F32Neg] = "f32.neg",
+        [F32Ceil] = "f32.ceil",
+        [F32Floor] = "f32.floor",
+        [F32Trunc] = "f32.trunc",
+        [F32Nearest] = "f32.nearest",
+        [F32Sqrt] = "f32.sqrt",
+        [F32Add] = "f32.add",
+        [F32Sub] = "f32.sub",
+        [F32Mul] = "f32.mul",
+        [F32Div] = "f32.div",
+        [F32Min] = "f32.min",
+        [F32Max] = "f32.max",
+        [F32CopySign] = "f32.copysign",
+        [F64Abs] = "f64.abs",
+        [F64Neg] = "f64.neg",
+        [F64Ceil] = "f64.ceil",
+        [F64Floor] = "f64.floor",
+        [F64Trunc] = "f64.trunc",
+        [F64Nearest] = "f64.nearest",
+        [F64Sqrt] = "f64.sqrt",
+        [F64Add] = "f64.add",
+        [F64Sub] = "f64.sub",
+        [F64Mul] = "f64.mul",
+        [F64Div] = "f64.div",
+        [F64Min] = "f64.min",
+        [F64Max] = "f64.max",
+        [F64CopySign] = "f64.copysign",
+        [I32WrapI64] = "i32.wrap_i64",
+        [I32TruncF32S] = "i32.trunc_f32_s",
+        [I32TruncF32U] = "i32.trunc_f32_u",
+        [I32TruncF64S] = "i32.trunc_f64_s",
+        [I32TruncF64U] = "i32.trunc_f64_u",
+        [I64ExtendI32S] = "i64.extend_i32_s",
+        [I64ExtendI32U] = "i64.extend_i32_u",
+        [I64TruncF32S] = "i64.trunc_f32_s",
+        [I64TruncF32U] = "i64.trunc_f32_u",
+        [I64TruncF64S] = "i64.trunc_f64_s",
+        [I64TruncF64U] = "i64.trunc_f64_u",
+        [F32ConvertI32S] = "f32.convert_i32_s",
+        [F32ConvertI32U] = "f32.convert_i32_u",
+        [F32ConvertI64S] = "f32.convert_i64_s",
+        [F32ConvertI64U] = "f32.convert_i64_u",
+        [F32DemoteF64] = "f32.demote_f64",
+        [F64ConvertI32S] = "f64.convert_i32_s",
+        [F64ConvertI32U] = "f64.convert_i32_u",
+        [F64ConvertI64S] = "f64.convert_i64_s",
+        [F64ConvertI64U] = "f64.convert_i64_u",
+        [F64PromoteF32] = "f64.promote_f32",
+        [I32ReinterpretF32] = "i32.reinterpret_f32",
+        [I64ReinterpretF64] = "i64.reinterpret_f64",
+        [F32ReinterpretI32] = "f32.reinterpret_i32",
+        [F64ReinterpretI64] = "f64.reinterpret_i64",
+        [I32Extend8S] = "i32.extend8_s",
+        [I32Extend16S] = "i32.extend16_s",
+        [I64Extend8S] = "i64.extend8_s",
+        [I64Extend16S] = "i64.extend16_s",
+        [I64Extend32S] = "i64.extend32_s",
+};
+
+// 原子指令（操作码前缀 0xFE 之后的部分）的助记符
+const char *atomic_opcode_names[256] = {
+        [AtomicNotify] = "memory.atomic.notify",
+        [AtomicWait32] = "memory.atomic.wait32",
+        [AtomicWait64] = "memory.atomic.wait64",
+        [AtomicFence] = "atomic.fence",
+        [I32AtomicLoad] = "i32.atomic.load",
+        [I64AtomicLoad] = "i64.atomic.load",
+        [I32AtomicLoad8U] = "i32.atomic.load8_u",
+        [I32AtomicLoad16U] = "i32.atomic.load16_u",
+        [I64AtomicLoad8U] = "i64.atomic.load8_u",
+        [I64AtomicLoad16U] = "i64.atomic.load16_u",
+        [I64AtomicLoad32U] = "i64.atomic.load32_u",
+        [I32AtomicStore] = "i32.atomic.store",
+        [I64AtomicStore] = "i64.atomic.store",
+        [I32AtomicStore8] = "i32.atomic.store8",
+        [I32AtomicStore16] = "i32.atomic.store16",
+        [I64AtomicStore8] = "i64.atomic.store8",
+        [I64AtomicStore16] = "i64.atomic.store16",
+        [I64AtomicStore32] = "i64.atomic.store32",
+        [I32AtomicRmwAdd] = "i32.atomic.rmw.add",
+        [I64AtomicRmwAdd] = "i64.atomic.rmw.add",
+        [I32AtomicRmw8AddU] = "i32.atomic.rmw8.add_u",
+        [I32AtomicRmw16AddU] = "i32.atomic.rmw16.add_u",
+        [I64AtomicRmw8AddU] = "i64.atomic.rmw8.add_u",
+        [I64AtomicRmw16AddU] = "i64.atomic.rmw16.add_u",
+        [I64AtomicRmw32AddU] = "i64.atomic.rmw32.add_u",
+        [I32AtomicRmwSub] = "i32.atomic.rmw.sub",
+        [I64AtomicRmwSub] = "i64.atomic.rmw.sub",
+        [I32AtomicRmw8SubU] = "i32.atomic.rmw8.sub_u",
+        [I32AtomicRmw16SubU] = "i32.atomic.rmw16.sub_u",
+        [I64AtomicRmw8SubU] = "i64.atomic.rmw8.sub_u",
+        [I64AtomicRmw16SubU] = "i64.atomic.rmw16.sub_u",
+        [I64AtomicRmw32SubU] = "i64.atomic.rmw32.sub_u",
+        [I32AtomicRmwAnd] = "i32.atomic.rmw.and",
+        [I64AtomicRmwAnd] = "i64.atomic.rmw.and",
+        [I32AtomicRmw8AndU] = "i32.atomic.rmw8.and_u",
+        [I32AtomicRmw16AndU] = "i32.atomic.rmw16.and_u",
+        [I64AtomicRmw8AndU] = "i64.atomic.rmw8.and_u",
+        [I64AtomicRmw16AndU] = "i64.atomic.rmw16.and_u",
+        [I64AtomicRmw32AndU] = "i64.atomic.rmw32.and_u",
+        [I32AtomicRmwOr] = "i32.atomic.rmw.or",
+        [I64AtomicRmwOr] = "i64.atomic.rmw.or",
+        [I32AtomicRmw8OrU] = "i32.atomic.rmw8.or_u",
+        [I32AtomicRmw16OrU] = "i32.atomic.rmw16.or_u",
+        [I64AtomicRmw8OrU] = "i64.atomic.rmw8.or_u",
+        [I64AtomicRmw16OrU] = "i64.atomic.rmw16.or_u",
+        [I64AtomicRmw32OrU] = "i64.atomic.rmw32.or_u",
+        [I32AtomicRmwXor] = "i32.atomic.rmw.xor",
+        [I64AtomicRmwXor] = "i64.atomic.rmw.xor",
+        [I32AtomicRmw8XorU] = "i32.atomic.rmw8.xor_u",
+        [I32AtomicRmw16XorU] = "i32.atomic.rmw16.xor_u",
+        [I64AtomicRmw8XorU] = "i64.atomic.rmw8.xor_u",
+        [I64AtomicRmw16XorU] = "i64.atomic.rmw16.xor_u",
+        [I64AtomicRmw32XorU] = "i64.atomic.rmw32.xor_u",
+        [I32AtomicRmwXchg] = "i32.atomic.rmw.xchg",
+        [I64AtomicRmwXchg] = "i64.atomic.rmw.xchg",
+        [I32AtomicRmw8XchgU] = "i32.atomic.rmw8.xchg_u",
+        [I32AtomicRmw16XchgU] = "i32.atomic.rmw16.xchg_u",
+        [I64AtomicRmw8XchgU] = "i64.atomic.rmw8.xchg_u",
+        [I64AtomicRmw16XchgU] = "i64.atomic.rmw16.xchg_u",
+        [I64AtomicRmw32XchgU] = "i64.atomic.rmw32.xchg_u",
+        [I32AtomicRmwCmpxchg] = "i32.atomic.rmw.cmpxchg",
+        [I64AtomicRmwCmpxchg] = "i64.atomic.rmw.cmpxchg",
+        [I32AtomicRmw8CmpxchgU] = "i32.atomic.rmw8.cmpxchg_u",
+        [I32AtomicRmw16CmpxchgU] = "i32.atomic.rmw16.cmpxchg_u",
+        [I64AtomicRmw8CmpxchgU] = "i64.atomic.rmw8.cmpxchg_u",
+        [I64AtomicRmw16CmpxchgU] = "i64.atomic.rmw16.cmpxchg_u",
+        [I64AtomicRmw32CmpxchgU] = "i64.atomic.rmw32.cmpxchg_u",
+};
+
+
+// 饱和截断指令（操作码前缀 0xFC 之后的部分）的助记符
+const char *trunc_sat_names[8] = {
+        "i32.trunc_sat_f32_s",
+        "i32.trunc_sat_f32_u",
+        "i32.trunc_sat_f64_s",
+        "i32.trunc_sat_f64_u",
+        "i64.trunc_sat_f32_s",
+        "i64.trunc_sat_f32_u",
+        "i64.trunc_sat_f64_s",
+        "i64.trunc_sat_f64_u",
+};
+
+// 指令类别的名称
+const char *opclass_names[OPCLASS_COUNT] = {
+        [OPCLASS_CONTROL] = "control",
+        [OPCLASS_PARAMETRIC] = "parametric",
+        [OPCLASS_VARIABLE] = "variable",
+        [OPCLASS_MEMORY] = "memory",
+        [OPCLASS_CONST] = "const",
+        [OPCLASS_I32] = "i32",
+        [OPCLASS_I64] = "i64",
+        [OPCLASS_F32] = "f32",
+        [OPCLASS_F64] = "f64",
+        [OPCLASS_CONVERSION] = "conversion",
+        [OPCLASS_ATOMIC] = "atomic",
+};
+
+_Thread_local OpcodeCounters *thread_counters = NULL;// 当前线程的统计数据，首次记录时分配
+OpcodeCounters *counter_list = NULL;                 // 所有线程的统计数据（线程退出后仍然保留，不会释放）
+pthread_mutex_t counter_list_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// 获取指令编号对应的助记符（非法的操作码也会被记录，其助记符为 unknown）
+const char *opstats_name(uint32_t code) {
+    const char *name;
+    if (code < OPSTATS_PREFIXED) {
+        name = opcode_names[code];
+    } else if (code < 2 * OPSTATS_PREFIXED) {
+        name = code - OPSTATS_PREFIXED < 8 ? trunc_sat_names[code - OPSTATS_PREFIXED] : NULL;
+    } else {
+        name = atomic_opcode_names[code - 2 * OPSTATS_PREFIXED];
+    }
+    return name ? name : "unknown";
+}
+
+// 获取指令编号对应的类别
+OpClass opstats_class(uint32_t code) {
+    if (code >= 2 * OPSTATS_PREFIXED) {
+        return OPCLASS_ATOMIC;
+    }
+    if (code >= OPSTATS_PREFIXED || (code >= I32WrapI64 && code <= I64Extend32S)) {
+        return OPCLASS_CONVERSION;
+    }
+    if (code <= CallIndirect) {
+        return OPCLASS_CONTROL;
+    }
+    if (code <= Select) {
+        return OPCLASS_PARAMETRIC;
+    }
+    if (code <= GlobalSet) {
+        return OPCLASS_VARIABLE;
+    }
+    if (code <= MemoryGrow) {
+        return OPCLASS_MEMORY;
+    }
+    if (code <= F64Const) {
+        return OPCLASS_CONST;
+    }
+    if (code <= I32GeU || (code >= I32Clz && code <= I32Rotr)) {
+        return OPCLASS_I32;
+    }
+    if (code <= I64GeU || (code >= I64Clz && code <= I64Rotr)) {
+        return OPCLASS_I64;
+    }
+    if (code <= F32Ge || (code >= F32Abs && code <= F32CopySign)) {
+        return OPCLASS_F32;
+    }
+    return OPCLASS_F64;
+}
+
+// 读取时间戳计数器
+uint64_t read_tsc(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+// 分配当前线程的统计数据并加入链表
+OpcodeCounters *register_thread_counters(void) {
+    OpcodeCounters *c = acalloc(1, sizeof(OpcodeCounters), "OpcodeCounters");
+    c->last_class = -1;
+    pthread_mutex_lock(&counter_list_lock);
+    c->next = counter_list;
+    counter_list = c;
+    pthread_mutex_unlock(&counter_list_lock);
+    thread_counters = c;
+    return c;
+}
+
+// 计数器加 1（只有所属线程写入，所以不需要带锁的原子指令，原子变量只是为了让汇总线程能够安全地读取）
+#define COUNTER_ADD(counter, n) \
+    atomic_store_explicit(&(counter), atomic_load_explicit(&(counter), memory_order_relaxed) + (n), memory_order_relaxed);
+
+// 记录一次指令执行
+void record_opcode(uint8_t opcode, const uint8_t *operand) {
+    OpcodeCounters *c = thread_counters ? thread_counters : register_thread_counters();
+    uint32_t code = opcode;
+    if (opcode == TruncSat) {
+        code = OPSTATS_PREFIXED + *operand;
+    } else if (opcode == Atomic) {
+        // 原子指令的子操作码都小于 0x80，所以其 LEB128 编码只有一个字节
+        code = 2 * OPSTATS_PREFIXED + *operand;
+    }
+    COUNTER_ADD(c->counts[code], 1)
+
+#ifdef WASMC_PROFILE_CYCLES
+    // 上一条指令从开始执行到当前指令开始执行之间的周期数都计入上一条指令的类别（包括统计本身的开销）
+    uint64_t now = read_tsc();
+    if (c->last_class >= 0) {
+        COUNTER_ADD(c->class_cycles[c->last_class], now - c->last_tsc)
+    }
+    c->last_tsc = now;
+    c->last_class = (int) opstats_class(code);
+#endif
+}
+
+// 进入解释器时调用，之后的第一条指令重新开始计时
+void begin_opcode_timing(void) {
+    if (thread_counters) {
+        thread_counters->last_class = -1;
+    }
+}
+
+// 比较两种指令的执行次数，用于从高到低排序
+int compare_opcode_stat(const void *a, const void *b) {
+    uint64_t x = ((const OpcodeStat *) a)->count, y = ((const OpcodeStat *) b)->count;
+    return x > y ? -1 : x < y;
+}
+
+// 汇总所有线程的统计数据，按照执行次数从高到低排序后写入 stats
+uint32_t collect_opcode_stats(OpcodeStat *stats, uint32_t capacity) {
+    uint64_t *totals = acalloc(OPSTATS_COUNT, sizeof(uint64_t), "opcode totals");
+    pthread_mutex_lock(&counter_list_lock);
+    for (OpcodeCounters *c = counter_list; c; c = c->next) {
+        for (uint32_t i = 0; i < OPSTATS_COUNT; i++) {
+            totals[i] += atomic_load_explicit(&c->counts[i], memory_order_relaxed);
+        }
+    }
+    pthread_mutex_unlock(&counter_list_lock);
+
+    OpcodeStat *all = acalloc(OPSTATS_COUNT, sizeof(OpcodeStat), "OpcodeStat");
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < OPSTATS_COUNT; i++) {
+        if (totals[i] > 0) {
+            all[count++] = (OpcodeStat){opstats_name(i), i, totals[i]};
+        }
+    }
+    qsort(all, count, sizeof(OpcodeStat), compare_opcode_stat);
+    for (uint32_t i = 0; i < count && i < capacity; i++) {
+        stats[i] = all[i];
+    }
+    free(all);
+    free(totals);
+    return count;
+}
+
+// 汇总所有线程中每类指令的执行次数以及消耗的周期数
+void collect_class_stats(uint64_t *counts, uint64_t *cycles) {
+    for (uint32_t i = 0; i < OPCLASS_COUNT; i++) {
+        counts[i] = cycles[i] = 0;
+    }
+    pthread_mutex_lock(&counter_list_lock);
+    for (OpcodeCounters *c = counter_list; c; c = c->next) {
+        for (uint32_t i = 0; i < OPSTATS_COUNT; i++) {
+            counts[opstats_class(i)] += atomic_load_explicit(&c->counts[i], memory_order_relaxed);
+        }
+        for (uint32_t i = 0; i < OPCLASS_COUNT; i++) {
+            cycles[i] += atomic_load_explicit(&c->class_cycles[i], memory_order_relaxed);
+        }
+    }
+    pthread_mutex_unlock(&counter_list_lock);
+}
+
+// 将汇总后的统计数据按照执行次数从高到低输出到 out
+void print_opcode_report(FILE *out) {
+#ifndef WASMC_PROFILE_OPCODES
+    fprintf(out, "opcode statistics are not available, rebuild with WASMC_PROFILE_OPCODES defined\n");
+#else
+    OpcodeStat *stats = acalloc(OPSTATS_COUNT, sizeof(OpcodeStat), "OpcodeStat");
+    uint32_t count = collect_opcode_stats(stats, OPSTATS_COUNT);
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        total += stats[i].count;
+    }
+
+    fprintf(out, "%-24s %16s %8s %8s\n", "opcode", "count", "%", "cum%");
+    uint64_t cumulative = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        cumulative += stats[i].count;
+        fprintf(out, "%-24s %16" PRIu64 " %7.2f%% %7.2f%%\n", stats[i].name, stats[i].count,
+                100.0 * (double) stats[i].count / (double) total, 100.0 * (double) cumulative / (double) total);
+    }
+    fprintf(out, "%-24s %16" PRIu64 "\n", "total", total);
+    free(stats);
+
+#ifdef WASMC_PROFILE_CYCLES
+    uint64_t counts[OPCLASS_COUNT], cycles[OPCLASS_COUNT], total_cycles = 0;
+    collect_class_stats(counts, cycles);
+    for (uint32_t i = 0; i < OPCLASS_COUNT; i++) {
+        total_cycles += cycles[i];
+    }
+    fprintf(out, "\n%-24s %16s %16s %8s %12s\n", "class", "count", "cycles", "%", "cycles/op");
+    for (uint32_t i = 0; i < OPCLASS_COUNT; i++) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        fprintf(out, "%-24s %16" PRIu64 " %16" PRIu64 " %7.2f%% %12.1f\n", opclass_names[i], counts[i], cycles[i],
+                total_cycles ? 100.0 * (double) cycles[i] / (double) total_cycles : 0, (double) cycles[i] / (double) counts[i]);
+    }
+#endif
+#endif
+}
+
+// 清零所有线程的统计数据
+void reset_opcode_stats(void) {
+    pthread_mutex_lock(&counter_list_lock);
+    for (OpcodeCounters *c = counter_list; c; c = c->next) {
+        for (uint32_t i = 0; i < OPSTATS_COUNT; i++) {
+            atomic_store_explicit(&c->counts[i], 0, memory_order_relaxed);
+        }
+        for (uint32_t i = 0; i < OPCLASS_COUNT; i++) {
+            atomic_store_explicit(&c->class_cycles[i], 0, memory_order_relaxed);
+        }
+    }
+    pthread_mutex_unlock(&counter_list_lock);
+}
@@ -0,0 +1,70 @@
+#ifndef WASMC_OPSTATS_H
+#define WASMC_OPSTATS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// 指令统计的构建模式（默认关闭，关闭时解释器没有任何额外开销）：
+// WASMC_PROFILE_OPCODES 统计每种指令的执行次数
+// WASMC_PROFILE_CYCLES  在此基础上读取时间戳计数器（x86 上为 rdtsc，其他架构为单调时钟的纳秒数），统计每类指令消耗的周期数
+#if defined(WASMC_PROFILE_CYCLES) && !defined(WASMC_PROFILE_OPCODES)
+#define WASMC_PROFILE_OPCODES
+#endif
+
+#define OPSTATS_PREFIXED 0x100// 带前缀的指令在统计中的编号为 OPSTATS_PREFIXED * 前缀序号 + 子操作码，前缀序号 1 为 0xFC，2 为 0xFE
+#define OPSTATS_COUNT 0x300   // 统计的指令编号数量（单字节操作码以及两种前缀的子操作码）
+
+// 指令的类别，用于统计每类指令消耗的周期数
+typedef enum OpClass {
+    OPCLASS_CONTROL,   // 控制指令
+    OPCLASS_PARAMETRIC,// 参数指令
+    OPCLASS_VARIABLE,  // 变量指令
+    OPCLASS_MEMORY,    // 内存指令
+    OPCLASS_CONST,     // 常量指令
+    OPCLASS_I32,       // i32 的比较和算术指令
+    OPCLASS_I64,       // i64 的比较和算术指令
+    OPCLASS_F32,       // f32 的比较和算术指令
+    OPCLASS_F64,       // f64 的比较和算术指令
+    OPCLASS_CONVERSION,// 类型转换指令（包括饱和截断指令）
+    OPCLASS_ATOMIC,    // 原子指令
+    OPCLASS_COUNT,
+} OpClass;
+
+// 一个线程的统计数据，只由该线程写入（不需要带锁的原子指令），汇总时由其他线程读取
+typedef struct OpcodeCounters {
+    _Atomic uint64_t counts[OPSTATS_COUNT];      // 每种指令的执行次数
+    _Atomic uint64_t class_cycles[OPCLASS_COUNT];// 每类指令消耗的周期数
+    uint64_t last_tsc;                           // 上一条指令开始执行时的时间戳
+    int last_class;                              // 上一条指令的类别，为 -1 表示还没有开始计时
+    struct OpcodeCounters *next;                 // 所有线程的统计数据组成的链表
+} OpcodeCounters;
+
+// 汇总后的一种指令的统计数据
+typedef struct OpcodeStat {
+    const char *name;// 助记符
+    uint32_t opcode; // 指令编号（见 OPSTATS_PREFIXED）
+    uint64_t count;  // 执行次数
+} OpcodeStat;
+
+// 记录一次指令执行，operand 指向操作码之后的字节（即前缀指令的子操作码）
+// 注：只在 WASMC_PROFILE_OPCODES 构建模式下由解释器在每条指令执行前调用
+void record_opcode(uint8_t opcode, const uint8_t *operand);
+
+// 进入解释器时调用，之后的第一条指令重新开始计时，避免将解释器之外的耗时计入上一条指令
+void begin_opcode_timing(void);
+
+// 汇总所有线程的统计数据，按照执行次数从高到低排序后写入 stats（最多 capacity 项），返回执行过的指令种类数量
+uint32_t collect_opcode_stats(OpcodeStat *stats, uint32_t capacity);
+
+// 汇总所有线程中每类指令的执行次数以及消耗的周期数（数组长度均为 OPCLASS_COUNT）
+void collect_class_stats(uint64_t *counts, uint64_t *cycles);
+
+// 将汇总后的统计数据按照执行次数从高到低输出到 out，启用 WASMC_PROFILE_CYCLES 时同时输出每类指令的周期数
+void print_opcode_report(FILE *out);
+
+// 清零所有线程的统计数据
+// 注：其他线程正在执行指令时清零，可能有少量计数不会被清零
+void reset_opcode_stats(void);
+
+#endif
@@ -0,0 +1,253 @@
+#define _GNU_SOURCE
+
+#include "pool.h"
+#include "module.h"
+#include "utils.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// 预留 size 字节的地址空间
+// 注：使用 MAP_NORESERVE 预留的地址空间不会占用物理内存，只有在实际访问时才会按页分配，且新分配的页天然就是用 0 初始化的
+void *reserve_memory(size_t size, char *name) {
+    if (size == 0) {
+        return NULL;
+    }
+    void *res = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (res == MAP_FAILED) {
+        FATAL("Could not reserve %lu bytes for %s\n", size, name)
+    }
+    return res;
+}
+
+// 创建一个内存文件（memfd），并将 size 字节的数据 bytes 写入其中，失败时返回 -1
+int create_memory_image(const uint8_t *bytes, size_t size) {
+    int fd = memfd_create("wasmc-memory-image", MFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate(fd, (off_t) size) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    // 分批写入数据，全为 0 的部分无需写入（ftruncate 后文件内容默认为 0）
+    for (size_t off = 0; off < size; off += PAGE_SIZE) {
+        size_t len = size - off < PAGE_SIZE ? size - off : PAGE_SIZE;
+        bool zero = true;
+        for (size_t i = 0; i < len && zero; i++) {
+            zero = bytes[off + i] == 0;
+        }
+        if (!zero && pwrite(fd, bytes + off, len, (off_t) off) != (ssize_t) len) {
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+// 将实例中所有与执行相关的状态（运行时状态、异常信息、陷阱、燃料、截止纪元以及调度器和异步 I/O 相关状态）恢复为模板实例的状态，
+// 避免上一个使用者留下的状态（例如暂停请求、挂起的 I/O 请求或者调度器的工作线程）影响下一个使用者
+void reset_run_state(Instance *inst, Instance *template) {
+    memcpy(inst->exception, template->exception, sizeof(inst->exception));
+    inst->trap = template->trap;
+    inst->suspend_request = template->suspend_request;
+    inst->fuel = template->fuel;
+    inst->epoch_deadline = template->epoch_deadline;
+    uint32_t running_worker = atomic_load_explicit(&template->running_worker, memory_order_relaxed);
+    uint32_t home_worker = atomic_load_explicit(&template->home_worker, memory_order_relaxed);
+    atomic_store_explicit(&inst->running_worker, running_worker, memory_order_relaxed);
+    atomic_store_explicit(&inst->home_worker, home_worker, memory_order_relaxed);
+    inst->aio = template->aio;
+    inst->pc = template->pc;
+    inst->sp = template->sp;
+    inst->fp = template->fp;
+    inst->csp = template->csp;
+}
+
+// 以模板实例为初始状态初始化槽位 idx 对应的实例
+void init_slot(InstancePool *pool, uint32_t idx) {
+    Module *m = pool->module;
+    Instance *template = pool->template;
+    Instance *inst = &pool->slots[idx];
+
+    inst->module = m;
+    reset_run_state(inst, template);
+
+    // 表：如果表是从外部模块导入的，则所有槽位都直接使用导入表，否则使用该槽位预留的表
+    inst->table = template->table;
+    if (!m->import_table) {
+        inst->table.entries = pool->table_base + (size_t) idx * m->table.cur_size;
+        memcpy(inst->table.entries, template->table.entries, sizeof(uint32_t) * template->table.cur_size);
+    }
+
+    // 内存：如果内存是从外部模块导入的，则所有槽位都直接使用导入内存，否则使用该槽位预留的内存
+    inst->memory = template->memory;
+    if (!m->import_memory) {
+        size_t init_size = (size_t) template->memory.cur_size * PAGE_SIZE;
+        inst->memory.bytes = pool->memory_base + idx * pool->memory_stride;
+        inst->memory.reserved_size = (uint32_t) (pool->memory_stride / PAGE_SIZE);
+
+        if (pool->image_fd >= 0 && init_size > 0) {
+            // 以写时复制的方式将模板实例的内存数据映射到该槽位预留的内存开头，
+            // 这样只有实际被写入的页才会复制出私有的副本，其余页都与其他槽位共享同一份物理内存
+            void *res = mmap(inst->memory.bytes, init_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, pool->image_fd, 0);
+            if (res == MAP_FAILED) {
+                FATAL("Could not map memory image for slot %u\n", idx)
+            }
+        } else {
+            memcpy(inst->memory.bytes, template->memory.bytes, init_size);
+        }
+    }
+
+    // 全局变量
+    inst->globals = pool->globals_base + (size_t) idx * m->global_count;
+    memcpy(inst->globals, template->globals, sizeof(StackValue) * m->global_count);
+}
+
+// 将实例重置为模板实例的状态
+// 注：操作数栈和调用栈中的数据无需清空，调用函数时局部变量会被重新初始化为 0（具体可查看 setup_call 函数）
+void reset_slot(InstancePool *pool, Instance *inst) {
+    Module *m = pool->module;
+    Instance *template = pool->template;
+
+    // 重置所有与执行相关的状态
+    reset_run_state(inst, template);
+
+    // 重置全局变量和表中元素
+    memcpy(inst->globals, template->globals, sizeof(StackValue) * m->global_count);
+    if (!m->import_table) {
+        memcpy(inst->table.entries, template->table.entries, sizeof(uint32_t) * template->table.cur_size);
+    }
+
+    // 重置内存：恢复模板实例的内存数据，如果内存增长过，还需要将增长的部分清零，保证预留的内存中超出当前页数的部分始终为 0
+    if (!m->import_memory) {
+        size_t init_size = (size_t) template->memory.cur_size * PAGE_SIZE;
+        size_t cur_size = (size_t) inst->memory.cur_size * PAGE_SIZE;
+
+        // 对整个当前内存执行 MADV_DONTNEED，内核只会丢弃实际被访问过的页：
+        // 1. 开头映射了内存文件的部分，被写入过的私有副本会被丢弃，再次访问时重新读取模板实例的内存数据
+        // 2. 内存增长的匿名映射部分，被访问过的页会被丢弃，再次访问时重新分配用 0 初始化的页
+        // 因此重置的开销只与实际被修改的页数相关，而与内存的总大小无关
+        if (cur_size > 0 && madvise(inst->memory.bytes, cur_size, MADV_DONTNEED) != 0) {
+            FATAL("Could not reset memory of slot %u\n", (uint32_t) (inst - pool->slots))
+        }
+
+        // 如果不支持内存文件，则开头部分也是匿名映射，被丢弃后需要重新拷贝模板实例的内存数据
+        if (pool->image_fd < 0) {
+            memcpy(inst->memory.bytes, template->memory.bytes, init_size);
+        }
+        inst->memory.cur_size = template->memory.cur_size;
+    }
+}
+
+// 基于模块创建包含 slot_count 个槽位的实例池
+InstancePool *create_pool(Module *m, uint32_t slot_count) {
+    ASSERT(slot_count > 0, "Instance pool needs at least 1 slot\n")
+
+    InstancePool *pool = acalloc(1, sizeof(InstancePool), "InstancePool");
+    pool->module = m;
+    pool->slot_count = slot_count;
+
+    // 创建模板实例，所有槽位都以其为初始状态，因此数据段、元素段的初始化以及起始函数都只会执行一次
+    pool->template = instantiate(m);
+
+    // 为所有槽位的实例预留地址空间
+    pool->slots = reserve_memory(sizeof(Instance) * slot_count, "InstancePool->slots");
+
+    // 为所有槽位的内存预留地址空间，每个槽位按照内存的最大页数预留，这样内存增长时无需重新申请内存
+    if (!m->import_memory) {
+        pool->memory_stride = (size_t) m->memory.max_size * PAGE_SIZE;
+        if (pool->memory_stride < (size_t) pool->template->memory.cur_size * PAGE_SIZE) {
+            pool->memory_stride = (size_t) pool->template->memory.cur_size * PAGE_SIZE;
+        }
+        pool->memory_base = reserve_memory(pool->memory_stride * slot_count, "InstancePool->memory");
+    }
+
+    // 将模板实例的内存数据写入内存文件，各个槽位初始化时以写时复制的方式映射该文件
+    // 注：如果系统不支持 memfd，则退化为初始化和重置时直接拷贝模板实例的内存数据
+    pool->image_fd = -1;
+    size_t init_size = (size_t) pool->template->memory.cur_size * PAGE_SIZE;
+    if (!m->import_memory && init_size > 0) {
+        pool->image_fd = create_memory_image(pool->template->memory.bytes, init_size);
+    }
+
+    // 为所有槽位的表和全局变量申请内存
+    pool->table_base = acalloc((size_t) m->table.cur_size * slot_count, sizeof(uint32_t), "InstancePool->table");
+    pool->globals_base = acalloc((size_t) m->global_count * slot_count, sizeof(StackValue), "InstancePool->globals");
+    pool->initialized = acalloc(slot_count, sizeof(bool), "InstancePool->initialized");
+
+    // 将所有槽位依次串联成空闲链表
+    pool->free_next = acalloc(slot_count, sizeof(_Atomic uint32_t), "InstancePool->free_next");
+    for (uint32_t i = 0; i < slot_count; i++) {
+        atomic_init(&pool->free_next[i], i + 1 < slot_count ? i + 2 : 0);
+    }
+    atomic_init(&pool->free_head, 1);
+
+    return pool;
+}
+
+// 从实例池中获取一个实例（可以在多个线程中同时调用），如果没有空闲的槽位则返回 NULL
+Instance *pool_acquire(InstancePool *pool) {
+    uint64_t head = atomic_load_explicit(&pool->free_head, memory_order_acquire);
+    uint64_t new_head;
+    uint32_t idx;
+
+    // 从空闲链表头部取出一个槽位，如果链表头在此期间被其他线程修改过，则重试
+    do {
+        idx = (uint32_t) head;
+        if (idx == 0) {
+            return NULL;
+        }
+        uint32_t next = atomic_load_explicit(&pool->free_next[idx - 1], memory_order_relaxed);
+        new_head = (((head >> 32) + 1) << 32) | next;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_head, &head, new_head,
+                                                    memory_order_acquire, memory_order_acquire));
+    idx -= 1;
+
+    // 槽位在首次被获取时才初始化，避免创建实例池时就为所有槽位分配物理内存
+    if (!pool->initialized[idx]) {
+        init_slot(pool, idx);
+        pool->initialized[idx] = true;
+    }
+    return &pool->slots[idx];
+}
+
+// 将实例归还到实例池中（可以在多个线程中同时调用），实例会被重置为模板实例的状态
+void pool_release(InstancePool *pool, Instance *inst) {
+    uint32_t idx = (uint32_t) (inst - pool->slots);
+    ASSERT(idx < pool->slot_count, "Instance does not belong to the pool\n")
+
+    // 先重置实例，再将槽位放回空闲链表，这样其他线程获取到该槽位时实例已经是模板实例的状态
+    reset_slot(pool, inst);
+
+    uint64_t head = atomic_load_explicit(&pool->free_head, memory_order_relaxed);
+    uint64_t new_head;
+    do {
+        atomic_store_explicit(&pool->free_next[idx], (uint32_t) head, memory_order_relaxed);
+        new_head = (((head >> 32) + 1) << 32) | (idx + 1);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->free_head, &head, new_head,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+// 释放实例池占用的内存
+void free_pool(InstancePool *pool) {
+    munmap(pool->slots, sizeof(Instance) * pool->slot_count);
+    if (pool->memory_base) {
+        munmap(pool->memory_base, pool->memory_stride * pool->slot_count);
+    }
+    free(pool->table_base);
+    free(pool->globals_base);
+    free(pool->initialized);
+    if (pool->image_fd >= 0) {
+        close(pool->image_fd);
+    }
+    free((void *) pool->free_next);
+    free_instance(pool->template);
+    free(pool);
+}
@@ -0,0 +1,47 @@
+#ifndef WASMC_POOL_H
+#define WASMC_POOL_H
+
+#include "module.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// 实例池结构体
+// 创建实例池时为 slot_count 个实例槽位一次性预留好实例（包括操作数栈、调用栈）、内存和表所需的地址空间，
+// 获取实例时从无锁空闲链表中取出一个槽位，归还实例时只重置实例中可能被修改过的状态，然后放回空闲链表
+typedef struct InstancePool {
+    Module *module;     // 实例池对应的模块
+    Instance *template; // 模板实例，即完成实例化（包括执行起始函数）后的实例，所有槽位都以其为初始状态
+    uint32_t slot_count;// 槽位数量
+
+    Instance *slots;         // 所有槽位的实例（预留的地址空间，使用时才会真正分配物理内存）
+    uint8_t *memory_base;    // 所有槽位的内存（预留的地址空间，每个槽位占 memory_stride 字节）
+    size_t memory_stride;    // 每个槽位预留的内存字节数
+    uint32_t *table_base;    // 所有槽位的表中元素（每个槽位占 module->table.cur_size 个元素）
+    StackValue *globals_base;// 所有槽位的全局变量（每个槽位占 module->global_count 个全局变量）
+    bool *initialized;       // 槽位是否已经以模板实例完成初始化（槽位在首次被获取时才初始化）
+    int image_fd;            // 存储模板实例内存数据的内存文件（memfd），各个槽位以写时复制的方式映射该文件作为内存的初始数据（为 -1 表示不支持）
+
+    // 无锁空闲链表（Treiber stack）
+    // 链表头 free_head 的低 32 位为【槽位索引加 1】（为 0 表示链表为空），高 32 位为版本号，每次修改链表头时加 1，用于避免 ABA 问题
+    _Atomic uint64_t free_head;
+    _Atomic uint32_t *free_next;// 每个槽位在空闲链表中的下一个槽位（同样为【槽位索引加 1】）
+} InstancePool;
+
+// 预留 size 字节的地址空间（不会立即占用物理内存），size 为 0 时返回 NULL
+void *reserve_memory(size_t size, char *name);
+
+// 基于模块创建包含 slot_count 个槽位的实例池
+InstancePool *create_pool(Module *m, uint32_t slot_count);
+
+// 从实例池中获取一个实例（可以在多个线程中同时调用），如果没有空闲的槽位则返回 NULL
+Instance *pool_acquire(InstancePool *pool);
+
+// 将实例归还到实例池中（可以在多个线程中同时调用），实例会被重置为模板实例的状态
+void pool_release(InstancePool *pool, Instance *inst);
+
+// 释放实例池占用的内存
+// 注：释放实例池前需要保证所有实例都已归还
+void free_pool(InstancePool *pool);
+
+#endif
@@ -0,0 +1,197 @@
+#include "profiler.h"
+#include "utils.h"
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+_Thread_local Instance *executing_instance = NULL;
+
+ProfileSample *profile_samples = NULL;   // 样本缓冲区（匿名映射，未写入的部分不占用物理内存）
+_Atomic uint32_t profile_sample_count = 0;// 信号处理函数申请过的样本数量，超过 PROFILE_MAX_SAMPLES 的部分即被丢弃的样本
+_Atomic bool profiler_running = false;   // 采样分析器是否正在运行
+
+// SIGPROF 信号处理函数：将被中断线程正在执行的实例的调用栈记录为一个样本
+// 注：信号处理函数中只读取内存和使用无锁的原子操作，不申请内存也不调用非异步信号安全的函数。
+// 被中断的线程可能正在压入或者弹出栈帧，此时可能读到尚未更新的 csp 或者栈帧，只会使个别样本不准确，
+// 而栈帧中的控制块在模块释放之前始终有效，所以不会访问到非法内存
+void sigprof_handler(int sig) {
+    (void) sig;
+    // 使用 acquire 语义读取运行标记，保证看到该标记时，也一定能看到启动时映射的样本缓冲区和清零的样本数量
+    Instance *inst = executing_instance;
+    if (!inst || !atomic_load_explicit(&profiler_running, memory_order_acquire)) {
+        return;
+    }
+    int csp = *(volatile int *) &inst->csp;
+    if (csp < 0) {
+        return;
+    }
+    if (csp >= CALLSTACK_SIZE) {
+        csp = CALLSTACK_SIZE - 1;
+    }
+
+    uint32_t idx = atomic_fetch_add_explicit(&profile_sample_count, 1, memory_order_relaxed);
+    if (idx >= PROFILE_MAX_SAMPLES) {
+        return;
+    }
+    ProfileSample *sample = &profile_samples[idx];
+
+    // 从最内层的栈帧开始向外收集控制块类型为函数的栈帧，超过 PROFILE_MAX_DEPTH 时丢弃外层的栈帧
+    uint32_t inner[PROFILE_MAX_DEPTH];
+    uint32_t depth = 0;
+    for (int i = csp; i >= 0; i--) {
+        Block *block = *(Block *volatile *) &inst->callstack[i].block;
+        if (!block || block->block_type != 0x00) {
+            continue;
+        }
+        if (depth == PROFILE_MAX_DEPTH) {
+            sample->truncated = true;
+            break;
+        }
+        inner[depth++] = block->fidx;
+    }
+    for (uint32_t i = 0; i < depth; i++) {
+        sample->frames[i] = inner[depth - 1 - i];
+    }
+    sample->module = inst->module;
+    // 最后才设置栈帧数量，写入文件时栈帧数量不为 0 的样本一定已经完整写入
+    atomic_store_explicit(&sample->depth, depth, memory_order_release);
+}
+
+// 启动采样分析器
+// 注：先映射新的样本缓冲区并清零样本数量，最后才设置运行标记，这样信号处理函数看到运行标记时缓冲区一定已经就绪，
+// 不会向旧的（已解除映射的）缓冲区写入样本
+bool start_profiler(uint32_t hz) {
+    if (atomic_load(&profiler_running)) {
+        return false;
+    }
+
+    // 每次启动都重新映射样本缓冲区，即丢弃之前记录的样本
+    size_t size = PROFILE_MAX_SAMPLES * sizeof(ProfileSample);
+    ProfileSample *samples = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (samples == MAP_FAILED) {
+        FATAL("Could not allocate %lu bytes for profile samples\n", size)
+    }
+    if (profile_samples) {
+        munmap(profile_samples, size);
+    }
+    atomic_store(&profile_sample_count, 0);
+    profile_samples = samples;
+
+    // SA_RESTART 使被信号中断的系统调用（例如读取标准输入）自动重新执行
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = sigprof_handler;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, NULL);
+
+    // ITIMER_PROF 按照进程（所有线程）消耗的 CPU 时间计时，空闲时不会产生样本
+    hz = hz ? hz : PROFILE_DEFAULT_HZ;
+    struct itimerval timer;
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = hz > 1000000 ? 1 : 1000000 / hz;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, NULL);
+
+    // 最后才设置运行标记（release 语义），在此之前产生的 SIGPROF 信号会被信号处理函数直接忽略
+    atomic_store_explicit(&profiler_running, true, memory_order_release);
+    return true;
+}
+
+// 停止采样分析器
+// 注：停止计时器之后仍然可能有已经产生但尚未处理的 SIGPROF 信号，所以保留信号处理函数（其默认行为是终止进程），
+// 信号处理函数在采样分析器停止后直接返回
+void stop_profiler(void) {
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    atomic_store(&profiler_running, false);
+}
+
+// 获取函数名：优先使用自定义段 name 中的函数名，其次是导出名，否则为 func[索引]
+const char *profile_function_name(Module *m, uint32_t fidx, char *buf, size_t buf_size) {
+    if (m->function_names && fidx < m->function_count && m->function_names[fidx]) {
+        return m->function_names[fidx];
+    }
+    for (uint32_t e = 0; e < m->export_count; e++) {
+        if (m->exports[e].external_kind == KIND_FUNCTION && m->exports[e].index == fidx) {
+            return m->exports[e].export_name;
+        }
+    }
+    snprintf(buf, buf_size, "func[%u]", fidx);
+    return buf;
+}
+
+// 比较两行折叠栈，用于排序后合并相同的调用栈
+int compare_stack_line(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+// 将记录的样本以折叠栈格式写入 path
+bool write_profile(const char *path) {
+    uint32_t count = atomic_load(&profile_sample_count);
+    uint32_t dropped = count > PROFILE_MAX_SAMPLES ? count - PROFILE_MAX_SAMPLES : 0;
+    count = count > PROFILE_MAX_SAMPLES ? PROFILE_MAX_SAMPLES : count;
+
+    // 将每个样本转换为一行以分号分隔的函数名（函数名中的分号和空白字符会破坏折叠栈格式，替换为下划线）
+    char **lines = acalloc(count ? count : 1, sizeof(char *), "profile lines");
+    uint32_t line_count = 0;
+    char buf[32];
+    for (uint32_t i = 0; i < count; i++) {
+        ProfileSample *sample = &profile_samples[i];
+        uint32_t depth = atomic_load_explicit(&sample->depth, memory_order_acquire);
+        if (depth == 0) {
+            continue;
+        }
+        char *line = NULL;
+        size_t line_size = 0;
+        FILE *out = open_memstream(&line, &line_size);
+        if (sample->truncated) {
+            fputs("[truncated]", out);
+        }
+        for (uint32_t d = 0; d < depth; d++) {
+            if (d > 0 || sample->truncated) {
+                fputc(';', out);
+            }
+            const char *name = profile_function_name(sample->module, sample->frames[d], buf, sizeof(buf));
+            for (const char *c = name; *c; c++) {
+                fputc(*c == ';' || *c == ' ' || *c == '\t' || *c == '\n' ? '_' : *c, out);
+            }
+        }
+        fclose(out);
+        lines[line_count++] = line;
+    }
+    qsort(lines, line_count, sizeof(char *), compare_stack_line);
+
+    FILE *file = fopen(path, "w");
+    bool ok = file != NULL;
+    for (uint32_t i = 0; ok && i < line_count;) {
+        uint32_t j = i + 1;
+        while (j < line_count && strcmp(lines[i], lines[j]) == 0) {
+            j++;
+        }
+        ok = fprintf(file, "%s %u\n", lines[i], j - i) > 0;
+        i = j;
+    }
+    if (file) {
+        ok = fclose(file) == 0 && ok;
+    }
+    if (!ok) {
+        ERROR("Could not write profile file '%s'\n", path)
+    }
+    if (dropped > 0) {
+        ERROR("Profile buffer full, %u samples dropped\n", dropped)
+    }
+
+    for (uint32_t i = 0; i < line_count; i++) {
+        free(lines[i]);
+    }
+    free(lines);
+    return ok;
+}
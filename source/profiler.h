@@ -0,0 +1,37 @@
+#ifndef WASMC_PROFILER_H
+#define WASMC_PROFILER_H
+
+#include "module.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PROFILE_DEFAULT_HZ 997     // 默认的采样频率（使用质数，避免与其他周期性任务同步）
+#define PROFILE_MAX_DEPTH 128      // 每个样本最多记录的函数栈帧数量，超出时只保留最内层的栈帧
+#define PROFILE_MAX_SAMPLES 0x10000// 最多记录的样本数量，超出后的样本被丢弃（只计数）
+
+// 一个样本：采样时刻客户函数的调用栈
+typedef struct ProfileSample {
+    _Atomic uint32_t depth;            // 函数栈帧数量，写完 frames 之后才设置，为 0 表示样本无效或者尚未写完
+    bool truncated;                    // 调用栈是否超过 PROFILE_MAX_DEPTH 而被截断
+    Module *module;                    // 函数所属的模块，用于获取函数名
+    uint32_t frames[PROFILE_MAX_DEPTH];// 函数索引，从最外层（调用栈底）到最内层（当前执行的函数）
+} ProfileSample;
+
+// 当前线程正在执行的实例（只在 invoke 和 resume 执行字节码期间设置），由 SIGPROF 信号处理函数读取
+extern _Thread_local Instance *executing_instance;
+
+// 启动采样分析器：按照进程消耗的 CPU 时间，每秒发送 hz 次 SIGPROF 信号，
+// 信号处理函数读取被中断线程正在执行的实例的调用栈（inst->callstack[0..csp] 中控制块类型为函数的栈帧）并记录为一个样本
+// 注：同一时刻只能有一个采样分析器，已经启动时返回 false；启动和停止需要在同一个线程中调用
+bool start_profiler(uint32_t hz);
+
+// 停止采样分析器（之后不再产生新的样本，已记录的样本保留到下次启动）
+void stop_profiler(void);
+
+// 将记录的样本以折叠栈格式（每行为 以分号分隔的函数名 样本数，例如 main;fib;fib 42）写入 path，可以直接作为 flamegraph.pl 的输入
+// 函数名优先使用自定义段 name 中的函数名，其次是导出名，否则为 func[索引]
+// 注：样本中记录了模块的指针，所以需要在释放模块之前写入
+bool write_profile(const char *path);
+
+#endif
@@ -0,0 +1,531 @@
+#include "scheduler.h"
+#include "interpreter.h"
+#include "module.h"
+#include "utils.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// 工作线程自身从底部压入任务，队列已满时返回 false
+bool deque_push(WorkDeque *q, Job *job) {
+    int64_t b = atomic_load(&q->bottom);
+    int64_t t = atomic_load(&q->top);
+    if (b - t >= DEQUE_CAPACITY) {
+        return false;
+    }
+    atomic_store(&q->buffer[b & (DEQUE_CAPACITY - 1)], job);
+    atomic_store(&q->bottom, b + 1);
+    return true;
+}
+
+// 工作线程自身从底部弹出任务，队列为空时返回 NULL
+Job *deque_pop(WorkDeque *q) {
+    int64_t b = atomic_load(&q->bottom) - 1;
+    atomic_store(&q->bottom, b);
+    int64_t t = atomic_load(&q->top);
+    if (t > b) {
+        atomic_store(&q->bottom, b + 1);
+        return NULL;
+    }
+    Job *job = atomic_load(&q->buffer[b & (DEQUE_CAPACITY - 1)]);
+    if (t == b) {
+        // 只剩最后一个任务时，需要与窃取任务的线程竞争
+        if (!atomic_compare_exchange_strong(&q->top, &t, t + 1)) {
+            job = NULL;
+        }
+        atomic_store(&q->bottom, b + 1);
+    }
+    return job;
+}
+
+// 其他工作线程从顶部窃取任务，队列为空或者竞争失败时返回 NULL
+Job *deque_steal(WorkDeque *q) {
+    int64_t t = atomic_load(&q->top);
+    int64_t b = atomic_load(&q->bottom);
+    if (t >= b) {
+        return NULL;
+    }
+    Job *job = atomic_load(&q->buffer[t & (DEQUE_CAPACITY - 1)]);
+    if (!atomic_compare_exchange_strong(&q->top, &t, t + 1)) {
+        return NULL;
+    }
+    return job;
+}
+
+// 通知空闲的工作线程有新任务
+void notify_work(Scheduler *s) {
+    pthread_mutex_lock(&s->lock);
+    s->work_seq++;
+    if (s->idle_count > 0) {
+        pthread_cond_broadcast(&s->work_cond);
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+// 将任务链表（从 head 到 tail，共 count 个任务）追加到工作线程的收件箱末尾
+void inbox_append(Worker *w, Job *head, Job *tail, uint32_t count) {
+    pthread_mutex_lock(&w->inbox_lock);
+    if (w->inbox_tail) {
+        w->inbox_tail->next = head;
+    } else {
+        w->inbox_head = head;
+    }
+    w->inbox_tail = tail;
+    atomic_fetch_add(&w->inbox_count, count);
+    pthread_mutex_unlock(&w->inbox_lock);
+}
+
+// 从工作线程的收件箱头部取出一个任务，收件箱为空时返回 NULL
+Job *inbox_take(Worker *w) {
+    if (atomic_load_explicit(&w->inbox_count, memory_order_relaxed) == 0) {
+        return NULL;
+    }
+    pthread_mutex_lock(&w->inbox_lock);
+    Job *job = w->inbox_head;
+    if (job) {
+        w->inbox_head = job->next;
+        if (!w->inbox_head) {
+            w->inbox_tail = NULL;
+        }
+        job->next = NULL;
+        atomic_fetch_sub(&w->inbox_count, 1);
+    }
+    pthread_mutex_unlock(&w->inbox_lock);
+    return job;
+}
+
+// 将任务转交给工作线程 w（任务的实例正在 w 上执行）
+void park_job(Worker *w, Job *job) {
+    pthread_mutex_lock(&w->inbox_lock);
+    job->next = w->parked;
+    w->parked = job;
+    pthread_mutex_unlock(&w->inbox_lock);
+}
+
+// 取出转交给工作线程 w 的所有任务
+Job *take_parked(Worker *w) {
+    pthread_mutex_lock(&w->inbox_lock);
+    Job *jobs = w->parked;
+    w->parked = NULL;
+    pthread_mutex_unlock(&w->inbox_lock);
+    return jobs;
+}
+
+// 为工作线程查找下一个要执行的任务，依次尝试：
+// 1. 从自身的任务双端队列底部弹出
+// 2. 将转交给自身的任务以及自身收件箱中的任务移入任务双端队列后再弹出
+// 3. 从其他工作线程的任务双端队列顶部窃取，或者从其收件箱中取出
+Job *find_job(Worker *w) {
+    Scheduler *s = w->scheduler;
+
+    Job *job = deque_pop(&w->deque);
+    if (job) {
+        return job;
+    }
+
+    // 转交过来的任务优先执行，任务双端队列已满时（极少发生）放回收件箱
+    Job *parked = take_parked(w);
+    while (parked) {
+        Job *next = parked->next;
+        parked->next = NULL;
+        if (!deque_push(&w->deque, parked)) {
+            inbox_append(w, parked, parked, 1);
+        }
+        parked = next;
+    }
+
+    // 收件箱中的任务按照先进先出的顺序移入任务双端队列，任务双端队列已满时剩余的任务继续留在收件箱中
+    while ((job = inbox_take(w))) {
+        if (!deque_push(&w->deque, job)) {
+            return job;
+        }
+    }
+    job = deque_pop(&w->deque);
+    if (job) {
+        return job;
+    }
+
+    // 从随机的工作线程开始依次尝试窃取任务，避免所有空闲的工作线程都从同一个工作线程窃取
+    w->rand ^= w->rand << 13;
+    w->rand ^= w->rand >> 7;
+    w->rand ^= w->rand << 17;
+    uint32_t start = (uint32_t) (w->rand % s->worker_count);
+    for (uint32_t k = 0; k < s->worker_count; k++) {
+        Worker *victim = &s->workers[(start + k) % s->worker_count];
+        if (victim == w) {
+            continue;
+        }
+        if ((job = deque_steal(&victim->deque)) || (job = inbox_take(victim))) {
+            return job;
+        }
+    }
+    return NULL;
+}
+
+// 任务完成：调用回调函数，设置完成状态，并通知等待的线程
+void complete_job(Scheduler *s, Job *job) {
+    if (job->callback) {
+        job->callback(job, job->data);
+    }
+    atomic_store(&job->done, true);
+    atomic_fetch_sub(&s->pending, 1);
+    if (atomic_load(&s->waiters) > 0) {
+        pthread_mutex_lock(&s->lock);
+        pthread_cond_broadcast(&s->done_cond);
+        pthread_mutex_unlock(&s->lock);
+    }
+}
+
+// 将暂存的任务重新移入任务双端队列，任务双端队列已满时（极少发生）放回收件箱
+void release_deferred(Worker *w) {
+    Job *job = w->deferred;
+    w->deferred = NULL;
+    while (job) {
+        Job *next = job->next;
+        job->next = NULL;
+        if (!deque_push(&w->deque, job)) {
+            inbox_append(w, job, job, 1);
+        }
+        job = next;
+    }
+}
+
+// 在工作线程上执行任务
+void run_job(Worker *w, Job *job) {
+    Scheduler *s = w->scheduler;
+    Instance *inst = job->inst;
+    Module *m = inst->module;
+    ExecStatus status;
+
+    if (job->started) {
+        // 暂停的任务继续执行：暂停期间实例仍由暂停时的工作线程持有，所以只能由该工作线程继续执行（被其他工作线程窃取时转交回去）
+        uint32_t running = atomic_load(&inst->running_worker);
+        if (running != w->id + 1) {
+            park_job(&s->workers[running - 1], job);
+            notify_work(s);
+            return;
+        }
+        status = resume(inst);
+    } else {
+        // 同一时刻一个实例只能在一个工作线程上执行，如果实例正在其他工作线程上执行，则将任务转交给该工作线程，
+        // 其执行完当前任务后会取出该任务（实例在此期间恰好执行完成时，同样由该工作线程执行，同时保持了亲和性）
+        uint32_t running = 0;
+        if (!atomic_compare_exchange_strong(&inst->running_worker, &running, w->id + 1)) {
+            // 实例由当前工作线程持有时，说明实例上的任务正在等待异步 I/O，暂存该任务直到实例被释放
+            if (running == w->id + 1) {
+                job->next = w->deferred;
+                w->deferred = job;
+                return;
+            }
+            park_job(&s->workers[running - 1], job);
+            notify_work(s);
+            return;
+        }
+        atomic_store_explicit(&inst->home_worker, w->id + 1, memory_order_relaxed);
+
+        // 检查导出函数及其参数，并将参数压入操作数栈
+        inst->sp = -1;
+        inst->fp = -1;
+        inst->csp = -1;
+        if (job->handle >= m->export_count || m->exports[job->handle].external_kind != KIND_FUNCTION) {
+            snprintf(inst->exception, EXCEPTION_SIZE, "export handle %u is not a function", job->handle);
+            inst->trap = TRAP_ERROR;
+            status = EXEC_TRAP;
+        } else if (m->functions[m->exports[job->handle].index].type->param_count != job->arg_count) {
+            snprintf(inst->exception, EXCEPTION_SIZE, "expected %u arguments, got %u",
+                     m->functions[m->exports[job->handle].index].type->param_count, job->arg_count);
+            inst->trap = TRAP_ERROR;
+            status = EXEC_TRAP;
+        } else {
+            Type *type = m->functions[m->exports[job->handle].index].type;
+            for (uint32_t i = 0; i < job->arg_count; i++) {
+                inst->stack[++inst->sp] = job->args[i];
+                inst->stack[inst->sp].value_type = type->params[i];
+            }
+
+            job->started = true;
+            inst->aio = s->ring ? &job->request : NULL;
+            status = invoke_resumable(inst, job->handle);
+        }
+    }
+
+    if (status == EXEC_SUSPENDED) {
+        switch (inst->trap) {
+            case TRAP_WAIT_IO:
+                // 实例继续由当前工作线程持有，请求完成后由完成线程将任务交还给当前工作线程
+                // 注：加入提交队列后请求随时可能完成，此后不能再访问任务和实例
+                if (io_ring_queue(s->ring, &job->request, (uint64_t) (uintptr_t) job)) {
+                    return;
+                }
+                // 提交队列已满时同步执行请求，覆盖占位的返回值后继续执行
+                inst->stack[inst->sp].value.int32 = aio_execute(&job->request);
+                if (!deque_push(&w->deque, job)) {
+                    inbox_append(w, job, job, 1);
+                }
+                return;
+            case TRAP_YIELD:
+                // 宿主函数请求让出执行，将任务放到收件箱末尾，等已有的任务执行后再继续执行
+                inbox_append(w, job, job, 1);
+                return;
+            default:
+                // 调度器不会补充燃料或者延长截止纪元，视为执行失败
+                break;
+        }
+    }
+
+    job->ok = status == EXEC_DONE;
+    if (job->ok) {
+        job->result_count = inst->sp >= 0 ? 1 : 0;
+        if (job->result_count) {
+            job->result = inst->stack[inst->sp];
+        }
+    } else {
+        // 任务中只保存异常信息的前 JOB_EXCEPTION_SIZE - 1 个字符，显式指定精度表明截断是预期的行为
+        snprintf(job->exception, JOB_EXCEPTION_SIZE, "%.*s", JOB_EXCEPTION_SIZE - 1, inst->exception);
+    }
+
+    inst->aio = NULL;
+    atomic_store(&inst->running_worker, 0);
+    complete_job(s, job);
+
+    // 实例已经释放，暂存的任务可以重新尝试执行
+    if (w->deferred) {
+        release_deferred(w);
+    }
+}
+
+// 工作线程主函数
+void *worker_main(void *arg) {
+    Worker *w = arg;
+    Scheduler *s = w->scheduler;
+
+    while (true) {
+        Job *job = find_job(w);
+        if (!job) {
+            // 先记录当前的任务序号再查找一次，如果此后有新任务，任务序号一定会变化，因此不会错过通知
+            pthread_mutex_lock(&s->lock);
+            uint64_t seq = s->work_seq;
+            IoRing *ring = s->ring;
+            pthread_mutex_unlock(&s->lock);
+
+            // 空闲前提交其他工作线程累积的请求，避免请求滞留在提交队列中
+            if (ring) {
+                io_ring_submit(ring);
+            }
+
+            job = find_job(w);
+            if (!job) {
+                pthread_mutex_lock(&s->lock);
+                while (s->work_seq == seq && !s->stop) {
+                    s->idle_count++;
+                    pthread_cond_wait(&s->work_cond, &s->lock);
+                    s->idle_count--;
+                }
+                bool stop = s->stop;
+                pthread_mutex_unlock(&s->lock);
+                if (stop) {
+                    break;
+                }
+                continue;
+            }
+        }
+        run_job(w, job);
+
+        // 暂停的请求先累积在提交队列中，累积足够多或者任务双端队列已空时再一次性提交给内核
+        if (s->ring && (atomic_load_explicit(&s->ring->queued, memory_order_relaxed) >= AIO_SUBMIT_BATCH ||
+                        atomic_load(&w->deque.bottom) <= atomic_load(&w->deque.top))) {
+            io_ring_submit(s->ring);
+        }
+    }
+    return NULL;
+}
+
+// 处理完成的请求：用请求的结果覆盖宿主函数压入的占位返回值，再将任务交给持有实例的工作线程继续执行
+void handle_io_completion(uint64_t user_data, int32_t res, void *arg) {
+    Scheduler *s = arg;
+    if (user_data == 0) {
+        s->io_stop = true;
+        return;
+    }
+
+    Job *job = (Job *) (uintptr_t) user_data;
+    Instance *inst = job->inst;
+    inst->stack[inst->sp].value.int32 = res;
+
+    Worker *owner = &s->workers[atomic_load(&inst->running_worker) - 1];
+    inbox_append(owner, job, job, 1);
+    notify_work(s);
+}
+
+// 完成线程主函数
+void *io_main(void *arg) {
+    Scheduler *s = arg;
+    while (!s->io_stop) {
+        io_ring_wait(s->ring, handle_io_completion, s);
+    }
+    return NULL;
+}
+
+// 为调度器启用异步 I/O
+bool scheduler_enable_aio(Scheduler *s) {
+    if (s->ring) {
+        return true;
+    }
+    IoRing *ring = create_io_ring(AIO_QUEUE_DEPTH);
+    if (!ring) {
+        return false;
+    }
+
+    // 工作线程已经启动，所以需要在锁内设置，此后提交的任务在执行时都能看到 io_uring
+    pthread_mutex_lock(&s->lock);
+    s->ring = ring;
+    pthread_mutex_unlock(&s->lock);
+
+    if (pthread_create(&s->io_thread, NULL, io_main, s) != 0) {
+        FATAL("Could not create io completion thread\n")
+    }
+    return true;
+}
+
+// 创建包含 worker_count 个工作线程的调度器，worker_count 为 0 时使用 CPU 核数
+Scheduler *create_scheduler(uint32_t worker_count) {
+    if (worker_count == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        worker_count = cpus > 0 ? (uint32_t) cpus : 1;
+    }
+
+    Scheduler *s = acalloc(1, sizeof(Scheduler), "Scheduler");
+    s->worker_count = worker_count;
+    s->workers = acalloc(worker_count, sizeof(Worker), "Worker");
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->work_cond, NULL);
+    pthread_cond_init(&s->done_cond, NULL);
+
+    for (uint32_t i = 0; i < worker_count; i++) {
+        Worker *w = &s->workers[i];
+        w->scheduler = s;
+        w->id = i;
+        w->rand = 0x9e3779b97f4a7c15ULL * (i + 1);
+        pthread_mutex_init(&w->inbox_lock, NULL);
+    }
+    for (uint32_t i = 0; i < worker_count; i++) {
+        if (pthread_create(&s->workers[i].thread, NULL, worker_main, &s->workers[i]) != 0) {
+            FATAL("Could not create worker thread %u\n", i)
+        }
+    }
+    return s;
+}
+
+// 批量提交 count 个任务
+void scheduler_submit(Scheduler *s, Job *jobs, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    // 先按照目标工作线程将任务分组，再将每组任务一次性追加到对应的收件箱中，减少加锁次数
+    Job **heads = acalloc(s->worker_count, sizeof(Job *), "Job heads");
+    Job **tails = acalloc(s->worker_count, sizeof(Job *), "Job tails");
+    uint32_t *counts = acalloc(s->worker_count, sizeof(uint32_t), "Job counts");
+
+    atomic_fetch_add(&s->pending, count);
+    for (uint32_t i = 0; i < count; i++) {
+        Job *job = &jobs[i];
+        job->ok = false;
+        job->result_count = 0;
+        job->exception[0] = '\0';
+        job->started = false;
+        job->next = NULL;
+        atomic_store_explicit(&job->done, false, memory_order_relaxed);
+
+        // 任务交给实例最近所在的工作线程，尚未执行过任务的实例轮流分配一个工作线程
+        uint32_t home = atomic_load_explicit(&job->inst->home_worker, memory_order_relaxed);
+        if (home == 0) {
+            uint32_t pick = atomic_fetch_add(&s->next_worker, 1) % s->worker_count + 1;
+            if (atomic_compare_exchange_strong(&job->inst->home_worker, &home, pick)) {
+                home = pick;
+            }
+        }
+        uint32_t target = (home - 1) % s->worker_count;
+
+        if (tails[target]) {
+            tails[target]->next = job;
+        } else {
+            heads[target] = job;
+        }
+        tails[target] = job;
+        counts[target]++;
+    }
+
+    for (uint32_t i = 0; i < s->worker_count; i++) {
+        if (heads[i]) {
+            inbox_append(&s->workers[i], heads[i], tails[i], counts[i]);
+        }
+    }
+    notify_work(s);
+
+    free(heads);
+    free(tails);
+    free(counts);
+}
+
+// 等待任务完成（即 future），返回任务是否成功执行
+bool job_wait(Scheduler *s, Job *job) {
+    if (!atomic_load(&job->done)) {
+        atomic_fetch_add(&s->waiters, 1);
+        pthread_mutex_lock(&s->lock);
+        while (!atomic_load(&job->done)) {
+            pthread_cond_wait(&s->done_cond, &s->lock);
+        }
+        pthread_mutex_unlock(&s->lock);
+        atomic_fetch_sub(&s->waiters, 1);
+    }
+    return job->ok;
+}
+
+// 等待所有已提交的任务完成
+void scheduler_wait_all(Scheduler *s) {
+    if (atomic_load(&s->pending) > 0) {
+        atomic_fetch_add(&s->waiters, 1);
+        pthread_mutex_lock(&s->lock);
+        while (atomic_load(&s->pending) > 0) {
+            pthread_cond_wait(&s->done_cond, &s->lock);
+        }
+        pthread_mutex_unlock(&s->lock);
+        atomic_fetch_sub(&s->waiters, 1);
+    }
+}
+
+// 停止所有工作线程并释放调度器占用的内存
+void free_scheduler(Scheduler *s) {
+    pthread_mutex_lock(&s->lock);
+    s->stop = true;
+    pthread_cond_broadcast(&s->work_cond);
+    pthread_mutex_unlock(&s->lock);
+
+    for (uint32_t i = 0; i < s->worker_count; i++) {
+        pthread_join(s->workers[i].thread, NULL);
+        pthread_mutex_destroy(&s->workers[i].inbox_lock);
+    }
+
+    // 提交一个 user_data 为 0 的空操作，完成线程收到后退出
+    if (s->ring) {
+        AioRequest nop = {.opcode = IORING_OP_NOP};
+        while (!io_ring_queue(s->ring, &nop, 0)) {
+            io_ring_submit(s->ring);
+        }
+        io_ring_submit(s->ring);
+        pthread_join(s->io_thread, NULL);
+        free_io_ring(s->ring);
+    }
+
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->work_cond);
+    pthread_cond_destroy(&s->done_cond);
+    free(s->workers);
+    free(s);
+}
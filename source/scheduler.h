@@ -0,0 +1,123 @@
+#ifndef WASMC_SCHEDULER_H
+#define WASMC_SCHEDULER_H
+
+#include "aio.h"
+#include "module.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DEQUE_CAPACITY 0x1000   // 每个工作线程的任务双端队列的容量 4096（必须为 2 的幂），超出的任务暂存在收件箱中
+#define JOB_EXCEPTION_SIZE 0x100// 任务中保存的异常信息的最大长度 256
+
+struct Job;
+
+// 任务完成时的回调函数，在执行任务的工作线程中调用
+typedef void (*JobCallback)(struct Job *job, void *data);
+
+// 调用任务，即在实例 inst 上调用句柄为 handle 的导出函数
+// 提交任务前由调用方填写【输入】部分，任务完成后由调度器填写【结果】部分
+typedef struct Job {
+    // 输入
+    Instance *inst;      // 执行任务的实例
+    uint32_t handle;     // 导出函数的句柄（可以通过 resolve_export 函数获取）
+    StackValue *args;    // 函数参数（在任务完成前需要保持有效）
+    uint32_t arg_count;  // 函数参数的数量
+    JobCallback callback;// 任务完成时的回调函数（可以为 NULL）
+    void *data;          // 传给回调函数的参数
+
+    // 结果
+    bool ok;                           // 函数是否成功执行
+    uint32_t result_count;             // 返回值的数量（0 或 1）
+    StackValue result;                 // 返回值
+    char exception[JOB_EXCEPTION_SIZE];// 执行失败时的异常信息
+    _Atomic bool done;                 // 任务是否已经完成（即 future 的状态）
+
+    // 执行状态
+    bool started;      // 任务是否已经开始执行（因等待异步 I/O 或者让出执行而暂停的任务继续执行时不需要重新压入参数）
+    AioRequest request;// 异步宿主函数记录的 I/O 请求
+
+    struct Job *next;// 任务在收件箱中的下一个任务
+} Job;
+
+// 工作线程的任务双端队列（Chase-Lev deque）
+// 工作线程自身从底部压入和弹出任务（后进先出，缓存更友好），其他工作线程从顶部窃取任务（先进先出，窃取最早的任务）
+typedef struct WorkDeque {
+    _Atomic int64_t top;                  // 队列顶部，窃取任务时加 1
+    _Atomic int64_t bottom;               // 队列底部，压入任务时加 1，弹出任务时减 1
+    _Atomic(Job *) buffer[DEQUE_CAPACITY];// 环形缓冲区
+} WorkDeque;
+
+// 工作线程
+typedef struct Worker {
+    struct Scheduler *scheduler;// 工作线程所属的调度器
+    uint32_t id;                // 工作线程编号
+    pthread_t thread;           // 线程
+    WorkDeque deque;            // 任务双端队列（只有工作线程自身可以压入和弹出）
+
+    // 收件箱：其他线程（提交任务的线程、以及需要将任务转交给该工作线程的工作线程）无法直接压入任务双端队列，
+    // 只能将任务放入收件箱，工作线程再将收件箱中的任务移入自身的任务双端队列
+    pthread_mutex_t inbox_lock;
+    Job *inbox_head;
+    Job *inbox_tail;
+    _Atomic uint32_t inbox_count;
+
+    // 转交给该工作线程的任务（其实例正在该工作线程上执行），由 inbox_lock 保护
+    // 与收件箱不同，这些任务不能被其他工作线程窃取，否则在实例执行完成前任务会在工作线程之间反复转交
+    Job *parked;
+
+    // 暂存的任务：其实例上的任务因等待异步 I/O 而暂停，但实例仍由该工作线程持有（只有工作线程自身可以访问）
+    // 该工作线程每执行完一个任务（即释放一个实例）后，再将这些任务重新移入任务双端队列
+    Job *deferred;
+
+    uint64_t rand;// 选择窃取对象时使用的随机数状态
+} Worker;
+
+// 工作窃取调度器
+// 任务按照实例分配给工作线程：同一实例上的任务总是优先交给最近执行过该实例的工作线程（亲和性），
+// 空闲的工作线程会从其他工作线程的任务双端队列中窃取任务，因此任务执行时间相差很大时负载依然均衡；
+// 同一实例上的任务不保证执行顺序，但保证串行执行（同一时刻一个实例只会在一个工作线程上执行）
+typedef struct Scheduler {
+    Worker *workers;             // 所有工作线程
+    uint32_t worker_count;       // 工作线程数量
+    _Atomic uint32_t next_worker;// 为尚未执行过任务的实例轮流选择工作线程
+
+    pthread_mutex_t lock;     // 用于空闲的工作线程等待新任务，以及等待任务完成
+    pthread_cond_t work_cond; // 有新任务时通知空闲的工作线程
+    pthread_cond_t done_cond; // 有任务完成时通知等待的线程
+    uint64_t work_seq;        // 每次有新任务时加 1（由 lock 保护），用于避免空闲的工作线程错过通知
+    uint32_t idle_count;      // 正在等待新任务的工作线程数量（由 lock 保护）
+    _Atomic uint32_t waiters; // 正在等待任务完成的线程数量
+    _Atomic uint64_t pending; // 已提交但尚未完成的任务数量
+    bool stop;                // 是否需要停止所有工作线程（由 lock 保护）
+
+    // 异步 I/O（具体可查看 scheduler_enable_aio 函数）
+    IoRing *ring;       // 所有工作线程共享的 io_uring，为 NULL 表示没有启用异步 I/O
+    pthread_t io_thread;// 完成线程，统一收取完成的请求并恢复对应的任务
+    bool io_stop;       // 是否需要停止完成线程（只由完成线程访问）
+} Scheduler;
+
+// 创建包含 worker_count 个工作线程的调度器，worker_count 为 0 时使用 CPU 核数
+Scheduler *create_scheduler(uint32_t worker_count);
+
+// 为调度器启用异步 I/O，内核不支持 io_uring 时返回 false（此时异步宿主函数同步执行）
+// 启用后，实例调用 aio 模块的宿主函数（具体可查看 register_aio_imports 函数）时暂停执行，工作线程转而执行其他任务，
+// 各个工作线程暂停的请求累积后一次性提交给内核，完成线程收取完成的请求并将任务交还给持有实例的工作线程继续执行
+// 注：需要在提交任务前调用
+bool scheduler_enable_aio(Scheduler *s);
+
+// 批量提交 count 个任务（可以在多个线程中同时调用），提交后任务的结果部分会被重置
+void scheduler_submit(Scheduler *s, Job *jobs, uint32_t count);
+
+// 等待任务完成（即 future），返回任务是否成功执行
+bool job_wait(Scheduler *s, Job *job);
+
+// 等待所有已提交的任务完成
+void scheduler_wait_all(Scheduler *s);
+
+// 停止所有工作线程并释放调度器占用的内存
+// 注：释放前需要保证所有已提交的任务都已完成
+void free_scheduler(Scheduler *s);
+
+#endif
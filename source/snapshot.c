@@ -0,0 +1,291 @@
+#include "snapshot.h"
+#include "module.h"
+#include "opcode.h"
+#include "utils.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 向缓冲区末尾追加 size 字节的数据
+void buffer_write(ByteBuffer *buf, const void *data, size_t size) {
+    if (buf->size + size > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity : 0x1000;
+        while (buf->size + size > capacity) {
+            capacity *= 2;
+        }
+        buf->data = arecalloc(buf->data, buf->capacity, capacity, sizeof(uint8_t), "ByteBuffer");
+        buf->capacity = capacity;
+    }
+    memcpy(buf->data + buf->size, data, size);
+    buf->size += size;
+}
+
+// 向缓冲区末尾追加单个字节
+void buffer_write_byte(ByteBuffer *buf, uint8_t byte) {
+    buffer_write(buf, &byte, 1);
+}
+
+// 以无符号整数的 LEB128 编码向缓冲区末尾追加整数 value（编码格式可查看 utils.c 中 read_LEB 函数的注释）
+void buffer_write_LEB_unsigned(ByteBuffer *buf, uint64_t value) {
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        if (value != 0) {
+            byte |= 0x80;
+        }
+        buffer_write_byte(buf, byte);
+    } while (value != 0);
+}
+
+// 以有符号整数的 LEB128 编码向缓冲区末尾追加整数 value
+void buffer_write_LEB_signed(ByteBuffer *buf, int64_t value) {
+    bool more = true;
+    while (more) {
+        uint8_t byte = value & 0x7f;
+        // 注：有符号整数右移为算术右移，即高位补符号位
+        value >>= 7;
+        // 剩余的位全部与符号位相同，且当前字节的第二高位（即符号位）也与之相同时，则无需后续字节
+        if ((value == 0 && (byte & 0x40) == 0) || (value == -1 && (byte & 0x40) != 0)) {
+            more = false;
+        } else {
+            byte |= 0x80;
+        }
+        buffer_write_byte(buf, byte);
+    }
+}
+
+// 向缓冲区末尾追加一个段：段 ID、段的字节数以及段的内容 payload
+void buffer_write_section(ByteBuffer *buf, uint8_t id, ByteBuffer *payload) {
+    buffer_write_byte(buf, id);
+    buffer_write_LEB_unsigned(buf, payload->size);
+    buffer_write(buf, payload->data, payload->size);
+    payload->size = 0;
+}
+
+// 以常量指令的形式写入初始化表达式，表达式的值为 value
+void write_const_expr(ByteBuffer *buf, StackValue *value) {
+    switch (value->value_type) {
+        case I32:
+            buffer_write_byte(buf, I32Const);
+            buffer_write_LEB_signed(buf, value->value.int32);
+            break;
+        case I64:
+            buffer_write_byte(buf, I64Const);
+            buffer_write_LEB_signed(buf, value->value.int64);
+            break;
+        case F32:
+            buffer_write_byte(buf, F32Const);
+            buffer_write(buf, &value->value.f32, 4);
+            break;
+        case F64:
+            buffer_write_byte(buf, F64Const);
+            buffer_write(buf, &value->value.f64, 8);
+            break;
+        default:
+            FATAL("Global type 0x%x unsupported\n", value->value_type)
+    }
+    buffer_write_byte(buf, End_);
+}
+
+// 生成全局段：模块内定义的全局变量的初始化表达式替换为实例中全局变量的当前值
+void write_global_section(ByteBuffer *payload, Instance *inst) {
+    Module *m = inst->module;
+
+    // 导入的全局变量在全局变量的前部分，只需写入模块内定义的全局变量
+    uint32_t first = 0;
+    while (first < m->global_count && m->globals[first].import_value) {
+        first++;
+    }
+
+    buffer_write_LEB_unsigned(payload, m->global_count - first);
+    for (uint32_t g = first; g < m->global_count; g++) {
+        buffer_write_byte(payload, m->globals[g].value_type);
+        buffer_write_byte(payload, m->globals[g].mutability);
+        write_const_expr(payload, &inst->globals[g]);
+    }
+}
+
+// 生成元素段：只包含一个元素项，从偏移量 0 开始覆盖整张表
+void write_elem_section(ByteBuffer *payload, Instance *inst) {
+    buffer_write_LEB_unsigned(payload, 1);
+    // 表索引
+    buffer_write_LEB_unsigned(payload, 0);
+    // 表内偏移量
+    buffer_write_byte(payload, I32Const);
+    buffer_write_LEB_signed(payload, 0);
+    buffer_write_byte(payload, End_);
+    // 函数索引列表
+    buffer_write_LEB_unsigned(payload, inst->table.cur_size);
+    for (uint32_t n = 0; n < inst->table.cur_size; n++) {
+        buffer_write_LEB_unsigned(payload, inst->table.entries[n]);
+    }
+}
+
+// 生成数据段：内存中每段连续的非 0 数据生成一个数据项，全为 0 的部分无需写入
+void write_data_section(ByteBuffer *payload, Instance *inst) {
+    const uint8_t *bytes = inst->memory.bytes;
+    size_t size = (size_t) inst->memory.cur_size * PAGE_SIZE;
+    ByteBuffer segments = {0};
+    uint32_t count = 0;
+    size_t pos = 0;
+
+    while (pos < size) {
+        // 跳过连续的 0 字节
+        while (pos < size && bytes[pos] == 0) {
+            pos++;
+        }
+        if (pos == size) {
+            break;
+        }
+
+        // 找到非 0 数据的结尾，连续 0 字节少于 SNAPSHOT_ZERO_GAP 时不拆分数据项
+        size_t start = pos, end = pos, zeros = 0;
+        while (pos < size && zeros < SNAPSHOT_ZERO_GAP) {
+            if (bytes[pos] == 0) {
+                zeros++;
+            } else {
+                zeros = 0;
+                end = pos + 1;
+            }
+            pos++;
+        }
+
+        // 内存索引、内存偏移量以及初始化数据
+        buffer_write_LEB_unsigned(&segments, 0);
+        buffer_write_byte(&segments, I32Const);
+        buffer_write_LEB_signed(&segments, (int32_t) start);
+        buffer_write_byte(&segments, End_);
+        buffer_write_LEB_unsigned(&segments, end - start);
+        buffer_write(&segments, bytes + start, end - start);
+        count++;
+    }
+
+    buffer_write_LEB_unsigned(payload, count);
+    if (segments.size > 0) {
+        buffer_write(payload, segments.data, segments.size);
+    }
+    free(segments.data);
+}
+
+// 生成内存段：内存的最小页数替换为实例中内存的当前页数，最大页数保持不变
+void write_memory_section(ByteBuffer *payload, Instance *inst, uint32_t pos) {
+    const uint8_t *bytes = inst->module->bytes;
+
+    // 读取原内存段中的内存数量（只能为 1）、标记位、最小页数以及最大页数
+    read_LEB_unsigned(bytes, &pos, 32);
+    uint32_t flags = read_LEB_unsigned(bytes, &pos, 32);
+    read_LEB_unsigned(bytes, &pos, 32);
+
+    buffer_write_LEB_unsigned(payload, 1);
+    buffer_write_LEB_unsigned(payload, flags);
+    buffer_write_LEB_unsigned(payload, inst->memory.cur_size);
+    if (flags & 0x1) {
+        buffer_write_LEB_unsigned(payload, read_LEB_unsigned(bytes, &pos, 32));
+    }
+}
+
+// 在原 Wasm 二进制文件中 ID 小于 next_id 的段都已写入后，补充写入原文件中不存在的元素段和数据段
+void write_pending_sections(ByteBuffer *out, ByteBuffer *payload, Instance *inst, uint32_t next_id,
+                            bool *elem_written, bool *data_written) {
+    Module *m = inst->module;
+
+    if (!*elem_written && next_id > ElemID) {
+        *elem_written = true;
+        if (!m->import_table && inst->table.cur_size > 0) {
+            write_elem_section(payload, inst);
+            buffer_write_section(out, ElemID, payload);
+        }
+    }
+    if (!*data_written && next_id > DataID) {
+        *data_written = true;
+        if (!m->import_memory && inst->memory.cur_size > 0) {
+            write_data_section(payload, inst);
+            buffer_write_section(out, DataID, payload);
+        }
+    }
+}
+
+// 将已完成实例化（包括执行起始函数）的实例 inst 的状态写入新的 Wasm 二进制文件 path（即预初始化快照）
+bool write_preinit_snapshot(Instance *inst, const char *path) {
+    Module *m = inst->module;
+    const uint8_t *bytes = m->bytes;
+    ByteBuffer out = {0}, payload = {0};
+    bool elem_written = false, data_written = false;
+
+    // 魔数和版本号保持不变
+    buffer_write(&out, bytes, 8);
+
+    uint32_t pos = 8;
+    while (pos < m->byte_count) {
+        uint32_t section_start = pos;
+        uint32_t id = read_LEB_unsigned(bytes, &pos, 7);
+        uint32_t slen = read_LEB_unsigned(bytes, &pos, 32);
+        uint32_t start_pos = pos;
+        pos = start_pos + slen;
+
+        // 自定义段可以出现在任意位置，其余段需要按照 ID 递增的顺序写入
+        if (id != CustomID) {
+            write_pending_sections(&out, &payload, inst, id, &elem_written, &data_written);
+        }
+
+        switch (id) {
+            case MemID:
+                if (!m->import_memory) {
+                    write_memory_section(&payload, inst, start_pos);
+                    buffer_write_section(&out, MemID, &payload);
+                    continue;
+                }
+                break;
+            case GlobalID:
+                write_global_section(&payload, inst);
+                buffer_write_section(&out, GlobalID, &payload);
+                continue;
+            case StartID:
+                // 起始函数已经执行过，无需再写入起始段
+                continue;
+            case ElemID:
+                // 表是从外部模块导入时保留原元素段，否则写入实例中表的当前数据
+                elem_written = true;
+                if (!m->import_table) {
+                    if (inst->table.cur_size > 0) {
+                        write_elem_section(&payload, inst);
+                        buffer_write_section(&out, ElemID, &payload);
+                    }
+                    continue;
+                }
+                break;
+            case DataID:
+                // 内存是从外部模块导入时保留原数据段，否则写入实例中内存的当前数据
+                data_written = true;
+                if (!m->import_memory) {
+                    if (inst->memory.cur_size > 0) {
+                        write_data_section(&payload, inst);
+                        buffer_write_section(&out, DataID, &payload);
+                    }
+                    continue;
+                }
+                break;
+            default:
+                break;
+        }
+
+        // 其余段原样写入
+        buffer_write(&out, bytes + section_start, pos - section_start);
+    }
+    write_pending_sections(&out, &payload, inst, DataID + 1, &elem_written, &data_written);
+
+    FILE *file = fopen(path, "wb");
+    bool ok = file && fwrite(out.data, 1, out.size, file) == out.size;
+    if (file) {
+        ok = fclose(file) == 0 && ok;
+    }
+    if (!ok) {
+        ERROR("Could not write snapshot file '%s'\n", path)
+    }
+
+    free(out.data);
+    free(payload.data);
+    return ok;
+}
@@ -0,0 +1,22 @@
+#ifndef WASMC_SNAPSHOT_H
+#define WASMC_SNAPSHOT_H
+
+#include "module.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SNAPSHOT_ZERO_GAP 16// 生成数据段时，连续 0 字节少于该长度时不拆分数据项，避免生成过多零碎的数据项
+
+// 生成 Wasm 二进制文件时使用的缓冲区
+typedef struct ByteBuffer {
+    uint8_t *data;  // 缓冲区数据
+    size_t size;    // 缓冲区已使用的字节数
+    size_t capacity;// 缓冲区的容量
+} ByteBuffer;
+
+// 将已完成实例化（包括执行起始函数）的实例 inst 的状态写入新的 Wasm 二进制文件 path（即预初始化快照）
+// 新文件中全局变量的初始化表达式为实例中全局变量的当前值，元素段和数据段为实例中表和内存的当前数据，且不再包含起始段，
+// 因此加载新文件时无需再执行起始函数，即可得到与实例相同的初始状态
+bool write_preinit_snapshot(Instance *inst, const char *path);
+
+#endif
@@ -1,7 +1,6 @@
 #include "utils.h"
 #include "module.h"
 #include <ctype.h>
-#include <dlfcn.h>
 #include <fcntl.h>
 #include <inttypes.h>
 #include <limits.h>
@@ -14,8 +13,9 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 
-// 全局的异常信息，用于收集运行时（即虚拟机执行指令过程）中的异常信息
-char exception[4096];
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
 
 /*
  * LEB128（Little Endian Base 128）变长编码格式目的是节约空间
@@ -33,7 +33,7 @@ char exception[4096];
  * 针对有符号整数的 LEB128 编码，与上面无符号的完全相同，
  * 只有最后一个字节的第二高位是符号位，如果是 1，表示这是一个负数，需将高位全部补全为 1，如果是 0，表示这是一个正数，需将高位全部补全为 0
 */
-uint64_t read_LEB(const uint8_t *bytes, uint32_t *pos, uint32_t maxbits, bool sign) {
+uint64_t read_LEB_slow(const uint8_t *bytes, uint32_t *pos, uint32_t maxbits, bool sign) {
     uint64_t result = 0;
     uint32_t shift = 0;
     uint32_t bcnt = 0;
@@ -44,7 +44,10 @@ uint64_t read_LEB(const uint8_t *bytes, uint32_t *pos, uint32_t maxbits, bool si
         byte = bytes[*pos];
         *pos += 1;
         // 取字节中后 7 位作为值插入到 result 中，按照小端序，即低位字节在前，高位字节在后
-        result |= ((byte & 0x7f) << shift);
+        // 注：移位数不小于 64 时结果是未定义的，超出 64 位的部分直接丢弃
+        if (shift < 64) {
+            result |= ((byte & 0x7f) << shift);
+        }
         shift += 7;
         // 如果某个字节的最高位为 0，即和 0x80 相与结果为 0，则表示该字节为最后一个字节，没有后续字节了
         if ((byte & 0x80) == 0) {
@@ -60,13 +63,66 @@ uint64_t read_LEB(const uint8_t *bytes, uint32_t *pos, uint32_t maxbits, bool si
         }
     }
 
-    // 如果是有符号整数，针对于最后一个字节，则需要
+    // 如果是有符号整数，针对于最后一个字节，则需要将高位全部补全为符号位
     if (sign && (shift < maxbits) && (byte & 0x40)) {
-        result |= -(1 << shift);
+        result |= (uint64_t) -1 << shift;
     }
     return result;
 }
 
+// 解码 LEB128 编码（快速路径）
+// 1. 单字节的情况（绝大多数的索引、操作码立即数等）只需一次判断
+// 2. 多字节的情况一次读取 8 个字节，通过标记位一次找到最后一个字节，再将每个字节的后 7 位拼接起来（支持 BMI2 时使用 pext 指令）
+// 3. 超过 8 个字节或者字节数超出 maxbits 限制的情况交由 read_LEB_slow 处理，因此溢出时的报错与逐字节解码完全相同
+uint64_t read_LEB(const uint8_t *bytes, uint32_t *pos, uint32_t maxbits, bool sign) {
+    const uint8_t *p = bytes + *pos;
+    uint64_t result = p[0];
+
+    if ((result & 0x80) == 0) {
+        *pos += 1;
+        if (sign && 7 < maxbits && (result & 0x40)) {
+            result |= (uint64_t) -1 << 7;
+        }
+        return result;
+    }
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && !defined(__SANITIZE_ADDRESS__)
+    // 一次读取 8 个字节时不能跨越页边界，否则可能会读到未映射的页（按照最小的 4K 页计算）
+    if (((uintptr_t) p & (LEB_LOAD_PAGE - 1)) <= LEB_LOAD_PAGE - 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+
+        // 每个字节的最高位取反后，最低的非 0 位所在的字节即最后一个字节
+        uint64_t stop = ~word & 0x8080808080808080ULL;
+        if (stop) {
+            uint32_t len = (__builtin_ctzll(stop) >> 3) + 1;
+            if (len - 1 <= (maxbits + 7 - 1) / 7) {
+                if (len < 8) {
+                    word &= (1ULL << (len * 8)) - 1;
+                }
+#ifdef __BMI2__
+                result = _pext_u64(word, 0x7f7f7f7f7f7f7f7fULL);
+#else
+                // 依次将相邻的 7 位组合并为 14 位组、28 位组，最后合并为 56 位
+                word &= 0x7f7f7f7f7f7f7f7fULL;
+                word = ((word & 0x7f007f007f007f00ULL) >> 1) | (word & 0x007f007f007f007fULL);
+                word = ((word & 0x3fff00003fff0000ULL) >> 2) | (word & 0x00003fff00003fffULL);
+                result = ((word & 0x0fffffff00000000ULL) >> 4) | (word & 0x000000000fffffffULL);
+#endif
+                uint32_t shift = len * 7;
+                if (sign && shift < maxbits && (p[len - 1] & 0x40)) {
+                    result |= (uint64_t) -1 << shift;
+                }
+                *pos += len;
+                return result;
+            }
+        }
+    }
+#endif
+
+    return read_LEB_slow(bytes, pos, maxbits, sign);
+}
+
 // 解码针对无符号整数的 LEB128 编码
 uint64_t read_LEB_unsigned(const uint8_t *bytes, uint32_t *pos, uint32_t maxbits) {
     return read_LEB(bytes, pos, maxbits, false);
@@ -77,13 +133,13 @@ uint64_t read_LEB_signed(const uint8_t *bytes, uint32_t *pos, uint32_t maxbits)
     return read_LEB(bytes, pos, maxbits, true);
 }
 
-// 从字节数组中读取字符串，其中字节数组的开头 4 个字节用于表示字符串的长度
+// 从字节数组中读取字符串，其中字节数组的开头 4 个字节用于表示字符串的长度，字符串的内存从内存池 arena 中申请
 // 注：如果参数 result_len 不为 NULL，则会被赋值为字符串的长度
-char *read_string(const uint8_t *bytes, uint32_t *pos, uint32_t *result_len) {
+char *read_string(const uint8_t *bytes, uint32_t *pos, uint32_t *result_len, Arena *arena) {
     // 读取字符串的长度
     uint32_t str_len = read_LEB_unsigned(bytes, pos, 32);
     // 为字符串申请内存
-    char *str = malloc(str_len + 1);
+    char *str = arena_alloc(arena, str_len + 1, sizeof(char), "string");
     // 将字节数组的数据拷贝到字符串 str 中
     memcpy(str, bytes + *pos, str_len);
     // 字符串以字符 '\0' 结尾
@@ -97,6 +153,34 @@ char *read_string(const uint8_t *bytes, uint32_t *pos, uint32_t *result_len) {
     return str;
 }
 
+// 计算字节数组的 64 位哈希值
+// 每次处理 8 个字节，先与哈希值异或，再乘以一个奇数常量并将高位混合到低位，剩余不足 8 个字节的部分逐字节处理
+uint64_t hash_bytes(const uint8_t *bytes, uint32_t len) {
+    uint64_t hash = 0xcbf29ce484222325ULL ^ len;
+    uint64_t word;
+    uint32_t i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+        hash ^= hash >> 29;
+    }
+    for (; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    hash ^= hash >> 32;
+    return hash;
+}
+
+// 计算字符串的 32 位 FNV-1a 哈希值
+uint32_t hash_string(const char *str) {
+    uint32_t hash = 0x811c9dc5;
+    for (; *str; str++) {
+        hash = (hash ^ (uint8_t) *str) * 0x01000193;
+    }
+    return hash;
+}
+
 // 申请内存
 void *acalloc(size_t nmemb, size_t size, char *name) {
     void *res = calloc(nmemb, size);
@@ -118,32 +202,75 @@ void *arecalloc(void *ptr, size_t old_nmemb, size_t nmemb, size_t size, char *na
     return res;
 }
 
-// 查找动态库中的 symbol
-// 如果解析成功则返回 true
-// 如果解析失败则返回 false 并设置 err
-bool resolve_sym(char *filename, char *symbol, void **val, char **err) {
-    void *handle = NULL;
-    dlerror();
+// 申请一块容量至少为 capacity 字节的内存块，并将其作为内存池的当前内存块
+void arena_grow(Arena *arena, size_t capacity) {
+    if (capacity < ARENA_CHUNK_SIZE) {
+        capacity = ARENA_CHUNK_SIZE;
+    }
+    // 使用 calloc 申请内存块，这样从内存块中申请的内存天然就是用 0 初始化的
+    ArenaChunk *chunk = acalloc(1, sizeof(ArenaChunk) + capacity, "ArenaChunk");
+    chunk->capacity = capacity;
+    chunk->next = arena->head;
+    arena->head = chunk;
+}
 
-    if (filename) {
-        handle = dlopen(filename, RTLD_LAZY);
-        if (!handle) {
-            *err = dlerror();
-            return false;
-        }
+// 初始化内存池，并预先申请一块容量为 capacity 字节的内存
+void arena_init(Arena *arena, size_t capacity) {
+    arena->head = NULL;
+    arena_grow(arena, capacity);
+}
+
+// 从内存池中申请内存（已用 0 初始化），当前内存块容量不足时会自动申请新的内存块
+void *arena_alloc(Arena *arena, size_t nmemb, size_t size, char *name) {
+    size_t bytes = nmemb * size;
+    if (bytes == 0) {
+        return NULL;
+    }
+    if (size != 0 && bytes / size != nmemb) {
+        FATAL("Could not allocate %lu * %lu bytes for %s", nmemb, size, name)
     }
 
-    // 查找动态库中的 symbol
-    // 根据 动态链接库 操作句柄 (handle) 与符号 (symbol)，返回符号对应的地址。使用这个函数不但可以获取函数地址，也可以获取变量地址。
-    // handle：由 dlopen 打开动态链接库后返回的指针；
-    // symbol：要求获取的函数或全局变量的名称。
-    // 返回值：指向函数的地址，供调用使用。
-    *val = dlsym(handle, symbol);
+    // 按照 ARENA_ALIGN 字节对齐，保证任意类型的数据都可以存放在内存池中
+    ArenaChunk *chunk = arena->head;
+    size_t offset = chunk ? (chunk->used + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1) : 0;
+    if (!chunk || offset + bytes > chunk->capacity) {
+        // 当前内存块容量不足，则申请新的内存块（新内存块的容量至少为上一个内存块的容量，避免频繁申请）
+        arena_grow(arena, chunk && chunk->capacity > bytes ? chunk->capacity : bytes);
+        chunk = arena->head;
+        offset = 0;
+    }
+    chunk->used = offset + bytes;
+    return chunk->data + offset;
+}
+
+// 将内存池 src 中的所有内存块转移到内存池 dst 中，转移后 src 为空
+// 注：只是将内存块的链表拼接起来，dst 的当前内存块保持不变
+void arena_merge(Arena *dst, Arena *src) {
+    ArenaChunk *last = src->head;
+    if (!last) {
+        return;
+    }
+    while (last->next) {
+        last = last->next;
+    }
+    if (dst->head) {
+        last->next = dst->head->next;
+        dst->head->next = src->head;
+    } else {
+        dst->head = src->head;
+    }
+    src->head = NULL;
+}
 
-    if ((*err = dlerror()) != NULL) {
-        return false;
+// 释放内存池中的所有内存块
+void arena_free(Arena *arena) {
+    ArenaChunk *chunk = arena->head;
+    while (chunk) {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
     }
-    return true;
+    arena->head = NULL;
 }
 
 // 基于函数签名计算唯一的掩码值
@@ -310,37 +437,68 @@ double wa_fmin(double a, double b) {
 }
 
 // 将 StackValue 类型数值用字符串形式展示，展示形式 "<value>:<value_type>"
-char value_str[256];
-char *value_repr(StackValue *v) {
+// 字符串写入调用方提供的缓冲区 buf 中，因此可以在多个线程中同时调用
+char *value_repr(StackValue *v, char *buf, size_t size) {
+    buf[0] = '\0';
     switch (v->value_type) {
         case I32:
-            snprintf(value_str, 255, "0x%x:i32", v->value.uint32);
+            snprintf(buf, size, "0x%x:i32", v->value.uint32);
             break;
         case I64:
-            snprintf(value_str, 255, "%" PRIu64 ":i64", v->value.uint64);
+            snprintf(buf, size, "%" PRIu64 ":i64", v->value.uint64);
             break;
         case F32:
-            snprintf(value_str, 255, "%.7g:f32", v->value.f32);
+            snprintf(buf, size, "%.7g:f32", v->value.f32);
             break;
         case F64:
-            snprintf(value_str, 255, "%.7g:f64", v->value.f64);
+            snprintf(buf, size, "%.7g:f64", v->value.f64);
             break;
     }
-    return value_str;
+    return buf;
 }
 
-// 通过名称从 Wasm 模块中查找同名的导出项
-void *get_export(Module *m, char *name) {
-    for (uint32_t e = 0; e < m->export_count; e++) {
-        char *export_name = m->exports[e].export_name;
-        if (!export_name) {
-            continue;
-        }
-        if (strncmp(name, export_name, 1024) == 0) {
-            return m->exports[e].value;
+// 通过名称从 Wasm 模块中查找同名的导出项，返回导出项的句柄（即导出项在 m->exports 中的索引）
+uint32_t resolve_export(Module *m, const char *name) {
+    if (!m->export_map) {
+        return EXPORT_HANDLE_INVALID;
+    }
+    // 从名称的哈希值对应的槽位开始线性探测，遇到空槽位说明不存在同名的导出项
+    uint32_t slot = hash_string(name) & m->export_map_mask;
+    while (m->export_map[slot]) {
+        uint32_t e = m->export_map[slot] - 1;
+        if (strcmp(name, m->exports[e].export_name) == 0) {
+            return e;
         }
+        slot = (slot + 1) & m->export_map_mask;
     }
-    return NULL;
+    return EXPORT_HANDLE_INVALID;
+}
+
+// 通过句柄获取实例中导出项的值，即根据导出项的类型和索引返回导出项的值
+// 注：导出函数属于模块，而导出的表、内存和全局变量属于实例
+void *get_export_by_handle(Instance *inst, uint32_t handle) {
+    Module *m = inst->module;
+    if (handle >= m->export_count) {
+        return NULL;
+    }
+    Export *export = &m->exports[handle];
+    switch (export->external_kind) {
+        case KIND_FUNCTION:
+            return &m->functions[export->index];
+        case KIND_TABLE:
+            return &inst->table;
+        case KIND_MEMORY:
+            return instance_memory(inst);
+        case KIND_GLOBAL:
+            return &inst->globals[export->index];
+        default:
+            return NULL;
+    }
+}
+
+// 通过名称从 Wasm 实例中查找同名的导出项，并返回导出项的值
+void *get_export(Instance *inst, char *name) {
+    return get_export_by_handle(inst, resolve_export(inst->module, name));
 }
 
 // 打开文件并将文件映射进内存
@@ -372,31 +530,31 @@ uint8_t *mmap_file(char *path, int *len) {
     return bytes;
 }
 
-// 将字符串 str 按照空格拆分成多个参数
+// 将字符串 str 按照空格拆分成多个参数，拆分结果写入调用方提供的数组 argv 中
 // 其中 argc 被赋值为拆分字符串 str 得到的参数数量
-char *argv_buf[100];
-char **split_argv(char *str, int *argc) {
-    argv_buf[(*argc)++] = str;
+char **split_argv(char *str, char **argv, int capacity, int *argc) {
+    argv[(*argc)++] = str;
 
-    for (int i = 1; str[i] != '\0'; i += 1) {
+    // 数组需要预留一个位置用于存放结尾的 NULL
+    for (int i = 1; str[i] != '\0' && *argc < capacity - 1; i += 1) {
         if (str[i - 1] == ' ') {
             str[i - 1] = '\0';
-            argv_buf[(*argc)++] = str + i;
+            argv[(*argc)++] = str + i;
         }
     }
-    argv_buf[(*argc)] = NULL;
-    return argv_buf;
+    argv[(*argc)] = NULL;
+    return argv;
 }
 
 // 解析函数参数，并将参数压入到操作数栈
-void parse_args(Module *m, Type *type, int argc, char **argv) {
+void parse_args(Instance *inst, Type *type, int argc, char **argv) {
     for (int i = 0; i < argc; i++) {
         for (int j = 0; argv[i][j]; j++) {
             argv[i][j] = (char) tolower(argv[i][j]);
         }
-        m->sp++;
+        inst->sp++;
         // 将参数压入到操作数栈顶
-        StackValue *sv = &m->stack[m->sp];
+        StackValue *sv = &inst->stack[inst->sp];
         // 设置参数的值类型
         sv->value_type = type->params[i];
         // 按照参数的值类型，设置参数的值
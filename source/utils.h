@@ -13,9 +13,6 @@ typedef int32_t i32;
 typedef double f64;
 typedef float f32;
 
-// 用于保存异常信息内容
-extern char exception[];
-
 // 报错
 #define FATAL(...)                                             \
     {                                                          \
@@ -36,15 +33,23 @@ extern char exception[];
 
 #define ERROR(...) fprintf(stderr, __VA_ARGS__);
 
+#define LEB_LOAD_PAGE 4096// 解码 LEB128 编码时一次读取 8 个字节不能跨越的边界，即最小的页大小
+
 // 解码针对无符号整数的 LEB128 编码
 uint64_t read_LEB_unsigned(const uint8_t *bytes, uint32_t *pos, uint32_t maxbits);
 
 // 解码针对有符号整数的 LEB128 编码
 uint64_t read_LEB_signed(const uint8_t *bytes, uint32_t *pos, uint32_t maxbits);
 
-// 从字节数组中读取字符串，其中字节数组的开头 4 个字节用于表示字符串的长度
+// 从字节数组中读取字符串，其中字节数组的开头 4 个字节用于表示字符串的长度，字符串的内存从内存池 arena 中申请
 // 注：如果参数 result_len 不为 NULL，则会被赋值为字符串的长度
-char *read_string(const uint8_t *bytes, uint32_t *pos, uint32_t *result_len);
+char *read_string(const uint8_t *bytes, uint32_t *pos, uint32_t *result_len, Arena *arena);
+
+// 计算字节数组的 64 位哈希值
+uint64_t hash_bytes(const uint8_t *bytes, uint32_t len);
+
+// 计算字符串的 32 位 FNV-1a 哈希值
+uint32_t hash_string(const char *str);
 
 // 申请内存
 void *acalloc(size_t nmemb, size_t size, char *name);
@@ -52,10 +57,17 @@ void *acalloc(size_t nmemb, size_t size, char *name);
 // 在原有内存基础上重新申请内存
 void *arecalloc(void *ptr, size_t old_nmemb, size_t nmemb, size_t size, char *name);
 
-// 查找动态库中的 symbol
-// 如果解析成功则返回 true
-// 如果解析失败则返回 false 并设置 err
-bool resolve_sym(char *filename, char *symbol, void **val, char **err);
+// 初始化内存池，并预先申请一块容量为 capacity 字节的内存
+void arena_init(Arena *arena, size_t capacity);
+
+// 从内存池中申请内存（已用 0 初始化），当前内存块容量不足时会自动申请新的内存块
+void *arena_alloc(Arena *arena, size_t nmemb, size_t size, char *name);
+
+// 将内存池 src 中的所有内存块转移到内存池 dst 中，转移后 src 为空
+void arena_merge(Arena *dst, Arena *src);
+
+// 释放内存池中的所有内存块
+void arena_free(Arena *arena);
 
 // 基于函数签名计算唯一的掩码值
 uint64_t get_type_mask(Type *type);
@@ -108,13 +120,14 @@ double wa_fmax(double a, double b);
 double wa_fmin(double a, double b);
 
 // 非饱和截断
+// 注：转换失败时将异常信息写入实例中，因此只能在 inst 变量可见的地方使用
 #define OP_TRUNC(RES, A, TYPE, RMIN, RMAX)                   \
     if (isnan(A)) {                                          \
-        sprintf(exception, "invalid conversion to integer"); \
+        sprintf(inst->exception, "invalid conversion to integer"); \
         return false;                                        \
     }                                                        \
     if ((A) <= (RMIN) || (A) >= (RMAX)) {                    \
-        sprintf(exception, "integer overflow");              \
+        sprintf(inst->exception, "integer overflow");              \
         return false;                                        \
     }                                                        \
     (RES) = (TYPE) (A);
@@ -153,20 +166,32 @@ double wa_fmin(double a, double b);
 #define OP_I64_TRUNC_SAT_F64(RES, A) OP_TRUNC_SAT(RES, A, i64, -9223372036854777856.0, 9223372036854775808.0, INT64_MIN, INT64_MAX)
 #define OP_U64_TRUNC_SAT_F64(RES, A) OP_TRUNC_SAT(RES, A, u64, -1.0, 18446744073709551616.0, 0ULL, UINT64_MAX)
 
+#define VALUE_STR_SIZE 256// 数值的字符串形式的最大长度
+
 // 将 StackValue 类型数值用字符串形式展示，展示形式 "<value>:<value_type>"
-char *value_repr(StackValue *v);
+// 字符串写入调用方提供的缓冲区 buf（长度为 size，通常为 VALUE_STR_SIZE）中，并返回 buf
+char *value_repr(StackValue *v, char *buf, size_t size);
+
+#define EXPORT_HANDLE_INVALID UINT32_MAX// 无效的导出项句柄，即没有找到同名的导出项
+
+// 通过名称从 Wasm 模块中查找同名的导出项，返回导出项的句柄（即导出项在 m->exports 中的索引）
+// 句柄只与模块相关，可以在该模块的所有实例中使用，因此调用方只需查找一次，后续直接通过句柄访问导出项
+uint32_t resolve_export(Module *m, const char *name);
+
+// 通过句柄获取实例中导出项的值
+void *get_export_by_handle(Instance *inst, uint32_t handle);
 
 // 通过名称从 Wasm 模块中查找同名的导出项
-void *get_export(Module *m, char *name);
+void *get_export(Instance *inst, char *name);
 
 // 打开文件并将文件映射进内存
 uint8_t *mmap_file(char *path, int *len);
 
-// 将字符串 str 按照空格拆分成多个参数
-// 其中 argc 被赋值为拆分字符串 str 得到的参数数量
-char **split_argv(char *str, int *argc);
+// 将字符串 str 按照空格拆分成多个参数，拆分结果写入调用方提供的数组 argv（容量为 capacity，以 NULL 结尾）中，并返回 argv
+// 其中 argc 被赋值为拆分字符串 str 得到的参数数量（超出容量的部分会合并到最后一个参数中）
+char **split_argv(char *str, char **argv, int capacity, int *argc);
 
 // 解析函数参数，并将参数压入到操作数栈
-void parse_args(Module *m, Type *type, int argc, char **argv);
+void parse_args(Instance *inst, Type *type, int argc, char **argv);
 
 #endif
@@ -0,0 +1,300 @@
+// 异步 I/O 回归测试：在启用了异步 I/O 的调度器中，多个实例通过 aio.read 读取文件和管道，检查每个任务的结果
+// 覆盖以下几条路径：
+// 1. 请求加入 io_uring 后实例暂停，完成线程收取结果（handle_io_completion）并交还给持有实例的工作线程继续执行，
+//    一批请求的数量超过提交队列的容量，错误码（例如无效的文件描述符）同样写回给实例
+// 2. 多个实例在空管道上暂停时，工作线程没有被阻塞，仍然可以执行其他实例上的任务；写入管道后暂停的任务继续执行
+// 3. 提交队列已满时，工作线程同步执行请求（测试中将提交队列的容量临时置为 0 来模拟）
+// 4. 不在调度器中执行时，宿主函数同步执行，缓冲区越界时调用失败
+//
+// 用法：wasmc-aio-test
+//
+// 全部检查通过时返回 0，否则输出失败的检查并返回 1；内核不支持 io_uring 时只检查同步执行的路径
+
+#include "aio.h"
+#include "interpreter.h"
+#include "module.h"
+#include "scheduler.h"
+#include "utils.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define WORKER_COUNT 2    // 工作线程数量，少于管道数量，同步读取管道会阻塞全部工作线程
+#define INSTANCE_COUNT 8  // 读取文件的实例数量
+#define FILE_JOB_COUNT 600// 每批读取文件的任务数量，多于提交队列的容量 AIO_QUEUE_DEPTH
+#define PIPE_COUNT 6      // 管道数量，每个管道由一个实例读取
+#define FILE_SIZE 0x10000 // 测试文件的字节数
+#define WAIT_LIMIT_MS 10000// 等待任务完成的最长时间，超时视为工作线程被阻塞
+#define MESSAGE_SIZE 256  // 失败信息的最大长度
+
+// 测试模块，等价于下面的 WAT：
+// (module
+//   (import "aio" "read" (func $read (param i32 i32 i32 i64) (result i32)))
+//   (memory 1)
+//   (export "read" (func $read))
+//   ;; 从文件偏移 off 处读取 4 个字节，返回【读取结果 << 32 | 读取的数据】
+//   (func $read_word (export "read_word") (param $fd i32) (param $off i64) (result i64)
+//     local.get $fd
+//     i32.const 0
+//     i32.const 4
+//     local.get $off
+//     call $read
+//     i64.extend_i32_s
+//     i64.const 32
+//     i64.shl
+//     i32.const 0
+//     i64.load32_u
+//     i64.or)
+//   ;; 分两次从管道中各读取 2 个字节，返回【两次读取结果之和 << 32 | 读取的数据】
+//   (func $read_pipe (export "read_pipe") (param $fd i32) (result i64)
+//     local.get $fd
+//     i32.const 0
+//     i32.const 2
+//     i64.const -1
+//     call $read
+//     local.get $fd
+//     i32.const 2
+//     i32.const 2
+//     i64.const -1
+//     call $read
+//     i32.add
+//     i64.extend_i32_s
+//     i64.const 32
+//     i64.shl
+//     i32.const 0
+//     i64.load32_u
+//     i64.or))
+const uint8_t test_module[] = {
+        0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00,
+        // 类型段
+        0x01, 0x14, 0x03, 0x60, 0x04, 0x7f, 0x7f, 0x7f, 0x7e, 0x01, 0x7f, 0x60, 0x02, 0x7f, 0x7e, 0x01, 0x7e, 0x60,
+        0x01, 0x7f, 0x01, 0x7e,
+        // 导入段
+        0x02, 0x0c, 0x01, 0x03, 0x61, 0x69, 0x6f, 0x04, 0x72, 0x65, 0x61, 0x64, 0x00, 0x00,
+        // 函数段
+        0x03, 0x03, 0x02, 0x01, 0x02,
+        // 内存段
+        0x05, 0x03, 0x01, 0x00, 0x01,
+        // 导出段
+        0x07, 0x20, 0x03, 0x04, 0x72, 0x65, 0x61, 0x64, 0x00, 0x00, 0x09, 0x72, 0x65, 0x61, 0x64, 0x5f, 0x77, 0x6f,
+        0x72, 0x64, 0x00, 0x01, 0x09, 0x72, 0x65, 0x61, 0x64, 0x5f, 0x70, 0x69, 0x70, 0x65, 0x00, 0x02,
+        // 代码段
+        0x0a, 0x3a, 0x02, 0x16, 0x00, 0x20, 0x00, 0x41, 0x00, 0x41, 0x04, 0x20, 0x01, 0x10, 0x00, 0xac, 0x42, 0x20,
+        0x86, 0x41, 0x00, 0x35, 0x02, 0x00, 0x84, 0x0b, 0x21, 0x00, 0x20, 0x00, 0x41, 0x00, 0x41, 0x02, 0x42, 0x7f,
+        0x10, 0x00, 0x20, 0x00, 0x41, 0x02, 0x41, 0x02, 0x42, 0x7f, 0x10, 0x00, 0x6a, 0xac, 0x42, 0x20, 0x86, 0x41,
+        0x00, 0x35, 0x02, 0x00, 0x84, 0x0b,
+};
+
+uint32_t failures = 0;      // 失败的检查数量
+uint8_t file_data[FILE_SIZE];// 测试文件的内容
+
+// 检查条件 cond 是否成立，不成立时输出 what 并计为失败
+void check(bool cond, const char *what) {
+    if (!cond) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// 函数 read_word 和 read_pipe 的期望返回值：高 32 位为读取结果，低 32 位为按小端序读取的 4 个字节
+uint64_t expected_value(int32_t res, const uint8_t *bytes) {
+    uint32_t word = (uint32_t) bytes[0] | (uint32_t) bytes[1] << 8 | (uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24;
+    return (uint64_t) (uint32_t) res << 32 | word;
+}
+
+// 准备 FILE_JOB_COUNT 个读取文件的任务，分布在所有实例上，每个任务读取不同的偏移
+void prepare_file_jobs(Job *jobs, StackValue *args, Instance **instances, uint32_t handle, int fd) {
+    for (uint32_t i = 0; i < FILE_JOB_COUNT; i++) {
+        args[2 * i].value.int32 = fd;
+        args[2 * i + 1].value.uint64 = (uint64_t) i * 7 % (FILE_SIZE - 4);
+        jobs[i] = (Job){.inst = instances[i % INSTANCE_COUNT], .handle = handle, .args = &args[2 * i], .arg_count = 2};
+    }
+}
+
+// 检查读取文件的任务的结果，只输出第一个错误的任务
+void check_file_jobs(Job *jobs, StackValue *args, const char *scene) {
+    for (uint32_t i = 0; i < FILE_JOB_COUNT; i++) {
+        uint64_t offset = args[2 * i + 1].value.uint64;
+        if (!jobs[i].ok || jobs[i].result.value.uint64 != expected_value(4, file_data + offset)) {
+            char message[MESSAGE_SIZE];
+            snprintf(message, sizeof(message), "%s: job %u read 0x%llx at offset %llu (%.64s)", scene, i,
+                     (unsigned long long) jobs[i].result.value.uint64, (unsigned long long) offset, jobs[i].exception);
+            check(false, message);
+            return;
+        }
+    }
+}
+
+// 等待任务完成，超过 WAIT_LIMIT_MS 毫秒仍未完成时返回 false（不使用 job_wait，避免工作线程被阻塞时测试永远等待）
+bool wait_done(Job *jobs, uint32_t count) {
+    for (uint32_t ms = 0; ms < WAIT_LIMIT_MS; ms++) {
+        uint32_t done = 0;
+        while (done < count && atomic_load(&jobs[done].done)) {
+            done++;
+        }
+        if (done == count) {
+            return true;
+        }
+        usleep(1000);
+    }
+    return false;
+}
+
+// 等待实例都被工作线程持有（即任务已经开始执行，并暂停在读取上），超过 WAIT_LIMIT_MS 毫秒时返回 false
+bool wait_held(Instance **instances, uint32_t count) {
+    for (uint32_t ms = 0; ms < WAIT_LIMIT_MS; ms++) {
+        uint32_t held = 0;
+        while (held < count && atomic_load(&instances[held]->running_worker)) {
+            held++;
+        }
+        if (held == count) {
+            return true;
+        }
+        usleep(1000);
+    }
+    return false;
+}
+
+// 异步读取文件和管道：管道中没有数据时读取管道的实例暂停，工作线程继续执行读取文件的任务
+void run_async(Scheduler *s, Module *m, Instance **instances, int fd) {
+    Job jobs[FILE_JOB_COUNT];
+    StackValue args[2 * FILE_JOB_COUNT];
+    prepare_file_jobs(jobs, args, instances, resolve_export(m, "read_word"), fd);
+
+    int pipes[PIPE_COUNT][2];
+    Instance *pipe_instances[PIPE_COUNT];
+    Job pipe_jobs[PIPE_COUNT];
+    StackValue pipe_args[PIPE_COUNT];
+    for (uint32_t i = 0; i < PIPE_COUNT; i++) {
+        if (pipe(pipes[i]) != 0) {
+            FATAL("Could not create pipe: %s\n", strerror(errno))
+        }
+        pipe_instances[i] = instantiate(m);
+        pipe_args[i].value.int32 = pipes[i][0];
+        pipe_jobs[i] = (Job){.inst = pipe_instances[i], .handle = resolve_export(m, "read_pipe"), .args = &pipe_args[i], .arg_count = 1};
+    }
+
+    // 先提交读取管道的任务，等这些任务都暂停在第一次读取上（同步读取时全部工作线程会阻塞，只能持有 WORKER_COUNT 个实例）
+    scheduler_submit(s, pipe_jobs, PIPE_COUNT);
+    check(wait_held(pipe_instances, PIPE_COUNT), "instances reading empty pipes were not all suspended");
+    scheduler_submit(s, jobs, FILE_JOB_COUNT);
+    check(wait_done(jobs, FILE_JOB_COUNT), "file reads did not finish while instances waited on pipes");
+    check_file_jobs(jobs, args, "async");
+    for (uint32_t i = 0; i < PIPE_COUNT; i++) {
+        check(!atomic_load(&pipe_jobs[i].done), "pipe read finished before the pipe was written");
+    }
+
+    // 分两次写入管道，两次读取都可能暂停
+    uint8_t bytes[PIPE_COUNT][4];
+    for (uint32_t half = 0; half < 2; half++) {
+        for (uint32_t i = 0; i < PIPE_COUNT; i++) {
+            for (uint32_t k = 0; k < 4; k++) {
+                bytes[i][k] = (uint8_t) (0x10 * i + k + 1);
+            }
+            check(write(pipes[i][1], bytes[i] + 2 * half, 2) == 2, "could not write to pipe");
+        }
+        usleep(10000);
+    }
+    check(wait_done(pipe_jobs, PIPE_COUNT), "pipe reads did not finish after the pipes were written");
+    for (uint32_t i = 0; i < PIPE_COUNT; i++) {
+        check(pipe_jobs[i].ok && pipe_jobs[i].result.value.uint64 == expected_value(4, bytes[i]), "pipe read returned wrong data");
+        close(pipes[i][0]);
+        close(pipes[i][1]);
+        free_instance(pipe_instances[i]);
+    }
+
+    // 请求失败时错误码同样通过完成队列写回
+    StackValue bad_args[2] = {{.value.int32 = -1}, {.value.uint64 = 0}};
+    Job bad = {.inst = instances[0], .handle = resolve_export(m, "read_word"), .args = bad_args, .arg_count = 2};
+    scheduler_submit(s, &bad, 1);
+    check(wait_done(&bad, 1), "read from an invalid descriptor did not finish");
+    check(bad.ok && (int32_t) (bad.result.value.uint64 >> 32) == -EBADF, "read from an invalid descriptor did not return -EBADF");
+}
+
+// 提交队列已满时同步执行请求：将提交队列的容量临时置为 0，所有请求都无法加入提交队列
+void run_queue_full(Scheduler *s, Module *m, Instance **instances, int fd) {
+    Job jobs[FILE_JOB_COUNT];
+    StackValue args[2 * FILE_JOB_COUNT];
+    prepare_file_jobs(jobs, args, instances, resolve_export(m, "read_word"), fd);
+
+    IoRing *ring = s->ring;
+    pthread_mutex_lock(&ring->lock);
+    uint32_t entries = ring->sq_entries;
+    uint32_t tail = atomic_load(ring->sq_tail);
+    ring->sq_entries = 0;
+    pthread_mutex_unlock(&ring->lock);
+
+    scheduler_submit(s, jobs, FILE_JOB_COUNT);
+    check(wait_done(jobs, FILE_JOB_COUNT), "file reads did not finish when the submission queue was full");
+    check_file_jobs(jobs, args, "queue full");
+
+    pthread_mutex_lock(&ring->lock);
+    check(atomic_load(ring->sq_tail) == tail, "request was queued although the submission queue was full");
+    ring->sq_entries = entries;
+    pthread_mutex_unlock(&ring->lock);
+}
+
+// 直接调用导出函数（不在调度器中执行）时同步读取，缓冲区越界时调用失败
+void run_sync(Module *m, int fd) {
+    Instance *inst = instantiate(m);
+    inst->sp = -1;
+    inst->stack[++inst->sp] = (StackValue){.value_type = I32, .value.int32 = fd};
+    inst->stack[++inst->sp] = (StackValue){.value_type = I64, .value.uint64 = 100};
+    check(invoke_export(inst, resolve_export(m, "read_word")) &&
+                  inst->stack[inst->sp].value.uint64 == expected_value(4, file_data + 100),
+          "synchronous read returned wrong data");
+
+    inst->sp = -1;
+    inst->exception[0] = '\0';
+    inst->stack[++inst->sp] = (StackValue){.value_type = I32, .value.int32 = fd};
+    inst->stack[++inst->sp] = (StackValue){.value_type = I32, .value.uint32 = PAGE_SIZE - 2};
+    inst->stack[++inst->sp] = (StackValue){.value_type = I32, .value.uint32 = 4};
+    inst->stack[++inst->sp] = (StackValue){.value_type = I64, .value.uint64 = 0};
+    check(!invoke_export(inst, resolve_export(m, "read")) && strcmp(inst->exception, "out of bounds memory access") == 0,
+          "read past the end of memory did not trap");
+    free_instance(inst);
+}
+
+int main(void) {
+    for (uint32_t i = 0; i < FILE_SIZE; i++) {
+        file_data[i] = (uint8_t) (i * 131 + (i >> 8));
+    }
+    FILE *file = tmpfile();
+    if (!file || fwrite(file_data, 1, FILE_SIZE, file) != FILE_SIZE || fflush(file) != 0) {
+        FATAL("Could not create test file\n")
+    }
+    int fd = fileno(file);
+
+    register_aio_imports();
+    Options options = {0};
+    Module *m = load_module(test_module, sizeof(test_module), options);
+    Instance *instances[INSTANCE_COUNT];
+    for (uint32_t i = 0; i < INSTANCE_COUNT; i++) {
+        instances[i] = instantiate(m);
+    }
+
+    Scheduler *s = create_scheduler(WORKER_COUNT);
+    bool aio = scheduler_enable_aio(s);
+    if (aio) {
+        run_async(s, m, instances, fd);
+        run_queue_full(s, m, instances, fd);
+    } else {
+        printf("io_uring is not supported, only the synchronous path is checked\n");
+    }
+    scheduler_wait_all(s);
+    free_scheduler(s);
+    run_sync(m, fd);
+
+    for (uint32_t i = 0; i < INSTANCE_COUNT; i++) {
+        free_instance(instances[i]);
+    }
+    free_module(m);
+    fclose(file);
+    printf("%s: %u workers, %u file reads per batch, %u pipes, %u failures\n", failures ? "FAIL" : "PASS",
+           WORKER_COUNT, aio ? FILE_JOB_COUNT : 0, aio ? PIPE_COUNT : 0, failures);
+    return failures ? 1 : 0;
+}
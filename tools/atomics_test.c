@@ -0,0 +1,401 @@
+// 原子指令回归测试：多个宿主线程各自在一个实例上执行，这些实例都导入同一块共享内存（线程提案），检查以下行为：
+// 1. 原子读-改-写指令（32 位加法、64 位减法、8 位加法）并发计数，以及基于 cmpxchg 的重试循环，最终的计数没有丢失
+// 2. memory.atomic.wait32 / memory.atomic.notify：无超时的等待被逐个唤醒，有超时的等待超时返回，期望值不相等时直接返回
+// 3. 多个线程同时执行 memory.grow 并立即访问各自增长的内存页，同时其他线程继续执行原子指令，超出最大页数时增长失败且页数不变
+// 4. 未对齐的原子访问和越界的原子访问产生陷阱
+// 通常配合 ThreadSanitizer 构建运行
+//
+// 用法：wasmc-atomics-test
+//
+// 全部检查通过时返回 0，否则输出失败的检查并返回 1
+
+#include "atomics.h"
+#include "import.h"
+#include "interpreter.h"
+#include "module.h"
+#include "utils.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define THREAD_COUNT 4    // 宿主线程数量
+#define COUNT_ROUNDS 100000// 每个线程执行读-改-写计数的次数
+#define CAS_ROUNDS 100000  // 每个线程通过 cmpxchg 循环累加的次数
+#define GROW_ROUNDS 10000  // 增长内存后每个线程继续执行读-改-写计数的次数
+#define MAX_PAGES 8       // 共享内存的最大页数
+#define WAIT_LIMIT_MS 10000// 唤醒所有等待线程的最长时间
+#define TIMEOUT_NS 1000000// 有超时的等待的纳秒数
+#define MESSAGE_SIZE 256  // 失败信息的最大长度
+
+// 共享内存中各个计数器的地址
+#define ADDR_COUNT32 0// i32.atomic.rmw.add 累加的 32 位计数器
+#define ADDR_COUNT64 8// i64.atomic.rmw.sub 递减的 64 位计数器
+#define ADDR_COUNT8 16// i32.atomic.rmw8.add_u 累加的 8 位计数器
+#define ADDR_CAS 32   // cmpxchg 循环累加的计数器
+#define ADDR_WAIT 48  // 等待和唤醒使用的地址
+
+// 测试模块，等价于下面的 WAT：
+// (module
+//   (import "env" "memory" (memory 1 8 shared))
+//   ;; 执行 n 次读-改-写计数
+//   (func $count (export "count") (param $n i32)
+//     block
+//       loop
+//         local.get $n
+//         i32.eqz
+//         br_if 1
+//         i32.const 0
+//         i32.const 1
+//         i32.atomic.rmw.add
+//         drop
+//         i32.const 8
+//         i64.const 1
+//         i64.atomic.rmw.sub
+//         drop
+//         i32.const 16
+//         i32.const 1
+//         i32.atomic.rmw8.add_u
+//         drop
+//         local.get $n
+//         i32.const 1
+//         i32.sub
+//         local.set $n
+//         br 0
+//       end
+//     end)
+//   ;; 通过 cmpxchg 循环累加 n 次，返回 cmpxchg 失败（需要重试）的次数
+//   (func $cas_add (export "cas_add") (param $n i32) (result i32) (local $old i32) (local $retries i32)
+//     block
+//       loop
+//         local.get $n
+//         i32.eqz
+//         br_if 1
+//         i32.const 32
+//         i32.atomic.load
+//         local.set $old
+//         i32.const 32
+//         local.get $old
+//         local.get $old
+//         i32.const 1
+//         i32.add
+//         i32.atomic.rmw.cmpxchg
+//         local.get $old
+//         i32.eq
+//         if
+//           local.get $n
+//           i32.const 1
+//           i32.sub
+//           local.set $n
+//         else
+//           local.get $retries
+//           i32.const 1
+//           i32.add
+//           local.set $retries
+//         end
+//         br 0
+//       end
+//     end
+//     local.get $retries)
+//   (func $load (export "load") (param $addr i32) (result i32)
+//     local.get $addr
+//     i32.atomic.load)
+//   (func $load64 (export "load64") (param $addr i32) (result i64)
+//     local.get $addr
+//     i64.atomic.load)
+//   (func $wait (export "wait") (param $addr i32) (param $expected i32) (param $timeout i64) (result i32)
+//     local.get $addr
+//     local.get $expected
+//     local.get $timeout
+//     memory.atomic.wait32)
+//   (func $notify (export "notify") (param $addr i32) (param $count i32) (result i32)
+//     local.get $addr
+//     local.get $count
+//     memory.atomic.notify)
+//   (func $add (export "add") (param $addr i32) (param $v i32) (result i32)
+//     local.get $addr
+//     local.get $v
+//     i32.atomic.rmw.add)
+//   ;; 增长 1 页并写入新页的最后 4 个字节，返回增长前的页数（增长失败时返回 -1）
+//   (func $grow_store (export "grow_store") (param $v i32) (result i32) (local $old i32)
+//     i32.const 1
+//     memory.grow
+//     local.tee $old
+//     i32.const -1
+//     i32.eq
+//     if
+//       i32.const -1
+//       return
+//     end
+//     local.get $old
+//     i32.const 16
+//     i32.shl
+//     i32.const 65532
+//     i32.add
+//     local.get $v
+//     i32.atomic.store
+//     local.get $old)
+//   (func $grow (export "grow") (param $delta i32) (result i32)
+//     local.get $delta
+//     memory.grow)
+//   (func $size (export "size") (result i32)
+//     memory.size))
+const uint8_t test_module[] = {
+        0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00,
+        // 类型段
+        0x01, 0x20, 0x06, 0x60, 0x01, 0x7f, 0x00, 0x60, 0x01, 0x7f, 0x01, 0x7f, 0x60, 0x01, 0x7f, 0x01, 0x7e, 0x60,
+        0x03, 0x7f, 0x7f, 0x7e, 0x01, 0x7f, 0x60, 0x02, 0x7f, 0x7f, 0x01, 0x7f, 0x60, 0x00, 0x01, 0x7f,
+        // 导入段
+        0x02, 0x10, 0x01, 0x03, 0x65, 0x6e, 0x76, 0x06, 0x6d, 0x65, 0x6d, 0x6f, 0x72, 0x79, 0x02, 0x03, 0x01, 0x08,
+        // 函数段
+        0x03, 0x0b, 0x0a, 0x00, 0x01, 0x01, 0x02, 0x03, 0x04, 0x04, 0x01, 0x01, 0x05,
+        // 导出段
+        0x07, 0x54, 0x0a, 0x05, 0x63, 0x6f, 0x75, 0x6e, 0x74, 0x00, 0x00, 0x07, 0x63, 0x61, 0x73, 0x5f, 0x61, 0x64,
+        0x64, 0x00, 0x01, 0x04, 0x6c, 0x6f, 0x61, 0x64, 0x00, 0x02, 0x06, 0x6c, 0x6f, 0x61, 0x64, 0x36, 0x34, 0x00,
+        0x03, 0x04, 0x77, 0x61, 0x69, 0x74, 0x00, 0x04, 0x06, 0x6e, 0x6f, 0x74, 0x69, 0x66, 0x79, 0x00, 0x05, 0x03,
+        0x61, 0x64, 0x64, 0x00, 0x06, 0x0a, 0x67, 0x72, 0x6f, 0x77, 0x5f, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x00, 0x07,
+        0x04, 0x67, 0x72, 0x6f, 0x77, 0x00, 0x08, 0x04, 0x73, 0x69, 0x7a, 0x65, 0x00, 0x09,
+        // 代码段
+        0x0a, 0xd8, 0x01, 0x0a, 0x31, 0x00, 0x02, 0x40, 0x03, 0x40, 0x20, 0x00, 0x45, 0x0d, 0x01, 0x41, 0x00, 0x41,
+        0x01, 0xfe, 0x1e, 0x02, 0x00, 0x1a, 0x41, 0x08, 0x42, 0x01, 0xfe, 0x26, 0x03, 0x00, 0x1a, 0x41, 0x10, 0x41,
+        0x01, 0xfe, 0x20, 0x00, 0x00, 0x1a, 0x20, 0x00, 0x41, 0x01, 0x6b, 0x21, 0x00, 0x0c, 0x00, 0x0b, 0x0b, 0x0b,
+        0x3d, 0x01, 0x02, 0x7f, 0x02, 0x40, 0x03, 0x40, 0x20, 0x00, 0x45, 0x0d, 0x01, 0x41, 0x20, 0xfe, 0x10, 0x02,
+        0x00, 0x21, 0x01, 0x41, 0x20, 0x20, 0x01, 0x20, 0x01, 0x41, 0x01, 0x6a, 0xfe, 0x48, 0x02, 0x00, 0x20, 0x01,
+        0x46, 0x04, 0x40, 0x20, 0x00, 0x41, 0x01, 0x6b, 0x21, 0x00, 0x05, 0x20, 0x02, 0x41, 0x01, 0x6a, 0x21, 0x02,
+        0x0b, 0x0c, 0x00, 0x0b, 0x0b, 0x20, 0x02, 0x0b, 0x08, 0x00, 0x20, 0x00, 0xfe, 0x10, 0x02, 0x00, 0x0b, 0x08,
+        0x00, 0x20, 0x00, 0xfe, 0x11, 0x03, 0x00, 0x0b, 0x0c, 0x00, 0x20, 0x00, 0x20, 0x01, 0x20, 0x02, 0xfe, 0x01,
+        0x02, 0x00, 0x0b, 0x0a, 0x00, 0x20, 0x00, 0x20, 0x01, 0xfe, 0x00, 0x02, 0x00, 0x0b, 0x0a, 0x00, 0x20, 0x00,
+        0x20, 0x01, 0xfe, 0x1e, 0x02, 0x00, 0x0b, 0x25, 0x01, 0x01, 0x7f, 0x41, 0x01, 0x40, 0x00, 0x22, 0x01, 0x41,
+        0x7f, 0x46, 0x04, 0x40, 0x41, 0x7f, 0x0f, 0x0b, 0x20, 0x01, 0x41, 0x10, 0x74, 0x41, 0xfc, 0xff, 0x03, 0x6a,
+        0x20, 0x00, 0xfe, 0x17, 0x02, 0x00, 0x20, 0x01, 0x0b, 0x06, 0x00, 0x20, 0x00, 0x40, 0x00, 0x0b, 0x04, 0x00,
+        0x3f, 0x00, 0x0b,
+};
+
+// 宿主线程执行的阶段
+typedef enum Phase {
+    PHASE_COUNT,// 读-改-写计数和 cmpxchg 循环
+    PHASE_WAIT, // 无超时地等待，直到被唤醒
+    PHASE_GROW, // 增长内存并写入新页，然后继续计数
+} Phase;
+
+// 宿主线程的参数和结果
+typedef struct Thread {
+    pthread_t thread;
+    uint32_t id;     // 线程编号
+    Instance *inst;  // 线程使用的实例（每个线程一个实例，都导入同一块共享内存）
+    Phase phase;     // 当前执行的阶段
+    bool ok;         // 该阶段的调用是否都成功执行
+    int32_t result;  // 该阶段最后一次调用的返回值
+    char exception[EXCEPTION_SIZE];// 调用失败时的异常信息
+} Thread;
+
+Module *module;       // 测试模块，所有线程共享
+uint32_t failures = 0;// 失败的检查数量（只在主线程中修改）
+
+// 检查条件 cond 是否成立，不成立时输出 what 并计为失败
+void check(bool cond, const char *what) {
+    if (!cond) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// 依次以 I32 类型的参数 a、b 和 I64 类型的参数 c 中的前 arg_count 个调用导出函数，返回调用是否成功
+bool call(Instance *inst, const char *name, uint32_t arg_count, int32_t a, int32_t b, int64_t c) {
+    inst->sp = -1;
+    inst->fp = -1;
+    inst->csp = -1;
+    inst->exception[0] = '\0';
+    StackValue args[] = {{.value_type = I32, .value.int32 = a},
+                         {.value_type = I32, .value.int32 = b},
+                         {.value_type = I64, .value.int64 = c}};
+    for (uint32_t i = 0; i < arg_count; i++) {
+        inst->stack[++inst->sp] = args[i];
+    }
+    return invoke_export(inst, resolve_export(module, name));
+}
+
+// 调用返回 i32 的导出函数，返回其返回值，调用失败时计为失败并返回 -1
+int32_t call_i32(Instance *inst, const char *name, uint32_t arg_count, int32_t a, int32_t b, int64_t c) {
+    if (!call(inst, name, arg_count, a, b, c)) {
+        char message[MESSAGE_SIZE];
+        snprintf(message, sizeof(message), "%s trapped: %.128s", name, inst->exception);
+        check(false, message);
+        return -1;
+    }
+    return inst->stack[inst->sp].value.int32;
+}
+
+// 宿主线程主函数：执行当前阶段的调用，记录是否成功以及最后一次调用的返回值
+void *thread_main(void *arg) {
+    Thread *t = arg;
+    Instance *inst = t->inst;
+    switch (t->phase) {
+        case PHASE_COUNT:
+            t->ok = call(inst, "count", 1, COUNT_ROUNDS, 0, 0) && call(inst, "cas_add", 1, CAS_ROUNDS, 0, 0);
+            break;
+        case PHASE_WAIT:
+            t->ok = call(inst, "wait", 3, ADDR_WAIT, 0, -1);
+            break;
+        case PHASE_GROW:
+            // 先增长内存并立即访问新页，再继续计数，使其他线程的增长和计数交错执行
+            t->ok = call(inst, "grow_store", 1, (int32_t) t->id + 1, 0, 0);
+            if (t->ok) {
+                int32_t old = inst->stack[inst->sp].value.int32;
+                t->ok = call(inst, "count", 1, GROW_ROUNDS, 0, 0);
+                t->result = old;
+            }
+            snprintf(t->exception, sizeof(t->exception), "%s", inst->exception);
+            return NULL;
+    }
+    t->result = t->ok && inst->sp >= 0 ? inst->stack[inst->sp].value.int32 : 0;
+    snprintf(t->exception, sizeof(t->exception), "%s", inst->exception);
+    return NULL;
+}
+
+// 在所有宿主线程中执行阶段 phase，并等待所有线程结束
+void start_phase(Thread *threads, Phase phase) {
+    for (uint32_t i = 0; i < THREAD_COUNT; i++) {
+        threads[i].phase = phase;
+        threads[i].ok = false;
+        threads[i].result = 0;
+        if (pthread_create(&threads[i].thread, NULL, thread_main, &threads[i]) != 0) {
+            FATAL("Could not create thread\n")
+        }
+    }
+}
+
+// 等待所有宿主线程结束，并检查每个线程的调用都成功执行
+void join_phase(Thread *threads, const char *phase_name) {
+    for (uint32_t i = 0; i < THREAD_COUNT; i++) {
+        pthread_join(threads[i].thread, NULL);
+        if (!threads[i].ok) {
+            char message[MESSAGE_SIZE];
+            snprintf(message, sizeof(message), "%s: thread %u trapped: %.128s", phase_name, i, threads[i].exception);
+            check(false, message);
+        }
+    }
+}
+
+// 读-改-写计数和 cmpxchg 循环：所有线程结束后每个计数器都等于各线程累加次数之和
+void run_count(Thread *threads, Instance *inst) {
+    start_phase(threads, PHASE_COUNT);
+    join_phase(threads, "count");
+
+    uint32_t total = THREAD_COUNT * COUNT_ROUNDS;
+    check(call_i32(inst, "load", 1, ADDR_COUNT32, 0, 0) == (int32_t) total, "i32.atomic.rmw.add lost updates");
+    check(call(inst, "load64", 1, ADDR_COUNT64, 0, 0) && inst->stack[inst->sp].value.int64 == -(int64_t) total,
+          "i64.atomic.rmw.sub lost updates");
+    check(call_i32(inst, "load", 1, ADDR_COUNT8, 0, 0) == (int32_t) (total & 0xff), "i32.atomic.rmw8.add_u did not wrap at 8 bits");
+    check(call_i32(inst, "load", 1, ADDR_CAS, 0, 0) == THREAD_COUNT * CAS_ROUNDS, "cmpxchg loop lost updates");
+}
+
+// 等待和唤醒：先检查期望值不相等和超时的情况，再让所有线程无超时地等待，逐个唤醒直到所有线程都被唤醒
+void run_wait(Thread *threads, Instance *inst) {
+    check(call_i32(inst, "wait", 3, ADDR_WAIT, 1, -1) == ATOMIC_WAIT_NOT_EQUAL, "wait with a different value did not return 1");
+    check(call_i32(inst, "notify", 2, ADDR_WAIT, 1, 0) == 0, "notify without waiters did not return 0");
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    check(call_i32(inst, "wait", 3, ADDR_WAIT, 0, TIMEOUT_NS) == ATOMIC_WAIT_TIMED_OUT, "wait with a timeout did not time out");
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    int64_t elapsed = (int64_t) (end.tv_sec - begin.tv_sec) * 1000000000 + (end.tv_nsec - begin.tv_nsec);
+    check(elapsed >= TIMEOUT_NS, "wait with a timeout returned early");
+
+    // 线程可能还没有开始等待，所以反复唤醒一个线程，直到被唤醒的线程数量等于线程数量
+    start_phase(threads, PHASE_WAIT);
+    int32_t woken = 0;
+    for (uint32_t ms = 0; ms < WAIT_LIMIT_MS && woken < THREAD_COUNT; ms++) {
+        int32_t n = call_i32(inst, "notify", 2, ADDR_WAIT, 1, 0);
+        check(n == 0 || n == 1, "notify woke more waiters than requested");
+        woken += n;
+        if (n == 0) {
+            usleep(1000);
+        }
+    }
+    check(woken == THREAD_COUNT, "notify did not wake every waiter");
+    if (woken < THREAD_COUNT) {
+        // 唤醒剩余的线程，避免测试无法结束
+        call_i32(inst, "notify", 2, ADDR_WAIT, THREAD_COUNT, 0);
+    }
+    join_phase(threads, "wait");
+    for (uint32_t i = 0; i < THREAD_COUNT; i++) {
+        check(threads[i].result == ATOMIC_WAIT_OK, "woken waiter did not return 0");
+    }
+}
+
+// 并发增长内存：每个线程增长 1 页，增长前的页数各不相同，新页写入的值可以被其他实例读到，超出最大页数时增长失败
+void run_grow(Thread *threads, Instance *inst) {
+    int32_t before = call_i32(inst, "size", 0, 0, 0, 0);
+    int32_t count_before = call_i32(inst, "load", 1, ADDR_COUNT32, 0, 0);
+    start_phase(threads, PHASE_GROW);
+    join_phase(threads, "grow");
+
+    check(call_i32(inst, "size", 0, 0, 0, 0) == before + THREAD_COUNT, "memory did not grow by one page per thread");
+    bool seen[MAX_PAGES] = {false};
+    for (uint32_t i = 0; i < THREAD_COUNT; i++) {
+        int32_t old = threads[i].result;
+        if (old < before || old >= before + THREAD_COUNT || seen[old]) {
+            check(false, "memory.grow returned a duplicate or wrong previous size");
+            continue;
+        }
+        seen[old] = true;
+        check(call_i32(inst, "load", 1, old * PAGE_SIZE + PAGE_SIZE - 4, 0, 0) == (int32_t) i + 1,
+              "value stored in a grown page is not visible to another instance");
+    }
+    check(call_i32(inst, "load", 1, ADDR_COUNT32, 0, 0) == count_before + THREAD_COUNT * GROW_ROUNDS,
+          "read-modify-write lost updates while memory grew");
+
+    // 增长到最大页数后继续增长失败（与非共享内存一致，失败时返回当前页数且页数不变）
+    check(call_i32(inst, "grow", 1, MAX_PAGES - before - THREAD_COUNT, 0, 0) == before + THREAD_COUNT,
+          "memory.grow to the maximum did not return the previous size");
+    check(call_i32(inst, "grow", 1, 1, 0, 0) == MAX_PAGES && call_i32(inst, "size", 0, 0, 0, 0) == MAX_PAGES,
+          "memory.grow past the maximum changed the size");
+}
+
+// 检查调用导出函数 name 时产生的陷阱信息为 expected
+void check_trap(Instance *inst, const char *name, int32_t addr, const char *expected, const char *what) {
+    check(!call(inst, name, 1, addr, 0, 0) && strcmp(inst->exception, expected) == 0, what);
+}
+
+// 未对齐的原子访问和越界的原子访问产生陷阱
+void run_traps(Instance *inst) {
+    int32_t end = call_i32(inst, "size", 0, 0, 0, 0) * PAGE_SIZE;
+    check_trap(inst, "load", ADDR_COUNT32 + 2, "unaligned atomic", "unaligned i32.atomic.load did not trap");
+    check_trap(inst, "load64", ADDR_COUNT64 + 4, "unaligned atomic", "unaligned i64.atomic.load did not trap");
+    check_trap(inst, "load", end, "out of bounds memory access", "i32.atomic.load past the end did not trap");
+    check_trap(inst, "load64", end - 4, "out of bounds memory access", "i64.atomic.load across the end did not trap");
+    check(!call(inst, "add", 2, end, 1, 0) && strcmp(inst->exception, "out of bounds memory access") == 0,
+          "i32.atomic.rmw.add past the end did not trap");
+}
+
+int main(void) {
+    Memory *mem = create_shared_memory(1, MAX_PAGES);
+    HostSymbol symbols[] = {{"memory", mem}};
+    register_host_symbols("env", symbols, 1);
+    Options options = {0};
+    module = load_module(test_module, sizeof(test_module), options);
+
+    Thread threads[THREAD_COUNT];
+    for (uint32_t i = 0; i < THREAD_COUNT; i++) {
+        threads[i] = (Thread){.id = i, .inst = instantiate(module)};
+    }
+    Instance *inst = instantiate(module);
+
+    run_count(threads, inst);
+    run_wait(threads, inst);
+    run_grow(threads, inst);
+    run_traps(inst);
+
+    for (uint32_t i = 0; i < THREAD_COUNT; i++) {
+        free_instance(threads[i].inst);
+    }
+    free_instance(inst);
+    free_module(module);
+    free_shared_memory(mem);
+    printf("%s: %u threads on one shared memory, %u failures\n", failures ? "FAIL" : "PASS", THREAD_COUNT, failures);
+    return failures ? 1 : 0;
+}
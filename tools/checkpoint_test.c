@@ -0,0 +1,267 @@
+// 检查点回归测试：在带有导入函数的模块上，先以少量燃料调用导出函数，使其在被调用函数的循环中因燃料耗尽而暂停，
+// 然后反复执行【写入检查点 -> 从检查点恢复出新的实例 -> 补充燃料并继续执行】直到调用完成，最后与一次性执行完成的结果比较；
+// 同时检查头部或者栈帧中的运行时状态超出范围的检查点文件，以及被截断而不包含完整内存数据的检查点文件会被拒绝
+//
+// 用法：wasmc-checkpoint-test [DIR]
+// DIR 存放临时检查点文件的目录，默认为 /tmp
+//
+// 全部检查通过时返回 0，否则输出失败的检查并返回 1
+// 注：拒绝损坏的检查点文件时 restore_checkpoint 会在标准错误中输出 Corrupted checkpoint file，属于预期的输出
+
+#include "checkpoint.h"
+#include "import.h"
+#include "interpreter.h"
+#include "module.h"
+#include "utils.h"
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define CHECKPOINT_DIR "/tmp"// 默认的临时检查点文件目录
+#define PATH_SIZE 1024       // 文件路径的最大长度
+#define FUEL_STEP 40         // 每次执行补充的燃料，远小于完成调用所需的燃料，保证调用会暂停很多次
+#define LOOP_COUNT 200       // 导出函数的参数，即被调用函数中循环的次数
+
+// 测试模块，等价于下面的 WAT（函数 0 为导入函数，所以 $sum 和 $run 在所有函数中的索引分别为 1 和 2）：
+// (module
+//   (import "env" "mix" (func $mix (param i32 i32) (result i32)))
+//   (memory 1)
+//   (func $sum (param $n i32) (result i32)
+//     (local $i i32) (local $acc i32)
+//     block
+//       loop
+//         local.get $i
+//         local.get $n
+//         i32.ge_u
+//         br_if 1
+//         local.get $acc
+//         local.get $i
+//         call $mix
+//         local.set $acc
+//         i32.const 0
+//         local.get $acc
+//         i32.store
+//         local.get $i
+//         i32.const 1
+//         i32.add
+//         local.set $i
+//         br 0
+//       end
+//     end
+//     local.get $acc)
+//   (func $run (export "run") (param i32) (result i32)
+//     local.get 0
+//     call $sum
+//     i32.const 0
+//     i32.load
+//     i32.add))
+const uint8_t test_module[] = {
+        0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00,
+        // 类型段
+        0x01, 0x0c, 0x02, 0x60, 0x02, 0x7f, 0x7f, 0x01, 0x7f, 0x60, 0x01, 0x7f, 0x01, 0x7f,
+        // 导入段
+        0x02, 0x0b, 0x01, 0x03, 0x65, 0x6e, 0x76, 0x03, 0x6d, 0x69, 0x78, 0x00, 0x00,
+        // 函数段
+        0x03, 0x03, 0x02, 0x01, 0x01,
+        // 内存段
+        0x05, 0x03, 0x01, 0x00, 0x01,
+        // 导出段
+        0x07, 0x07, 0x01, 0x03, 0x72, 0x75, 0x6e, 0x00, 0x02,
+        // 代码段
+        0x0a, 0x3a, 0x02,
+        0x2b, 0x01, 0x02, 0x7f, 0x02, 0x40, 0x03, 0x40, 0x20, 0x01, 0x20, 0x00, 0x4f, 0x0d, 0x01, 0x20, 0x02, 0x20,
+        0x01, 0x10, 0x00, 0x21, 0x02, 0x41, 0x00, 0x20, 0x02, 0x36, 0x02, 0x00, 0x20, 0x01, 0x41, 0x01, 0x6a, 0x21,
+        0x01, 0x0c, 0x00, 0x0b, 0x0b, 0x20, 0x02, 0x0b,
+        0x0c, 0x00, 0x20, 0x00, 0x10, 0x01, 0x41, 0x00, 0x28, 0x02, 0x00, 0x6a, 0x0b,
+};
+
+uint32_t failures = 0;// 失败的检查数量
+
+// 检查条件 cond 是否成立，不成立时输出 what 并计为失败
+void check(bool cond, const char *what) {
+    if (!cond) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// 导入函数 env.mix：mix(a, b) = a * 31 + b
+bool host_mix(Instance *inst, StackValue *args, StackValue *results) {
+    (void) inst;
+    results[0].value.uint32 = args[0].value.uint32 * 31 + args[1].value.uint32;
+    return true;
+}
+
+// 将参数 LOOP_COUNT 压入操作数栈，准备调用导出函数
+void push_arg(Instance *inst) {
+    inst->sp = -1;
+    inst->fp = -1;
+    inst->csp = -1;
+    inst->stack[++inst->sp].value.uint32 = LOOP_COUNT;
+    inst->stack[inst->sp].value_type = I32;
+}
+
+// 判断实例的调用栈中是否有索引为 fidx 的函数的栈帧
+bool has_function_frame(Instance *inst, uint32_t fidx) {
+    for (int i = 0; i <= inst->csp; i++) {
+        Block *block = inst->callstack[i].block;
+        if (block->block_type == 0x00 && block->fidx == fidx) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 复制检查点文件 src 到 dst，并将偏移量为 offset 处的 4 个字节修改为 value
+bool corrupt_checkpoint(const char *src, const char *dst, uint64_t offset, uint32_t value) {
+    int byte_count;
+    uint8_t *bytes = mmap_file((char *) src, &byte_count);
+    if (!bytes || offset + sizeof(uint32_t) > (uint64_t) byte_count) {
+        return false;
+    }
+    FILE *file = fopen(dst, "wb");
+    bool ok = file && fwrite(bytes, 1, byte_count, file) == (size_t) byte_count &&
+              fseek(file, (long) offset, SEEK_SET) == 0 && fwrite(&value, sizeof(value), 1, file) == 1;
+    ok = file && fclose(file) == 0 && ok;
+    munmap(bytes, byte_count);
+    return ok;
+}
+
+// 将检查点文件 src 的前 size 个字节复制到 dst，即得到被截断为 size 字节的检查点文件
+bool truncate_checkpoint(const char *src, const char *dst, uint64_t size) {
+    int byte_count;
+    uint8_t *bytes = mmap_file((char *) src, &byte_count);
+    if (!bytes || size > (uint64_t) byte_count) {
+        return false;
+    }
+    FILE *file = fopen(dst, "wb");
+    bool ok = file && fwrite(bytes, 1, size, file) == size;
+    ok = file && fclose(file) == 0 && ok;
+    munmap(bytes, byte_count);
+    return ok;
+}
+
+// 检查检查点文件 path 会被拒绝
+void check_restore_fails(Module *m, const char *path, const char *what) {
+    Instance *inst = restore_checkpoint(m, path);
+    check(inst == NULL, what);
+    if (inst) {
+        free_instance(inst);
+    }
+}
+
+// 检查修改后的检查点文件会被拒绝
+void check_rejected(Module *m, const char *src, const char *dst, uint64_t offset, uint32_t value, const char *what) {
+    if (!corrupt_checkpoint(src, dst, offset, value)) {
+        check(false, "could not write corrupted checkpoint");
+        return;
+    }
+    check_restore_fails(m, dst, what);
+}
+
+// 检查截断后的检查点文件会被拒绝（内存数据以 MAP_FIXED 的方式映射文件，未拒绝时访问被截断的页会触发 SIGBUS）
+void check_truncated(Module *m, const char *src, const char *dst, uint64_t size, const char *what) {
+    if (!truncate_checkpoint(src, dst, size)) {
+        check(false, "could not write truncated checkpoint");
+        return;
+    }
+    check_restore_fails(m, dst, what);
+}
+
+int main(int argc, char **argv) {
+    const char *dir = argc > 1 ? argv[1] : CHECKPOINT_DIR;
+    char path[PATH_SIZE], bad_path[PATH_SIZE];
+    snprintf(path, PATH_SIZE, "%s/wasmc-checkpoint-test.%d", dir, (int) getpid());
+    snprintf(bad_path, PATH_SIZE, "%s/wasmc-checkpoint-test.%d.bad", dir, (int) getpid());
+
+    HostSymbol symbols[] = {{"mix", host_mix}};
+    register_host_symbols("env", symbols, 1);
+    Options options = {0};
+    Module *m = load_module(test_module, sizeof(test_module), options);
+    uint32_t handle = resolve_export(m, "run");
+
+    // 一次性执行完成的结果作为参照
+    Instance *inst = instantiate(m);
+    push_arg(inst);
+    check(invoke_export(inst, handle), "uninterrupted call failed");
+    uint32_t expected = inst->stack[inst->sp].value.uint32;
+    free_instance(inst);
+
+    // 以少量燃料调用，每次暂停时都写入检查点，再用恢复出的新实例继续执行
+    inst = instantiate(m);
+    push_arg(inst);
+    inst->fuel = FUEL_STEP;
+    ExecStatus status = invoke_resumable(inst, handle);
+    uint32_t rounds = 0;
+    bool mid_call = false, corrupted_checked = false;
+    while (status == EXEC_SUSPENDED && rounds < LOOP_COUNT * 10) {
+        rounds++;
+        check(inst->trap == TRAP_OUT_OF_FUEL, "suspended for a reason other than fuel");
+        mid_call = mid_call || (has_function_frame(inst, 1) && has_function_frame(inst, 2));
+        if (!write_checkpoint(inst, path)) {
+            check(false, "write_checkpoint failed");
+            break;
+        }
+
+        // 在被调用函数中暂停时，检查头部和栈帧中超出范围的运行时状态会被拒绝
+        if (!corrupted_checked && inst->csp > 0) {
+            corrupted_checked = true;
+            CheckpointHeader header;
+            int fd = open(path, O_RDONLY);
+            bool ok = fd >= 0 && pread(fd, &header, sizeof(header), 0) == sizeof(header);
+            if (fd >= 0) {
+                close(fd);
+            }
+            check(ok, "could not read checkpoint header");
+            uint64_t frame = header.callstack_offset + sizeof(CheckpointFrame) * header.csp;
+            check_rejected(m, path, bad_path, offsetof(CheckpointHeader, pc), m->byte_count, "header pc out of range accepted");
+            check_rejected(m, path, bad_path, offsetof(CheckpointHeader, fp), header.sp + 2, "header fp above sp + 1 accepted");
+            check_rejected(m, path, bad_path, offsetof(CheckpointHeader, fp), (uint32_t) -2, "header fp below -1 accepted");
+            check_rejected(m, path, bad_path, frame + offsetof(CheckpointFrame, fidx), 0, "frame of imported function accepted");
+            check_rejected(m, path, bad_path, frame + offsetof(CheckpointFrame, sp), STACK_SIZE, "frame sp out of range accepted");
+            check_rejected(m, path, bad_path, frame + offsetof(CheckpointFrame, fp), (uint32_t) -2, "frame fp below -1 accepted");
+            check_rejected(m, path, bad_path, frame + offsetof(CheckpointFrame, ra), m->byte_count, "frame ra out of range accepted");
+            uint64_t memory_end = header.memory_offset + (uint64_t) header.memory_pages * PAGE_SIZE;
+            check(header.memory_pages > 0, "checkpoint has no memory to truncate");
+            check_truncated(m, path, bad_path, memory_end - 1, "checkpoint truncated inside memory accepted");
+            check_truncated(m, path, bad_path, header.memory_offset, "checkpoint truncated before memory accepted");
+        }
+
+        Instance *restored = restore_checkpoint(m, path);
+        if (!restored) {
+            check(false, "restore_checkpoint failed");
+            break;
+        }
+        check(restored->csp == inst->csp && restored->sp == inst->sp && restored->fp == inst->fp && restored->pc == inst->pc,
+              "restored registers differ");
+        for (int i = 0; i <= inst->csp && i <= restored->csp; i++) {
+            check(restored->callstack[i].block == inst->callstack[i].block, "restored frame has a different block");
+        }
+        free_instance(inst);
+        inst = restored;
+        inst->fuel = FUEL_STEP;
+        status = resume(inst);
+    }
+
+    check(status == EXEC_DONE, "resumed call did not complete");
+    check(rounds > 1, "call did not suspend more than once");
+    check(mid_call, "call never suspended inside the called function");
+    check(corrupted_checked, "corrupted checkpoints were not checked");
+    check(status == EXEC_DONE && inst->stack[inst->sp].value.uint32 == expected, "resumed result differs from uninterrupted run");
+    if (status != EXEC_DONE) {
+        printf("exception: %s\n", inst->exception);
+    }
+
+    free_instance(inst);
+    free_module(m);
+    unlink(path);
+    unlink(bad_path);
+    printf("%s: %u checkpoints, result 0x%x, %u failures\n", failures ? "FAIL" : "PASS", rounds, expected, failures);
+    return failures ? 1 : 0;
+}
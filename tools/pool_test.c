@@ -0,0 +1,232 @@
+// 实例池回归测试：从实例池中获取实例后修改其全局变量、表和内存（包括增长到超出模板实例的页数），
+// 再让其因陷阱失败、因燃料耗尽暂停，并模拟调度器和异步 I/O 留下的状态，然后归还实例并重新获取同一个槽位，
+// 逐字节检查重新获取的实例与新实例化的实例一致，且增长过的内存在缩回后已被清零
+// 同时覆盖重置内存的两种方式：以 MADV_DONTNEED 丢弃内存文件的私有副本，以及不支持内存文件时直接拷贝模板实例的内存数据
+//
+// 用法：wasmc-pool-test
+//
+// 全部检查通过时返回 0，否则输出失败的检查并返回 1
+
+#include "interpreter.h"
+#include "module.h"
+#include "pool.h"
+#include "utils.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define POOL_SLOTS 2    // 实例池的槽位数量
+#define ROUNDS 3        // 每个实例池中【修改 -> 归还 -> 重新获取】的轮数
+#define SPIN_FUEL 50    // 调用死循环函数时的燃料，耗尽后调用暂停
+#define GROW_PAGES 2    // 导出函数 dirty 增长的内存页数
+#define MESSAGE_SIZE 256// 失败信息的最大长度
+
+// 测试模块，等价于下面的 WAT：
+// (module
+//   (memory 1 4)
+//   (table 2 anyfunc)
+//   (global $g (mut i32) (i32.const 7))
+//   (func $seven (result i32)
+//     i32.const 7)
+//   (func $dirty (export "dirty") (param $v i32) (result i32)
+//     i32.const 0        ;; 覆盖数据段初始化的数据
+//     local.get $v
+//     i32.store
+//     i32.const 40000    ;; 写入模板实例中全为 0 的位置
+//     local.get $v
+//     i32.store
+//     local.get $v
+//     global.set $g
+//     i32.const 2        ;; 增长到超出模板实例的页数，并写入增长的部分
+//     memory.grow
+//     drop
+//     i32.const 131088
+//     local.get $v
+//     i32.store
+//     memory.size)
+//   (func $trap (export "trap")
+//     unreachable)
+//   (func $spin (export "spin")
+//     loop
+//       br 0
+//     end)
+//   (elem (i32.const 0) $seven)
+//   (data (i32.const 0) "wasmc pool"))
+const uint8_t test_module[] = {
+        0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00,
+        // 类型段
+        0x01, 0x0d, 0x03, 0x60, 0x00, 0x01, 0x7f, 0x60, 0x01, 0x7f, 0x01, 0x7f, 0x60, 0x00, 0x00,
+        // 函数段
+        0x03, 0x05, 0x04, 0x00, 0x01, 0x02, 0x02,
+        // 表段
+        0x04, 0x04, 0x01, 0x70, 0x00, 0x02,
+        // 内存段
+        0x05, 0x04, 0x01, 0x01, 0x01, 0x04,
+        // 全局段
+        0x06, 0x06, 0x01, 0x7f, 0x01, 0x41, 0x07, 0x0b,
+        // 导出段
+        0x07, 0x17, 0x03, 0x05, 0x64, 0x69, 0x72, 0x74, 0x79, 0x00, 0x01, 0x04, 0x74, 0x72, 0x61, 0x70, 0x00, 0x02,
+        0x04, 0x73, 0x70, 0x69, 0x6e, 0x00, 0x03,
+        // 元素段
+        0x09, 0x07, 0x01, 0x00, 0x41, 0x00, 0x0b, 0x01, 0x00,
+        // 代码段
+        0x0a, 0x39, 0x04, 0x04, 0x00, 0x41, 0x07, 0x0b, 0x26, 0x00, 0x41, 0x00, 0x20, 0x00, 0x36, 0x02, 0x00, 0x41,
+        0xc0, 0xb8, 0x02, 0x20, 0x00, 0x36, 0x02, 0x00, 0x20, 0x00, 0x24, 0x00, 0x41, 0x02, 0x40, 0x00, 0x1a, 0x41,
+        0x90, 0x80, 0x08, 0x20, 0x00, 0x36, 0x02, 0x00, 0x3f, 0x00, 0x0b, 0x03, 0x00, 0x00, 0x0b, 0x07, 0x00, 0x03,
+        0x40, 0x0c, 0x00, 0x0b, 0x0b,
+        // 数据段
+        0x0b, 0x10, 0x01, 0x00, 0x41, 0x00, 0x0b, 0x0a, 0x77, 0x61, 0x73, 0x6d, 0x63, 0x20, 0x70, 0x6f, 0x6f, 0x6c,
+};
+
+uint32_t failures = 0;// 失败的检查数量
+
+// 检查条件 cond 是否成立，不成立时输出 what 并计为失败
+void check(bool cond, const char *what) {
+    if (!cond) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// 检查条件 cond 是否成立，不成立时输出【场景 scene: 字段 field 不一致】并计为失败
+void check_field(bool cond, const char *scene, const char *field) {
+    char message[MESSAGE_SIZE];
+    snprintf(message, sizeof(message), "%s: %s differs from a fresh instance", scene, field);
+    check(cond, message);
+}
+
+// 重置运行时状态并压入参数，准备调用导出函数
+void prepare_call(Instance *inst, bool has_arg, uint32_t arg) {
+    inst->sp = -1;
+    inst->fp = -1;
+    inst->csp = -1;
+    inst->exception[0] = '\0';
+    if (has_arg) {
+        inst->stack[++inst->sp].value.uint32 = arg;
+        inst->stack[inst->sp].value_type = I32;
+    }
+}
+
+// 逐字节比较槽位实例与新实例化的实例中所有会被使用者修改的状态，并检查预留内存中超出当前页数的部分都为 0
+void compare_with_fresh(Instance *inst, Instance *fresh, const char *scene) {
+    Module *m = fresh->module;
+
+    check_field(inst->module == m, scene, "module");
+    check_field(memcmp(inst->globals, fresh->globals, sizeof(StackValue) * m->global_count) == 0, scene, "globals");
+    check_field(inst->table.cur_size == fresh->table.cur_size &&
+                        memcmp(inst->table.entries, fresh->table.entries, sizeof(uint32_t) * fresh->table.cur_size) == 0,
+                scene, "table");
+    check_field(inst->memory.cur_size == fresh->memory.cur_size &&
+                        memcmp(inst->memory.bytes, fresh->memory.bytes, (size_t) fresh->memory.cur_size * PAGE_SIZE) == 0,
+                scene, "memory");
+
+    // 上一个使用者增长过的内存页在缩回后必须为 0，否则再次增长时会读到上一个使用者的数据
+    bool zero = true;
+    size_t grown_end = (size_t) (fresh->memory.cur_size + GROW_PAGES) * PAGE_SIZE;
+    for (size_t i = (size_t) fresh->memory.cur_size * PAGE_SIZE; i < grown_end && zero; i++) {
+        zero = inst->memory.bytes[i] == 0;
+    }
+    check_field(zero, scene, "memory beyond the current size");
+
+    check_field(strcmp(inst->exception, fresh->exception) == 0, scene, "exception");
+    check_field(inst->trap == fresh->trap, scene, "trap");
+    check_field(inst->suspend_request == fresh->suspend_request, scene, "suspend_request");
+    check_field(inst->fuel == fresh->fuel, scene, "fuel");
+    check_field(inst->epoch_deadline == fresh->epoch_deadline, scene, "epoch_deadline");
+    check_field(atomic_load(&inst->running_worker) == atomic_load(&fresh->running_worker), scene, "running_worker");
+    check_field(atomic_load(&inst->home_worker) == atomic_load(&fresh->home_worker), scene, "home_worker");
+    check_field(inst->aio == fresh->aio, scene, "aio");
+    check_field(inst->pc == fresh->pc && inst->sp == fresh->sp && inst->fp == fresh->fp && inst->csp == fresh->csp,
+                scene, "registers");
+}
+
+// 修改实例的全局变量、表和内存，并让其依次因陷阱失败、因燃料耗尽暂停，再模拟调度器和异步 I/O 留下的状态
+void dirty_instance(Instance *inst, uint32_t value) {
+    Module *m = inst->module;
+
+    prepare_call(inst, true, value);
+    bool ok = invoke_export(inst, resolve_export(m, "dirty"));
+    check(ok && inst->stack[inst->sp].value.uint32 == m->memory.min_size + GROW_PAGES, "dirty did not grow memory");
+    check(inst->globals[0].value.uint32 == value, "dirty did not set the global");
+
+    // Wasm 1.0 中没有修改表的指令，所以由宿主直接修改表中元素
+    inst->table.entries[0] = value;
+    inst->table.entries[1] = value + 1;
+
+    prepare_call(inst, false, 0);
+    check(!invoke_export(inst, resolve_export(m, "trap")), "trap did not trap");
+
+    prepare_call(inst, false, 0);
+    inst->fuel = SPIN_FUEL;
+    ExecStatus status = invoke_resumable(inst, resolve_export(m, "spin"));
+    check(status == EXEC_SUSPENDED && inst->trap == TRAP_OUT_OF_FUEL && inst->csp >= 0, "spin did not suspend on fuel");
+
+    // 调度器在执行任务期间会设置这些状态，异步宿主函数暂停时会留下暂停请求和 I/O 请求
+    inst->suspend_request = TRAP_WAIT_IO;
+    atomic_store(&inst->running_worker, 1);
+    atomic_store(&inst->home_worker, 2);
+    inst->aio = (struct AioRequest *) inst;
+    inst->epoch_deadline = 1;
+}
+
+// 在实例池上执行 ROUNDS 轮【修改 -> 归还 -> 重新获取】，每次获取后都与新实例化的实例比较
+void run_pool(Module *m, Instance *fresh, bool use_image) {
+    InstancePool *pool = create_pool(m, POOL_SLOTS);
+    const char *scene = use_image ? "MADV_DONTNEED reset" : "memcpy reset";
+    if (use_image) {
+        check(pool->image_fd >= 0, "memory image was not created, MADV_DONTNEED path not covered");
+    } else if (pool->image_fd >= 0) {
+        // 模拟不支持内存文件的系统：槽位在首次被获取时才初始化，所以在获取之前关闭内存文件即可
+        close(pool->image_fd);
+        pool->image_fd = -1;
+    }
+
+    Instance *inst = pool_acquire(pool);
+    compare_with_fresh(inst, fresh, scene);
+
+    // 空闲链表是后进先出的，所以归还后重新获取的是同一个槽位
+    for (uint32_t round = 0; round < ROUNDS; round++) {
+        dirty_instance(inst, 0x1000 + round);
+        pool_release(pool, inst);
+        Instance *again = pool_acquire(pool);
+        check(again == inst, "released slot was not reused");
+        inst = again;
+        compare_with_fresh(inst, fresh, scene);
+    }
+
+    // 获取其余的槽位，槽位全部被获取后应返回 NULL
+    Instance *others[POOL_SLOTS];
+    for (uint32_t i = 1; i < POOL_SLOTS; i++) {
+        others[i] = pool_acquire(pool);
+        check(others[i] != NULL && others[i] != inst, "pool did not hand out a distinct slot");
+        if (others[i]) {
+            compare_with_fresh(others[i], fresh, scene);
+        }
+    }
+    check(pool_acquire(pool) == NULL, "exhausted pool handed out a slot");
+
+    for (uint32_t i = 1; i < POOL_SLOTS; i++) {
+        if (others[i]) {
+            pool_release(pool, others[i]);
+        }
+    }
+    pool_release(pool, inst);
+    free_pool(pool);
+}
+
+int main(void) {
+    Options options = {0};
+    Module *m = load_module(test_module, sizeof(test_module), options);
+    Instance *fresh = instantiate(m);
+
+    run_pool(m, fresh, true);
+    run_pool(m, fresh, false);
+
+    free_instance(fresh);
+    free_module(m);
+    printf("%s: %u slots, %u rounds per pool, %u failures\n", failures ? "FAIL" : "PASS", POOL_SLOTS, ROUNDS, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,285 @@
+// 调度器回归测试：多个线程同时向调度器批量提交任务，任务分布在多个实例上，执行时间相差 1000 倍，
+// 其中一部分任务会因陷阱、无效的导出函数句柄或者参数数量不符而失败，检查每个任务的结果、异常信息和回调函数，
+// 同时由导入函数记录每个实例上正在执行的任务数量，检查同一实例上的任务从不并发执行（导入函数还会请求让出执行，
+// 让任务在执行中途暂停，暂停期间实例仍被持有，其上的其他任务必须等待），通常配合 ThreadSanitizer 构建运行
+//
+// 用法：wasmc-scheduler-test [-w N]
+// -w N 工作线程数量，默认为 4
+//
+// 全部检查通过时返回 0，否则输出前几次错误并返回 1
+
+#include "import.h"
+#include "interpreter.h"
+#include "module.h"
+#include "scheduler.h"
+#include "utils.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INSTANCE_COUNT 6 // 实例数量
+#define SUBMITTER_COUNT 2// 提交任务的线程数量
+#define JOB_COUNT 600    // 每个线程提交的任务数量
+#define SHORT_LOOP 20    // 短任务的循环次数
+#define LONG_LOOP 20000  // 长任务的循环次数，约为短任务的 1000 倍
+#define LONG_EVERY 16    // 每 LONG_EVERY 个任务中有一个长任务
+#define FAIL_EVERY 7     // 每 FAIL_EVERY 个任务中有一个因陷阱失败的任务
+#define REPORT_LIMIT 5   // 最多输出的错误数量
+
+// 测试模块，等价于下面的 WAT（函数 0 和 1 为导入函数，所以 $work 和 $fail 在所有函数中的索引分别为 2 和 3）：
+// (module
+//   (import "env" "enter" (func $enter))
+//   (import "env" "leave" (func $leave))
+//   (memory 1)
+//   (func $work (export "work") (param $n i32) (result i32) (local $i i32) (local $acc i32)
+//     call $enter
+//     block
+//       loop
+//         local.get $i
+//         local.get $n
+//         i32.ge_u
+//         br_if 1
+//         local.get $acc
+//         i32.const 31
+//         i32.mul
+//         local.get $i
+//         i32.add
+//         local.set $acc
+//         local.get $i
+//         i32.const 1
+//         i32.add
+//         local.set $i
+//         br 0
+//       end
+//     end
+//     call $leave
+//     local.get $acc)
+//   (func $fail (export "fail") (param $n i32) (result i32)
+//     call $enter
+//     call $leave
+//     unreachable))
+const uint8_t test_module[] = {
+        0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00,
+        // 类型段
+        0x01, 0x09, 0x02, 0x60, 0x00, 0x00, 0x60, 0x01, 0x7f, 0x01, 0x7f,
+        // 导入段
+        0x02, 0x19, 0x02, 0x03, 0x65, 0x6e, 0x76, 0x05, 0x65, 0x6e, 0x74, 0x65, 0x72, 0x00, 0x00, 0x03, 0x65, 0x6e,
+        0x76, 0x05, 0x6c, 0x65, 0x61, 0x76, 0x65, 0x00, 0x00,
+        // 函数段
+        0x03, 0x03, 0x02, 0x01, 0x01,
+        // 内存段
+        0x05, 0x03, 0x01, 0x00, 0x01,
+        // 导出段
+        0x07, 0x0f, 0x02, 0x04, 0x77, 0x6f, 0x72, 0x6b, 0x00, 0x02, 0x04, 0x66, 0x61, 0x69, 0x6c, 0x00, 0x03,
+        // 代码段
+        0x0a, 0x34, 0x02, 0x2a, 0x01, 0x02, 0x7f, 0x10, 0x00, 0x02, 0x40, 0x03, 0x40, 0x20, 0x01, 0x20, 0x00, 0x4f,
+        0x0d, 0x01, 0x20, 0x02, 0x41, 0x1f, 0x6c, 0x20, 0x01, 0x6a, 0x21, 0x02, 0x20, 0x01, 0x41, 0x01, 0x6a, 0x21,
+        0x01, 0x0c, 0x00, 0x0b, 0x0b, 0x10, 0x01, 0x20, 0x02, 0x0b, 0x07, 0x00, 0x10, 0x00, 0x10, 0x01, 0x00, 0x0b,
+};
+
+// 任务的期望结果
+typedef struct Expected {
+    bool ok;              // 是否应该成功执行
+    uint32_t result;      // 成功时的返回值
+    const char *exception;// 失败时的异常信息
+} Expected;
+
+Module *module;                         // 所有实例共享的模块
+Scheduler *scheduler;                   // 所有线程共享的调度器
+Instance *instances[INSTANCE_COUNT];    // 所有实例
+_Atomic uint32_t active[INSTANCE_COUNT];// 每个实例上正在执行的任务数量
+_Atomic uint32_t in_flight;             // 所有实例上已经开始但尚未结束的任务数量（包括让出执行的任务）
+_Atomic uint32_t max_in_flight;         // in_flight 的最大值
+_Atomic uint32_t errors;                // 出现的错误数量
+
+// 记录一次错误，只输出前 REPORT_LIMIT 次错误的详细信息
+void report(const char *what, uint32_t index, const char *detail) {
+    if (atomic_fetch_add(&errors, 1) < REPORT_LIMIT) {
+        printf("job %u: %s (%s)\n", index, what, detail);
+    }
+}
+
+// 获取实例在 instances 中的编号
+uint32_t instance_id(Instance *inst) {
+    for (uint32_t i = 0; i < INSTANCE_COUNT; i++) {
+        if (instances[i] == inst) {
+            return i;
+        }
+    }
+    FATAL("Unknown instance %p\n", (void *) inst)
+}
+
+// 导入函数 env.enter：记录实例上开始执行一个任务，如果实例上已经有任务在执行则记为错误，然后请求让出执行
+bool host_enter(Instance *inst, StackValue *args, StackValue *results) {
+    (void) args;
+    (void) results;
+    uint32_t id = instance_id(inst);
+    if (atomic_fetch_add(&active[id], 1) != 0) {
+        report("ran concurrently with another job on the same instance", id, "enter");
+    }
+    uint32_t now = atomic_fetch_add(&in_flight, 1) + 1;
+    uint32_t max = atomic_load(&max_in_flight);
+    while (now > max && !atomic_compare_exchange_weak(&max_in_flight, &max, now)) {
+    }
+    request_yield(inst);
+    return true;
+}
+
+// 导入函数 env.leave：记录实例上的任务执行结束
+bool host_leave(Instance *inst, StackValue *args, StackValue *results) {
+    (void) args;
+    (void) results;
+    uint32_t id = instance_id(inst);
+    if (atomic_fetch_sub(&active[id], 1) != 1) {
+        report("ran concurrently with another job on the same instance", id, "leave");
+    }
+    atomic_fetch_sub(&in_flight, 1);
+    return true;
+}
+
+// 计算导出函数 work 的期望返回值
+uint32_t expected_work(uint32_t n) {
+    uint32_t acc = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        acc = acc * 31 + i;
+    }
+    return acc;
+}
+
+// 每个提交任务的线程的状态
+typedef struct Submitter {
+    uint32_t id;                          // 线程编号
+    Job jobs[JOB_COUNT];                  // 提交的任务
+    StackValue args[JOB_COUNT];           // 任务的参数
+    Expected expected[JOB_COUNT];         // 任务的期望结果
+    _Atomic uint32_t callbacks[JOB_COUNT];// 每个任务的回调函数被调用的次数
+} Submitter;
+
+// 检查任务的结果与期望结果是否一致
+void check_job(Submitter *sub, uint32_t i, const char *where) {
+    Job *job = &sub->jobs[i];
+    Expected *exp = &sub->expected[i];
+    uint32_t index = sub->id * JOB_COUNT + i;
+    if (job->ok != exp->ok) {
+        report(exp->ok ? "failed unexpectedly" : "succeeded unexpectedly", index, exp->ok ? job->exception : where);
+    } else if (exp->ok && (job->result_count != 1 || job->result.value.uint32 != exp->result)) {
+        report("returned a wrong result", index, where);
+    } else if (!exp->ok && strcmp(job->exception, exp->exception) != 0) {
+        report("failed with a wrong exception", index, job->exception);
+    }
+}
+
+// 任务完成时的回调函数：在执行任务的工作线程中调用，此时任务的结果已经填写完成，但尚未标记为已完成
+void on_job_done(Job *job, void *data) {
+    Submitter *sub = data;
+    uint32_t i = (uint32_t) (job - sub->jobs);
+    atomic_fetch_add(&sub->callbacks[i], 1);
+    if (atomic_load(&job->done)) {
+        report("was marked done before its callback", sub->id * JOB_COUNT + i, "callback");
+    }
+    check_job(sub, i, "callback");
+}
+
+// 提交任务的线程：一次性批量提交 JOB_COUNT 个任务，等待全部完成后检查结果和回调函数
+void *submitter_main(void *arg) {
+    Submitter *sub = arg;
+    uint32_t work = resolve_export(module, "work");
+    uint32_t fail = resolve_export(module, "fail");
+
+    for (uint32_t i = 0; i < JOB_COUNT; i++) {
+        uint32_t n = (i + sub->id) % LONG_EVERY == 0 ? LONG_LOOP : SHORT_LOOP + i % 10;
+        sub->args[i] = (StackValue) {.value_type = I32, .value.uint32 = n};
+        sub->jobs[i] = (Job) {
+                .inst = instances[(i * 7 + sub->id) % INSTANCE_COUNT],
+                .handle = work,
+                .args = &sub->args[i],
+                .arg_count = 1,
+                .callback = on_job_done,
+                .data = sub,
+        };
+        sub->expected[i] = (Expected) {.ok = true, .result = expected_work(n)};
+
+        // 部分任务因陷阱、无效的导出函数句柄或者参数数量不符而失败
+        if (i % FAIL_EVERY == 3) {
+            sub->jobs[i].handle = fail;
+            sub->expected[i] = (Expected) {.ok = false, .exception = "unreachable"};
+        } else if (i == 5) {
+            sub->jobs[i].handle = module->export_count;
+            sub->expected[i] = (Expected) {.ok = false, .exception = "export handle 2 is not a function"};
+        } else if (i == 6) {
+            sub->jobs[i].arg_count = 0;
+            sub->expected[i] = (Expected) {.ok = false, .exception = "expected 1 arguments, got 0"};
+        }
+    }
+
+    scheduler_submit(scheduler, sub->jobs, JOB_COUNT);
+
+    // 前一半任务逐个等待，后一半任务统一等待
+    for (uint32_t i = 0; i < JOB_COUNT / 2; i++) {
+        if (job_wait(scheduler, &sub->jobs[i]) != sub->expected[i].ok) {
+            report("job_wait returned a wrong status", sub->id * JOB_COUNT + i, "job_wait");
+        }
+    }
+    scheduler_wait_all(scheduler);
+
+    for (uint32_t i = 0; i < JOB_COUNT; i++) {
+        uint32_t index = sub->id * JOB_COUNT + i;
+        if (!atomic_load(&sub->jobs[i].done)) {
+            report("was not marked done", index, "wait");
+        }
+        if (atomic_load(&sub->callbacks[i]) != 1) {
+            report("callback was not called exactly once", index, "wait");
+        }
+        check_job(sub, i, "wait");
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    uint32_t worker_count = 4;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            worker_count = (uint32_t) strtoul(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "The right usage is:\n%s [-w N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    HostSymbol symbols[] = {{"enter", host_enter}, {"leave", host_leave}};
+    register_host_symbols("env", symbols, 2);
+    Options options = {0};
+    module = load_module(test_module, sizeof(test_module), options);
+    for (uint32_t i = 0; i < INSTANCE_COUNT; i++) {
+        instances[i] = instantiate(module);
+    }
+    scheduler = create_scheduler(worker_count);
+
+    static Submitter submitters[SUBMITTER_COUNT];
+    pthread_t threads[SUBMITTER_COUNT];
+    for (uint32_t t = 0; t < SUBMITTER_COUNT; t++) {
+        submitters[t].id = t;
+        if (pthread_create(&threads[t], NULL, submitter_main, &submitters[t]) != 0) {
+            FATAL("Could not create submitter thread\n")
+        }
+    }
+    for (uint32_t t = 0; t < SUBMITTER_COUNT; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    uint32_t workers = scheduler->worker_count;
+    free_scheduler(scheduler);
+    for (uint32_t i = 0; i < INSTANCE_COUNT; i++) {
+        free_instance(instances[i]);
+    }
+    free_module(module);
+
+    uint32_t total = atomic_load(&errors);
+    printf("%s: %u workers, %u jobs on %u instances, at most %u in flight, %u errors\n", total ? "FAIL" : "PASS",
+           workers, SUBMITTER_COUNT * JOB_COUNT, INSTANCE_COUNT, atomic_load(&max_in_flight), total);
+    return total ? 1 : 0;
+}
@@ -0,0 +1,816 @@
+// 规范测试运行器：解析 res/spectest 中由 wast2json 生成的 *.json 文件，在进程内加载其引用的 .wasm 文件并执行断言，
+// 输出每个文件的通过数量和执行耗时，作为解释器的正确性和性能回归检查
+//
+// 用法：wasmc-spectest [-j N] [-v] [-d DIR] [-b FILE] [-w FILE] [NAME|FILE.json ...]
+// -j N    同时运行的子进程数量，默认为 CPU 核数
+// -v      输出每条失败断言的详细信息
+// -d DIR  规范测试目录，默认为 res/spectest
+// -b FILE 与基线文件（例如 tools/spectest_baseline.txt）中每个文件的通过和失败数量比较，只有与基线不一致时才返回 1
+// -w FILE 将每个文件的通过和失败数量写入基线文件（修复或引入失败的断言后用于更新基线）
+// NAME    只运行 DIR/NAME/NAME.json（例如 i32 f64 br_table），不指定时运行目录下的所有文件
+//
+// 每个模块及其后续的断言（直到下一个模块）在单独的子进程中执行：加载模块失败时解释器会直接退出进程（FATAL），
+// 这样只会影响该模块的断言；子进程把结果写入与父进程共享的内存中，子进程异常退出时其尚未执行的断言计为失败
+// 注：只执行 assert_return、assert_trap、assert_exhaustion 以及 action 命令，
+// 其他命令（例如 assert_invalid、assert_malformed、register）以及调用其他具名模块的命令计为跳过
+
+#include "import.h"
+#include "interpreter.h"
+#include "module.h"
+#include "utils.h"
+#include <dirent.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SPECTEST_DIR "res/spectest"// 默认的规范测试目录
+#define PATH_SIZE 1024             // 文件路径的最大长度
+#define BASELINE_LINE_SIZE 256     // 基线文件中每行的最大长度
+
+// JSON 值的类型
+typedef enum JsonType {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT,
+} JsonType;
+
+// JSON 值（wast2json 生成的文件只包含对象、数组、字符串和整数）
+typedef struct JsonValue {
+    JsonType type;
+    char *str;               // 字符串的值
+    double num;              // 数字或者布尔值的值
+    char **keys;             // 对象的键
+    struct JsonValue **items;// 数组的元素或者对象的值
+    uint32_t count;          // 元素或者键值对的数量
+} JsonValue;
+
+// 测试段：一个模块以及其后直到下一个模块为止的所有命令，在一个子进程中执行
+typedef struct SpecSegment {
+    uint32_t file;     // 所属的测试文件
+    char *wasm_path;   // 模块的 .wasm 文件路径
+    char *module_name; // 模块的名称（例如 $M1，可以为 NULL）
+    JsonValue **cmds;  // 需要执行的命令
+    uint32_t cmd_count;// 需要执行的命令数量
+} SpecSegment;
+
+// 测试段的执行结果，位于父子进程共享的内存中
+typedef struct SpecResult {
+    uint32_t passed;// 通过的断言数量
+    uint32_t failed;// 失败的断言数量
+    uint32_t done;  // 已经执行的断言数量
+    uint64_t ns;    // 加载模块和执行断言的耗时（纳秒）
+} SpecResult;
+
+// 测试文件
+typedef struct SpecFile {
+    char *name;    // 名称，即 .json 文件名去掉扩展名
+    char *dir;     // 所在的目录
+    JsonValue *doc;// 解析得到的 JSON 文档
+} SpecFile;
+
+// 基线文件中一个测试文件的通过和失败数量
+typedef struct BaselineEntry {
+    char name[BASELINE_LINE_SIZE];// 测试文件的名称
+    uint32_t passed;              // 通过的断言数量
+    uint32_t failed;              // 失败的断言数量
+    bool seen;                    // 本次是否运行了该测试文件
+} BaselineEntry;
+
+bool verbose = false;// 是否输出失败断言的详细信息
+
+// spectest 模块提供给测试模块导入的宿主符号
+StackValue spectest_global_i32 = {I32, {.uint32 = 666}};
+StackValue spectest_global_i64 = {I64, {.uint64 = 666}};
+StackValue spectest_global_f32 = {F32, {.f32 = 666.6f}};
+StackValue spectest_global_f64 = {F64, {.f64 = 666.6}};
+Table spectest_table;
+Memory spectest_memory;
+
+// 获取单调时钟的纳秒数
+uint64_t spectest_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+// 跳过空白字符
+void json_skip_space(char **p) {
+    while (**p == ' ' || **p == '\n' || **p == '\r' || **p == '\t') {
+        (*p)++;
+    }
+}
+
+// 解析 JSON 字符串（p 指向开头的引号），只处理 wast2json 会生成的转义字符
+char *json_parse_string(char **p) {
+    char *start = ++(*p);
+    char *out = start;
+    // 原地解码：解码后的字符串不会比原字符串长
+    while (**p && **p != '"') {
+        if (**p == '\\') {
+            (*p)++;
+            switch (**p) {
+                case 'n':
+                    *out++ = '\n';
+                    break;
+                case 't':
+                    *out++ = '\t';
+                    break;
+                case 'u': {
+                    // \uXXXX 只会出现在导出名中，按照 UTF-8 编码写回
+                    unsigned int cp = 0;
+                    sscanf(*p + 1, "%4x", &cp);
+                    *p += 4;
+                    if (cp < 0x80) {
+                        *out++ = (char) cp;
+                    } else if (cp < 0x800) {
+                        *out++ = (char) (0xC0 | (cp >> 6));
+                        *out++ = (char) (0x80 | (cp & 0x3F));
+                    } else {
+                        *out++ = (char) (0xE0 | (cp >> 12));
+                        *out++ = (char) (0x80 | ((cp >> 6) & 0x3F));
+                        *out++ = (char) (0x80 | (cp & 0x3F));
+                    }
+                    break;
+                }
+                default:
+                    *out++ = **p;
+                    break;
+            }
+            (*p)++;
+        } else {
+            *out++ = *(*p)++;
+        }
+    }
+    ASSERT(**p == '"', "Unterminated JSON string\n")
+    (*p)++;
+    *out = '\0';
+    return start;
+}
+
+// 解析 JSON 值（原地修改输入的字符串）
+JsonValue *json_parse(char **p) {
+    JsonValue *v = acalloc(1, sizeof(JsonValue), "JsonValue");
+    json_skip_space(p);
+    switch (**p) {
+        case '{':
+        case '[': {
+            bool object = **p == '{';
+            char close = object ? '}' : ']';
+            v->type = object ? JSON_OBJECT : JSON_ARRAY;
+            (*p)++;
+            json_skip_space(p);
+            uint32_t capacity = 0;
+            while (**p != close) {
+                if (v->count == capacity) {
+                    uint32_t new_capacity = capacity ? capacity * 2 : 8;
+                    v->items = arecalloc(v->items, capacity, new_capacity, sizeof(JsonValue *), "JsonValue items");
+                    if (object) {
+                        v->keys = arecalloc(v->keys, capacity, new_capacity, sizeof(char *), "JsonValue keys");
+                    }
+                    capacity = new_capacity;
+                }
+                if (object) {
+                    json_skip_space(p);
+                    ASSERT(**p == '"', "Expected JSON object key\n")
+                    v->keys[v->count] = json_parse_string(p);
+                    json_skip_space(p);
+                    ASSERT(**p == ':', "Expected ':' in JSON object\n")
+                    (*p)++;
+                }
+                v->items[v->count++] = json_parse(p);
+                json_skip_space(p);
+                if (**p == ',') {
+                    (*p)++;
+                    json_skip_space(p);
+                }
+            }
+            (*p)++;
+            break;
+        }
+        case '"':
+            v->type = JSON_STRING;
+            v->str = json_parse_string(p);
+            break;
+        case 't':
+        case 'f':
+            v->type = JSON_BOOL;
+            v->num = **p == 't';
+            *p += **p == 't' ? 4 : 5;
+            break;
+        case 'n':
+            v->type = JSON_NULL;
+            *p += 4;
+            break;
+        default:
+            v->type = JSON_NUMBER;
+            v->num = strtod(*p, p);
+            break;
+    }
+    return v;
+}
+
+// 获取 JSON 对象中键为 key 的值，不存在时返回 NULL
+JsonValue *json_get(JsonValue *obj, const char *key) {
+    if (!obj || obj->type != JSON_OBJECT) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < obj->count; i++) {
+        if (strcmp(obj->keys[i], key) == 0) {
+            return obj->items[i];
+        }
+    }
+    return NULL;
+}
+
+// 获取 JSON 对象中键为 key 的字符串，不存在时返回 NULL
+char *json_get_str(JsonValue *obj, const char *key) {
+    JsonValue *v = json_get(obj, key);
+    return v && v->type == JSON_STRING ? v->str : NULL;
+}
+
+// 根据值类型的名称获取值类型
+uint8_t parse_value_type(const char *name) {
+    if (strcmp(name, "i32") == 0) {
+        return I32;
+    } else if (strcmp(name, "i64") == 0) {
+        return I64;
+    } else if (strcmp(name, "f32") == 0) {
+        return F32;
+    } else if (strcmp(name, "f64") == 0) {
+        return F64;
+    }
+    return 0;
+}
+
+// 解析命令中的参数或者期望值 {"type": "i32", "value": "1"}，浮点数的值为其位模式
+bool parse_value(JsonValue *v, StackValue *sv) {
+    char *type = json_get_str(v, "type");
+    char *value = json_get_str(v, "value");
+    if (!type || !value || !(sv->value_type = parse_value_type(type))) {
+        return false;
+    }
+    sv->value.uint64 = strtoull(value, NULL, 10);
+    return true;
+}
+
+// 比较返回值和期望值，期望值为 nan:canonical 或者 nan:arithmetic 时只检查 NaN 的种类
+bool match_value(JsonValue *expected, StackValue *got) {
+    char *type = json_get_str(expected, "type");
+    char *value = json_get_str(expected, "value");
+    uint8_t value_type = type ? parse_value_type(type) : 0;
+    if (!value || value_type != got->value_type) {
+        return false;
+    }
+    switch (value_type) {
+        case I32:
+            return got->value.uint32 == (uint32_t) strtoull(value, NULL, 10);
+        case F32:
+            if (strcmp(value, "nan:canonical") == 0) {
+                return (got->value.uint32 & 0x7FFFFFFF) == 0x7FC00000;
+            } else if (strcmp(value, "nan:arithmetic") == 0) {
+                return isnan(got->value.f32) && (got->value.uint32 & 0x00400000);
+            }
+            return got->value.uint32 == (uint32_t) strtoull(value, NULL, 10);
+        case I64:
+            return got->value.uint64 == strtoull(value, NULL, 10);
+        case F64:
+            if (strcmp(value, "nan:canonical") == 0) {
+                return (got->value.uint64 & 0x7FFFFFFFFFFFFFFFULL) == 0x7FF8000000000000ULL;
+            } else if (strcmp(value, "nan:arithmetic") == 0) {
+                return isnan(got->value.f64) && (got->value.uint64 & 0x0008000000000000ULL);
+            }
+            return got->value.uint64 == strtoull(value, NULL, 10);
+        default:
+            return false;
+    }
+}
+
+// 执行命令中的动作（调用导出函数或者读取导出的全局变量），成功时返回 true 并将结果放在操作数栈顶
+bool run_action(Instance *inst, JsonValue *action) {
+    Module *m = inst->module;
+    char *type = json_get_str(action, "type");
+    char *field = json_get_str(action, "field");
+    uint32_t handle = field ? resolve_export(m, field) : EXPORT_HANDLE_INVALID;
+
+    inst->sp = -1;
+    inst->fp = -1;
+    inst->csp = -1;
+    if (handle == EXPORT_HANDLE_INVALID) {
+        sprintf(inst->exception, "unknown export");
+        return false;
+    }
+
+    if (strcmp(type, "get") == 0) {
+        if (m->exports[handle].external_kind != KIND_GLOBAL) {
+            sprintf(inst->exception, "export is not a global");
+            return false;
+        }
+        inst->stack[++inst->sp] = *(StackValue *) get_export_by_handle(inst, handle);
+        return true;
+    }
+
+    if (m->exports[handle].external_kind != KIND_FUNCTION) {
+        sprintf(inst->exception, "export is not a function");
+        return false;
+    }
+    JsonValue *args = json_get(action, "args");
+    uint32_t arg_count = args ? args->count : 0;
+    Block *func = get_export_by_handle(inst, handle);
+    if (func->type->param_count != arg_count) {
+        sprintf(inst->exception, "argument count mismatch");
+        return false;
+    }
+    for (uint32_t i = 0; i < arg_count; i++) {
+        if (!parse_value(args->items[i], &inst->stack[++inst->sp])) {
+            sprintf(inst->exception, "unsupported argument type");
+            return false;
+        }
+    }
+    return invoke_export(inst, handle);
+}
+
+// 执行一条命令并检查结果，返回断言是否通过
+bool run_command(Instance *inst, const char *file_name, JsonValue *cmd) {
+    char *type = json_get_str(cmd, "type");
+    JsonValue *action = json_get(cmd, "action");
+    JsonValue *line = json_get(cmd, "line");
+    int line_no = line ? (int) line->num : 0;
+    char value_str[VALUE_STR_SIZE];
+
+    bool ok = run_action(inst, action);
+    if (strcmp(type, "assert_return") == 0 || strcmp(type, "action") == 0) {
+        JsonValue *expected = json_get(cmd, "expected");
+        uint32_t count = expected ? expected->count : 0;
+        if (!ok) {
+            if (verbose) {
+                fprintf(stderr, "%s:%d: %s: unexpected trap: %s\n", file_name, line_no, json_get_str(action, "field"), inst->exception);
+            }
+            return false;
+        }
+        if (strcmp(type, "action") == 0) {
+            return true;
+        }
+        if (inst->sp + 1 != (int) count) {
+            if (verbose) {
+                fprintf(stderr, "%s:%d: %s: expected %u results, got %d\n", file_name, line_no, json_get_str(action, "field"), count, inst->sp + 1);
+            }
+            return false;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            StackValue *got = &inst->stack[i];
+            if (!match_value(expected->items[i], got)) {
+                if (verbose) {
+                    fprintf(stderr, "%s:%d: %s: expected %s:%s, got %s\n", file_name, line_no, json_get_str(action, "field"),
+                            json_get_str(expected->items[i], "value"), json_get_str(expected->items[i], "type"),
+                            value_repr(got, value_str, VALUE_STR_SIZE));
+                }
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // assert_trap 和 assert_exhaustion：调用需要失败，并且异常信息以期望的文本开头
+    char *text = json_get_str(cmd, "text");
+    if (ok || (text && strncmp(inst->exception, text, strlen(text)) != 0)) {
+        if (verbose) {
+            fprintf(stderr, "%s:%d: %s: expected trap '%s', got %s\n", file_name, line_no, json_get_str(action, "field"),
+                    text ? text : "", ok ? "success" : inst->exception);
+        }
+        return false;
+    }
+    return true;
+}
+
+// 在子进程中执行测试段，结果写入共享内存 result
+void run_segment(SpecFile *file, SpecSegment *seg, SpecResult *result) {
+    uint64_t start = spectest_now_ns();
+    int byte_count;
+    uint8_t *bytes = mmap_file(seg->wasm_path, &byte_count);
+    if (!bytes) {
+        ERROR("%s: could not load %s\n", file->name, seg->wasm_path)
+        exit(1);
+    }
+    Options options = {0};
+    Module *m = load_module(bytes, byte_count, options);
+    Instance *inst = instantiate(m);
+
+    for (uint32_t i = 0; i < seg->cmd_count; i++) {
+        if (run_command(inst, file->name, seg->cmds[i])) {
+            result->passed++;
+        } else {
+            result->failed++;
+        }
+        result->done++;
+        result->ns = spectest_now_ns() - start;
+    }
+    result->ns = spectest_now_ns() - start;
+}
+
+// spectest 模块的打印函数，测试中只需要能够调用，不需要真正输出
+bool spectest_print(Instance *inst, StackValue *args, StackValue *results) {
+    (void) inst;
+    (void) args;
+    (void) results;
+    return true;
+}
+
+// 注册测试模块会导入的 spectest 模块（与参考解释器中的定义一致）
+void register_spectest_module(void) {
+    spectest_table.min_size = 10;
+    spectest_table.max_size = 20;
+    spectest_table.cur_size = 10;
+    spectest_table.entries = acalloc(20, sizeof(uint32_t), "spectest table");
+    spectest_memory.min_size = 1;
+    spectest_memory.max_size = 2;
+    spectest_memory.cur_size = 1;
+    spectest_memory.bytes = acalloc(2, PAGE_SIZE, "spectest memory");
+
+    static HostSymbol symbols[] = {
+            {"global_f32", &spectest_global_f32.value},
+            {"global_f64", &spectest_global_f64.value},
+            {"global_i32", &spectest_global_i32.value},
+            {"global_i64", &spectest_global_i64.value},
+            {"memory", &spectest_memory},
+            {"print", (void *) spectest_print},
+            {"print_f32", (void *) spectest_print},
+            {"print_f64", (void *) spectest_print},
+            {"print_f64_f64", (void *) spectest_print},
+            {"print_i32", (void *) spectest_print},
+            {"print_i32_f32", (void *) spectest_print},
+            {"print_i64", (void *) spectest_print},
+            {"table", &spectest_table},
+    };
+    register_host_symbols("spectest", symbols, sizeof(symbols) / sizeof(symbols[0]));
+}
+
+// 加载并解析测试文件 path（即 DIR/NAME.json）
+bool load_spec_file(SpecFile *file, const char *path) {
+    int len;
+    uint8_t *bytes = mmap_file((char *) path, &len);
+    if (!bytes) {
+        return false;
+    }
+    // mmap_file 映射的内存是只读的，拷贝一份用于原地解析
+    char *text = acalloc((size_t) len + 1, 1, "spec json");
+    memcpy(text, bytes, (size_t) len);
+    munmap(bytes, (size_t) len);
+
+    char *p = text;
+    file->doc = json_parse(&p);
+
+    const char *slash = strrchr(path, '/');
+    file->dir = acalloc(PATH_SIZE, 1, "spec dir");
+    if (slash) {
+        snprintf(file->dir, PATH_SIZE, "%.*s", (int) (slash - path), path);
+    } else {
+        snprintf(file->dir, PATH_SIZE, ".");
+    }
+    const char *base = slash ? slash + 1 : path;
+    file->name = acalloc(PATH_SIZE, 1, "spec name");
+    snprintf(file->name, PATH_SIZE, "%.*s", (int) (strlen(base) - strlen(".json")), base);
+    return true;
+}
+
+// 将测试文件按照模块拆分成测试段，返回跳过的命令数量（位于第一个模块之前的命令也计为跳过）
+uint32_t split_segments(SpecFile *file, uint32_t file_idx, SpecSegment **segs, uint32_t *seg_count, uint32_t *capacity) {
+    JsonValue *cmds = json_get(file->doc, "commands");
+    SpecSegment *cur = NULL;
+    uint32_t skipped = 0;
+
+    for (uint32_t i = 0; cmds && i < cmds->count; i++) {
+        JsonValue *cmd = cmds->items[i];
+        char *type = json_get_str(cmd, "type");
+        if (strcmp(type, "module") == 0) {
+            if (*seg_count == *capacity) {
+                uint32_t new_capacity = *capacity ? *capacity * 2 : 256;
+                *segs = arecalloc(*segs, *capacity, new_capacity, sizeof(SpecSegment), "SpecSegment");
+                *capacity = new_capacity;
+            }
+            cur = &(*segs)[(*seg_count)++];
+            cur->file = file_idx;
+            cur->wasm_path = acalloc(PATH_SIZE, 1, "wasm path");
+            snprintf(cur->wasm_path, PATH_SIZE, "%s/%s", file->dir, json_get_str(cmd, "filename"));
+            cur->module_name = json_get_str(cmd, "name");
+            cur->cmds = acalloc(cmds->count - i, sizeof(JsonValue *), "SpecSegment cmds");
+            continue;
+        }
+
+        bool runnable = strcmp(type, "assert_return") == 0 || strcmp(type, "assert_trap") == 0 ||
+                        strcmp(type, "assert_exhaustion") == 0 || strcmp(type, "action") == 0;
+        JsonValue *action = json_get(cmd, "action");
+        char *target = json_get_str(action, "module");
+        if (!cur || !runnable || (target && (!cur->module_name || strcmp(target, cur->module_name) != 0))) {
+            skipped++;
+            continue;
+        }
+        cur->cmds[cur->cmd_count++] = cmd;
+    }
+    return skipped;
+}
+
+// 比较两个测试文件的名称，用于排序
+int compare_spec_name(const void *a, const void *b) {
+    return strcmp(((const SpecFile *) a)->name, ((const SpecFile *) b)->name);
+}
+
+// 读取基线文件，每行为【名称 通过数量 失败数量】，以 # 开头的行为注释，返回条目数量，无法读取时返回 -1
+int load_baseline(const char *path, BaselineEntry **entries) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+    char line[BASELINE_LINE_SIZE];
+    uint32_t count = 0, capacity = 0;
+    *entries = NULL;
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (count == capacity) {
+            uint32_t new_capacity = capacity ? capacity * 2 : 128;
+            *entries = arecalloc(*entries, capacity, new_capacity, sizeof(BaselineEntry), "BaselineEntry");
+            capacity = new_capacity;
+        }
+        BaselineEntry *e = &(*entries)[count];
+        if (sscanf(line, "%255s %u %u", e->name, &e->passed, &e->failed) != 3) {
+            fprintf(stderr, "Malformed baseline line: %s", line);
+            fclose(fp);
+            return -1;
+        }
+        count++;
+    }
+    fclose(fp);
+    return (int) count;
+}
+
+// 将每个测试文件的通过和失败数量写入基线文件，返回是否写入成功
+bool write_baseline(const char *path, SpecFile *files, uint32_t file_count, uint32_t *passed, uint32_t *failed) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        return false;
+    }
+    fprintf(fp, "# wasmc-spectest 基线：每行为【文件名 通过的断言数量 失败的断言数量】，由 wasmc-spectest -w 生成\n");
+    for (uint32_t i = 0; i < file_count; i++) {
+        fprintf(fp, "%s %u %u\n", files[i].name, passed[i], failed[i]);
+    }
+    return fclose(fp) == 0;
+}
+
+// 将每个测试文件的通过和失败数量与基线比较，输出不一致的文件，返回不一致的文件数量
+// 只运行部分文件（all 为 false）时，基线中没有运行的文件不计为不一致
+uint32_t compare_baseline(BaselineEntry *entries, uint32_t entry_count, SpecFile *files, uint32_t file_count,
+                          uint32_t *passed, uint32_t *failed, bool all) {
+    uint32_t changes = 0;
+    for (uint32_t i = 0; i < file_count; i++) {
+        BaselineEntry *e = NULL;
+        for (uint32_t j = 0; j < entry_count && !e; j++) {
+            e = strcmp(entries[j].name, files[i].name) == 0 ? &entries[j] : NULL;
+        }
+        if (!e) {
+            printf("baseline: %s is not in the baseline (passed %u, failed %u)\n", files[i].name, passed[i], failed[i]);
+            changes++;
+            continue;
+        }
+        e->seen = true;
+        if (e->passed != passed[i] || e->failed != failed[i]) {
+            printf("baseline: %s %s: passed %u, failed %u (baseline passed %u, failed %u)\n", files[i].name,
+                   passed[i] < e->passed || failed[i] > e->failed ? "regressed" : "improved", passed[i], failed[i],
+                   e->passed, e->failed);
+            changes++;
+        }
+    }
+    for (uint32_t j = 0; all && j < entry_count; j++) {
+        if (!entries[j].seen) {
+            printf("baseline: %s was not run\n", entries[j].name);
+            changes++;
+        }
+    }
+    return changes;
+}
+
+int main(int argc, char **argv) {
+    const char *root = SPECTEST_DIR;
+    const char *baseline_path = NULL;// 比较的基线文件
+    const char *write_path = NULL;   // 写入的基线文件
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t jobs = cpus > 0 ? (uint32_t) cpus : 1;
+
+    int arg_idx = 1;
+    for (; arg_idx < argc && argv[arg_idx][0] == '-'; arg_idx++) {
+        if (strcmp(argv[arg_idx], "-j") == 0 && arg_idx + 1 < argc) {
+            jobs = (uint32_t) strtoul(argv[++arg_idx], NULL, 0);
+            jobs = jobs ? jobs : 1;
+        } else if (strcmp(argv[arg_idx], "-v") == 0) {
+            verbose = true;
+        } else if (strcmp(argv[arg_idx], "-d") == 0 && arg_idx + 1 < argc) {
+            root = argv[++arg_idx];
+        } else if (strcmp(argv[arg_idx], "-b") == 0 && arg_idx + 1 < argc) {
+            baseline_path = argv[++arg_idx];
+        } else if (strcmp(argv[arg_idx], "-w") == 0 && arg_idx + 1 < argc) {
+            write_path = argv[++arg_idx];
+        } else {
+            fprintf(stderr, "The right usage is:\n%s [-j N] [-v] [-d DIR] [-b FILE] [-w FILE] [NAME|FILE.json ...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // 先读取基线文件，避免运行完所有测试后才发现基线文件无法读取
+    BaselineEntry *baseline = NULL;
+    int baseline_count = 0;
+    if (baseline_path) {
+        baseline_count = load_baseline(baseline_path, &baseline);
+        if (baseline_count < 0) {
+            fprintf(stderr, "Could not load baseline %s\n", baseline_path);
+            return 2;
+        }
+    }
+
+    // 收集测试文件：命令行中指定的名称或者 .json 文件，否则为目录下的所有 NAME/NAME.json
+    char path[PATH_SIZE];
+    uint32_t file_count = 0, file_capacity = 0;
+    SpecFile *files = NULL;
+    char **names = argv + arg_idx;
+    uint32_t name_count = (uint32_t) (argc - arg_idx);
+    DIR *dir = NULL;
+    if (name_count == 0) {
+        dir = opendir(root);
+        if (!dir) {
+            fprintf(stderr, "Could not open %s\n", root);
+            return 2;
+        }
+    }
+    for (uint32_t i = 0;; i++) {
+        const char *name;
+        if (dir) {
+            struct dirent *entry = readdir(dir);
+            if (!entry) {
+                break;
+            }
+            if (entry->d_name[0] == '.') {
+                continue;
+            }
+            name = entry->d_name;
+        } else {
+            if (i >= name_count) {
+                break;
+            }
+            name = names[i];
+        }
+
+        size_t len = strlen(name);
+        if (len > 5 && strcmp(name + len - 5, ".json") == 0) {
+            snprintf(path, PATH_SIZE, "%s", name);
+        } else {
+            snprintf(path, PATH_SIZE, "%s/%s/%s.json", root, name, name);
+        }
+        if (access(path, R_OK) != 0) {
+            if (!dir) {
+                fprintf(stderr, "Could not find %s\n", path);
+                return 2;
+            }
+            continue;
+        }
+        if (file_count == file_capacity) {
+            uint32_t new_capacity = file_capacity ? file_capacity * 2 : 128;
+            files = arecalloc(files, file_capacity, new_capacity, sizeof(SpecFile), "SpecFile");
+            file_capacity = new_capacity;
+        }
+        if (!load_spec_file(&files[file_count], path)) {
+            fprintf(stderr, "Could not load %s\n", path);
+            return 2;
+        }
+        file_count++;
+    }
+    if (dir) {
+        closedir(dir);
+    }
+    qsort(files, file_count, sizeof(SpecFile), compare_spec_name);
+
+    // 拆分测试段
+    SpecSegment *segs = NULL;
+    uint32_t seg_count = 0, seg_capacity = 0;
+    uint32_t *file_skipped = acalloc(file_count ? file_count : 1, sizeof(uint32_t), "file skipped");
+    for (uint32_t i = 0; i < file_count; i++) {
+        file_skipped[i] = split_segments(&files[i], i, &segs, &seg_count, &seg_capacity);
+    }
+
+    // 测试段的结果位于父子进程共享的内存中
+    SpecResult *results = mmap(NULL, (seg_count ? seg_count : 1) * sizeof(SpecResult), PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (results == MAP_FAILED) {
+        FATAL("Could not map shared results\n")
+    }
+    pid_t *pids = acalloc(jobs, sizeof(pid_t), "pids");
+    uint32_t *running = acalloc(jobs, sizeof(uint32_t), "running segments");
+
+    register_spectest_module();
+    fflush(stdout);
+    fflush(stderr);
+
+    // 同时最多运行 jobs 个子进程，每个子进程执行一个测试段
+    uint64_t start = spectest_now_ns();
+    uint32_t next = 0, active = 0;
+    while (next < seg_count || active > 0) {
+        if (next < seg_count && active < jobs) {
+            uint32_t slot = 0;
+            while (pids[slot]) {
+                slot++;
+            }
+            pid_t pid = fork();
+            if (pid < 0) {
+                FATAL("Could not fork\n")
+            }
+            if (pid == 0) {
+                // 加载失败的模块会由解释器输出错误信息，只在需要详细信息时保留
+                if (!verbose) {
+                    freopen("/dev/null", "w", stderr);
+                }
+                run_segment(&files[segs[next].file], &segs[next], &results[next]);
+                fflush(stderr);
+                _exit(0);
+            }
+            pids[slot] = pid;
+            running[slot] = next++;
+            active++;
+            continue;
+        }
+
+        int status;
+        pid_t pid = wait(&status);
+        if (pid < 0) {
+            break;
+        }
+        for (uint32_t slot = 0; slot < jobs; slot++) {
+            if (pids[slot] != pid) {
+                continue;
+            }
+            // 子进程异常退出时（例如模块加载失败），尚未执行的断言计为失败
+            SpecSegment *seg = &segs[running[slot]];
+            SpecResult *r = &results[running[slot]];
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                if (verbose) {
+                    if (WIFSIGNALED(status)) {
+                        fprintf(stderr, "%s: %s killed by signal %d after %u of %u commands\n", files[seg->file].name,
+                                seg->wasm_path, WTERMSIG(status), r->done, seg->cmd_count);
+                    } else {
+                        fprintf(stderr, "%s: %s exited after %u of %u commands\n", files[seg->file].name,
+                                seg->wasm_path, r->done, seg->cmd_count);
+                    }
+                }
+                r->failed += seg->cmd_count - r->done;
+            }
+            pids[slot] = 0;
+            active--;
+            break;
+        }
+    }
+    uint64_t wall = spectest_now_ns() - start;
+
+    // 按照文件汇总结果
+    uint32_t total_passed = 0, total_count = 0, total_skipped = 0;
+    uint32_t *file_passed = acalloc(file_count ? file_count : 1, sizeof(uint32_t), "file passed");
+    uint32_t *file_failed = acalloc(file_count ? file_count : 1, sizeof(uint32_t), "file failed");
+    uint32_t s = 0;
+    printf("%-28s %14s %8s %12s\n", "file", "passed", "skipped", "time(ms)");
+    for (uint32_t i = 0; i < file_count; i++) {
+        uint32_t passed = 0, count = 0;
+        uint64_t ns = 0;
+        for (; s < seg_count && segs[s].file == i; s++) {
+            passed += results[s].passed;
+            count += results[s].passed + results[s].failed;
+            ns += results[s].ns;
+        }
+        printf("%-28s %7u/%-6u %8u %12.3f\n", files[i].name, passed, count, file_skipped[i], (double) ns / 1e6);
+        file_passed[i] = passed;
+        file_failed[i] = count - passed;
+        total_passed += passed;
+        total_count += count;
+        total_skipped += file_skipped[i];
+    }
+    printf("passed %u/%u, skipped %u, files %u, wall %.3f ms (%u jobs)\n", total_passed, total_count, total_skipped,
+           file_count, (double) wall / 1e6, jobs);
+
+    if (write_path && !write_baseline(write_path, files, file_count, file_passed, file_failed)) {
+        fprintf(stderr, "Could not write baseline %s\n", write_path);
+        return 2;
+    }
+    if (baseline_path) {
+        // 与基线不一致（包括修复了失败的断言）时都返回 1，修复后需要用 -w 更新基线
+        uint32_t changes = compare_baseline(baseline, (uint32_t) baseline_count, files, file_count, file_passed,
+                                            file_failed, name_count == 0);
+        printf("baseline: %u of %u files differ from %s\n", changes, file_count, baseline_path);
+        return changes ? 1 : 0;
+    }
+    return total_passed == total_count ? 0 : 1;
+}
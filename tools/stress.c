@@ -0,0 +1,150 @@
+// 多线程压力测试：多个线程同时在同一个模块的不同实例上执行大量调用，检查每次调用的结果以及异常信息，
+// 用于验证解释器是可重入的（运行时状态和异常信息都属于实例，线程之间没有共享的可变状态），通常配合 ThreadSanitizer 构建运行
+//
+// 用法：wasmc-stress [-t N] [-n N] [-d DIR]
+// -t N   线程数量，默认为 8
+// -n N   每个线程的调用轮数，默认为 3000
+// -d DIR 仓库根目录，默认为当前目录（需要其中的 examples/fib.wasm 以及 res/spectest/conversions/conversions.0.wasm）
+//
+// 每个线程各自创建两个实例：一个来自预先编译的 fib 模块，一个来自延迟编译的 conversions 模块（多个线程会同时触发同一个函数的编译），
+// 每轮调用 fib 并检查返回值及其字符串形式，再调用 i32.trunc_f32_s 并轮流触发 NaN 转换陷阱、溢出陷阱和正常截断
+// 全部调用的结果都正确时返回 0，否则输出前几次错误并返回 1
+
+#include "interpreter.h"
+#include "module.h"
+#include "utils.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define STRESS_MAX_THREADS 256 // 最大线程数量
+#define STRESS_REPORT_LIMIT 3  // 最多输出的错误数量
+#define PATH_SIZE 1024         // 文件路径的最大长度
+
+Module *fib_module;      // 预先编译的 fib 模块，所有线程共享
+Module *conv_module;     // 延迟编译的 conversions 模块，所有线程共享
+uint32_t iterations;     // 每个线程的调用轮数
+_Atomic uint32_t errors; // 所有线程出现的错误数量
+
+// fib(10) 到 fib(14) 的期望值
+const uint32_t fib_expected[] = {89, 144, 233, 377, 610};
+
+// 记录一次错误，只输出前 STRESS_REPORT_LIMIT 次错误的详细信息
+void report(long id, const char *what, const char *exception) {
+    if (atomic_fetch_add(&errors, 1) < STRESS_REPORT_LIMIT) {
+        printf("thread %ld: %s (%s)\n", id, what, exception);
+    }
+}
+
+// 以参数 arg 调用实例 inst 中句柄为 handle 的导出函数，返回调用是否成功
+bool call_with(Instance *inst, uint32_t handle, StackValue arg) {
+    inst->sp = -1;
+    inst->fp = -1;
+    inst->csp = -1;
+    inst->exception[0] = '\0';
+    inst->stack[++inst->sp] = arg;
+    return invoke_export(inst, handle);
+}
+
+// 工作线程：在自己的实例上执行 iterations 轮调用，并检查每次调用的结果
+void *stress_worker(void *arg) {
+    long id = (long) arg;
+    Instance *fib_inst = instantiate(fib_module);
+    Instance *conv_inst = instantiate(conv_module);
+    uint32_t fib = resolve_export(fib_module, "fib");
+    uint32_t trunc = resolve_export(conv_module, "i32.trunc_f32_s");
+    char buf[VALUE_STR_SIZE], expected[VALUE_STR_SIZE];
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        // 不同线程错开参数，使同一时刻各个线程执行的调用深度不同
+        uint32_t n = (i + id) % 5;
+        StackValue fib_arg = {.value_type = I32, .value.uint32 = 10 + n};
+        if (!call_with(fib_inst, fib, fib_arg) || fib_inst->stack[fib_inst->sp].value.uint32 != fib_expected[n]) {
+            report(id, "fib returned a wrong result", fib_inst->exception);
+        }
+        snprintf(expected, sizeof(expected), "0x%x:i32", fib_expected[n]);
+        if (strcmp(value_repr(&fib_inst->stack[fib_inst->sp], buf, sizeof(buf)), expected) != 0) {
+            report(id, "value_repr returned a wrong string", buf);
+        }
+
+        // 轮流触发 NaN 转换陷阱、溢出陷阱和正常截断，检查异常信息只来自当前实例
+        uint32_t k = (i + id) % 3;
+        StackValue conv_arg = {.value_type = F32, .value.f32 = k == 0 ? NAN : k == 1 ? 1e10f : -7.5f};
+        bool ok = call_with(conv_inst, trunc, conv_arg);
+        if (k == 0 && (ok || strcmp(conv_inst->exception, "invalid conversion to integer") != 0)) {
+            report(id, "NaN conversion did not trap", conv_inst->exception);
+        } else if (k == 1 && (ok || strcmp(conv_inst->exception, "integer overflow") != 0)) {
+            report(id, "overflowing conversion did not trap", conv_inst->exception);
+        } else if (k == 2 && (!ok || conv_inst->stack[conv_inst->sp].value.int32 != -7)) {
+            report(id, "conversion returned a wrong result", conv_inst->exception);
+        }
+    }
+
+    free_instance(fib_inst);
+    free_instance(conv_inst);
+    return NULL;
+}
+
+// 加载模块，失败时直接退出
+Module *load_stress_module(const char *root, const char *file, bool lazy, uint8_t **bytes, int *byte_count) {
+    char path[PATH_SIZE];
+    snprintf(path, PATH_SIZE, "%s/%s", root, file);
+    *bytes = mmap_file(path, byte_count);
+    if (!*bytes) {
+        FATAL("Could not load %s\n", path)
+    }
+    Options options = {.lazy_compile = lazy};
+    return load_module(*bytes, *byte_count, options);
+}
+
+int main(int argc, char **argv) {
+    const char *root = ".";
+    uint32_t thread_count = 8;
+    iterations = 3000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            thread_count = (uint32_t) strtoul(argv[++i], NULL, 0);
+            thread_count = thread_count ? thread_count : 1;
+            thread_count = thread_count > STRESS_MAX_THREADS ? STRESS_MAX_THREADS : thread_count;
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = (uint32_t) strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            root = argv[++i];
+        } else {
+            fprintf(stderr, "The right usage is:\n%s [-t N] [-n N] [-d DIR]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    uint8_t *fib_bytes, *conv_bytes;
+    int fib_count, conv_count;
+    fib_module = load_stress_module(root, "examples/fib.wasm", false, &fib_bytes, &fib_count);
+    conv_module = load_stress_module(root, "res/spectest/conversions/conversions.0.wasm", true, &conv_bytes, &conv_count);
+
+    pthread_t threads[STRESS_MAX_THREADS];
+    uint32_t created = 0;
+    for (; created < thread_count; created++) {
+        if (pthread_create(&threads[created], NULL, stress_worker, (void *) (long) created) != 0) {
+            break;
+        }
+    }
+    for (uint32_t t = 0; t < created; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    free_module(fib_module);
+    free_module(conv_module);
+    munmap(fib_bytes, fib_count);
+    munmap(conv_bytes, conv_count);
+
+    uint32_t total = atomic_load(&errors);
+    printf("%s: %u threads, %u calls, %u errors\n", total ? "FAIL" : "PASS", created, created * iterations * 2, total);
+    return total ? 1 : 0;
+}